@@ -49,6 +49,128 @@ static GHashTable *fontset_name_hash = NULL;
 #define FONT_IS_8BIT(private) ((FONT_XFONT(private)->min_byte1 == 0) && \
 			       (FONT_XFONT(private)->max_byte1 == 0))
 
+/* Fontset widths are only asked of Xlib the first time a character
+ * is measured; this marks the ones that haven't been yet. */
+#define WIDTH_UNKNOWN G_MINSHORT
+
+/* The metrics of the character byte1, byte2 as XTextWidth() finds
+ * them, or NULL if the font doesn't have it. */
+static XCharStruct *
+gdk_font_char_struct (XFontStruct *xfont,
+		      guint        byte1,
+		      guint        byte2)
+{
+  XCharStruct *cs;
+
+  if (byte1 < xfont->min_byte1 || byte1 > xfont->max_byte1 ||
+      byte2 < xfont->min_char_or_byte2 || byte2 > xfont->max_char_or_byte2)
+    return NULL;
+
+  if (!xfont->per_char)
+    return &xfont->max_bounds;
+
+  cs = &xfont->per_char[(byte1 - xfont->min_byte1) *
+			(xfont->max_char_or_byte2 - xfont->min_char_or_byte2 + 1) +
+			(byte2 - xfont->min_char_or_byte2)];
+
+  if (cs->width == 0 &&
+      (cs->lbearing | cs->rbearing | cs->ascent | cs->descent) == 0)
+    return NULL;
+
+  return cs;
+}
+
+/* Page number page of the width table, made if it isn't there yet.
+ * For a font it comes straight from the per_char metrics, with
+ * missing characters taking the width of the default character. */
+static gint16 *
+gdk_font_width_page (GdkFontPrivate *private,
+		     guint           page)
+{
+  XFontStruct *xfont;
+  XCharStruct *cs;
+  XCharStruct *def;
+  gint16 *widths;
+  guint i;
+
+  if (!private->width_pages)
+    private->width_pages = g_new0 (gint16 *, 256);
+
+  widths = private->width_pages[page];
+  if (widths)
+    return widths;
+
+  widths = g_new (gint16, 256);
+  private->width_pages[page] = widths;
+
+  if (private->font.type == GDK_FONT_FONTSET)
+    {
+      for (i = 0; i < 256; i++)
+	widths[i] = WIDTH_UNKNOWN;
+      return widths;
+    }
+
+  xfont = FONT_XFONT (private);
+  if (FONT_IS_8BIT (private))
+    def = gdk_font_char_struct (xfont, 0, xfont->default_char);
+  else
+    def = gdk_font_char_struct (xfont, xfont->default_char >> 8,
+				xfont->default_char & 0xff);
+
+  for (i = 0; i < 256; i++)
+    {
+      cs = gdk_font_char_struct (xfont, page, i);
+      if (!cs)
+	cs = def;
+      widths[i] = cs ? cs->width : 0;
+    }
+
+  return widths;
+}
+
+/* The width of wc, below 0x10000, in a fontset that can be
+ * tabulated. */
+static gint
+gdk_fontset_wc_width (GdkFontPrivate *private,
+		      GdkWChar        wc)
+{
+  gint16 *widths;
+  wchar_t char_wc;
+
+  widths = gdk_font_width_page (private, wc >> 8);
+  if (widths[wc & 0xff] == WIDTH_UNKNOWN)
+    {
+      char_wc = wc;
+      widths[wc & 0xff] = XwcTextEscapement ((XFontSet) private->xfont,
+					     &char_wc, 1);
+    }
+
+  return widths[wc & 0xff];
+}
+
+/* Sum widths over text, four characters at a time into separate
+ * totals so that the loads and adds don't wait on each other. */
+static gint
+gdk_font_sum_widths (const gint16 *widths,
+		     const guchar *text,
+		     gint          text_length)
+{
+  gint w0 = 0, w1 = 0, w2 = 0, w3 = 0;
+  gint i;
+
+  for (i = 0; i + 4 <= text_length; i += 4)
+    {
+      w0 += widths[text[i]];
+      w1 += widths[text[i + 1]];
+      w2 += widths[text[i + 2]];
+      w3 += widths[text[i + 3]];
+    }
+  for (; i < text_length; i++)
+    w0 += widths[text[i]];
+
+  return w0 + w1 + w2 + w3;
+}
+
 static void
 gdk_font_hash_insert (GdkFontType type, GdkFont *font, const gchar *font_name)
 {
@@ -136,6 +258,8 @@ gdk_font_load (const gchar *font_name)
       private->xfont = xfont;
       private->ref_count = 1;
       private->names = NULL;
+      private->width_pages = NULL;
+      private->no_widths = FALSE;
  
       font = (GdkFont*) private;
       font->type = GDK_FONT_FONT;
@@ -216,6 +340,13 @@ gdk_fontset_load (const gchar *fontset_name)
       font->type = GDK_FONT_FONTSET;
       num_fonts = XFontsOfFontSet (fontset, &font_structs, &font_names);
 
+      private->width_pages = NULL;
+#if defined (XlibSpecificationRelease) && XlibSpecificationRelease >= 6
+      private->no_widths = XContextDependentDrawing (fontset) != False;
+#else
+      private->no_widths = TRUE;
+#endif
+
       font->ascent = font->descent = 0;
       
       for (i = 0; i < num_fonts; i++)
@@ -270,6 +401,15 @@ gdk_font_unref (GdkFont *font)
 	  g_error ("unknown font type.");
 	  break;
 	}
+
+      if (private->width_pages)
+	{
+	  gint i;
+
+	  for (i = 0; i < 256; i++)
+	    g_free (private->width_pages[i]);
+	  g_free (private->width_pages);
+	}
       g_free (font);
     }
 }
@@ -329,38 +469,10 @@ gint
 gdk_string_width (GdkFont     *font,
 		  const gchar *string)
 {
-  GdkFontPrivate *font_private;
-  gint width;
-  XFontStruct *xfont;
-  XFontSet fontset;
-
   g_return_val_if_fail (font != NULL, -1);
   g_return_val_if_fail (string != NULL, -1);
 
-  font_private = (GdkFontPrivate*) font;
-
-  switch (font->type)
-    {
-    case GDK_FONT_FONT:
-      xfont = (XFontStruct *) font_private->xfont;
-      if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
-	{
-	  width = XTextWidth (xfont, string, strlen (string));
-	}
-      else
-	{
-	  width = XTextWidth16 (xfont, (XChar2b *) string, strlen (string) / 2);
-	}
-      break;
-    case GDK_FONT_FONTSET:
-      fontset = (XFontSet) font_private->xfont;
-      width = XmbTextEscapement (fontset, string, strlen(string));
-      break;
-    default:
-      width = 0;
-    }
-
-  return width;
+  return gdk_text_width (font, string, strlen (string));
 }
 
 gint
@@ -384,14 +496,35 @@ gdk_text_width (GdkFont      *font,
       xfont = (XFontStruct *) private->xfont;
       if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
 	{
-	  width = XTextWidth (xfont, text, text_length);
+	  width = gdk_font_sum_widths (gdk_font_width_page (private, 0),
+				       (const guchar *) text, text_length);
 	}
       else
 	{
-	  width = XTextWidth16 (xfont, (XChar2b *) text, text_length / 2);
+	  const XChar2b *text2b = (const XChar2b *) text;
+	  gint i;
+
+	  width = 0;
+	  for (i = 0; i < text_length / 2; i++)
+	    width += gdk_font_width_page (private, text2b[i].byte1)[text2b[i].byte2];
 	}
       break;
     case GDK_FONT_FONTSET:
+      /* ASCII needs no conversion to look up as wide characters */
+      width = 0;
+      if (!private->no_widths)
+	{
+	  gint i;
+
+	  for (i = 0; i < text_length; i++)
+	    {
+	      if ((guchar) text[i] > 0x7f)
+		break;
+	      width += gdk_fontset_wc_width (private, text[i]);
+	    }
+	  if (i == text_length)
+	    break;
+	}
       fontset = (XFontSet) private->xfont;
       width = XmbTextEscapement (fontset, text, text_length);
       break;
@@ -421,6 +554,25 @@ gdk_text_width_wc (GdkFont	  *font,
       {
 	gchar *glyphs;
 	int glyphs_len;
+	gint i;
+
+	/* ASCII in an 8-bit font, or anything in a 16-bit one, is
+	 * looked up without converting to glyphs first. */
+	width = 0;
+	if (FONT_IS_8BIT (private))
+	  {
+	    gint16 *widths = gdk_font_width_page (private, 0);
+
+	    for (i = 0; i < text_length && text[i] <= 0x7f; i++)
+	      width += widths[text[i]];
+	  }
+	else
+	  {
+	    for (i = 0; i < text_length && text[i] <= 0xffff; i++)
+	      width += gdk_font_width_page (private, text[i] >> 8)[text[i] & 0xff];
+	  }
+	if (i == text_length)
+	  break;
 
 	if (_gdk_font_wc_to_glyphs (font, text, text_length,
 				    &glyphs, &glyphs_len))
@@ -434,6 +586,16 @@ gdk_text_width_wc (GdkFont	  *font,
 	break;
       }
     case GDK_FONT_FONTSET:
+      if (!private->no_widths)
+	{
+	  gint i;
+
+	  width = 0;
+	  for (i = 0; i < text_length && text[i] <= 0xffff; i++)
+	    width += gdk_fontset_wc_width (private, text[i]);
+	  if (i == text_length)
+	    break;
+	}
       if (sizeof(GdkWChar) == sizeof(wchar_t))
 	{
 	  fontset = (XFontSet) private->xfont;
@@ -464,7 +626,6 @@ gdk_char_width (GdkFont *font,
   GdkFontPrivate *private;
   XCharStruct *chars;
   gint width;
-  XFontStruct *xfont;
   XFontSet fontset;
 
   g_return_val_if_fail (font != NULL, -1);
@@ -474,11 +635,16 @@ gdk_char_width (GdkFont *font,
   switch (font->type)
     {
     case GDK_FONT_FONT:
-      /* only 8 bits characters are considered here */
-      xfont = (XFontStruct *) private->xfont;
-      width = XTextWidth (xfont, &character, 1);
+      /* only 8 bits characters are considered here; XTextWidth()
+       * takes them from row 0 of a 16-bit font too */
+      width = gdk_font_width_page (private, 0)[(guchar) character];
       break;
     case GDK_FONT_FONTSET:
+      if (!private->no_widths && (guchar) character <= 0x7f)
+	{
+	  width = gdk_fontset_wc_width (private, character);
+	  break;
+	}
       fontset = (XFontSet) private->xfont;
       width = XmbTextEscapement (fontset, &character, 1) ;
       break;
@@ -517,6 +683,12 @@ gdk_char_width_wc (GdkFont *font,
 	  gchar *glyphs;
 	  int glyphs_len;
 
+	  if (FONT_IS_8BIT (private) ? character <= 0x7f : character <= 0xffff)
+	    {
+	      width = gdk_font_width_page (private, character >> 8)[character & 0xff];
+	      break;
+	    }
+
 	  if (_gdk_font_wc_to_glyphs (font, &character, 1, &glyphs, &glyphs_len))
 	    {
 	      width = gdk_text_width (font, glyphs, glyphs_len);
@@ -528,6 +700,11 @@ gdk_char_width_wc (GdkFont *font,
 	  break;
 	}
     case GDK_FONT_FONTSET:
+      if (!private->no_widths && character <= 0xffff)
+	{
+	  width = gdk_fontset_wc_width (private, character);
+	  break;
+	}
       fontset = (XFontSet) private->xfont;
       {
 	wchar_t char_wc = character;
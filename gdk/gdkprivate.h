@@ -148,6 +148,12 @@ struct _GdkFontPrivate
   guint ref_count;
 
   GSList *names;
+
+  /* Advance widths of characters (of wide characters for a fontset),
+   * in pages of 256 made as they are first needed.  A fontset whose
+   * drawing depends on context can't be tabulated and sets no_widths. */
+  gint16 **width_pages;
+  guint no_widths : 1;
 };
 
 struct _GdkCursorPrivate
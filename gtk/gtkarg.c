@@ -31,10 +31,12 @@
 
 
 #define	MAX_ARG_LENGTH	(256)
+#define	MAX_CACHED_INFOS (1024)
 
 
 /* --- typedefs --- */
 typedef struct _GtkArgQueryData	GtkArgQueryData;
+typedef struct _GtkArgInfoCacheKey GtkArgInfoCacheKey;
 
 
 /* --- structures --- */
@@ -44,6 +46,106 @@ struct _GtkArgQueryData
   GtkType class_type;
 };
 
+/* gtk_arg_get_info() caches the results of argument name lookups,
+ * so repeated "GtkWidget::visible"-style names don't need to be
+ * parsed and searched for throughout the class ancestry again.
+ */
+struct _GtkArgInfoCacheKey
+{
+  GHashTable *arg_info_hash_table;
+  GtkType object_type;
+  gchar *arg_name;
+  GtkArgInfo *info;
+};
+
+
+/* --- variables --- */
+static GHashTable *arg_info_cache_ht = NULL;
+
+
+/* --- arg info cache --- */
+static guint
+gtk_arg_info_cache_hash (gconstpointer key)
+{
+  const GtkArgInfoCacheKey *ckey = key;
+
+  return (g_str_hash (ckey->arg_name) ^
+	  (ckey->object_type >> 8) ^
+	  GPOINTER_TO_UINT (ckey->arg_info_hash_table));
+}
+
+static gint
+gtk_arg_info_cache_equal (gconstpointer key_1,
+			  gconstpointer key_2)
+{
+  const GtkArgInfoCacheKey *ckey_1 = key_1;
+  const GtkArgInfoCacheKey *ckey_2 = key_2;
+
+  return (ckey_1->object_type == ckey_2->object_type &&
+	  ckey_1->arg_info_hash_table == ckey_2->arg_info_hash_table &&
+	  strcmp (ckey_1->arg_name, ckey_2->arg_name) == 0);
+}
+
+static gboolean
+gtk_arg_info_cache_free_key (gpointer key,
+			     gpointer value,
+			     gpointer user_data)
+{
+  GtkArgInfoCacheKey *ckey = key;
+
+  g_free (ckey->arg_name);
+  g_free (ckey);
+
+  return TRUE;
+}
+
+static void
+gtk_arg_info_cache_flush (void)
+{
+  if (arg_info_cache_ht)
+    g_hash_table_foreach_remove (arg_info_cache_ht, gtk_arg_info_cache_free_key, NULL);
+}
+
+static GtkArgInfo*
+gtk_arg_info_cache_lookup (GtkType	object_type,
+			   GHashTable  *arg_info_hash_table,
+			   const gchar *arg_name)
+{
+  GtkArgInfoCacheKey key, *ckey;
+
+  if (!arg_info_cache_ht)
+    return NULL;
+
+  key.arg_info_hash_table = arg_info_hash_table;
+  key.object_type = object_type;
+  key.arg_name = (gchar*) arg_name;
+  ckey = g_hash_table_lookup (arg_info_cache_ht, &key);
+
+  return ckey ? ckey->info : NULL;
+}
+
+static void
+gtk_arg_info_cache_insert (GtkType	object_type,
+			   GHashTable  *arg_info_hash_table,
+			   const gchar *arg_name,
+			   GtkArgInfo  *info)
+{
+  GtkArgInfoCacheKey *ckey;
+
+  if (!arg_info_cache_ht)
+    arg_info_cache_ht = g_hash_table_new (gtk_arg_info_cache_hash,
+					  gtk_arg_info_cache_equal);
+  else if (g_hash_table_size (arg_info_cache_ht) >= MAX_CACHED_INFOS)
+    gtk_arg_info_cache_flush ();
+
+  ckey = g_new (GtkArgInfoCacheKey, 1);
+  ckey->arg_info_hash_table = arg_info_hash_table;
+  ckey->object_type = object_type;
+  ckey->arg_name = g_strdup (arg_name);
+  ckey->info = info;
+  g_hash_table_insert (arg_info_cache_ht, ckey, ckey);
+}
+
 
 
 /* --- functions --- */
@@ -111,6 +213,10 @@ gtk_arg_type_new_static (GtkType      base_class_type,
 
   g_hash_table_insert (arg_info_hash_table, info, info);
 
+  /* a new argument may shadow one that an ancestor class introduced
+   */
+  gtk_arg_info_cache_flush ();
+
   return info;
 }
 
@@ -151,6 +257,7 @@ gtk_arg_get_info (GtkType       object_type,
 {
   GtkType otype;
   gchar buffer[MAX_ARG_LENGTH];
+  const gchar *full_name;
   guint len;
   gchar *p;
   
@@ -161,6 +268,11 @@ gtk_arg_get_info (GtkType       object_type,
   if (!arg_name || strlen (arg_name) > MAX_ARG_LENGTH - 8)
     return g_strdup ("argument name exceeds maximum size.");
 
+  *info_p = gtk_arg_info_cache_lookup (object_type, arg_info_hash_table, arg_name);
+  if (*info_p)
+    return NULL;
+  full_name = arg_name;
+
   /* split off the object-type part
    */
   p = strchr (arg_name, ':');
@@ -235,6 +347,8 @@ gtk_arg_get_info (GtkType       object_type,
 			"' class ancestry",
 			NULL);
 
+  gtk_arg_info_cache_insert (object_type, arg_info_hash_table, full_name, *info_p);
+
   return NULL;
 }
 
@@ -84,6 +84,7 @@ gtk_button_box_init (GtkButtonBox *button_box)
 
 /* set default values for child size and child internal padding */
 /* default spacing is in defined in subclasses */
+/* boxes that are already shown only pick up new defaults when resized */
 
 void gtk_button_box_set_child_size_default (gint width, gint height)
 {
@@ -115,29 +116,58 @@ void gtk_button_box_get_child_ipadding_default (gint *ipad_x, gint *ipad_y)
 
 void gtk_button_box_set_spacing (GtkButtonBox *widget, gint spacing)
 {
-  widget->spacing = spacing;
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_BUTTON_BOX (widget));
+
+  if (widget->spacing != spacing)
+    {
+      widget->spacing = spacing;
+      gtk_widget_queue_resize (GTK_WIDGET (widget));
+    }
 }
 
 void gtk_button_box_set_child_size (GtkButtonBox *widget, gint width, gint height)
 {
-  widget->child_min_width = width;
-  widget->child_min_height = height;
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_BUTTON_BOX (widget));
+
+  if (widget->child_min_width != width ||
+      widget->child_min_height != height)
+    {
+      widget->child_min_width = width;
+      widget->child_min_height = height;
+      gtk_widget_queue_resize (GTK_WIDGET (widget));
+    }
 }
 
 void gtk_button_box_set_child_ipadding (GtkButtonBox *widget,
 					gint ipad_x, gint ipad_y)
 {
-  widget->child_ipad_x = ipad_x;
-  widget->child_ipad_y = ipad_y;
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_BUTTON_BOX (widget));
+
+  if (widget->child_ipad_x != ipad_x ||
+      widget->child_ipad_y != ipad_y)
+    {
+      widget->child_ipad_x = ipad_x;
+      widget->child_ipad_y = ipad_y;
+      gtk_widget_queue_resize (GTK_WIDGET (widget));
+    }
 }
 
 void gtk_button_box_set_layout (GtkButtonBox *widget, 
 				GtkButtonBoxStyle layout_style)
 {
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_BUTTON_BOX (widget));
   g_return_if_fail (layout_style >= GTK_BUTTONBOX_DEFAULT_STYLE &&
 		    layout_style <= GTK_BUTTONBOX_END);
 
-  widget->layout_style = layout_style;
+  if (widget->layout_style != layout_style)
+    {
+      widget->layout_style = layout_style;
+      gtk_widget_queue_resize (GTK_WIDGET (widget));
+    }
 }
 
 
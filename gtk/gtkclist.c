@@ -33,6 +33,7 @@
 #include "gtkbindings.h"
 #include "gtkdnd.h"
 #include "gtkwindow.h"
+#include "gtkprivate.h"
 #include <gdk/gdkx.h>
 #include <gdk/gdkkeysyms.h>
 
@@ -125,9 +126,7 @@ LIST_WIDTH (GtkCList * clist)
 }
 
 /* returns the GList item for the nth row */
-#define	ROW_ELEMENT(clist, row)	(((row) == (clist)->rows - 1) ? \
-				 (clist)->row_list_end : \
-				 g_list_nth ((clist)->row_list, (row)))
+#define	ROW_ELEMENT(clist, row)	_gtk_clist_row_element ((clist), (row))
 
 
 #define GTK_CLIST_CLASS_FW(_widget_) GTK_CLIST_CLASS (((GtkObject*) (_widget_))->klass)
@@ -178,6 +177,99 @@ enum {
   ARG_SORT_TYPE
 };
 
+/* most row_list elements a block of the row index holds */
+#define ROW_BLOCK_SIZE 256
+
+typedef struct _GtkCListRowBlock GtkCListRowBlock;
+typedef struct _GtkCListPrivate  GtkCListPrivate;
+
+struct _GtkCListRowBlock
+{
+  gint   length;
+  GList *rows[ROW_BLOCK_SIZE];
+};
+
+struct _GtkCListPrivate
+{
+  /* the row_list elements of the first n_indexed rows, in blocks.
+   * row_block_sums is a Fenwick tree over the block lengths, node i
+   * (counting from 1) summing up the blocks i - (i & -i) to i - 1 */
+  GtkCListRowBlock **row_blocks;
+  gint              *row_block_sums;
+  gint               n_row_blocks;
+  gint               row_blocks_size;
+  gint               n_indexed;
+
+  /* virtual mode: rows aren't stored, ROW_ELEMENT hands out
+   * virtual_link/virtual_row set up for the requested row */
+  GtkCListVirtualFunc virtual_func;
+  gpointer            virtual_data;
+  GtkDestroyNotify    virtual_destroy;
+  GtkCListRow        *virtual_row;
+  GList               virtual_link;
+  gchar             **virtual_text;
+  GHashTable         *virtual_states;
+
+  /* columns default_compare sorts by number, NULL if none */
+  gboolean           *sort_numeric;
+
+  /* per auto_resize column, a tree counting the rows of each cell
+   * width (widest first), so the optimal width is always at hand.
+   * NULL entries are rebuilt on demand. */
+  GTree             **cell_widths;
+  gint                n_cell_widths;
+
+  /* the rows in clist->selection as sorted, disjoint runs, run i
+   * covering the rows sel_runs[2 * i] to sel_runs[2 * i + 1] */
+  gint               *sel_runs;
+  gint                n_sel_runs;
+  gint                sel_runs_size;
+
+  /* row data -> first row holding it, plus one.  Rows with NULL
+   * data aren't entered.  NULL while out of date. */
+  gboolean            row_data_indexed;
+  GHashTable         *row_data_index;
+};
+
+typedef struct _GtkCListSortEntry GtkCListSortEntry;
+
+/* a row together with the key default_compare would extract from it */
+struct _GtkCListSortEntry
+{
+  GList   *list;
+  gint     kind;
+  gchar   *text;
+  gdouble  number;
+};
+
+enum {
+  SORT_KEY_NONE,
+  SORT_KEY_NUMBER,
+  SORT_KEY_TEXT
+};
+
+typedef struct _GtkCListDrawCell GtkCListDrawCell;
+
+/* a cell on its way to the screen, see draw_rows_batched() */
+struct _GtkCListDrawCell
+{
+  GtkCListRow  *row;
+  gint          column;
+  GtkStyle     *style;
+  GdkGC        *fg_gc;
+  GdkGC        *bg_gc;
+  GdkRectangle  background;
+  GdkRectangle  clip;
+  gint          baseline;
+  gint          text_x;
+  gint          text_width;
+  gchar        *text;
+  gboolean      own_clip;
+  gboolean      fits;
+};
+
+#define CLIST_VIRTUAL(clist) (gtk_clist_get_private (clist)->virtual_func != NULL)
+
 /* GtkCList Methods */
 static void gtk_clist_class_init (GtkCListClass *klass);
 static void gtk_clist_init       (GtkCList      *clist);
@@ -281,6 +373,37 @@ static void update_extended_selection (GtkCList      *clist,
 static GList *selection_find          (GtkCList      *clist,
 			               gint           row_number,
 			               GList         *row_list_element);
+static gint selection_run_find        (GtkCListPrivate *private,
+				       gint           row);
+static gboolean selection_runs_contain (GtkCList    *clist,
+					gint         row);
+static void selection_runs_add        (GtkCList      *clist,
+				       gint           start,
+				       gint           end);
+static void selection_runs_remove     (GtkCList      *clist,
+				       gint           start,
+				       gint           end);
+static void selection_runs_shift      (GtkCList      *clist,
+				       gint           row,
+				       gint           d);
+static void selection_runs_rebuild    (GtkCList      *clist);
+static gboolean selection_signals_needed (GtkCList   *clist);
+static void selection_select_range    (GtkCList      *clist,
+				       gint           start,
+				       gint           end);
+static void selection_unselect_range  (GtkCList      *clist,
+				       gint           start,
+				       gint           end);
+static void selection_list_rebuild    (GtkCList      *clist);
+
+/* Row data index */
+static void row_data_index_invalidate (GtkCList      *clist);
+static void row_data_index_add        (GtkCList      *clist,
+				       gint           row,
+				       gpointer       data);
+static void row_data_index_remove     (GtkCList      *clist,
+				       gint           row,
+				       gpointer       data);
 static void real_select_all           (GtkCList      *clist);
 static void real_unselect_all         (GtkCList      *clist);
 static void move_vertical             (GtkCList      *clist,
@@ -345,6 +468,14 @@ static void column_auto_resize        (GtkCList       *clist,
 				       GtkCListRow    *clist_row,
 				       gint            column,
 				       gint            old_width);
+static void cell_widths_invalidate    (GtkCList       *clist,
+				       gint            column);
+static void cell_widths_update        (GtkCList       *clist,
+				       gint            column,
+				       gint            old_width,
+				       gint            new_width);
+static gint cell_widths_max           (GtkCList       *clist,
+				       gint            column);
 static void real_resize_column        (GtkCList       *clist,
 				       gint            column,
 				       gint            width);
@@ -399,6 +530,10 @@ static void draw_row         (GtkCList      *clist,
 			      GtkCListRow   *clist_row);
 static void draw_rows        (GtkCList      *clist,
 			      GdkRectangle  *area);
+static void draw_rows_batched (GtkCList     *clist,
+			       GdkRectangle *area,
+			       gint          first_row,
+			       gint          last_row);
 static void clist_refresh    (GtkCList      *clist);
 static void draw_drag_highlight (GtkCList        *clist,
 				 GtkCListRow     *dest_row,
@@ -440,12 +575,24 @@ static gint default_compare        (GtkCList      *clist,
 			            gconstpointer  row1,
 			            gconstpointer  row2);
 static void real_sort_list         (GtkCList      *clist);
-static GList *gtk_clist_merge      (GtkCList      *clist,
-				    GList         *a,
-				    GList         *b);
-static GList *gtk_clist_mergesort  (GtkCList      *clist,
-				    GList         *list,
-				    gint           num);
+/* Row index */
+static GtkCListPrivate *gtk_clist_get_private (GtkCList *clist);
+static void row_index_append          (GtkCListPrivate *private,
+				       GList           *list);
+static void row_index_insert          (GtkCListPrivate *private,
+				       gint             row,
+				       GList           *list,
+				       gint             n_rows);
+static void row_index_remove          (GtkCListPrivate *private,
+				       gint             row,
+				       gint             n_rows);
+static GtkCListRow *row_get           (GtkCList  *clist,
+				       gint       row);
+static void row_set_state             (GtkCList    *clist,
+				       gint         row,
+				       GtkCListRow *clist_row,
+				       GtkStateType state);
+
 /* Misc */
 static gboolean title_focus           (GtkCList  *clist,
 			               gint       dir);
@@ -465,6 +612,9 @@ static void drag_dest_cell            (GtkCList         *clist,
 static GtkContainerClass *parent_class = NULL;
 static guint clist_signals[LAST_SIGNAL] = {0};
 
+static const gchar *private_key = "gtk-clist-private";
+static guint        private_key_id = 0;
+
 static GtkTargetEntry clist_target_table = { "gtk-clist-drag-reorder", 0, 0};
 
 GtkType
@@ -506,6 +656,8 @@ gtk_clist_class_init (GtkCListClass *klass)
 
   parent_class = gtk_type_class (GTK_TYPE_CONTAINER);
 
+  private_key_id = g_quark_from_static_string (private_key);
+
   gtk_object_add_arg_type ("GtkCList::n_columns",
 			   GTK_TYPE_UINT,
 			   GTK_ARG_READWRITE | GTK_ARG_CONSTRUCT_ONLY,
@@ -922,9 +1074,54 @@ gtk_clist_get_arg (GtkObject      *object,
     }
 }
 
+static void
+gtk_clist_private_destroy (GtkCListPrivate *private)
+{
+  gint i;
+
+  if (private->virtual_destroy)
+    private->virtual_destroy (private->virtual_data);
+  if (private->virtual_states)
+    g_hash_table_destroy (private->virtual_states);
+  if (private->virtual_row)
+    {
+      g_free (private->virtual_row->cell);
+      g_free (private->virtual_row);
+    }
+  g_free (private->virtual_text);
+  g_free (private->sort_numeric);
+  for (i = 0; i < private->n_row_blocks; i++)
+    g_free (private->row_blocks[i]);
+  g_free (private->row_blocks);
+  g_free (private->row_block_sums);
+  g_free (private->sel_runs);
+  if (private->row_data_index)
+    g_hash_table_destroy (private->row_data_index);
+  if (private->cell_widths)
+    {
+      for (i = 0; i < private->n_cell_widths; i++)
+	if (private->cell_widths[i])
+	  g_tree_destroy (private->cell_widths[i]);
+      g_free (private->cell_widths);
+    }
+  g_free (private);
+}
+
+static GtkCListPrivate *
+gtk_clist_get_private (GtkCList *clist)
+{
+  return gtk_object_get_data_by_id (GTK_OBJECT (clist), private_key_id);
+}
+
 static void
 gtk_clist_init (GtkCList *clist)
 {
+  GtkCListPrivate *private;
+
+  private = g_new0 (GtkCListPrivate, 1);
+  gtk_object_set_data_by_id_full (GTK_OBJECT (clist), private_key_id, private,
+				  (GtkDestroyNotify) gtk_clist_private_destroy);
+
   clist->flags = 0;
 
   GTK_WIDGET_UNSET_FLAGS (clist, GTK_NO_WINDOW);
@@ -1634,7 +1831,9 @@ gtk_clist_set_column_auto_resize (GtkCList *clist,
     return;
 
   clist->column[column].auto_resize = auto_resize;
-  if (auto_resize)
+  if (!auto_resize)
+    cell_widths_invalidate (clist, column);
+  else
     {
       clist->column[column].resizeable = FALSE;
       if (!GTK_CLIST_AUTO_RESIZE_BLOCKED(clist))
@@ -1696,6 +1895,9 @@ gtk_clist_optimal_column_width (GtkCList *clist,
   else
     width = 0;
 
+  if (clist->column[column].auto_resize)
+    return MAX (width, cell_widths_max (clist, column));
+
   for (list = clist->row_list; list; list = list->next)
     {
       GTK_CLIST_CLASS_FW (clist)->cell_size_request
@@ -1768,6 +1970,9 @@ gtk_clist_set_column_max_width (GtkCList *clist,
 }
 
 /* PRIVATE COLUMN FUNCTIONS
+ *   cell_widths_invalidate
+ *   cell_widths_update
+ *   cell_widths_max
  *   column_auto_resize
  *   real_resize_column
  *   abort_column_resize
@@ -1780,6 +1985,137 @@ gtk_clist_set_column_max_width (GtkCList *clist,
  *   column_button_clicked
  *   column_title_passive_func
  */
+/* The cell width trees are only kept for rows whose cells are set
+ * through our own set_cell_contents.  Subclasses like GtkCTree keep
+ * rows outside of row_list and resize their columns themselves. */
+#define CLIST_TRACKS_WIDTHS(clist) \
+  (GTK_CLIST_CLASS_FW (clist)->set_cell_contents == set_cell_contents)
+
+static gint
+cell_width_compare (gconstpointer a,
+		    gconstpointer b)
+{
+  return GPOINTER_TO_INT (b) - GPOINTER_TO_INT (a);
+}
+
+static gint
+cell_width_first (gpointer key,
+		  gpointer value,
+		  gpointer data)
+{
+  *(gint *) data = GPOINTER_TO_INT (key);
+  return TRUE;
+}
+
+static void
+cell_width_add (GTree *tree,
+		gint   width,
+		gint   delta)
+{
+  gint count;
+
+  /* empty cells don't count */
+  if (width <= 0)
+    return;
+
+  count = GPOINTER_TO_INT (g_tree_lookup (tree, GINT_TO_POINTER (width)));
+  count += delta;
+  if (count > 0)
+    g_tree_insert (tree, GINT_TO_POINTER (width), GINT_TO_POINTER (count));
+  else
+    g_tree_remove (tree, GINT_TO_POINTER (width));
+}
+
+static void
+cell_widths_invalidate (GtkCList *clist,
+			gint      column)
+{
+  GtkCListPrivate *private;
+  gint i;
+
+  private = gtk_clist_get_private (clist);
+  if (!private->cell_widths)
+    return;
+
+  for (i = 0; i < private->n_cell_widths; i++)
+    if ((column < 0 || i == column) && private->cell_widths[i])
+      {
+	g_tree_destroy (private->cell_widths[i]);
+	private->cell_widths[i] = NULL;
+      }
+}
+
+/* a cell of column changed from old_width to new_width, a width of
+ * 0 stands for a cell that doesn't exist (yet) */
+static void
+cell_widths_update (GtkCList *clist,
+		    gint      column,
+		    gint      old_width,
+		    gint      new_width)
+{
+  GtkCListPrivate *private;
+  GTree *tree;
+
+  private = gtk_clist_get_private (clist);
+  if (!private->cell_widths || old_width == new_width)
+    return;
+
+  tree = private->cell_widths[column];
+  if (tree)
+    {
+      cell_width_add (tree, old_width, -1);
+      cell_width_add (tree, new_width, 1);
+    }
+}
+
+/* widest cell of column, not counting the title */
+static gint
+cell_widths_max (GtkCList *clist,
+		 gint      column)
+{
+  GtkCListPrivate *private;
+  GtkRequisition requisition;
+  GList *list;
+  GTree *tree;
+  gint width = 0;
+
+  if (!CLIST_TRACKS_WIDTHS (clist))
+    {
+      for (list = clist->row_list; list; list = list->next)
+	{
+	  GTK_CLIST_CLASS_FW (clist)->cell_size_request
+	    (clist, GTK_CLIST_ROW (list), column, &requisition);
+	  width = MAX (width, requisition.width);
+	}
+      return width;
+    }
+
+  private = gtk_clist_get_private (clist);
+  if (!private->cell_widths)
+    {
+      private->n_cell_widths = clist->columns;
+      private->cell_widths = g_new0 (GTree *, clist->columns);
+    }
+
+  tree = private->cell_widths[column];
+  if (!tree)
+    {
+      tree = g_tree_new (cell_width_compare);
+      for (list = clist->row_list; list; list = list->next)
+	{
+	  GTK_CLIST_CLASS_FW (clist)->cell_size_request
+	    (clist, GTK_CLIST_ROW (list), column, &requisition);
+	  cell_width_add (tree, requisition.width, 1);
+	}
+      private->cell_widths[column] = tree;
+    }
+
+  /* the tree is sorted widest first */
+  g_tree_traverse (tree, cell_width_first, G_IN_ORDER, &width);
+
+  return width;
+}
+
 static void
 column_auto_resize (GtkCList    *clist,
 		    GtkCListRow *clist_row,
@@ -1789,9 +2125,14 @@ column_auto_resize (GtkCList    *clist,
   /* resize column if needed for auto_resize */
   GtkRequisition requisition;
 
-  if (!clist->column[column].auto_resize ||
-      GTK_CLIST_AUTO_RESIZE_BLOCKED(clist))
+  if (!clist->column[column].auto_resize)
     return;
+  if (GTK_CLIST_AUTO_RESIZE_BLOCKED(clist))
+    {
+      /* old_width wasn't measured, so we lose track of this column */
+      cell_widths_invalidate (clist, column);
+      return;
+    }
 
   if (clist_row)
     GTK_CLIST_CLASS_FW (clist)->cell_size_request (clist, clist_row,
@@ -1799,30 +2140,22 @@ column_auto_resize (GtkCList    *clist,
   else
     requisition.width = 0;
 
+  cell_widths_update (clist, column, old_width, requisition.width);
+
   if (requisition.width > clist->column[column].width)
     gtk_clist_set_column_width (clist, column, requisition.width);
   else if (requisition.width < old_width &&
 	   old_width == clist->column[column].width)
     {
-      GList *list;
-      gint new_width = 0;
+      gint new_width;
 
-      /* run a "gtk_clist_optimal_column_width" but break, if
-       * the column doesn't shrink */
       if (GTK_CLIST_SHOW_TITLES(clist) && clist->column[column].button)
 	new_width = (clist->column[column].button->requisition.width -
 		     (CELL_SPACING + (2 * COLUMN_INSET)));
       else
 	new_width = 0;
 
-      for (list = clist->row_list; list; list = list->next)
-	{
-	  GTK_CLIST_CLASS_FW (clist)->cell_size_request
-	    (clist, GTK_CLIST_ROW (list), column, &requisition);
-	  new_width = MAX (new_width, requisition.width);
-	  if (new_width == clist->column[column].width)
-	    break;
-	}
+      new_width = MAX (new_width, cell_widths_max (clist, column));
       if (new_width < clist->column[column].width)
 	gtk_clist_set_column_width
 	  (clist, column, MAX (new_width, clist->column[column].min_width));
@@ -2212,7 +2545,7 @@ gtk_clist_get_cell_type (GtkCList *clist,
   if (column < 0 || column >= clist->columns)
     return -1;
 
-  clist_row = ROW_ELEMENT (clist, row)->data;
+  clist_row = row_get (clist, row);
 
   return clist_row->cell[column].type;
 }
@@ -2263,7 +2596,7 @@ gtk_clist_get_text (GtkCList  *clist,
   if (column < 0 || column >= clist->columns)
     return 0;
 
-  clist_row = ROW_ELEMENT (clist, row)->data;
+  clist_row = row_get (clist, row);
 
   if (clist_row->cell[column].type != GTK_CELL_TEXT)
     return 0;
@@ -2325,7 +2658,7 @@ gtk_clist_get_pixmap (GtkCList   *clist,
   if (column < 0 || column >= clist->columns)
     return 0;
 
-  clist_row = ROW_ELEMENT (clist, row)->data;
+  clist_row = row_get (clist, row);
 
   if (clist_row->cell[column].type != GTK_CELL_PIXMAP)
     return 0;
@@ -2393,7 +2726,7 @@ gtk_clist_get_pixtext (GtkCList   *clist,
   if (column < 0 || column >= clist->columns)
     return 0;
 
-  clist_row = ROW_ELEMENT (clist, row)->data;
+  clist_row = row_get (clist, row);
 
   if (clist_row->cell[column].type != GTK_CELL_PIXTEXT)
     return 0;
@@ -2424,6 +2757,7 @@ gtk_clist_set_shift (GtkCList *clist,
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (row < 0 || row >= clist->rows)
     return;
@@ -2468,6 +2802,7 @@ set_cell_contents (GtkCList    *clist,
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
   g_return_if_fail (clist_row != NULL);
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (clist->column[column].auto_resize &&
       !GTK_CLIST_AUTO_RESIZE_BLOCKED(clist))
@@ -2533,8 +2868,7 @@ set_cell_contents (GtkCList    *clist,
       break;
     }
 
-  if (clist->column[column].auto_resize &&
-      !GTK_CLIST_AUTO_RESIZE_BLOCKED(clist))
+  if (clist->column[column].auto_resize)
     column_auto_resize (clist, clist_row, column, requisition.width);
 
   if (old_text)
@@ -2601,6 +2935,7 @@ cell_size_request (GtkCList       *clist,
  *   gtk_clist_prepend
  *   gtk_clist_append
  *   gtk_clist_insert
+ *   gtk_clist_append_rows
  *   gtk_clist_remove
  *   gtk_clist_clear
  */
@@ -2641,161 +2976,939 @@ gtk_clist_insert (GtkCList    *clist,
   return GTK_CLIST_CLASS_FW (clist)->insert_row (clist, row, text);
 }
 
-void
-gtk_clist_remove (GtkCList *clist,
-		  gint      row)
-{
-  GTK_CLIST_CLASS_FW (clist)->remove_row (clist, row);
-}
-
-void
-gtk_clist_clear (GtkCList *clist)
-{
-  g_return_if_fail (clist != NULL);
-  g_return_if_fail (GTK_IS_CLIST (clist));
-  
-  GTK_CLIST_CLASS_FW (clist)->clear (clist);
-}
-
-/* PRIVATE INSERT/REMOVE ROW FUNCTIONS
- *   real_insert_row
- *   real_remove_row
- *   real_clear
- *   real_row_move
- */
-static gint
-real_insert_row (GtkCList *clist,
-		 gint      row,
-		 gchar    *text[])
+gint
+gtk_clist_append_rows (GtkCList  *clist,
+		       gchar    **text[],
+		       gint       n_rows)
 {
-  gint i;
+  GtkCListPrivate *private;
+  GtkRequisition requisition;
   GtkCListRow *clist_row;
+  GList *list;
+  GTree **cell_widths = NULL;
+  gboolean resize;
+  gint *max_width;
+  gint first;
+  gint i;
+  gint j;
 
   g_return_val_if_fail (clist != NULL, -1);
   g_return_val_if_fail (GTK_IS_CLIST (clist), -1);
   g_return_val_if_fail (text != NULL, -1);
+  g_return_val_if_fail (!CLIST_VIRTUAL (clist), -1);
 
-  /* return if out of bounds */
-  if (row < 0 || row > clist->rows)
+  if (n_rows <= 0)
     return -1;
 
-  /* create the row */
-  clist_row = row_new (clist);
+  first = clist->rows;
 
-  /* set the text in the row's columns */
-  for (i = 0; i < clist->columns; i++)
-    if (text[i])
-      GTK_CLIST_CLASS_FW (clist)->set_cell_contents
-	(clist, clist_row, i, GTK_CELL_TEXT, text[i], 0, NULL ,NULL);
+  /* subclasses keep their own row structures, so let them insert
+   * the rows one by one and just batch the redraw */
+  if (GTK_CLIST_CLASS_FW (clist)->insert_row != real_insert_row)
+    {
+      gtk_clist_freeze (clist);
+      for (i = 0; i < n_rows; i++)
+	GTK_CLIST_CLASS_FW (clist)->insert_row (clist, clist->rows, text[i]);
+      gtk_clist_thaw (clist);
 
-  if (!clist->rows)
+      return GTK_CLIST_AUTO_SORT(clist) ? -1 : first;
+    }
+
+  /* measure every new cell once and keep the widest per column
+   * instead of resizing the columns cell by cell */
+  resize = !GTK_CLIST_AUTO_RESIZE_BLOCKED(clist);
+  max_width = g_new0 (gint, clist->columns);
+  GTK_CLIST_SET_FLAG (clist, CLIST_AUTO_RESIZE_BLOCKED);
+
+  /* keep the cell width trees out of reach of the blocked
+   * column_auto_resize, we update them ourselves */
+  private = gtk_clist_get_private (clist);
+  if (resize)
     {
-      clist->row_list = g_list_append (clist->row_list, clist_row);
-      clist->row_list_end = clist->row_list;
+      cell_widths = private->cell_widths;
+      private->cell_widths = NULL;
     }
-  else
+
+  for (i = 0; i < n_rows; i++)
     {
-      if (GTK_CLIST_AUTO_SORT(clist))   /* override insertion pos */
-	{
-	  GList *work;
-	  
-	  row = 0;
-	  work = clist->row_list;
-	  
-	  if (clist->sort_type == GTK_SORT_ASCENDING)
-	    {
-	      while (row < clist->rows &&
-		     clist->compare (clist, clist_row,
-				     GTK_CLIST_ROW (work)) > 0)
-		{
-		  row++;
-		  work = work->next;
-		}
-	    }
-	  else
+      clist_row = row_new (clist);
+
+      for (j = 0; j < clist->columns; j++)
+	if (text[i][j])
+	  GTK_CLIST_CLASS_FW (clist)->set_cell_contents
+	    (clist, clist_row, j, GTK_CELL_TEXT, text[i][j], 0, NULL, NULL);
+
+      if (resize)
+	for (j = 0; j < clist->columns; j++)
+	  if (clist->column[j].auto_resize)
 	    {
-	      while (row < clist->rows &&
-		     clist->compare (clist, clist_row,
-				     GTK_CLIST_ROW (work)) < 0)
-		{
-		  row++;
-		  work = work->next;
-		}
+	      GTK_CLIST_CLASS_FW (clist)->cell_size_request
+		(clist, clist_row, j, &requisition);
+	      max_width[j] = MAX (max_width[j], requisition.width);
+	      if (cell_widths && cell_widths[j])
+		cell_width_add (cell_widths[j], requisition.width, 1);
 	    }
-	}
-      
-      /* reset the row end pointer if we're inserting at the end of the list */
-      if (row == clist->rows)
-	clist->row_list_end = (g_list_append (clist->row_list_end,
-					      clist_row))->next;
+
+      list = g_list_alloc ();
+      list->data = clist_row;
+      list->prev = clist->row_list_end;
+      if (clist->row_list_end)
+	clist->row_list_end->next = list;
       else
-	clist->row_list = g_list_insert (clist->row_list, clist_row, row);
+	clist->row_list = list;
+      clist->row_list_end = list;
 
+      row_index_insert (private, clist->rows, list, 1);
+      clist->rows++;
     }
-  clist->rows++;
 
-  if (row < ROW_FROM_YPIXEL (clist, 0))
-    clist->voffset -= (clist->row_height + CELL_SPACING);
+  if (resize)
+    {
+      private->cell_widths = cell_widths;
+      GTK_CLIST_UNSET_FLAG (clist, CLIST_AUTO_RESIZE_BLOCKED);
+      for (j = 0; j < clist->columns; j++)
+	if (clist->column[j].auto_resize &&
+	    max_width[j] > clist->column[j].width)
+	  gtk_clist_set_column_width (clist, j, max_width[j]);
+    }
+  g_free (max_width);
 
-  /* syncronize the selection list */
-  sync_selection (clist, row, SYNC_INSERT);
+  sync_selection (clist, first, SYNC_INSERT);
 
-  if (clist->rows == 1)
+  if (first == 0)
     {
       clist->focus_row = 0;
       if (clist->selection_mode == GTK_SELECTION_BROWSE)
 	gtk_clist_select_row (clist, 0, -1);
     }
 
-  /* redraw the list if it isn't frozen */
+  if (GTK_CLIST_AUTO_SORT(clist))
+    {
+      /* sort_list freezes and thaws, which redraws */
+      GTK_CLIST_CLASS_FW (clist)->sort_list (clist);
+      return -1;
+    }
+
   if (CLIST_UNFROZEN (clist))
     {
       adjust_adjustments (clist, FALSE);
 
-      if (gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE)
+      if (gtk_clist_row_is_visible (clist, first) != GTK_VISIBILITY_NONE)
 	draw_rows (clist, NULL);
     }
 
-  return row;
+  return first;
 }
 
-static void
-real_remove_row (GtkCList *clist,
-		 gint      row)
+void
+gtk_clist_remove (GtkCList *clist,
+		  gint      row)
 {
-  gint was_visible, was_selected;
-  GList *list;
-  GtkCListRow *clist_row;
+  GTK_CLIST_CLASS_FW (clist)->remove_row (clist, row);
+}
 
+void
+gtk_clist_clear (GtkCList *clist)
+{
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  
+  GTK_CLIST_CLASS_FW (clist)->clear (clist);
+}
 
-  /* return if out of bounds */
-  if (row < 0 || row > (clist->rows - 1))
-    return;
+void
+gtk_clist_set_virtual (GtkCList            *clist,
+		       GtkCListVirtualFunc  func,
+		       gpointer             data,
+		       GtkDestroyNotify     destroy)
+{
+  GtkCListPrivate *private;
+  GtkDestroyNotify old_destroy;
+  gpointer old_data;
 
-  was_visible = (gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE);
-  was_selected = 0;
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+  /* GtkCTree's node code walks row_list itself */
+  g_return_if_fail (!gtk_type_is_a (GTK_OBJECT_TYPE (clist),
+				    gtk_type_from_name ("GtkCTree")));
 
-  /* get the row we're going to delete */
-  list = ROW_ELEMENT (clist, row);
-  g_assert (list != NULL);
-  clist_row = list->data;
+  gtk_clist_clear (clist);
 
-  /* if we're removing a selected row, we have to make sure
-   * it's properly unselected, and then sync up the clist->selected
-   * list to reflect the deincrimented indexies of rows after the
-   * removal */
-  if (clist_row->state == GTK_STATE_SELECTED)
-    gtk_signal_emit (GTK_OBJECT (clist), clist_signals[UNSELECT_ROW],
-		     row, -1, NULL);
+  private = gtk_clist_get_private (clist);
+  old_destroy = private->virtual_destroy;
+  old_data = private->virtual_data;
 
-  sync_selection (clist, row, SYNC_REMOVE);
+  private->virtual_func = func;
+  private->virtual_data = data;
+  private->virtual_destroy = destroy;
 
-  /* reset the row end pointer if we're removing at the end of the list */
-  clist->rows--;
-  if (clist->row_list == list)
-    clist->row_list = g_list_next (list);
+  if (func && !private->virtual_row)
+    {
+      private->virtual_row = g_new0 (GtkCListRow, 1);
+      private->virtual_row->cell = g_new0 (GtkCell, clist->columns);
+      private->virtual_row->selectable = TRUE;
+      private->virtual_link.data = private->virtual_row;
+      private->virtual_text = g_new0 (gchar *, clist->columns);
+    }
+
+  if (old_destroy)
+    old_destroy (old_data);
+}
+
+void
+gtk_clist_set_virtual_rows (GtkCList *clist,
+			    gint      rows)
+{
+  GList *list;
+  gint row;
+
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (CLIST_VIRTUAL (clist));
+  g_return_if_fail (rows >= 0);
+
+  GTK_CLIST_CLASS_FW (clist)->resync_selection (clist, NULL);
+
+  g_list_free (clist->undo_selection);
+  g_list_free (clist->undo_unselection);
+  clist->undo_selection = NULL;
+  clist->undo_unselection = NULL;
+  clist->anchor = -1;
+  clist->drag_pos = -1;
+
+  /* drop the selection of rows that went away */
+  list = clist->selection;
+  while (list)
+    {
+      row = GPOINTER_TO_INT (list->data);
+      list = list->next;
+      if (row >= rows)
+	gtk_signal_emit (GTK_OBJECT (clist), clist_signals[UNSELECT_ROW],
+			 row, -1, NULL);
+    }
+
+  clist->rows = rows;
+  if (clist->focus_row >= rows)
+    clist->focus_row = rows - 1;
+  else if (clist->focus_row < 0 && rows > 0)
+    clist->focus_row = 0;
+  clist->undo_anchor = clist->focus_row;
+
+  if (clist->selection_mode == GTK_SELECTION_BROWSE && !clist->selection &&
+      clist->focus_row >= 0)
+    gtk_signal_emit (GTK_OBJECT (clist), clist_signals[SELECT_ROW],
+		     clist->focus_row, -1, NULL);
+
+  CLIST_REFRESH (clist);
+}
+
+/* ROW INDEX
+ *   _gtk_clist_row_element
+ *   _gtk_clist_row_list_changed
+ *   _gtk_clist_row_index_insert
+ *   _gtk_clist_row_index_remove
+ *   row_index_append
+ *   row_index_insert
+ *   row_index_remove
+ *
+ * row_list stays the authoritative row storage, the index keeps its
+ * elements in blocks of at most ROW_BLOCK_SIZE.  The Fenwick tree
+ * over the block lengths finds the block of a row in O(log blocks),
+ * so looking up, inserting and removing a row each touch one block
+ * plus O(log blocks) sums.  Only when a block in the middle overflows
+ * or falls below a quarter full are blocks split or merged, and the
+ * sums recomputed.
+ *
+ * The index is filled lazily from the end of the indexed rows.  Code
+ * that splices row_list behind our back (GtkCTree does) reports the
+ * rows it inserted or removed with _gtk_clist_row_index_insert() and
+ * _gtk_clist_row_index_remove(), or drops everything from the first
+ * changed row on with _gtk_clist_row_list_changed().
+ */
+static void
+row_blocks_reserve (GtkCListPrivate *private,
+		    gint             n_blocks)
+{
+  if (n_blocks > private->row_blocks_size)
+    {
+      private->row_blocks_size = MAX (n_blocks, 2 * private->row_blocks_size);
+      private->row_blocks = g_renew (GtkCListRowBlock *, private->row_blocks,
+				     private->row_blocks_size);
+      private->row_block_sums = g_renew (gint, private->row_block_sums,
+					 private->row_blocks_size + 1);
+    }
+}
+
+/* recompute the Fenwick tree after blocks were added or dropped */
+static void
+row_blocks_sum (GtkCListPrivate *private)
+{
+  gint *sums = private->row_block_sums;
+  gint i;
+  gint j;
+
+  for (i = 1; i <= private->n_row_blocks; i++)
+    sums[i] = private->row_blocks[i - 1]->length;
+  for (i = 1; i <= private->n_row_blocks; i++)
+    {
+      j = i + (i & -i);
+      if (j <= private->n_row_blocks)
+	sums[j] += sums[i];
+    }
+}
+
+static void
+row_blocks_add (GtkCListPrivate *private,
+		gint             block,
+		gint             delta)
+{
+  gint i;
+
+  private->row_blocks[block]->length += delta;
+  for (i = block + 1; i <= private->n_row_blocks; i += i & -i)
+    private->row_block_sums[i] += delta;
+}
+
+/* the block holding an indexed row, *offset is set to the row's
+ * position within the block */
+static gint
+row_blocks_find (GtkCListPrivate *private,
+		 gint             row,
+		 gint            *offset)
+{
+  gint block = 0;
+  gint step;
+
+  for (step = 1; 2 * step <= private->n_row_blocks; step *= 2)
+    ;
+  for (; step > 0; step /= 2)
+    if (block + step <= private->n_row_blocks &&
+	private->row_block_sums[block + step] <= row)
+      {
+	block += step;
+	row -= private->row_block_sums[block];
+      }
+
+  *offset = row;
+  return block;
+}
+
+/* replace block by as many blocks as the n elements fill to about
+ * three quarters.  The sums have to be recomputed afterwards. */
+static void
+row_blocks_refill (GtkCListPrivate  *private,
+		   gint              block,
+		   GList           **elements,
+		   gint              n)
+{
+  GtkCListRowBlock *row_block;
+  gint n_blocks;
+  gint i;
+
+  n_blocks = MAX (1, (n + 3 * ROW_BLOCK_SIZE / 4 - 1) / (3 * ROW_BLOCK_SIZE / 4));
+  row_blocks_reserve (private, private->n_row_blocks + n_blocks - 1);
+  g_memmove (private->row_blocks + block + n_blocks,
+	     private->row_blocks + block + 1,
+	     ((private->n_row_blocks - block - 1) *
+	      sizeof (GtkCListRowBlock *)));
+  private->n_row_blocks += n_blocks - 1;
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      if (i > 0)
+	private->row_blocks[block + i] = g_new (GtkCListRowBlock, 1);
+      row_block = private->row_blocks[block + i];
+      row_block->length = n / (n_blocks - i);
+      memcpy (row_block->rows, elements, row_block->length * sizeof (GList *));
+      elements += row_block->length;
+      n -= row_block->length;
+    }
+}
+
+/* merge block with a neighbour, or even the two out, if it is less
+ * than a quarter full.  The sums have to be recomputed afterwards. */
+static void
+row_blocks_balance (GtkCListPrivate *private,
+		    gint             block)
+{
+  GtkCListRowBlock *left;
+  GtkCListRowBlock *right;
+  gint n;
+
+  if (block >= private->n_row_blocks ||
+      private->row_blocks[block]->length >= ROW_BLOCK_SIZE / 4)
+    return;
+
+  if (private->n_row_blocks == 1)
+    {
+      if (private->row_blocks[0]->length == 0)
+	{
+	  g_free (private->row_blocks[0]);
+	  private->n_row_blocks = 0;
+	}
+      return;
+    }
+
+  if (block == private->n_row_blocks - 1)
+    block--;
+  left = private->row_blocks[block];
+  right = private->row_blocks[block + 1];
+
+  if (left->length + right->length <= ROW_BLOCK_SIZE)
+    {
+      memcpy (left->rows + left->length, right->rows,
+	      right->length * sizeof (GList *));
+      left->length += right->length;
+      g_free (right);
+      g_memmove (private->row_blocks + block + 1,
+		 private->row_blocks + block + 2,
+		 ((private->n_row_blocks - block - 2) *
+		  sizeof (GtkCListRowBlock *)));
+      private->n_row_blocks--;
+    }
+  else if (left->length < right->length)
+    {
+      n = (right->length - left->length) / 2;
+      memcpy (left->rows + left->length, right->rows, n * sizeof (GList *));
+      g_memmove (right->rows, right->rows + n,
+		 (right->length - n) * sizeof (GList *));
+      left->length += n;
+      right->length -= n;
+    }
+  else
+    {
+      n = (left->length - right->length) / 2;
+      g_memmove (right->rows + n, right->rows,
+		 right->length * sizeof (GList *));
+      memcpy (right->rows, left->rows + left->length - n, n * sizeof (GList *));
+      left->length -= n;
+      right->length += n;
+    }
+}
+
+static void
+row_index_append (GtkCListPrivate *private,
+		  GList           *list)
+{
+  GtkCListRowBlock *row_block;
+  gint n = private->n_row_blocks;
+  gint i;
+
+  if (n == 0 || private->row_blocks[n - 1]->length == ROW_BLOCK_SIZE)
+    {
+      row_blocks_reserve (private, n + 1);
+      row_block = g_new (GtkCListRowBlock, 1);
+      row_block->length = 0;
+      private->row_blocks[n] = row_block;
+      private->n_row_blocks = ++n;
+
+      /* the new node sums up the nodes that fall within its range */
+      private->row_block_sums[n] = 0;
+      for (i = n - 1; i > n - (n & -n); i -= i & -i)
+	private->row_block_sums[n] += private->row_block_sums[i];
+    }
+
+  row_block = private->row_blocks[n - 1];
+  row_block->rows[row_block->length] = list;
+  row_blocks_add (private, n - 1, 1);
+  private->n_indexed++;
+}
+
+/* enter the n_rows elements starting with list at row, if the rows
+ * before are indexed */
+static void
+row_index_insert (GtkCListPrivate *private,
+		  gint             row,
+		  GList           *list,
+		  gint             n_rows)
+{
+  GtkCListRowBlock *row_block;
+  GList **elements;
+  gint offset;
+  gint block;
+  gint n;
+  gint i;
+
+  if (row > private->n_indexed || n_rows <= 0)
+    return;
+
+  if (row == private->n_indexed)
+    {
+      for (; n_rows > 0; n_rows--, list = list->next)
+	row_index_append (private, list);
+      return;
+    }
+
+  block = row_blocks_find (private, row, &offset);
+  row_block = private->row_blocks[block];
+  n = row_block->length;
+
+  if (n + n_rows <= ROW_BLOCK_SIZE)
+    {
+      g_memmove (row_block->rows + offset + n_rows, row_block->rows + offset,
+		 (n - offset) * sizeof (GList *));
+      for (i = 0; i < n_rows; i++, list = list->next)
+	row_block->rows[offset + i] = list;
+      row_blocks_add (private, block, n_rows);
+    }
+  else
+    {
+      elements = g_new (GList *, n + n_rows);
+      memcpy (elements, row_block->rows, offset * sizeof (GList *));
+      for (i = 0; i < n_rows; i++, list = list->next)
+	elements[offset + i] = list;
+      memcpy (elements + offset + n_rows, row_block->rows + offset,
+	      (n - offset) * sizeof (GList *));
+      row_blocks_refill (private, block, elements, n + n_rows);
+      row_blocks_sum (private);
+      g_free (elements);
+    }
+
+  private->n_indexed += n_rows;
+}
+
+static void
+row_index_remove (GtkCListPrivate *private,
+		  gint             row,
+		  gint             n_rows)
+{
+  GtkCListRowBlock *row_block;
+  gint first;
+  gint last;
+  gint offset;
+  gint end;
+  gint i;
+
+  n_rows = MIN (n_rows, private->n_indexed - row);
+  if (row < 0 || n_rows <= 0)
+    return;
+
+  first = row_blocks_find (private, row, &offset);
+  last = row_blocks_find (private, row + n_rows - 1, &end);
+  end++;
+  private->n_indexed -= n_rows;
+
+  if (first == last)
+    {
+      row_block = private->row_blocks[first];
+      g_memmove (row_block->rows + offset, row_block->rows + end,
+		 (row_block->length - end) * sizeof (GList *));
+      row_blocks_add (private, first, -n_rows);
+      if (row_block->length >= ROW_BLOCK_SIZE / 4 ||
+	  (private->n_row_blocks == 1 && row_block->length > 0))
+	return;
+    }
+  else
+    {
+      /* keep the head of first and the tail of last, drop the blocks
+       * in between */
+      private->row_blocks[first]->length = offset;
+      row_block = private->row_blocks[last];
+      g_memmove (row_block->rows, row_block->rows + end,
+		 (row_block->length - end) * sizeof (GList *));
+      row_block->length -= end;
+
+      for (i = first + 1; i < last; i++)
+	g_free (private->row_blocks[i]);
+      g_memmove (private->row_blocks + first + 1, private->row_blocks + last,
+		 ((private->n_row_blocks - last) *
+		  sizeof (GtkCListRowBlock *)));
+      private->n_row_blocks -= last - first - 1;
+
+      row_blocks_balance (private, first + 1);
+    }
+
+  row_blocks_balance (private, first);
+  row_blocks_sum (private);
+}
+
+GList *
+_gtk_clist_row_element (GtkCList *clist,
+			gint      row)
+{
+  GtkCListPrivate *private;
+  GtkCListRowBlock *row_block;
+  GList *list;
+  gint offset;
+  gint n;
+
+  g_return_val_if_fail (clist != NULL, NULL);
+  g_return_val_if_fail (GTK_IS_CLIST (clist), NULL);
+
+  if (row < 0 || row >= clist->rows)
+    return NULL;
+  if (row == clist->rows - 1 && clist->row_list_end)
+    return clist->row_list_end;
+
+  private = gtk_clist_get_private (clist);
+  if (private->virtual_func)
+    {
+      GtkCListRow *clist_row;
+
+      /* cells are only filled in by row_get() */
+      clist_row = private->virtual_row;
+      for (n = 0; n < clist->columns; n++)
+	clist_row->cell[n].type = GTK_CELL_EMPTY;
+      clist_row->fg_set = FALSE;
+      clist_row->bg_set = FALSE;
+      clist_row->selectable = TRUE;
+      if (private->virtual_states)
+	clist_row->state = GPOINTER_TO_INT
+	  (g_hash_table_lookup (private->virtual_states, GINT_TO_POINTER (row)));
+      else
+	clist_row->state = GTK_STATE_NORMAL;
+
+      return &private->virtual_link;
+    }
+
+  if (private->n_indexed > clist->rows)
+    row_index_remove (private, 0, private->n_indexed);
+
+  if (row >= private->n_indexed)
+    {
+      if (private->n_indexed)
+	{
+	  row_block = private->row_blocks[private->n_row_blocks - 1];
+	  list = row_block->rows[row_block->length - 1]->next;
+	}
+      else
+	list = clist->row_list;
+
+      for (; list && private->n_indexed <= row; list = list->next)
+	row_index_append (private, list);
+      if (row >= private->n_indexed)
+	return NULL;
+    }
+
+  row_block = private->row_blocks[row_blocks_find (private, row, &offset)];
+  return row_block->rows[offset];
+}
+
+void
+_gtk_clist_row_list_changed (GtkCList *clist,
+			     gint      row)
+{
+  GtkCListPrivate *private;
+
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+
+  private = gtk_clist_get_private (clist);
+  row = MAX (row, 0);
+  row_index_remove (private, row, private->n_indexed - row);
+}
+
+void
+_gtk_clist_row_index_insert (GtkCList *clist,
+			     gint      row,
+			     GList    *list,
+			     gint      n_rows)
+{
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+
+  row_index_insert (gtk_clist_get_private (clist), row, list, n_rows);
+}
+
+void
+_gtk_clist_row_index_remove (GtkCList *clist,
+			     gint      row,
+			     gint      n_rows)
+{
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+
+  row_index_remove (gtk_clist_get_private (clist), row, n_rows);
+}
+
+/* like ROW_ELEMENT (clist, row)->data, but with the cells of a virtual
+ * row filled in.  Only valid until the next row lookup. */
+static GtkCListRow *
+row_get (GtkCList *clist,
+	 gint      row)
+{
+  GtkCListPrivate *private;
+  GtkCListRow *clist_row;
+  gint i;
+
+  clist_row = ROW_ELEMENT (clist, row)->data;
+
+  private = gtk_clist_get_private (clist);
+  if (clist_row == private->virtual_row)
+    {
+      for (i = 0; i < clist->columns; i++)
+	private->virtual_text[i] = NULL;
+
+      private->virtual_func (clist, row, private->virtual_text,
+			     private->virtual_data);
+
+      for (i = 0; i < clist->columns; i++)
+	if (private->virtual_text[i])
+	  {
+	    clist_row->cell[i].type = GTK_CELL_TEXT;
+	    GTK_CELL_TEXT (clist_row->cell[i])->text = private->virtual_text[i];
+	  }
+    }
+
+  return clist_row;
+}
+
+/* set the state of a row obtained from ROW_ELEMENT, virtual rows
+ * keep it in a table since their GtkCListRow is shared */
+static void
+row_set_state (GtkCList     *clist,
+	       gint          row,
+	       GtkCListRow  *clist_row,
+	       GtkStateType  state)
+{
+  GtkCListPrivate *private;
+
+  clist_row->state = state;
+
+  private = gtk_clist_get_private (clist);
+  if (clist_row != private->virtual_row)
+    return;
+
+  if (state == GTK_STATE_NORMAL)
+    {
+      if (private->virtual_states)
+	g_hash_table_remove (private->virtual_states, GINT_TO_POINTER (row));
+    }
+  else
+    {
+      if (!private->virtual_states)
+	private->virtual_states = g_hash_table_new (g_direct_hash,
+						    g_direct_equal);
+      g_hash_table_insert (private->virtual_states, GINT_TO_POINTER (row),
+			   GINT_TO_POINTER (state));
+    }
+}
+
+/* ROW DATA INDEX
+ *   row_data_index_invalidate
+ *   row_data_index_add
+ *   row_data_index_remove
+ *
+ * The index is dropped whenever rows change position and rebuilt by
+ * the next gtk_clist_find_row_from_data().  Appending and removing
+ * the last row keep it up to date.
+ */
+static void
+row_data_index_invalidate (GtkCList *clist)
+{
+  GtkCListPrivate *private;
+
+  private = gtk_clist_get_private (clist);
+  if (private->row_data_index)
+    {
+      g_hash_table_destroy (private->row_data_index);
+      private->row_data_index = NULL;
+    }
+}
+
+static void
+row_data_index_add (GtkCList *clist,
+		    gint      row,
+		    gpointer  data)
+{
+  GtkCListPrivate *private;
+  gint first;
+
+  private = gtk_clist_get_private (clist);
+  if (!private->row_data_index || !data)
+    return;
+
+  first = GPOINTER_TO_INT (g_hash_table_lookup (private->row_data_index,
+						data)) - 1;
+  if (first < 0 || row < first)
+    g_hash_table_insert (private->row_data_index, data,
+			 GINT_TO_POINTER (row + 1));
+}
+
+/* row no longer holds data */
+static void
+row_data_index_remove (GtkCList *clist,
+		       gint      row,
+		       gpointer  data)
+{
+  GtkCListPrivate *private;
+  gint first;
+
+  private = gtk_clist_get_private (clist);
+  if (!private->row_data_index || !data)
+    return;
+
+  first = GPOINTER_TO_INT (g_hash_table_lookup (private->row_data_index,
+						data)) - 1;
+  if (first != row)
+    return;
+
+  /* further rows may hold the same data, we only know there are none
+   * if this is the last row */
+  if (row == clist->rows - 1)
+    g_hash_table_remove (private->row_data_index, data);
+  else
+    row_data_index_invalidate (clist);
+}
+
+/* PRIVATE INSERT/REMOVE ROW FUNCTIONS
+ *   real_insert_row
+ *   real_remove_row
+ *   real_clear
+ *   real_row_move
+ */
+static gint
+real_insert_row (GtkCList *clist,
+		 gint      row,
+		 gchar    *text[])
+{
+  gint i;
+  GtkCListRow *clist_row;
+
+  g_return_val_if_fail (clist != NULL, -1);
+  g_return_val_if_fail (GTK_IS_CLIST (clist), -1);
+  g_return_val_if_fail (text != NULL, -1);
+  g_return_val_if_fail (!CLIST_VIRTUAL (clist), -1);
+
+  /* return if out of bounds */
+  if (row < 0 || row > clist->rows)
+    return -1;
+
+  /* create the row */
+  clist_row = row_new (clist);
+
+  /* set the text in the row's columns */
+  for (i = 0; i < clist->columns; i++)
+    if (text[i])
+      GTK_CLIST_CLASS_FW (clist)->set_cell_contents
+	(clist, clist_row, i, GTK_CELL_TEXT, text[i], 0, NULL ,NULL);
+
+  if (!clist->rows)
+    {
+      clist->row_list = g_list_append (clist->row_list, clist_row);
+      clist->row_list_end = clist->row_list;
+    }
+  else
+    {
+      if (GTK_CLIST_AUTO_SORT(clist))   /* override insertion pos */
+	{
+	  gint lo = 0;
+	  gint hi = clist->rows;
+	  gint mid;
+	  gint cmp;
+
+	  /* the list is kept sorted, so bisect for the first row
+	   * the new one doesn't sort after */
+	  while (lo < hi)
+	    {
+	      mid = (lo + hi) / 2;
+	      cmp = clist->compare (clist, clist_row,
+				    GTK_CLIST_ROW (ROW_ELEMENT (clist, mid)));
+	      if (clist->sort_type == GTK_SORT_DESCENDING)
+		cmp = -cmp;
+	      if (cmp > 0)
+		lo = mid + 1;
+	      else
+		hi = mid;
+	    }
+	  row = lo;
+	}
+      
+      /* reset the row end pointer if we're inserting at the end of the list */
+      if (row == clist->rows)
+	clist->row_list_end = (g_list_append (clist->row_list_end,
+					      clist_row))->next;
+      else
+	{
+	  GList *work;
+	  GList *list;
+
+	  work = ROW_ELEMENT (clist, row);
+	  list = g_list_alloc ();
+	  list->data = clist_row;
+	  list->next = work;
+	  list->prev = work->prev;
+	  if (work->prev)
+	    work->prev->next = list;
+	  else
+	    clist->row_list = list;
+	  work->prev = list;
+
+	  row_index_insert (gtk_clist_get_private (clist), row, list, 1);
+	  row_data_index_invalidate (clist);
+	}
+    }
+  clist->rows++;
+
+  if (row < ROW_FROM_YPIXEL (clist, 0))
+    clist->voffset -= (clist->row_height + CELL_SPACING);
+
+  /* syncronize the selection list */
+  sync_selection (clist, row, SYNC_INSERT);
+
+  if (clist->rows == 1)
+    {
+      clist->focus_row = 0;
+      if (clist->selection_mode == GTK_SELECTION_BROWSE)
+	gtk_clist_select_row (clist, 0, -1);
+    }
+
+  /* redraw the list if it isn't frozen */
+  if (CLIST_UNFROZEN (clist))
+    {
+      adjust_adjustments (clist, FALSE);
+
+      if (gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE)
+	draw_rows (clist, NULL);
+    }
+
+  return row;
+}
+
+static void
+real_remove_row (GtkCList *clist,
+		 gint      row)
+{
+  gint was_visible, was_selected;
+  GList *list;
+  GtkCListRow *clist_row;
+
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
+
+  /* return if out of bounds */
+  if (row < 0 || row > (clist->rows - 1))
+    return;
+
+  was_visible = (gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE);
+  was_selected = 0;
+
+  /* get the row we're going to delete */
+  list = ROW_ELEMENT (clist, row);
+  g_assert (list != NULL);
+  clist_row = list->data;
+
+  /* if we're removing a selected row, we have to make sure
+   * it's properly unselected, and then sync up the clist->selected
+   * list to reflect the deincrimented indexies of rows after the
+   * removal */
+  if (clist_row->state == GTK_STATE_SELECTED)
+    gtk_signal_emit (GTK_OBJECT (clist), clist_signals[UNSELECT_ROW],
+		     row, -1, NULL);
+
+  sync_selection (clist, row, SYNC_REMOVE);
+
+  if (row == clist->rows - 1)
+    row_data_index_remove (clist, row, clist_row->data);
+  else
+    row_data_index_invalidate (clist);
+
+  /* reset the row end pointer if we're removing at the end of the list */
+  row_index_remove (gtk_clist_get_private (clist), row, 1);
+  clist->rows--;
+  if (clist->row_list == list)
+    clist->row_list = g_list_next (list);
   if (clist->row_list_end == list)
     clist->row_list_end = g_list_previous (list);
   g_list_remove (list, clist_row);
@@ -2828,6 +3941,7 @@ real_remove_row (GtkCList *clist,
 static void
 real_clear (GtkCList *clist)
 {
+  GtkCListPrivate *private;
   GList *list;
   GList *free_list;
   gint i;
@@ -2844,6 +3958,7 @@ real_clear (GtkCList *clist)
   clist->selection_end = NULL;
   clist->undo_selection = NULL;
   clist->undo_unselection = NULL;
+  gtk_clist_get_private (clist)->n_sel_runs = 0;
   clist->voffset = 0;
   clist->focus_row = -1;
   clist->anchor = -1;
@@ -2857,6 +3972,14 @@ real_clear (GtkCList *clist)
   clist->row_list = NULL;
   clist->row_list_end = NULL;
   clist->rows = 0;
+  _gtk_clist_row_list_changed (clist, 0);
+  row_data_index_invalidate (clist);
+  private = gtk_clist_get_private (clist);
+  if (private->virtual_states)
+    {
+      g_hash_table_destroy (private->virtual_states);
+      private->virtual_states = NULL;
+    }
   for (list = free_list; list; list = list->next)
     row_delete (clist, GTK_CLIST_ROW (list));
   g_list_free (free_list);
@@ -2886,8 +4009,10 @@ real_row_move (GtkCList *clist,
 	       gint      source_row,
 	       gint      dest_row)
 {
-  GtkCListRow *clist_row;
+  GtkCListPrivate *private;
   GList *list;
+  GList *work;
+  gboolean selected;
   gint first, last;
   gint d;
 
@@ -2902,19 +4027,50 @@ real_row_move (GtkCList *clist,
       source_row == dest_row)
     return;
 
+  /* virtual models move their rows themselves */
+  if (CLIST_VIRTUAL (clist))
+    return;
+
   gtk_clist_freeze (clist);
 
   /* unlink source row */
-  clist_row = ROW_ELEMENT (clist, source_row)->data;
-  if (source_row == clist->rows - 1)
-    clist->row_list_end = clist->row_list_end->prev;
-  clist->row_list = g_list_remove (clist->row_list, clist_row);
+  private = gtk_clist_get_private (clist);
+  list = ROW_ELEMENT (clist, source_row);
+  row_data_index_invalidate (clist);
+  if (list->prev)
+    list->prev->next = list->next;
+  else
+    clist->row_list = list->next;
+  if (list->next)
+    list->next->prev = list->prev;
+  else
+    clist->row_list_end = list->prev;
+  row_index_remove (private, source_row, 1);
   clist->rows--;
 
-  /* relink source row */
-  clist->row_list = g_list_insert (clist->row_list, clist_row, dest_row);
+  /* relink source row in front of the one now at dest_row */
   if (dest_row == clist->rows)
-    clist->row_list_end = clist->row_list_end->next;
+    {
+      list->next = NULL;
+      list->prev = clist->row_list_end;
+      if (clist->row_list_end)
+	clist->row_list_end->next = list;
+      else
+	clist->row_list = list;
+      clist->row_list_end = list;
+    }
+  else
+    {
+      work = ROW_ELEMENT (clist, dest_row);
+      list->next = work;
+      list->prev = work->prev;
+      if (work->prev)
+	work->prev->next = list;
+      else
+	clist->row_list = list;
+      work->prev = list;
+    }
+  row_index_insert (private, dest_row, list, 1);
   clist->rows++;
 
   /* sync selection */
@@ -2939,6 +4095,13 @@ real_row_move (GtkCList *clist,
 	       last >= GPOINTER_TO_INT (list->data))
 	list->data = GINT_TO_POINTER (GPOINTER_TO_INT (list->data) + d);
     }
+
+  /* take the row out of the runs and put it back at dest_row */
+  selected = selection_runs_contain (clist, source_row);
+  selection_runs_shift (clist, source_row, -1);
+  selection_runs_shift (clist, dest_row, 1);
+  if (selected)
+    selection_runs_add (clist, dest_row, dest_row);
   
   if (clist->focus_row == source_row)
     clist->focus_row = dest_row;
@@ -3058,6 +4221,7 @@ gtk_clist_set_row_data_full (GtkCList         *clist,
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (row < 0 || row > (clist->rows - 1))
     return;
@@ -3066,9 +4230,13 @@ gtk_clist_set_row_data_full (GtkCList         *clist,
 
   if (clist_row->destroy)
     clist_row->destroy (clist_row->data);
+
+  row_data_index_remove (clist, row, clist_row->data);
   
   clist_row->data = data;
   clist_row->destroy = destroy;
+
+  row_data_index_add (clist, row, data);
 }
 
 gpointer
@@ -3091,12 +4259,29 @@ gint
 gtk_clist_find_row_from_data (GtkCList *clist,
 			      gpointer  data)
 {
+  GtkCListPrivate *private;
   GList *list;
   gint n;
 
   g_return_val_if_fail (clist != NULL, -1);
   g_return_val_if_fail (GTK_IS_CLIST (clist), -1);
 
+  private = gtk_clist_get_private (clist);
+  if (data && private->row_data_indexed &&
+      GTK_CLIST_CLASS_FW (clist)->insert_row == real_insert_row)
+    {
+      if (!private->row_data_index)
+	{
+	  private->row_data_index = g_hash_table_new (g_direct_hash,
+						      g_direct_equal);
+	  for (n = 0, list = clist->row_list; list; n++, list = list->next)
+	    row_data_index_add (clist, n, GTK_CLIST_ROW (list)->data);
+	}
+
+      return GPOINTER_TO_INT (g_hash_table_lookup (private->row_data_index,
+						   data)) - 1;
+    }
+
   for (n = 0, list = clist->row_list; list; n++, list = list->next)
     if (GTK_CLIST_ROW (list)->data == data)
       return n;
@@ -3104,6 +4289,20 @@ gtk_clist_find_row_from_data (GtkCList *clist,
   return -1;
 }
 
+void
+gtk_clist_set_row_data_indexed (GtkCList *clist,
+				gboolean  indexed)
+{
+  GtkCListPrivate *private;
+
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+
+  private = gtk_clist_get_private (clist);
+  private->row_data_indexed = indexed != FALSE;
+  row_data_index_invalidate (clist);
+}
+
 void 
 gtk_clist_swap_rows (GtkCList *clist,
 		     gint      row1, 
@@ -3188,6 +4387,7 @@ gtk_clist_set_foreground (GtkCList *clist,
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (row < 0 || row >= clist->rows)
     return;
@@ -3218,6 +4418,7 @@ gtk_clist_set_background (GtkCList *clist,
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (row < 0 || row >= clist->rows)
     return;
@@ -3257,6 +4458,7 @@ gtk_clist_set_cell_style (GtkCList *clist,
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (row < 0 || row >= clist->rows)
     return;
@@ -3332,6 +4534,7 @@ gtk_clist_set_row_style (GtkCList *clist,
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (row < 0 || row >= clist->rows)
     return;
@@ -3372,9 +4575,8 @@ gtk_clist_set_row_style (GtkCList *clist,
 					     clist->clist_window);
     }
 
-  if (GTK_CLIST_AUTO_RESIZE_BLOCKED(clist))
-    for (i = 0; i < clist->columns; i++)
-      column_auto_resize (clist, clist_row, i, old_width[i]);
+  for (i = 0; i < clist->columns; i++)
+    column_auto_resize (clist, clist_row, i, old_width[i]);
 
   g_free (old_width);
 
@@ -3421,6 +4623,7 @@ gtk_clist_set_selectable (GtkCList *clist,
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CLIST (clist));
+  g_return_if_fail (!CLIST_VIRTUAL (clist));
 
   if (row < 0 || row >= clist->rows)
     return;
@@ -3511,6 +4714,37 @@ gtk_clist_unselect_all (GtkCList *clist)
   GTK_CLIST_CLASS_FW (clist)->unselect_all (clist);
 }
 
+gint
+gtk_clist_next_selected (GtkCList *clist,
+			 gint      row)
+{
+  GtkCListPrivate *private;
+  gint i;
+
+  g_return_val_if_fail (clist != NULL, -1);
+  g_return_val_if_fail (GTK_IS_CLIST (clist), -1);
+
+  if (row < -1)
+    row = -1;
+
+  /* subclasses keep their own selection, ask them row by row */
+  if (GTK_CLIST_CLASS_FW (clist)->selection_find != selection_find)
+    {
+      for (row++; row < clist->rows; row++)
+	if (GTK_CLIST_CLASS_FW (clist)->selection_find
+	    (clist, row, ROW_ELEMENT (clist, row)))
+	  return row;
+      return -1;
+    }
+
+  private = gtk_clist_get_private (clist);
+  i = selection_run_find (private, row + 1);
+  if (i == private->n_sel_runs)
+    return -1;
+
+  return MAX (row + 1, private->sel_runs[2 * i]);
+}
+
 void
 gtk_clist_undo_selection (GtkCList *clist)
 {
@@ -3523,7 +4757,18 @@ gtk_clist_undo_selection (GtkCList *clist)
 }
 
 /* PRIVATE SELECTION FUNCTIONS
+ *   selection_run_find
+ *   selection_runs_contain
+ *   selection_runs_add
+ *   selection_runs_remove
+ *   selection_runs_shift
+ *   selection_runs_rebuild
+ *   selection_signals_needed
+ *   selection_select_range
+ *   selection_unselect_range
+ *   selection_list_rebuild
  *   selection_find
+ *   row_in_selection
  *   toggle_row
  *   fake_toggle_row
  *   toggle_focus_row
@@ -3535,6 +4780,7 @@ gtk_clist_undo_selection (GtkCList *clist)
  *   fake_unselect_all
  *   real_undo_selection
  *   set_anchor
+ *   resync_unselect_row
  *   resync_selection
  *   update_extended_selection
  *   start_selection
@@ -3542,12 +4788,363 @@ gtk_clist_undo_selection (GtkCList *clist)
  *   extend_selection
  *   sync_selection
  */
+/* index of the first selection run that doesn't end before row */
+static gint
+selection_run_find (GtkCListPrivate *private,
+		    gint             row)
+{
+  gint lo = 0;
+  gint hi = private->n_sel_runs;
+  gint mid;
+
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (private->sel_runs[2 * mid + 1] < row)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  return lo;
+}
+
+static gboolean
+selection_runs_contain (GtkCList *clist,
+			gint      row)
+{
+  GtkCListPrivate *private;
+  gint i;
+
+  private = gtk_clist_get_private (clist);
+  i = selection_run_find (private, row);
+
+  return (i < private->n_sel_runs && private->sel_runs[2 * i] <= row);
+}
+
+static void
+selection_runs_insert (GtkCListPrivate *private,
+		       gint             i,
+		       gint             start,
+		       gint             end)
+{
+  if (private->n_sel_runs == private->sel_runs_size)
+    {
+      private->sel_runs_size = MAX (8, 2 * private->sel_runs_size);
+      private->sel_runs = g_renew (gint, private->sel_runs,
+				   2 * private->sel_runs_size);
+    }
+
+  g_memmove (private->sel_runs + 2 * (i + 1), private->sel_runs + 2 * i,
+	     2 * (private->n_sel_runs - i) * sizeof (gint));
+  private->sel_runs[2 * i] = start;
+  private->sel_runs[2 * i + 1] = end;
+  private->n_sel_runs++;
+}
+
+static void
+selection_runs_delete (GtkCListPrivate *private,
+		       gint             i,
+		       gint             n)
+{
+  if (n <= 0)
+    return;
+
+  private->n_sel_runs -= n;
+  g_memmove (private->sel_runs + 2 * i, private->sel_runs + 2 * (i + n),
+	     2 * (private->n_sel_runs - i) * sizeof (gint));
+}
+
+static void
+selection_runs_add (GtkCList *clist,
+		    gint      start,
+		    gint      end)
+{
+  GtkCListPrivate *private;
+  gint i;
+  gint j;
+
+  private = gtk_clist_get_private (clist);
+
+  /* merge with every run that overlaps or touches start..end */
+  i = selection_run_find (private, start - 1);
+  for (j = i; j < private->n_sel_runs && private->sel_runs[2 * j] <= end + 1;
+       j++)
+    {
+      start = MIN (start, private->sel_runs[2 * j]);
+      end = MAX (end, private->sel_runs[2 * j + 1]);
+    }
+
+  if (j == i)
+    selection_runs_insert (private, i, start, end);
+  else
+    {
+      private->sel_runs[2 * i] = start;
+      private->sel_runs[2 * i + 1] = end;
+      selection_runs_delete (private, i + 1, j - i - 1);
+    }
+}
+
+static void
+selection_runs_remove (GtkCList *clist,
+		       gint      start,
+		       gint      end)
+{
+  GtkCListPrivate *private;
+  gint s;
+  gint e;
+  gint i;
+
+  private = gtk_clist_get_private (clist);
+
+  i = selection_run_find (private, start);
+  while (i < private->n_sel_runs && private->sel_runs[2 * i] <= end)
+    {
+      s = private->sel_runs[2 * i];
+      e = private->sel_runs[2 * i + 1];
+
+      if (s < start && e > end)
+	{
+	  private->sel_runs[2 * i + 1] = start - 1;
+	  selection_runs_insert (private, i + 1, end + 1, e);
+	  return;
+	}
+      else if (s < start)
+	{
+	  private->sel_runs[2 * i + 1] = start - 1;
+	  i++;
+	}
+      else if (e > end)
+	{
+	  private->sel_runs[2 * i] = end + 1;
+	  return;
+	}
+      else
+	selection_runs_delete (private, i, 1);
+    }
+}
+
+/* a row was inserted (d = 1) or removed (d = -1) at row */
+static void
+selection_runs_shift (GtkCList *clist,
+		      gint      row,
+		      gint      d)
+{
+  GtkCListPrivate *private;
+  gint e;
+  gint i;
+
+  private = gtk_clist_get_private (clist);
+
+  if (d < 0)
+    selection_runs_remove (clist, row, row);
+
+  i = selection_run_find (private, row);
+  if (i == private->n_sel_runs)
+    return;
+
+  /* the new row is unselected, so it splits the run it lands in */
+  if (d > 0 && private->sel_runs[2 * i] < row)
+    {
+      e = private->sel_runs[2 * i + 1];
+      private->sel_runs[2 * i + 1] = row - 1;
+      selection_runs_insert (private, ++i, row, e);
+    }
+
+  for (e = i; e < private->n_sel_runs; e++)
+    {
+      private->sel_runs[2 * e] += d;
+      private->sel_runs[2 * e + 1] += d;
+    }
+
+  /* closing the gap may join two runs */
+  if (d < 0 && i > 0 &&
+      private->sel_runs[2 * i - 1] + 1 == private->sel_runs[2 * i])
+    {
+      private->sel_runs[2 * i - 1] = private->sel_runs[2 * i + 1];
+      selection_runs_delete (private, i, 1);
+    }
+}
+
+static gint
+selection_row_compare (gconstpointer a,
+		       gconstpointer b)
+{
+  return *(gint *) a - *(gint *) b;
+}
+
+/* for when clist->selection got replaced wholesale */
+static void
+selection_runs_rebuild (GtkCList *clist)
+{
+  GtkCListPrivate *private;
+  GList *list;
+  gint *rows;
+  gint n;
+  gint i;
+
+  private = gtk_clist_get_private (clist);
+  private->n_sel_runs = 0;
+
+  n = g_list_length (clist->selection);
+  if (!n)
+    return;
+
+  rows = g_new (gint, n);
+  for (i = 0, list = clist->selection; list; i++, list = list->next)
+    rows[i] = GPOINTER_TO_INT (list->data);
+  qsort (rows, n, sizeof (gint), selection_row_compare);
+
+  for (i = 0; i < n; i++)
+    {
+      if (private->n_sel_runs &&
+	  rows[i] <= private->sel_runs[2 * private->n_sel_runs - 1] + 1)
+	private->sel_runs[2 * private->n_sel_runs - 1] =
+	  MAX (rows[i], private->sel_runs[2 * private->n_sel_runs - 1]);
+      else
+	selection_runs_insert (private, private->n_sel_runs,
+			       rows[i], rows[i]);
+    }
+
+  g_free (rows);
+}
+
+/* Whether selecting and unselecting rows has to go through the
+ * select_row and unselect_row signals.  If nobody but us listens, the
+ * range operations change the rows and the runs directly and rebuild
+ * clist->selection once at the end. */
+static gboolean
+selection_signals_needed (GtkCList *clist)
+{
+  return (GTK_CLIST_CLASS_FW (clist)->select_row != real_select_row ||
+	  GTK_CLIST_CLASS_FW (clist)->unselect_row != real_unselect_row ||
+	  GTK_CLIST_CLASS_FW (clist)->selection_find != selection_find ||
+	  gtk_signal_handler_pending (GTK_OBJECT (clist),
+				      clist_signals[SELECT_ROW], TRUE) ||
+	  gtk_signal_handler_pending (GTK_OBJECT (clist),
+				      clist_signals[UNSELECT_ROW], TRUE));
+}
+
+/* what real_select_row does for each of the rows start to end, save
+ * for drawing them and updating clist->selection */
+static void
+selection_select_range (GtkCList *clist,
+			gint      start,
+			gint      end)
+{
+  GtkCListRow *clist_row;
+  gint first = -1;
+  gint row;
+
+  start = MAX (start, 0);
+  end = MIN (end, clist->rows - 1);
+  if (start > end)
+    return;
+
+  for (row = start; row <= end + 1; row++)
+    {
+      if (row <= end)
+	{
+	  clist_row = ROW_ELEMENT (clist, row)->data;
+	  if (clist_row->state == GTK_STATE_NORMAL && clist_row->selectable)
+	    {
+	      row_set_state (clist, row, clist_row, GTK_STATE_SELECTED);
+	      if (first < 0)
+		first = row;
+	      continue;
+	    }
+	}
+      if (first >= 0)
+	{
+	  selection_runs_add (clist, first, row - 1);
+	  first = -1;
+	}
+    }
+}
+
+/* what real_unselect_row does for each of the rows start to end, save
+ * for drawing them and updating clist->selection.  Only the selected
+ * rows are visited. */
+static void
+selection_unselect_range (GtkCList *clist,
+			  gint      start,
+			  gint      end)
+{
+  GtkCListPrivate *private;
+  GtkCListRow *clist_row;
+  gint row;
+  gint i;
+
+  start = MAX (start, 0);
+  end = MIN (end, clist->rows - 1);
+  if (start > end)
+    return;
+
+  private = gtk_clist_get_private (clist);
+  for (i = selection_run_find (private, start);
+       i < private->n_sel_runs && private->sel_runs[2 * i] <= end; i++)
+    for (row = MAX (start, private->sel_runs[2 * i]);
+	 row <= MIN (end, private->sel_runs[2 * i + 1]); row++)
+      {
+	clist_row = ROW_ELEMENT (clist, row)->data;
+	if (clist_row->state == GTK_STATE_SELECTED)
+	  row_set_state (clist, row, clist_row, GTK_STATE_NORMAL);
+      }
+
+  selection_runs_remove (clist, start, end);
+}
+
+/* make clist->selection list the rows of the runs, in order */
+static void
+selection_list_rebuild (GtkCList *clist)
+{
+  GtkCListPrivate *private;
+  gint row;
+  gint i;
+
+  private = gtk_clist_get_private (clist);
+
+  g_list_free (clist->selection);
+  clist->selection = NULL;
+  clist->selection_end = NULL;
+
+  for (i = private->n_sel_runs - 1; i >= 0; i--)
+    for (row = private->sel_runs[2 * i + 1];
+	 row >= private->sel_runs[2 * i]; row--)
+      {
+	clist->selection = g_list_prepend (clist->selection,
+					   GINT_TO_POINTER (row));
+	if (!clist->selection_end)
+	  clist->selection_end = clist->selection;
+      }
+}
+
+/* The runs answer this on their own.  A selected row gets the head of
+ * clist->selection rather than its own element, which would take a
+ * walk down the list to find; all callers just test for NULL. */
 static GList *
 selection_find (GtkCList *clist,
 		gint      row_number,
 		GList    *row_list_element)
 {
-  return g_list_find (clist->selection, GINT_TO_POINTER (row_number));
+  if (!selection_runs_contain (clist, row_number))
+    return NULL;
+
+  return clist->selection;
+}
+
+/* like selection_find, for callers that only need to know whether
+ * row is selected */
+static gboolean
+row_in_selection (GtkCList *clist,
+		  gint      row,
+		  GList    *row_list_element)
+{
+  if (GTK_CLIST_CLASS_FW (clist)->selection_find == selection_find)
+    return selection_runs_contain (clist, row);
+
+  return (GTK_CLIST_CLASS_FW (clist)->selection_find
+	  (clist, row, row_list_element) != NULL);
 }
 
 static void
@@ -3593,9 +5190,10 @@ fake_toggle_row (GtkCList *clist,
     return;
   
   if (GTK_CLIST_ROW (work)->state == GTK_STATE_NORMAL)
-    clist->anchor_state = GTK_CLIST_ROW (work)->state = GTK_STATE_SELECTED;
+    clist->anchor_state = GTK_STATE_SELECTED;
   else
-    clist->anchor_state = GTK_CLIST_ROW (work)->state = GTK_STATE_NORMAL;
+    clist->anchor_state = GTK_STATE_NORMAL;
+  row_set_state (clist, row, GTK_CLIST_ROW (work), clist->anchor_state);
   
   if (CLIST_UNFROZEN (clist) &&
       gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE)
@@ -3717,7 +5315,7 @@ real_select_row (GtkCList *clist,
   if (clist_row->state != GTK_STATE_NORMAL || !clist_row->selectable)
     return;
 
-  clist_row->state = GTK_STATE_SELECTED;
+  row_set_state (clist, row, clist_row, GTK_STATE_SELECTED);
   if (!clist->selection)
     {
       clist->selection = g_list_append (clist->selection,
@@ -3727,6 +5325,7 @@ real_select_row (GtkCList *clist,
   else
     clist->selection_end = 
       g_list_append (clist->selection_end, GINT_TO_POINTER (row))->next;
+  selection_runs_add (clist, row, row);
   
   if (CLIST_UNFROZEN (clist)
       && (gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE))
@@ -3751,7 +5350,7 @@ real_unselect_row (GtkCList *clist,
 
   if (clist_row->state == GTK_STATE_SELECTED)
     {
-      clist_row->state = GTK_STATE_NORMAL;
+      row_set_state (clist, row, clist_row, GTK_STATE_NORMAL);
 
       if (clist->selection_end && 
 	  clist->selection_end->data == GINT_TO_POINTER (row))
@@ -3759,6 +5358,7 @@ real_unselect_row (GtkCList *clist,
 
       clist->selection = g_list_remove (clist->selection,
 					GINT_TO_POINTER (row));
+      selection_runs_remove (clist, row, row);
       
       if (CLIST_UNFROZEN (clist)
 	  && (gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE))
@@ -3769,7 +5369,6 @@ real_unselect_row (GtkCList *clist,
 static void
 real_select_all (GtkCList *clist)
 {
-  GList *list;
   gint i;
  
   g_return_if_fail (clist != NULL);
@@ -3791,8 +5390,7 @@ real_select_all (GtkCList *clist)
       clist->undo_unselection = NULL;
 	  
       if (clist->rows &&
-	  ((GtkCListRow *) (clist->row_list->data))->state !=
-	  GTK_STATE_SELECTED)
+	  GTK_CLIST_ROW (ROW_ELEMENT (clist, 0))->state != GTK_STATE_SELECTED)
 	fake_toggle_row (clist, 0);
 
       clist->anchor_state =  GTK_STATE_SELECTED;
@@ -3804,9 +5402,18 @@ real_select_all (GtkCList *clist)
       return;
 
     case GTK_SELECTION_MULTIPLE:
-      for (i = 0, list = clist->row_list; list; i++, list = list->next)
+      if (!selection_signals_needed (clist))
+	{
+	  gtk_clist_freeze (clist);
+	  selection_select_range (clist, 0, clist->rows - 1);
+	  selection_list_rebuild (clist);
+	  gtk_clist_thaw (clist);
+	  return;
+	}
+
+      for (i = 0; i < clist->rows; i++)
 	{
-	  if (((GtkCListRow *)(list->data))->state == GTK_STATE_NORMAL)
+	  if (GTK_CLIST_ROW (ROW_ELEMENT (clist, i))->state == GTK_STATE_NORMAL)
 	    gtk_signal_emit (GTK_OBJECT (clist), clist_signals[SELECT_ROW],
 			     i, -1, NULL);
 	}
@@ -3851,6 +5458,15 @@ real_unselect_all (GtkCList *clist)
       break;
     }
 
+  if (!selection_signals_needed (clist))
+    {
+      gtk_clist_freeze (clist);
+      selection_unselect_range (clist, 0, clist->rows - 1);
+      selection_list_rebuild (clist);
+      gtk_clist_thaw (clist);
+      return;
+    }
+
   list = clist->selection;
   while (list)
     {
@@ -3874,7 +5490,7 @@ fake_unselect_all (GtkCList *clist,
       if (GTK_CLIST_ROW (work)->state == GTK_STATE_NORMAL &&
 	  GTK_CLIST_ROW (work)->selectable)
 	{
-	  GTK_CLIST_ROW (work)->state = GTK_STATE_SELECTED;
+	  row_set_state (clist, row, GTK_CLIST_ROW (work), GTK_STATE_SELECTED);
 	  
 	  if (CLIST_UNFROZEN (clist) &&
 	      gtk_clist_row_is_visible (clist, row) != GTK_VISIBILITY_NONE)
@@ -3886,14 +5502,15 @@ fake_unselect_all (GtkCList *clist,
   clist->undo_selection = clist->selection;
   clist->selection = NULL;
   clist->selection_end = NULL;
+  gtk_clist_get_private (clist)->n_sel_runs = 0;
 
   for (list = clist->undo_selection; list; list = list->next)
     {
       if ((i = GPOINTER_TO_INT (list->data)) == row ||
-	  !(work = g_list_nth (clist->row_list, i)))
+	  !(work = ROW_ELEMENT (clist, i)))
 	continue;
 
-      GTK_CLIST_ROW (work)->state = GTK_STATE_NORMAL;
+      row_set_state (clist, i, GTK_CLIST_ROW (work), GTK_STATE_NORMAL);
       if (CLIST_UNFROZEN (clist) &&
 	  gtk_clist_row_is_visible (clist, i) != GTK_VISIBILITY_NONE)
 	GTK_CLIST_CLASS_FW (clist)->draw_row (clist, NULL, i,
@@ -3921,15 +5538,30 @@ real_undo_selection (GtkCList *clist)
       return;
     }
 
-  for (work = clist->undo_selection; work; work = work->next)
-    gtk_signal_emit (GTK_OBJECT (clist), clist_signals[SELECT_ROW],
-		     GPOINTER_TO_INT (work->data), -1, NULL);
-
-  for (work = clist->undo_unselection; work; work = work->next)
+  if (!selection_signals_needed (clist))
+    {
+      gtk_clist_freeze (clist);
+      for (work = clist->undo_selection; work; work = work->next)
+	selection_select_range (clist, GPOINTER_TO_INT (work->data),
+				GPOINTER_TO_INT (work->data));
+      for (work = clist->undo_unselection; work; work = work->next)
+	selection_unselect_range (clist, GPOINTER_TO_INT (work->data),
+				  GPOINTER_TO_INT (work->data));
+      selection_list_rebuild (clist);
+      gtk_clist_thaw (clist);
+    }
+  else
     {
-      /* g_print ("unselect %d\n",GPOINTER_TO_INT (work->data)); */
-      gtk_signal_emit (GTK_OBJECT (clist), clist_signals[UNSELECT_ROW], 
-		       GPOINTER_TO_INT (work->data), -1, NULL);
+      for (work = clist->undo_selection; work; work = work->next)
+	gtk_signal_emit (GTK_OBJECT (clist), clist_signals[SELECT_ROW],
+			 GPOINTER_TO_INT (work->data), -1, NULL);
+
+      for (work = clist->undo_unselection; work; work = work->next)
+	{
+	  /* g_print ("unselect %d\n",GPOINTER_TO_INT (work->data)); */
+	  gtk_signal_emit (GTK_OBJECT (clist), clist_signals[UNSELECT_ROW], 
+			   GPOINTER_TO_INT (work->data), -1, NULL);
+	}
     }
 
   if (GTK_WIDGET_HAS_FOCUS(clist) && clist->focus_row != clist->undo_anchor)
@@ -3985,6 +5617,27 @@ set_anchor (GtkCList *clist,
   clist->undo_anchor = undo_anchor;
 }
 
+/* take a row out of the selection during resync_selection() */
+static void
+resync_unselect_row (GtkCList    *clist,
+		     gint         row,
+		     GtkCListRow *clist_row,
+		     gboolean     signals,
+		     GdkEvent    *event)
+{
+  if (signals)
+    {
+      row_set_state (clist, row, clist_row, GTK_STATE_SELECTED);
+      gtk_signal_emit (GTK_OBJECT (clist), clist_signals[UNSELECT_ROW],
+		       row, -1, event);
+    }
+  else
+    {
+      row_set_state (clist, row, clist_row, GTK_STATE_NORMAL);
+      selection_runs_remove (clist, row, row);
+    }
+}
+
 static void
 resync_selection (GtkCList *clist,
 		  GdkEvent *event)
@@ -3992,6 +5645,7 @@ resync_selection (GtkCList *clist,
   gint i;
   gint e;
   gint row;
+  gboolean signals;
   GList *list;
   GtkCListRow *clist_row;
 
@@ -4006,12 +5660,17 @@ resync_selection (GtkCList *clist,
   i = MIN (clist->anchor, clist->drag_pos);
   e = MAX (clist->anchor, clist->drag_pos);
 
+  /* with nobody listening, the rows go in and out of the runs
+   * directly and clist->selection is rebuilt from them at the end */
+  signals = selection_signals_needed (clist);
+
   if (clist->undo_selection)
     {
       list = clist->selection;
       clist->selection = clist->undo_selection;
       clist->selection_end = g_list_last (clist->selection);
       clist->undo_selection = list;
+      selection_runs_rebuild (clist);
       list = clist->selection;
       while (list)
 	{
@@ -4019,13 +5678,10 @@ resync_selection (GtkCList *clist,
 	  list = list->next;
 	  if (row < i || row > e)
 	    {
-	      clist_row = g_list_nth (clist->row_list, row)->data;
+	      clist_row = ROW_ELEMENT (clist, row)->data;
 	      if (clist_row->selectable)
 		{
-		  clist_row->state = GTK_STATE_SELECTED;
-		  gtk_signal_emit (GTK_OBJECT (clist),
-				   clist_signals[UNSELECT_ROW],
-				   row, -1, event);
+		  resync_unselect_row (clist, row, clist_row, signals, event);
 		  clist->undo_selection = g_list_prepend
 		    (clist->undo_selection, GINT_TO_POINTER (row));
 		}
@@ -4035,65 +5691,70 @@ resync_selection (GtkCList *clist,
 
   if (clist->anchor < clist->drag_pos)
     {
-      for (list = g_list_nth (clist->row_list, i); i <= e;
-	   i++, list = list->next)
-	if (GTK_CLIST_ROW (list)->selectable)
-	  {
-	    if (g_list_find (clist->selection, GINT_TO_POINTER(i)))
-	      {
-		if (GTK_CLIST_ROW (list)->state == GTK_STATE_NORMAL)
-		  {
-		    GTK_CLIST_ROW (list)->state = GTK_STATE_SELECTED;
-		    gtk_signal_emit (GTK_OBJECT (clist),
-				     clist_signals[UNSELECT_ROW],
-				     i, -1, event);
-		    clist->undo_selection =
-		      g_list_prepend (clist->undo_selection,
-				      GINT_TO_POINTER (i));
-		  }
-	      }
-	    else if (GTK_CLIST_ROW (list)->state == GTK_STATE_SELECTED)
-	      {
-		GTK_CLIST_ROW (list)->state = GTK_STATE_NORMAL;
-		clist->undo_unselection =
-		  g_list_prepend (clist->undo_unselection,
-				  GINT_TO_POINTER (i));
-	      }
-	  }
+      for (; i <= e; i++)
+	{
+	  clist_row = ROW_ELEMENT (clist, i)->data;
+	  if (!clist_row->selectable)
+	    continue;
+
+	  if (selection_runs_contain (clist, i))
+	    {
+	      if (clist_row->state == GTK_STATE_NORMAL)
+		{
+		  resync_unselect_row (clist, i, clist_row, signals, event);
+		  clist->undo_selection =
+		    g_list_prepend (clist->undo_selection,
+				    GINT_TO_POINTER (i));
+		}
+	    }
+	  else if (clist_row->state == GTK_STATE_SELECTED)
+	    {
+	      row_set_state (clist, i, clist_row, GTK_STATE_NORMAL);
+	      clist->undo_unselection =
+		g_list_prepend (clist->undo_unselection,
+				GINT_TO_POINTER (i));
+	    }
+	}
     }
   else
     {
-      for (list = g_list_nth (clist->row_list, e); i <= e;
-	   e--, list = list->prev)
-	if (GTK_CLIST_ROW (list)->selectable)
-	  {
-	    if (g_list_find (clist->selection, GINT_TO_POINTER(e)))
-	      {
-		if (GTK_CLIST_ROW (list)->state == GTK_STATE_NORMAL)
-		  {
-		    GTK_CLIST_ROW (list)->state = GTK_STATE_SELECTED;
-		    gtk_signal_emit (GTK_OBJECT (clist),
-				     clist_signals[UNSELECT_ROW],
-				     e, -1, event);
-		    clist->undo_selection =
-		      g_list_prepend (clist->undo_selection,
-				      GINT_TO_POINTER (e));
-		  }
-	      }
-	    else if (GTK_CLIST_ROW (list)->state == GTK_STATE_SELECTED)
-	      {
-		GTK_CLIST_ROW (list)->state = GTK_STATE_NORMAL;
-		clist->undo_unselection =
-		  g_list_prepend (clist->undo_unselection,
-				  GINT_TO_POINTER (e));
-	      }
-	  }
+      for (; i <= e; e--)
+	{
+	  clist_row = ROW_ELEMENT (clist, e)->data;
+	  if (!clist_row->selectable)
+	    continue;
+
+	  if (selection_runs_contain (clist, e))
+	    {
+	      if (clist_row->state == GTK_STATE_NORMAL)
+		{
+		  resync_unselect_row (clist, e, clist_row, signals, event);
+		  clist->undo_selection =
+		    g_list_prepend (clist->undo_selection,
+				    GINT_TO_POINTER (e));
+		}
+	    }
+	  else if (clist_row->state == GTK_STATE_SELECTED)
+	    {
+	      row_set_state (clist, e, clist_row, GTK_STATE_NORMAL);
+	      clist->undo_unselection =
+		g_list_prepend (clist->undo_unselection,
+				GINT_TO_POINTER (e));
+	    }
+	}
     }
   
   clist->undo_unselection = g_list_reverse (clist->undo_unselection);
   for (list = clist->undo_unselection; list; list = list->next)
-    gtk_signal_emit (GTK_OBJECT (clist), clist_signals[SELECT_ROW],
-		     GPOINTER_TO_INT (list->data), -1, event);
+    if (signals)
+      gtk_signal_emit (GTK_OBJECT (clist), clist_signals[SELECT_ROW],
+		       GPOINTER_TO_INT (list->data), -1, event);
+    else
+      selection_select_range (clist, GPOINTER_TO_INT (list->data),
+			      GPOINTER_TO_INT (list->data));
+
+  if (!signals)
+    selection_list_rebuild (clist);
 
   clist->anchor = -1;
   clist->drag_pos = -1;
@@ -4179,15 +5840,14 @@ update_extended_selection (GtkCList *clist,
   /* restore the elements between s1 and e1 */
   if (s1 >= 0)
     {
-      for (i = s1, list = g_list_nth (clist->row_list, i); i <= e1;
-	   i++, list = list->next)
-	if (GTK_CLIST_ROW (list)->selectable)
-	  {
-	    if (GTK_CLIST_CLASS_FW (clist)->selection_find (clist, i, list))
-	      GTK_CLIST_ROW (list)->state = GTK_STATE_SELECTED;
-	    else
-	      GTK_CLIST_ROW (list)->state = GTK_STATE_NORMAL;
-	  }
+      for (i = s1; i <= e1; i++)
+	{
+	  list = ROW_ELEMENT (clist, i);
+	  if (GTK_CLIST_ROW (list)->selectable)
+	    row_set_state (clist, i, GTK_CLIST_ROW (list),
+			   row_in_selection (clist, i, list) ?
+			   GTK_STATE_SELECTED : GTK_STATE_NORMAL);
+	}
 
       top = ROW_TOP_YPIXEL (clist, clist->focus_row);
 
@@ -4217,11 +5877,14 @@ update_extended_selection (GtkCList *clist,
   /* extend the selection between s2 and e2 */
   if (s2 >= 0)
     {
-      for (i = s2, list = g_list_nth (clist->row_list, i); i <= e2;
-	   i++, list = list->next)
-	if (GTK_CLIST_ROW (list)->selectable &&
-	    GTK_CLIST_ROW (list)->state != clist->anchor_state)
-	  GTK_CLIST_ROW (list)->state = clist->anchor_state;
+      for (i = s2; i <= e2; i++)
+	{
+	  list = ROW_ELEMENT (clist, i);
+	  if (GTK_CLIST_ROW (list)->selectable &&
+	      GTK_CLIST_ROW (list)->state != clist->anchor_state)
+	    row_set_state (clist, i, GTK_CLIST_ROW (list),
+			   clist->anchor_state);
+	}
 
       top = ROW_TOP_YPIXEL (clist, clist->focus_row);
 
@@ -4354,6 +6017,7 @@ sync_selection (GtkCList *clist,
 	list->data = ((gchar*) list->data) + d;
       list = list->next;
     }
+  selection_runs_shift (clist, row, d);
 }
 
 /* GTKOBJECT
@@ -4579,11 +6243,9 @@ gtk_clist_realize (GtkWidget *widget)
 					  GDK_GC_SUBWINDOW);
 
   /* attach optional row/cell styles, allocate foreground/background colors */
-  list = clist->row_list;
-  for (i = 0; i < clist->rows; i++)
+  for (list = clist->row_list; list; list = list->next)
     {
       clist_row = list->data;
-      list = list->next;
 
       if (clist_row->style)
 	clist_row->style = gtk_style_attach (clist_row->style,
@@ -4633,11 +6295,9 @@ gtk_clist_unrealize (GtkWidget *widget)
       GList *list;
       gint j;
 
-      list = clist->row_list;
-      for (i = 0; i < clist->rows; i++)
+      for (list = clist->row_list; list; list = list->next)
 	{
 	  clist_row = list->data;
-	  list = list->next;
 
 	  if (clist_row->style)
 	    gtk_style_detach (clist_row->style);
@@ -4894,6 +6554,7 @@ gtk_clist_style_set (GtkWidget *widget,
 				      widget->style->font->descent - 1) / 2;
 
   /* Column widths */
+  cell_widths_invalidate (clist, -1);
   if (!GTK_CLIST_AUTO_RESIZE_BLOCKED(clist))
     {
       gint width;
@@ -5573,6 +7234,7 @@ gtk_clist_forall (GtkContainer *container,
  *   draw_cell_pixmap
  *   draw_row
  *   draw_rows
+ *   draw_rows_batched
  *   draw_xor_line
  *   clist_refresh
  */
@@ -5714,8 +7376,8 @@ draw_row (GtkCList     *clist,
 
   /* if the function is passed the pointer to the row instead of null,
    * it avoids this expensive lookup */
-  if (!clist_row)
-    clist_row = ROW_ELEMENT (clist, row)->data;
+  if (!clist_row || CLIST_VIRTUAL (clist))
+    clist_row = row_get (clist, row);
 
   /* rectangle of the entire row */
   row_rectangle.x = 0;
@@ -5761,7 +7423,7 @@ draw_row (GtkCList     *clist,
 			    intersect_rectangle.height);
 
       /* the last row has to clear its bottom cell spacing too */
-      if (clist_row == clist->row_list_end->data)
+      if (row == clist->rows - 1)
 	{
 	  cell_rectangle.y += clist->row_height + CELL_SPACING;
 
@@ -5792,7 +7454,7 @@ draw_row (GtkCList     *clist,
 			  cell_rectangle.height);
 
       /* the last row has to clear its bottom cell spacing too */
-      if (clist_row == clist->row_list_end->data)
+      if (row == clist->rows - 1)
 	{
 	  cell_rectangle.y += clist->row_height + CELL_SPACING;
 
@@ -5875,71 +7537,543 @@ draw_row (GtkCList     *clist,
 	  break;
 	}
 
-      switch (clist->column[i].justification)
+      switch (clist->column[i].justification)
+	{
+	case GTK_JUSTIFY_LEFT:
+	  offset = clip_rectangle.x + clist_row->cell[i].horizontal;
+	  break;
+	case GTK_JUSTIFY_RIGHT:
+	  offset = (clip_rectangle.x + clist_row->cell[i].horizontal +
+		    clip_rectangle.width - width);
+	  break;
+	case GTK_JUSTIFY_CENTER:
+	case GTK_JUSTIFY_FILL:
+	  offset = (clip_rectangle.x + clist_row->cell[i].horizontal +
+		    (clip_rectangle.width / 2) - (width / 2));
+	  break;
+	};
+
+      /* Draw Text and/or Pixmap */
+      switch (clist_row->cell[i].type)
+	{
+	case GTK_CELL_PIXMAP:
+	  draw_cell_pixmap (clist->clist_window, &clip_rectangle, fg_gc,
+			    GTK_CELL_PIXMAP (clist_row->cell[i])->pixmap,
+			    GTK_CELL_PIXMAP (clist_row->cell[i])->mask,
+			    offset,
+			    clip_rectangle.y + clist_row->cell[i].vertical +
+			    (clip_rectangle.height - height) / 2,
+			    pixmap_width, height);
+	  break;
+	case GTK_CELL_PIXTEXT:
+	  offset =
+	    draw_cell_pixmap (clist->clist_window, &clip_rectangle, fg_gc,
+			      GTK_CELL_PIXTEXT (clist_row->cell[i])->pixmap,
+			      GTK_CELL_PIXTEXT (clist_row->cell[i])->mask,
+			      offset,
+			      clip_rectangle.y + clist_row->cell[i].vertical+
+			      (clip_rectangle.height - height) / 2,
+			      pixmap_width, height);
+	  offset += GTK_CELL_PIXTEXT (clist_row->cell[i])->spacing;
+	case GTK_CELL_TEXT:
+	  if (style != GTK_WIDGET (clist)->style)
+	    row_center_offset = (((clist->row_height - style->font->ascent -
+				  style->font->descent - 1) / 2) + 1.5 +
+				 style->font->ascent);
+	  else
+	    row_center_offset = clist->row_center_offset;
+
+	  gdk_gc_set_clip_rectangle (fg_gc, &clip_rectangle);
+	  gdk_draw_string (clist->clist_window, style->font, fg_gc,
+			   offset,
+			   row_rectangle.y + row_center_offset + 
+			   clist_row->cell[i].vertical,
+			   (clist_row->cell[i].type == GTK_CELL_PIXTEXT) ?
+			   GTK_CELL_PIXTEXT (clist_row->cell[i])->text :
+			   GTK_CELL_TEXT (clist_row->cell[i])->text);
+	  gdk_gc_set_clip_rectangle (fg_gc, NULL);
+	  break;
+	default:
+	  break;
+	}
+    }
+
+  /* draw focus rectangle */
+  if (clist->focus_row == row &&
+      GTK_WIDGET_CAN_FOCUS (widget) && GTK_WIDGET_HAS_FOCUS(widget))
+    {
+      if (!area)
+	gdk_draw_rectangle (clist->clist_window, clist->xor_gc, FALSE,
+			    row_rectangle.x, row_rectangle.y,
+			    row_rectangle.width - 1, row_rectangle.height - 1);
+      else if (gdk_rectangle_intersect (area, &row_rectangle,
+					&intersect_rectangle))
+	{
+	  gdk_gc_set_clip_rectangle (clist->xor_gc, &intersect_rectangle);
+	  gdk_draw_rectangle (clist->clist_window, clist->xor_gc, FALSE,
+			      row_rectangle.x, row_rectangle.y,
+			      row_rectangle.width - 1,
+			      row_rectangle.height - 1);
+	  gdk_gc_set_clip_rectangle (clist->xor_gc, NULL);
+	}
+    }
+}
+
+static void
+draw_rows (GtkCList     *clist,
+	   GdkRectangle *area)
+{
+  gint i;
+  gint first_row;
+  gint last_row;
+
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+
+  if (clist->row_height == 0 ||
+      !GTK_WIDGET_DRAWABLE (clist))
+    return;
+
+  if (area)
+    {
+      first_row = ROW_FROM_YPIXEL (clist, area->y);
+      last_row = ROW_FROM_YPIXEL (clist, area->y + area->height);
+    }
+  else
+    {
+      first_row = ROW_FROM_YPIXEL (clist, 0);
+      last_row = ROW_FROM_YPIXEL (clist, clist->clist_window_height);
+    }
+
+  /* this is a small special case which exposes the bottom cell line
+   * on the last row -- it might go away if I change the wall the cell
+   * spacings are drawn
+   */
+  if (clist->rows == first_row)
+    first_row--;
+
+  /* unless a subclass draws its own rows, do the whole range at once */
+  if (first_row >= 0 && first_row < clist->rows &&
+      GTK_CLIST_CLASS_FW (clist)->draw_row == draw_row &&
+      !CLIST_VIRTUAL (clist))
+    {
+      if (first_row > last_row)
+	return;
+
+      draw_rows_batched (clist, area, first_row,
+			 MIN (last_row, clist->rows - 1));
+      if (last_row < clist->rows)
+	return;
+      i = clist->rows;
+    }
+  else
+    for (i = first_row; i >= 0 && i < clist->rows; i++)
+      {
+	if (i > last_row)
+	  return;
+
+	GTK_CLIST_CLASS_FW (clist)->draw_row (clist, area, i, NULL);
+      }
+
+  if (!area)
+    gdk_window_clear_area (clist->clist_window, 0,
+			   ROW_TOP_YPIXEL (clist, i), 0, 0);
+}
+
+static gint
+draw_cell_compare_background (gconstpointer a,
+			      gconstpointer b)
+{
+  const GtkCListDrawCell *cell_a = *((GtkCListDrawCell **) a);
+  const GtkCListDrawCell *cell_b = *((GtkCListDrawCell **) b);
+
+  if (cell_a->bg_gc != cell_b->bg_gc)
+    return ((gulong) cell_a->bg_gc < (gulong) cell_b->bg_gc) ? -1 : 1;
+
+  return (cell_a < cell_b) ? -1 : (cell_a > cell_b);
+}
+
+static gint
+draw_cell_compare_row (gconstpointer a,
+		       gconstpointer b)
+{
+  const GtkCListDrawCell *cell_a = *((GtkCListDrawCell **) a);
+  const GtkCListDrawCell *cell_b = *((GtkCListDrawCell **) b);
+
+  if (cell_a->clip.y != cell_b->clip.y)
+    return cell_a->clip.y - cell_b->clip.y;
+  if (cell_a->fg_gc != cell_b->fg_gc)
+    return ((gulong) cell_a->fg_gc < (gulong) cell_b->fg_gc) ? -1 : 1;
+  if (cell_a->style->font != cell_b->style->font)
+    return (((gulong) cell_a->style->font < (gulong) cell_b->style->font) ?
+	    -1 : 1);
+  if (cell_a->baseline != cell_b->baseline)
+    return cell_a->baseline - cell_b->baseline;
+
+  return cell_a->text_x - cell_b->text_x;
+}
+
+static gint
+draw_cell_compare_text (gconstpointer a,
+			gconstpointer b)
+{
+  const GtkCListDrawCell *cell_a = *((GtkCListDrawCell **) a);
+  const GtkCListDrawCell *cell_b = *((GtkCListDrawCell **) b);
+
+  if (cell_a->column != cell_b->column)
+    return cell_a->column - cell_b->column;
+  if (cell_a->fg_gc != cell_b->fg_gc)
+    return ((gulong) cell_a->fg_gc < (gulong) cell_b->fg_gc) ? -1 : 1;
+  if (cell_a->style->font != cell_b->style->font)
+    return (((gulong) cell_a->style->font < (gulong) cell_b->style->font) ?
+	    -1 : 1);
+
+  return (cell_a < cell_b) ? -1 : (cell_a > cell_b);
+}
+
+/* Does the same as calling draw_row() for first_row to last_row,
+ * but in an order that needs far fewer X requests: the cell spacings
+ * first, then the backgrounds grouped by gc (so Xlib can merge the
+ * fills into one PolyFillRectangle per gc), then the pixmaps, and
+ * the text last.  Text that lies inside its cell needs no clip, and
+ * goes out as one PolyText request per row, gc and font.  The rest
+ * is drawn column by column, grouped by gc and font, so the clip
+ * rectangle is set once per group instead of twice per cell.
+ */
+static void
+draw_rows_batched (GtkCList     *clist,
+		   GdkRectangle *area,
+		   gint          first_row,
+		   gint          last_row)
+{
+  GtkWidget *widget;
+  GtkCListDrawCell *cells;
+  GtkCListDrawCell **sorted;
+  GtkCListDrawCell *cell;
+  GtkCListRow *color_row;
+  GdkRectangle row_rectangle;
+  GdkRectangle cell_rectangle;
+  GdkRectangle clip_rectangle;
+  GdkRectangle intersect_rectangle;
+  GdkGC *spacing_gc;
+  XTextItem *items;
+  GList *list;
+  gint n_cells = 0;
+  gint n_text;
+  gint last_column;
+  gint row;
+  gint i;
+  gint j;
+
+  widget = GTK_WIDGET (clist);
+  spacing_gc = widget->style->base_gc[GTK_STATE_ACTIVE];
+
+  for (last_column = clist->columns - 1;
+       last_column >= 0 && !clist->column[last_column].visible; last_column--)
+    ;
+
+  cells = g_new (GtkCListDrawCell, (last_row - first_row + 1) * clist->columns);
+
+  row_rectangle.x = 0;
+  row_rectangle.width = clist->clist_window_width;
+  row_rectangle.height = clist->row_height;
+
+  /* cell spacings, and collect the cells to draw */
+  list = ROW_ELEMENT (clist, first_row);
+  for (row = first_row; row <= last_row && list; row++, list = list->next)
+    {
+      GtkCListRow *clist_row = list->data;
+
+      row_rectangle.y = ROW_TOP_YPIXEL (clist, row);
+
+      cell_rectangle.x = 0;
+      cell_rectangle.y = row_rectangle.y - CELL_SPACING;
+      cell_rectangle.width = row_rectangle.width;
+      cell_rectangle.height = CELL_SPACING;
+
+      for (i = 0; i < 1 + (row == clist->rows - 1); i++)
+	{
+	  if (!area)
+	    gdk_draw_rectangle (clist->clist_window, spacing_gc, TRUE,
+				cell_rectangle.x, cell_rectangle.y,
+				cell_rectangle.width, cell_rectangle.height);
+	  else if (gdk_rectangle_intersect (area, &cell_rectangle,
+					    &intersect_rectangle))
+	    gdk_draw_rectangle (clist->clist_window, spacing_gc, TRUE,
+				intersect_rectangle.x, intersect_rectangle.y,
+				intersect_rectangle.width,
+				intersect_rectangle.height);
+
+	  /* the last row has to clear its bottom cell spacing too */
+	  cell_rectangle.y += clist->row_height + CELL_SPACING;
+	}
+
+      if (area && !gdk_rectangle_intersect (area, &row_rectangle,
+					    &intersect_rectangle))
+	continue;
+
+      clip_rectangle.y = row_rectangle.y;
+      clip_rectangle.height = row_rectangle.height;
+
+      for (i = 0; i < clist->columns; i++)
+	{
+	  if (!clist->column[i].visible)
+	    continue;
+
+	  clip_rectangle.x = (clist->column[i].area.x + clist->hoffset -
+			      COLUMN_INSET - CELL_SPACING);
+	  clip_rectangle.width = (clist->column[i].area.width +
+				  2 * COLUMN_INSET + CELL_SPACING +
+				  (i == last_column) * CELL_SPACING);
+
+	  cell = cells + n_cells;
+	  if (!area)
+	    cell->background = clip_rectangle;
+	  else if (!gdk_rectangle_intersect (area, &clip_rectangle,
+					     &cell->background))
+	    continue;
+
+	  cell->row = clist_row;
+	  cell->column = i;
+	  cell->clip.x = clist->column[i].area.x + clist->hoffset;
+	  cell->clip.y = row_rectangle.y;
+	  cell->clip.width = clist->column[i].area.width;
+	  cell->clip.height = row_rectangle.height;
+	  cell->text = NULL;
+	  get_cell_style (clist, clist_row, clist_row->state, i,
+			  &cell->style, &cell->fg_gc, &cell->bg_gc);
+	  n_cells++;
+	}
+    }
+
+  sorted = g_new (GtkCListDrawCell *, n_cells);
+  for (i = 0; i < n_cells; i++)
+    sorted[i] = cells + i;
+
+  /* backgrounds.  Rows with their own colors share clist->bg_gc, its
+   * foreground is set whenever the row changes. */
+  qsort (sorted, n_cells, sizeof (GtkCListDrawCell *),
+	 draw_cell_compare_background);
+
+  color_row = NULL;
+  for (i = 0; i < n_cells; i++)
+    {
+      cell = sorted[i];
+      if (cell->bg_gc == clist->bg_gc && cell->row != color_row)
+	{
+	  color_row = cell->row;
+	  gdk_gc_set_foreground (clist->bg_gc, &color_row->background);
+	}
+      gdk_draw_rectangle (clist->clist_window, cell->bg_gc, TRUE,
+			  cell->background.x, cell->background.y,
+			  cell->background.width, cell->background.height);
+    }
+
+  /* pixmaps, and where the text goes */
+  for (i = 0; i < n_cells; i++)
+    {
+      GtkCell *clist_cell;
+      GdkPixmap *pixmap = NULL;
+      GdkBitmap *mask = NULL;
+      gint pixmap_width = 0;
+      gint height = 0;
+      gint width = 0;
+      gint offset = 0;
+
+      cell = cells + i;
+      clist_cell = &cell->row->cell[cell->column];
+
+      switch (clist_cell->type)
+	{
+	case GTK_CELL_TEXT:
+	  cell->text = GTK_CELL_TEXT (*clist_cell)->text;
+	  break;
+	case GTK_CELL_PIXMAP:
+	  pixmap = GTK_CELL_PIXMAP (*clist_cell)->pixmap;
+	  mask = GTK_CELL_PIXMAP (*clist_cell)->mask;
+	  break;
+	case GTK_CELL_PIXTEXT:
+	  cell->text = GTK_CELL_PIXTEXT (*clist_cell)->text;
+	  pixmap = GTK_CELL_PIXTEXT (*clist_cell)->pixmap;
+	  mask = GTK_CELL_PIXTEXT (*clist_cell)->mask;
+	  break;
+	default:
+	  continue;
+	}
+
+      if (pixmap)
+	{
+	  gdk_window_get_size (pixmap, &pixmap_width, &height);
+	  width = pixmap_width;
+	  if (cell->text)
+	    width += GTK_CELL_PIXTEXT (*clist_cell)->spacing;
+	}
+      /* text width only matters for the justification */
+      if (cell->text &&
+	  clist->column[cell->column].justification != GTK_JUSTIFY_LEFT)
+	width += gdk_string_width (cell->style->font, cell->text);
+
+      switch (clist->column[cell->column].justification)
 	{
 	case GTK_JUSTIFY_LEFT:
-	  offset = clip_rectangle.x + clist_row->cell[i].horizontal;
+	  offset = cell->clip.x + clist_cell->horizontal;
 	  break;
 	case GTK_JUSTIFY_RIGHT:
-	  offset = (clip_rectangle.x + clist_row->cell[i].horizontal +
-		    clip_rectangle.width - width);
+	  offset = (cell->clip.x + clist_cell->horizontal +
+		    cell->clip.width - width);
 	  break;
 	case GTK_JUSTIFY_CENTER:
 	case GTK_JUSTIFY_FILL:
-	  offset = (clip_rectangle.x + clist_row->cell[i].horizontal +
-		    (clip_rectangle.width / 2) - (width / 2));
+	  offset = (cell->clip.x + clist_cell->horizontal +
+		    (cell->clip.width / 2) - (width / 2));
 	  break;
 	};
 
-      /* Draw Text and/or Pixmap */
-      switch (clist_row->cell[i].type)
+      if (pixmap)
 	{
-	case GTK_CELL_PIXMAP:
-	  draw_cell_pixmap (clist->clist_window, &clip_rectangle, fg_gc,
-			    GTK_CELL_PIXMAP (clist_row->cell[i])->pixmap,
-			    GTK_CELL_PIXMAP (clist_row->cell[i])->mask,
-			    offset,
-			    clip_rectangle.y + clist_row->cell[i].vertical +
-			    (clip_rectangle.height - height) / 2,
-			    pixmap_width, height);
-	  break;
-	case GTK_CELL_PIXTEXT:
-	  offset =
-	    draw_cell_pixmap (clist->clist_window, &clip_rectangle, fg_gc,
-			      GTK_CELL_PIXTEXT (clist_row->cell[i])->pixmap,
-			      GTK_CELL_PIXTEXT (clist_row->cell[i])->mask,
-			      offset,
-			      clip_rectangle.y + clist_row->cell[i].vertical+
-			      (clip_rectangle.height - height) / 2,
-			      pixmap_width, height);
-	  offset += GTK_CELL_PIXTEXT (clist_row->cell[i])->spacing;
-	case GTK_CELL_TEXT:
-	  if (style != GTK_WIDGET (clist)->style)
-	    row_center_offset = (((clist->row_height - style->font->ascent -
-				  style->font->descent - 1) / 2) + 1.5 +
-				 style->font->ascent);
+	  offset = draw_cell_pixmap (clist->clist_window, &cell->clip,
+				     cell->fg_gc, pixmap, mask, offset,
+				     cell->clip.y + clist_cell->vertical +
+				     (cell->clip.height - height) / 2,
+				     pixmap_width, height);
+	  if (cell->text)
+	    offset += GTK_CELL_PIXTEXT (*clist_cell)->spacing;
+	}
+
+      if (!cell->text)
+	continue;
+
+      cell->text_x = offset;
+      if (cell->style != widget->style)
+	cell->baseline = (((clist->row_height - cell->style->font->ascent -
+			    cell->style->font->descent - 1) / 2) + 1.5 +
+			  cell->style->font->ascent);
+      else
+	cell->baseline = clist->row_center_offset;
+      cell->baseline += cell->clip.y + clist_cell->vertical;
+
+      /* only text that stays within its row may share a clip
+       * rectangle spanning several rows */
+      cell->own_clip = (clist_cell->vertical != 0 ||
+			(cell->style->font->ascent +
+			 cell->style->font->descent >= clist->row_height));
+
+      /* text of a single byte font that doesn't leave its cell at
+       * all can be drawn without a clip */
+      cell->fits = FALSE;
+      if (!cell->own_clip && cell->style->font->type == GDK_FONT_FONT)
+	{
+	  XFontStruct *xfont = GDK_FONT_XFONT (cell->style->font);
+	  gint lbearing;
+	  gint rbearing;
+	  gint ascent;
+	  gint descent;
+
+	  if (xfont->min_byte1 == 0 && xfont->max_byte1 == 0)
+	    {
+	      gdk_string_extents (cell->style->font, cell->text,
+				  &lbearing, &rbearing, &cell->text_width,
+				  &ascent, &descent);
+	      cell->fits = (cell->text_x + lbearing >= cell->clip.x &&
+			    (cell->text_x + rbearing <=
+			     cell->clip.x + cell->clip.width));
+	    }
+	}
+    }
+
+  /* text inside its cell, a row at a time.  Cells of a row sharing gc,
+   * font and baseline go into one XDrawText call, the gaps between
+   * them becoming the items' deltas. */
+  for (i = 0, j = 0; i < n_cells; i++)
+    if (cells[i].text && cells[i].fits)
+      sorted[j++] = cells + i;
+  n_text = j;
+
+  qsort (sorted, n_text, sizeof (GtkCListDrawCell *), draw_cell_compare_row);
+
+  items = g_new (XTextItem, n_text);
+  color_row = NULL;
+  for (i = 0; i < n_text; i = j)
+    {
+      cell = sorted[i];
+      for (j = i; (j < n_text && sorted[j]->row == cell->row &&
+		   sorted[j]->fg_gc == cell->fg_gc &&
+		   sorted[j]->style->font == cell->style->font &&
+		   sorted[j]->baseline == cell->baseline); j++)
+	{
+	  items[j - i].chars = sorted[j]->text;
+	  items[j - i].nchars = strlen (sorted[j]->text);
+	  items[j - i].font = None;
+	  if (j == i)
+	    items[j - i].delta = 0;
 	  else
-	    row_center_offset = clist->row_center_offset;
+	    items[j - i].delta = (sorted[j]->text_x - sorted[j - 1]->text_x -
+				  sorted[j - 1]->text_width);
+	}
 
-	  gdk_gc_set_clip_rectangle (fg_gc, &clip_rectangle);
-	  gdk_draw_string (clist->clist_window, style->font, fg_gc,
-			   offset,
-			   row_rectangle.y + row_center_offset + 
-			   clist_row->cell[i].vertical,
-			   (clist_row->cell[i].type == GTK_CELL_PIXTEXT) ?
-			   GTK_CELL_PIXTEXT (clist_row->cell[i])->text :
-			   GTK_CELL_TEXT (clist_row->cell[i])->text);
-	  gdk_gc_set_clip_rectangle (fg_gc, NULL);
-	  break;
-	default:
-	  break;
+      if (cell->fg_gc == clist->fg_gc && cell->row != color_row)
+	{
+	  color_row = cell->row;
+	  gdk_gc_set_foreground (clist->fg_gc, &color_row->foreground);
+	}
+      /* the font goes into the gc as gdk_draw_string() would put it */
+      XSetFont (GDK_GC_XDISPLAY (cell->fg_gc), GDK_GC_XGC (cell->fg_gc),
+		((XFontStruct *) GDK_FONT_XFONT (cell->style->font))->fid);
+      XDrawText (GDK_WINDOW_XDISPLAY (clist->clist_window),
+		 GDK_WINDOW_XWINDOW (clist->clist_window),
+		 GDK_GC_XGC (cell->fg_gc), cell->text_x, cell->baseline,
+		 items, j - i);
+    }
+  g_free (items);
+
+  /* the remaining text, a column at a time */
+  for (i = 0, j = 0; i < n_cells; i++)
+    if (cells[i].text && !cells[i].fits)
+      sorted[j++] = cells + i;
+  n_cells = j;
+
+  qsort (sorted, n_cells, sizeof (GtkCListDrawCell *),
+	 draw_cell_compare_text);
+
+  color_row = NULL;
+  for (i = 0; i < n_cells; i = j)
+    {
+      GdkRectangle band;
+
+      cell = sorted[i];
+      band = cell->clip;
+      j = i + 1;
+      if (!cell->own_clip)
+	for (; j < n_cells && !sorted[j]->own_clip &&
+	       sorted[j]->column == cell->column &&
+	       sorted[j]->fg_gc == cell->fg_gc &&
+	       sorted[j]->style->font == cell->style->font; j++)
+	  band.height = sorted[j]->clip.y + sorted[j]->clip.height - band.y;
+
+      gdk_gc_set_clip_rectangle (cell->fg_gc, &band);
+      for (; i < j; i++)
+	{
+	  cell = sorted[i];
+	  if (cell->fg_gc == clist->fg_gc && cell->row != color_row)
+	    {
+	      color_row = cell->row;
+	      gdk_gc_set_foreground (clist->fg_gc, &color_row->foreground);
+	    }
+	  gdk_draw_string (clist->clist_window, cell->style->font, cell->fg_gc,
+			   cell->text_x, cell->baseline, cell->text);
 	}
+      gdk_gc_set_clip_rectangle (cell->fg_gc, NULL);
     }
 
+  g_free (sorted);
+  g_free (cells);
+
   /* draw focus rectangle */
-  if (clist->focus_row == row &&
-      GTK_WIDGET_CAN_FOCUS (widget) && GTK_WIDGET_HAS_FOCUS(widget))
+  if (clist->focus_row >= first_row && clist->focus_row <= last_row &&
+      GTK_WIDGET_CAN_FOCUS (widget) && GTK_WIDGET_HAS_FOCUS (widget))
     {
+      row_rectangle.y = ROW_TOP_YPIXEL (clist, clist->focus_row);
+
       if (!area)
 	gdk_draw_rectangle (clist->clist_window, clist->xor_gc, FALSE,
 			    row_rectangle.x, row_rectangle.y,
@@ -5957,60 +8091,6 @@ draw_row (GtkCList     *clist,
     }
 }
 
-static void
-draw_rows (GtkCList     *clist,
-	   GdkRectangle *area)
-{
-  GList *list;
-  GtkCListRow *clist_row;
-  gint i;
-  gint first_row;
-  gint last_row;
-
-  g_return_if_fail (clist != NULL);
-  g_return_if_fail (GTK_IS_CLIST (clist));
-
-  if (clist->row_height == 0 ||
-      !GTK_WIDGET_DRAWABLE (clist))
-    return;
-
-  if (area)
-    {
-      first_row = ROW_FROM_YPIXEL (clist, area->y);
-      last_row = ROW_FROM_YPIXEL (clist, area->y + area->height);
-    }
-  else
-    {
-      first_row = ROW_FROM_YPIXEL (clist, 0);
-      last_row = ROW_FROM_YPIXEL (clist, clist->clist_window_height);
-    }
-
-  /* this is a small special case which exposes the bottom cell line
-   * on the last row -- it might go away if I change the wall the cell
-   * spacings are drawn
-   */
-  if (clist->rows == first_row)
-    first_row--;
-
-  list = ROW_ELEMENT (clist, first_row);
-  i = first_row;
-  while (list)
-    {
-      clist_row = list->data;
-      list = list->next;
-
-      if (i > last_row)
-	return;
-
-      GTK_CLIST_CLASS_FW (clist)->draw_row (clist, area, i, clist_row);
-      i++;
-    }
-
-  if (!area)
-    gdk_window_clear_area (clist->clist_window, 0,
-			   ROW_TOP_YPIXEL (clist, i), 0, 0);
-}
-
 static void                          
 draw_xor_line (GtkCList *clist)
 {
@@ -6144,6 +8224,7 @@ adjust_adjustments (GtkCList *clist,
       GtkRequisition requisition;
 
       widget = GTK_WIDGET (clist);
+      GTK_PRIVATE_SET_FLAG (widget, GTK_REQUEST_NEEDED);
       gtk_widget_size_request (widget, &requisition);
 
       if ((!clist->hadjustment &&
@@ -6542,6 +8623,9 @@ row_delete (GtkCList    *clist,
     {
       GTK_CLIST_CLASS_FW (clist)->set_cell_contents
 	(clist, clist_row, i, GTK_CELL_EMPTY, NULL, 0, NULL, NULL);
+      /* an empty cell still takes up its shift */
+      if (clist_row->cell[i].horizontal)
+	column_auto_resize (clist, NULL, i, clist_row->cell[i].horizontal);
       if (clist_row->cell[i].style)
 	{
 	  if (GTK_WIDGET_REALIZED (clist))
@@ -6706,7 +8790,7 @@ gtk_clist_focus_in (GtkWidget     *widget,
     {
       GList *list;
 
-      list = g_list_nth (clist->row_list, clist->focus_row);
+      list = ROW_ELEMENT (clist, clist->focus_row);
       if (list && GTK_CLIST_ROW (list)->selectable)
 	gtk_signal_emit (GTK_OBJECT (clist), clist_signals[SELECT_ROW],
 			 clist->focus_row, -1, event);
@@ -7279,59 +9363,211 @@ gtk_clist_set_sort_column (GtkCList *clist,
   clist->sort_column = column;
 }
 
+void
+gtk_clist_set_column_sort_numeric (GtkCList *clist,
+				   gint      column,
+				   gboolean  numeric)
+{
+  GtkCListPrivate *private;
+
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+
+  if (column < 0 || column >= clist->columns)
+    return;
+
+  private = gtk_clist_get_private (clist);
+  if (!private->sort_numeric)
+    {
+      if (!numeric)
+	return;
+      private->sort_numeric = g_new0 (gboolean, clist->columns);
+    }
+
+  private->sort_numeric[column] = (numeric != FALSE);
+}
+
 /* PRIVATE SORTING FUNCTIONS
+ *   sort_key_init
+ *   sort_key_compare
  *   default_compare
+ *   sort_entries
+ *   _gtk_clist_sort_elements
  *   real_sort_list
- *   gtk_clist_merge
- *   gtk_clist_mergesort
  */
-static gint
-default_compare (GtkCList      *clist,
-		 gconstpointer  ptr1,
-		 gconstpointer  ptr2)
+static void
+sort_key_init (GtkCList          *clist,
+	       GtkCListRow       *clist_row,
+	       GtkCListSortEntry *entry)
 {
-  char *text1 = NULL;
-  char *text2 = NULL;
-
-  GtkCListRow *row1 = (GtkCListRow *) ptr1;
-  GtkCListRow *row2 = (GtkCListRow *) ptr2;
+  GtkCListPrivate *private;
+  gchar *text = NULL;
+  gchar *end;
 
-  switch (row1->cell[clist->sort_column].type)
+  switch (clist_row->cell[clist->sort_column].type)
     {
     case GTK_CELL_TEXT:
-      text1 = GTK_CELL_TEXT (row1->cell[clist->sort_column])->text;
+      text = GTK_CELL_TEXT (clist_row->cell[clist->sort_column])->text;
       break;
     case GTK_CELL_PIXTEXT:
-      text1 = GTK_CELL_PIXTEXT (row1->cell[clist->sort_column])->text;
+      text = GTK_CELL_PIXTEXT (clist_row->cell[clist->sort_column])->text;
       break;
     default:
       break;
     }
- 
-  switch (row2->cell[clist->sort_column].type)
+
+  entry->text = text;
+  entry->kind = text ? SORT_KEY_TEXT : SORT_KEY_NONE;
+
+  private = gtk_clist_get_private (clist);
+  if (text && private->sort_numeric &&
+      private->sort_numeric[clist->sort_column])
     {
-    case GTK_CELL_TEXT:
-      text2 = GTK_CELL_TEXT (row2->cell[clist->sort_column])->text;
-      break;
-    case GTK_CELL_PIXTEXT:
-      text2 = GTK_CELL_PIXTEXT (row2->cell[clist->sort_column])->text;
-      break;
+      entry->number = strtod (text, &end);
+      if (end != text)
+	{
+	  while (*end == ' ' || *end == '\t')
+	    end++;
+	  if (!*end)
+	    entry->kind = SORT_KEY_NUMBER;
+	}
+    }
+}
+
+/* cells without text sort first, then numbers, then other text */
+static gint
+sort_key_compare (GtkCListSortEntry *entry1,
+		  GtkCListSortEntry *entry2)
+{
+  if (entry1->kind != entry2->kind)
+    return entry1->kind < entry2->kind ? -1 : 1;
+
+  switch (entry1->kind)
+    {
+    case SORT_KEY_NUMBER:
+      if (entry1->number != entry2->number)
+	return entry1->number < entry2->number ? -1 : 1;
+      return 0;
+    case SORT_KEY_TEXT:
+      return strcmp (entry1->text, entry2->text);
     default:
-      break;
+      return 0;
     }
+}
 
-  if (!text2)
-    return (text1 != NULL);
+static gint
+default_compare (GtkCList      *clist,
+		 gconstpointer  ptr1,
+		 gconstpointer  ptr2)
+{
+  GtkCListSortEntry entry1;
+  GtkCListSortEntry entry2;
 
-  if (!text1)
-    return -1;
+  sort_key_init (clist, (GtkCListRow *) ptr1, &entry1);
+  sort_key_init (clist, (GtkCListRow *) ptr2, &entry2);
+
+  return sort_key_compare (&entry1, &entry2);
+}
+
+/* stable bottom-up merge sort of n entries, in sort_type order */
+static void
+sort_entries (GtkCList          *clist,
+	      GtkCListSortEntry *entries,
+	      gint               n)
+{
+  GtkCListSortEntry *src;
+  GtkCListSortEntry *dest;
+  GtkCListSortEntry *tmp;
+  gboolean use_keys;
+  gint width;
+  gint lo, mid, hi;
+  gint i, j, k;
+  gint cmp;
+
+  use_keys = (clist->compare == default_compare);
+
+  src = entries;
+  dest = g_new (GtkCListSortEntry, n);
+
+  for (width = 1; width < n; width *= 2)
+    {
+      for (lo = 0; lo < n; lo += 2 * width)
+	{
+	  mid = MIN (lo + width, n);
+	  hi = MIN (lo + 2 * width, n);
+
+	  for (i = lo, j = mid, k = lo; i < mid && j < hi; k++)
+	    {
+	      if (use_keys)
+		cmp = sort_key_compare (&src[i], &src[j]);
+	      else
+		cmp = clist->compare (clist, GTK_CLIST_ROW (src[i].list),
+				      GTK_CLIST_ROW (src[j].list));
+	      if (clist->sort_type == GTK_SORT_DESCENDING)
+		cmp = -cmp;
+
+	      if (cmp <= 0)
+		dest[k] = src[i++];
+	      else
+		dest[k] = src[j++];
+	    }
+	  while (i < mid)
+	    dest[k++] = src[i++];
+	  while (j < hi)
+	    dest[k++] = src[j++];
+	}
+
+      tmp = src;
+      src = dest;
+      dest = tmp;
+    }
+
+  if (src != entries)
+    {
+      memcpy (entries, src, n * sizeof (GtkCListSortEntry));
+      g_free (src);
+    }
+  else
+    g_free (dest);
+}
+
+/* sort n row elements (GtkCListRows or GtkCTreeNodes) in place, the
+ * sort keys for default_compare are extracted only once per row */
+void
+_gtk_clist_sort_elements (GtkCList  *clist,
+			  GList    **elements,
+			  gint       n)
+{
+  GtkCListSortEntry *entries;
+  gint i;
+
+  g_return_if_fail (clist != NULL);
+  g_return_if_fail (GTK_IS_CLIST (clist));
+
+  if (n < 2)
+    return;
+
+  entries = g_new (GtkCListSortEntry, n);
+  for (i = 0; i < n; i++)
+    {
+      entries[i].list = elements[i];
+      if (clist->compare == default_compare)
+	sort_key_init (clist, GTK_CLIST_ROW (elements[i]), &entries[i]);
+    }
+
+  sort_entries (clist, entries, n);
+
+  for (i = 0; i < n; i++)
+    elements[i] = entries[i].list;
 
-  return strcmp (text1, text2);
+  g_free (entries);
 }
 
 static void
 real_sort_list (GtkCList *clist)
 {
+  GtkCListPrivate *private;
+  GList **elements;
   GList *list;
   GList *work;
   gint i;
@@ -7345,6 +9581,14 @@ real_sort_list (GtkCList *clist)
   if (gdk_pointer_is_grabbed () && GTK_WIDGET_HAS_GRAB (clist))
     return;
 
+  /* the model has sorted itself, our row numbers mean nothing now */
+  if (CLIST_VIRTUAL (clist))
+    {
+      gtk_clist_unselect_all (clist);
+      CLIST_REFRESH (clist);
+      return;
+    }
+
   gtk_clist_freeze (clist);
 
   if (clist->anchor != -1 && clist->selection_mode == GTK_SELECTION_EXTENDED)
@@ -7355,8 +9599,29 @@ real_sort_list (GtkCList *clist)
       clist->undo_selection = NULL;
       clist->undo_unselection = NULL;
     }
-   
-  clist->row_list = gtk_clist_mergesort (clist, clist->row_list, clist->rows);
+
+  elements = g_new (GList *, clist->rows);
+  for (i = 0, list = clist->row_list; i < clist->rows; i++, list = list->next)
+    elements[i] = list;
+
+  _gtk_clist_sort_elements (clist, elements, clist->rows);
+  row_data_index_invalidate (clist);
+
+  /* relink the rows in their new order */
+  for (i = 0; i < clist->rows; i++)
+    {
+      elements[i]->prev = (i > 0) ? elements[i - 1] : NULL;
+      elements[i]->next = (i < clist->rows - 1) ? elements[i + 1] : NULL;
+    }
+  clist->row_list = elements[0];
+  clist->row_list_end = elements[clist->rows - 1];
+
+  /* the sorted array is exactly the new row index */
+  private = gtk_clist_get_private (clist);
+  row_index_remove (private, 0, private->n_indexed);
+  for (i = 0; i < clist->rows; i++)
+    row_index_append (private, elements[i]);
+  g_free (elements);
 
   work = clist->selection;
 
@@ -7367,99 +9632,12 @@ real_sort_list (GtkCList *clist)
 	  work->data = GINT_TO_POINTER (i);
 	  work = work->next;
 	}
-      
-      if (i == clist->rows - 1)
-	clist->row_list_end = list;
     }
+  selection_runs_rebuild (clist);
 
   gtk_clist_thaw (clist);
 }
 
-static GList *
-gtk_clist_merge (GtkCList *clist,
-		 GList    *a,         /* first list to merge */
-		 GList    *b)         /* second list to merge */
-{
-  GList z = { 0 };                    /* auxiliary node */
-  GList *c;
-  gint cmp;
-
-  c = &z;
-
-  while (a || b)
-    {
-      if (a && !b)
-	{
-	  c->next = a;
-	  a->prev = c;
-	  c = a;
-	  a = a->next;
-	  break;
-	}
-      else if (!a && b)
-	{
-	  c->next = b;
-	  b->prev = c;
-	  c = b;
-	  b = b->next;
-	  break;
-	}
-      else /* a && b */
-	{
-	  cmp = clist->compare (clist, GTK_CLIST_ROW (a), GTK_CLIST_ROW (b));
-	  if ((cmp >= 0 && clist->sort_type == GTK_SORT_DESCENDING) ||
-	      (cmp <= 0 && clist->sort_type == GTK_SORT_ASCENDING) ||
-	      (a && !b))
-	    {
-	      c->next = a;
-	      a->prev = c;
-	      c = a;
-	      a = a->next;
-	    }
-	  else
-	    {
-	      c->next = b;
-	      b->prev = c;
-	      c = b;
-	      b = b->next;
-	    }
-	}
-    }
-
-  z.next->prev = NULL;
-  return z.next;
-}
-
-static GList *
-gtk_clist_mergesort (GtkCList *clist,
-		     GList    *list,         /* the list to sort */
-		     gint      num)          /* the list's length */
-{
-  GList *half;
-  gint i;
-
-  if (num == 1)
-    {
-      return list;
-    }
-  else
-    {
-      /* move "half" to the middle */
-      half = list;
-      for (i = 0; i < num / 2; i++)
-	half = half->next;
-
-      /* cut the list in two */
-      half->prev->next = NULL;
-      half->prev = NULL;
-
-      /* recursively sort both lists */
-      return gtk_clist_merge (clist,
-		       gtk_clist_mergesort (clist, list, num / 2),
-		       gtk_clist_mergesort (clist, half, num - num / 2));
-    }
-}
-
 /************************/
 
 static void
@@ -7632,7 +9810,7 @@ gtk_clist_drag_leave (GtkWidget      *widget,
 		{
 		  GTK_CLIST_CLASS_FW (clist)->draw_drag_highlight
 		    (clist,
-		     g_list_nth (clist->row_list, dest_info->cell.row)->data,
+		     ROW_ELEMENT (clist, dest_info->cell.row)->data,
 		     dest_info->cell.row, dest_info->insert_pos);
 		  break;
 		}
@@ -7712,8 +9890,7 @@ gtk_clist_drag_motion (GtkWidget      *widget,
 	    {
 	      if (dest_info->cell.row >= 0)
 		GTK_CLIST_CLASS_FW (clist)->draw_drag_highlight
-		  (clist, g_list_nth (clist->row_list,
-				      dest_info->cell.row)->data,
+		  (clist, ROW_ELEMENT (clist, dest_info->cell.row)->data,
 		   dest_info->cell.row, dest_info->insert_pos);
 
 	      dest_info->insert_pos  = new_info.insert_pos;
@@ -7721,8 +9898,7 @@ gtk_clist_drag_motion (GtkWidget      *widget,
 	      dest_info->cell.column = new_info.cell.column;
 	      
 	      GTK_CLIST_CLASS_FW (clist)->draw_drag_highlight
-		(clist, g_list_nth (clist->row_list,
-				    dest_info->cell.row)->data,
+		(clist, ROW_ELEMENT (clist, dest_info->cell.row)->data,
 		 dest_info->cell.row, dest_info->insert_pos);
 
 	      gdk_drag_status (context, context->suggested_action, time);
@@ -127,6 +127,11 @@ typedef gint (*GtkCListCompareFunc) (GtkCList     *clist,
 				     gconstpointer ptr1,
 				     gconstpointer ptr2);
 
+typedef void (*GtkCListVirtualFunc) (GtkCList     *clist,
+				     gint          row,
+				     gchar       **text,
+				     gpointer      data);
+
 typedef struct _GtkCListCellInfo GtkCListCellInfo;
 typedef struct _GtkCListDestInfo GtkCListDestInfo;
 
@@ -689,6 +694,16 @@ gint gtk_clist_insert (GtkCList    *clist,
 		       gint         row,
 		       gchar       *text[]);
 
+/* appends n_rows rows at once, text[i] holding the column texts of
+ * the i-th new row.  Column sizes, adjustments and the display are
+ * only updated once for the whole batch.  Returns the index of the
+ * first new row, unless the clist is auto sorted, in which case the
+ * rows are sorted into place and -1 is returned.
+ */
+gint gtk_clist_append_rows (GtkCList    *clist,
+			    gchar      **text[],
+			    gint         n_rows);
+
 /* removes row at index row */
 void gtk_clist_remove (GtkCList *clist,
 		       gint      row);
@@ -714,6 +729,12 @@ gpointer gtk_clist_get_row_data (GtkCList *clist,
 gint gtk_clist_find_row_from_data (GtkCList *clist,
 				   gpointer  data);
 
+/* keep a table from row data to rows, so that finding a row from its
+ * data doesn't have to scan the list
+ */
+void gtk_clist_set_row_data_indexed (GtkCList *clist,
+				     gboolean  indexed);
+
 /* force selection of a row */
 void gtk_clist_select_row (GtkCList *clist,
 			   gint      row,
@@ -732,6 +753,27 @@ void gtk_clist_undo_selection (GtkCList *clist);
  */
 void gtk_clist_clear (GtkCList *clist);
 
+/* switch the list to virtual mode: no rows are stored, instead func
+ * is asked for the text of a row (one string per column, left NULL for
+ * empty cells) whenever the row is drawn or queried.  The strings stay
+ * owned by the caller and only need to live until the next call.
+ * Rows can't be inserted, removed or modified in virtual mode, and
+ * neither can their data, styles, colors, shifts or selectability.
+ * The model is expected to reorder itself: "row_move" is still emitted
+ * but does nothing by default, and gtk_clist_sort() only drops the
+ * selection and redraws.  A GtkCTree can't be made virtual.  Passing
+ * NULL for func leaves virtual mode; either way the list is cleared.
+ */
+void gtk_clist_set_virtual (GtkCList            *clist,
+			    GtkCListVirtualFunc  func,
+			    gpointer             data,
+			    GtkDestroyNotify     destroy);
+
+/* set the number of rows of a virtual list and redraw it, call this
+ * whenever the model changed */
+void gtk_clist_set_virtual_rows (GtkCList *clist,
+				 gint      rows);
+
 /* return the row column corresponding to the x and y coordinates,
  * the returned values are only valid if the x and y coordinates
  * are respectively to a window == clist->clist_window
@@ -748,6 +790,12 @@ void gtk_clist_select_all (GtkCList *clist);
 /* in all modes except browse mode, deselect all rows */
 void gtk_clist_unselect_all (GtkCList *clist);
 
+/* returns the first selected row after row, or -1 if there is none.
+ * Start with row = -1 to walk the selection in row order.
+ */
+gint gtk_clist_next_selected (GtkCList *clist,
+			      gint      row);
+
 /* swap the position of two rows */
 void gtk_clist_swap_rows (GtkCList *clist,
 			  gint      row1,
@@ -777,6 +825,28 @@ void gtk_clist_sort (GtkCList *clist);
 void gtk_clist_set_auto_sort (GtkCList *clist,
 			      gboolean  auto_sort);
 
+/* make the default compare function sort column by numeric value.
+ * Cells without text sort first, as always, and cells whose text isn't
+ * a number sort by text after the numbers */
+void gtk_clist_set_column_sort_numeric (GtkCList *clist,
+					gint      column,
+					gboolean  numeric);
+
+/* Internal functions */
+GList *_gtk_clist_row_element      (GtkCList *clist,
+				    gint      row);
+void   _gtk_clist_row_list_changed (GtkCList *clist,
+				    gint      row);
+void   _gtk_clist_row_index_insert (GtkCList *clist,
+				    gint      row,
+				    GList    *list,
+				    gint      n_rows);
+void   _gtk_clist_row_index_remove (GtkCList *clist,
+				    gint      row,
+				    gint      n_rows);
+void   _gtk_clist_sort_elements    (GtkCList *clist,
+				    GList   **elements,
+				    gint      n);
 
 #ifdef __cplusplus
 }
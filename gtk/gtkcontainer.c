@@ -699,7 +699,7 @@ gtk_container_set_border_width (GtkContainer *container,
     {
       container->border_width = border_width;
 
-      if (GTK_WIDGET_REALIZED (container))
+      if (GTK_WIDGET_VISIBLE (container))
 	gtk_widget_queue_resize (GTK_WIDGET (container));
     }
 }
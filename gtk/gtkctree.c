@@ -79,6 +79,37 @@ COLUMN_FROM_XPIXEL (GtkCList * clist,
     GTK_CLIST_CLASS_FW (clist)->refresh ((GtkCList*) (clist)); \
 } G_STMT_END
 
+#define NODE_HAS_CHILDREN(node) (GTK_CTREE_ROW (node)->children || \
+				 GTK_CTREE_ROW (node)->lazy)
+
+typedef struct _GtkCTreePrivate GtkCTreePrivate;
+typedef struct _PopulateJob     PopulateJob;
+
+struct _GtkCTreePrivate
+{
+  /* maps each node in clist->selection to its element there */
+  GHashTable *selection_links;
+
+  /* row data -> GList of the nodes holding it, NULL data excluded */
+  GHashTable *row_data_index;
+
+  /* lazy nodes */
+  GtkCTreePopulateFunc populate_func;
+  gpointer populate_data;
+  GtkDestroyNotify populate_destroy;
+  gchar *placeholder;
+  GList *populate_jobs;
+  PopulateJob *populate_current;
+  guint populate_idle;
+};
+
+/* a lazy node being populated from the idle */
+struct _PopulateJob
+{
+  GtkCTreeNode *node;
+  GtkCTreeNode *placeholder;
+};
+
 
 enum {
   ARG_0,
@@ -239,6 +270,10 @@ static void gtk_ctree_unlink            (GtkCTree      *ctree,
 					 gboolean       update_focus_row);
 static GtkCTreeNode * gtk_ctree_last_visible (GtkCTree     *ctree,
 					      GtkCTreeNode *node);
+static gint gtk_ctree_node_row          (GtkCTree      *ctree,
+					 GtkCTreeNode  *node);
+static void visible_descendants_changed (GtkCTreeNode  *parent,
+					 gint           delta);
 static gboolean ctree_is_hot_spot       (GtkCTree      *ctree, 
 					 GtkCTreeNode  *node,
 					 gint           row, 
@@ -252,6 +287,20 @@ static void fake_unselect_all           (GtkCList      *clist,
 static GList * selection_find           (GtkCList      *clist,
 					 gint           row_number,
 					 GList         *row_list_element);
+static void selection_links_rebuild     (GtkCTree      *ctree);
+static void row_data_index_add          (GtkCTree      *ctree,
+					 GtkCTreeNode  *node,
+					 gpointer       data);
+static void row_data_index_remove       (GtkCTree      *ctree,
+					 GtkCTreeNode  *node,
+					 gpointer       data);
+static void tree_populate               (GtkCTree      *ctree,
+					 GtkCTreeNode  *node);
+static gint populate_idle               (GtkCTree      *ctree);
+static void populate_jobs_free          (GtkCTree      *ctree,
+					 gboolean       remove_placeholders);
+static void populate_jobs_remove_node   (GtkCTree      *ctree,
+					 GtkCTreeNode  *node);
 static void resync_selection            (GtkCList      *clist,
 					 GdkEvent      *event);
 static void real_undo_selection         (GtkCList      *clist);
@@ -315,6 +364,9 @@ static GtkCListClass *parent_class = NULL;
 static GtkContainerClass *container_class = NULL;
 static guint ctree_signals[LAST_SIGNAL] = {0};
 
+static const gchar *private_key = "gtk-ctree-private";
+static guint        private_key_id = 0;
+
 
 GtkType
 gtk_ctree_get_type (void)
@@ -357,6 +409,8 @@ gtk_ctree_class_init (GtkCTreeClass *klass)
   parent_class = gtk_type_class (GTK_TYPE_CLIST);
   container_class = gtk_type_class (GTK_TYPE_CONTAINER);
 
+  private_key_id = g_quark_from_static_string (private_key);
+
   gtk_object_add_arg_type ("GtkCTree::n_columns",
 			   GTK_TYPE_UINT,
 			   GTK_ARG_READWRITE | GTK_ARG_CONSTRUCT_ONLY,
@@ -617,11 +671,56 @@ gtk_ctree_get_arg (GtkObject      *object,
     }
 }
 
+static void
+row_data_index_free_nodes (gpointer key,
+			   gpointer value,
+			   gpointer data)
+{
+  g_list_free (value);
+}
+
+static void
+gtk_ctree_private_destroy (GtkCTreePrivate *private)
+{
+  GList *list;
+
+  if (private->populate_idle)
+    gtk_idle_remove (private->populate_idle);
+  for (list = private->populate_jobs; list; list = list->next)
+    g_free (list->data);
+  g_list_free (private->populate_jobs);
+  if (private->populate_destroy)
+    private->populate_destroy (private->populate_data);
+  g_free (private->placeholder);
+
+  if (private->selection_links)
+    g_hash_table_destroy (private->selection_links);
+  if (private->row_data_index)
+    {
+      g_hash_table_foreach (private->row_data_index,
+			    row_data_index_free_nodes, NULL);
+      g_hash_table_destroy (private->row_data_index);
+    }
+  g_free (private);
+}
+
+static GtkCTreePrivate *
+gtk_ctree_get_private (GtkCTree *ctree)
+{
+  return gtk_object_get_data_by_id (GTK_OBJECT (ctree), private_key_id);
+}
+
 static void
 gtk_ctree_init (GtkCTree *ctree)
 {
+  GtkCTreePrivate *private;
   GtkCList *clist;
 
+  private = g_new0 (GtkCTreePrivate, 1);
+  private->selection_links = g_hash_table_new (g_direct_hash, g_direct_equal);
+  gtk_object_set_data_by_id_full (GTK_OBJECT (ctree), private_key_id, private,
+				  (GtkDestroyNotify) gtk_ctree_private_destroy);
+
   GTK_CLIST_SET_FLAG (ctree, CLIST_DRAW_DRAG_RECT);
   GTK_CLIST_SET_FLAG (ctree, CLIST_DRAW_DRAG_LINE);
 
@@ -803,10 +902,10 @@ gtk_ctree_button_press (GtkWidget      *widget,
       if (!gtk_clist_get_selection_info (clist, x, y, &row, &column))
 	return FALSE;
 
-      work = GTK_CTREE_NODE (g_list_nth (clist->row_list, row));
+      work = GTK_CTREE_NODE (_gtk_clist_row_element (clist, row));
 	  
       if (button_actions & GTK_BUTTON_EXPANDS &&
-	  (GTK_CTREE_ROW (work)->children && !GTK_CTREE_ROW (work)->is_leaf  &&
+	  (NODE_HAS_CHILDREN (work) && !GTK_CTREE_ROW (work)->is_leaf  &&
 	   (event->type == GDK_2BUTTON_PRESS ||
 	    ctree_is_hot_spot (ctree, work, row, x, y))))
 	{
@@ -1112,7 +1211,7 @@ gtk_ctree_draw_expander (GtkCTree     *ctree,
   y = (clip_rectangle->y + (clip_rectangle->height - PM_SIZE) / 2 -
        (clip_rectangle->height + 1) % 2);
 
-  if (!ctree_row->children)
+  if (!ctree_row->children && !ctree_row->lazy)
     {
       switch (ctree->expander_style)
 	{
@@ -1631,7 +1730,7 @@ draw_row (GtkCList     *clist,
   /* if the function is passed the pointer to the row instead of null,
    * it avoids this expensive lookup */
   if (!clist_row)
-    clist_row = (g_list_nth (clist->row_list, row))->data;
+    clist_row = (_gtk_clist_row_element (clist, row))->data;
 
   /* rectangle of the entire row */
   row_rectangle.x = 0;
@@ -2053,6 +2152,58 @@ gtk_ctree_last_visible (GtkCTree     *ctree,
   return gtk_ctree_last_visible (ctree, work);
 }
 
+#define NODE_ROWS(node) (1 + (GTK_CTREE_ROW (node)->expanded ? \
+			      GTK_CTREE_ROW (node)->visible_descendants : 0))
+
+/* Row of a viewable node, or -1.  Every earlier sibling of the node
+ * and of its ancestors is skipped together with its visible subtree,
+ * so this never walks the rows in between.
+ */
+static gint
+gtk_ctree_node_row (GtkCTree     *ctree,
+		    GtkCTreeNode *node)
+{
+  GtkCTreeNode *parent;
+  GtkCTreeNode *work;
+  gint row = 0;
+
+  for (; node; node = parent)
+    {
+      parent = GTK_CTREE_ROW (node)->parent;
+      if (parent)
+	{
+	  if (!GTK_CTREE_ROW (parent)->expanded)
+	    return -1;
+	  work = GTK_CTREE_ROW (parent)->children;
+	  row++;
+	}
+      else
+	work = GTK_CTREE_NODE (GTK_CLIST (ctree)->row_list);
+
+      for (; work && work != node; work = GTK_CTREE_ROW (work)->sibling)
+	row += NODE_ROWS (work);
+      if (!work)
+	return -1;
+    }
+
+  return row;
+}
+
+/* Propagate a change in the number of visible rows below a child of
+ * parent up to the first collapsed ancestor.
+ */
+static void
+visible_descendants_changed (GtkCTreeNode *parent,
+			     gint          delta)
+{
+  for (; parent && delta; parent = GTK_CTREE_ROW (parent)->parent)
+    {
+      GTK_CTREE_ROW (parent)->visible_descendants += delta;
+      if (!GTK_CTREE_ROW (parent)->expanded)
+	break;
+    }
+}
+
 static void
 gtk_ctree_link (GtkCTree     *ctree,
 		GtkCTreeNode *node,
@@ -2085,12 +2236,12 @@ gtk_ctree_link (GtkCTree     *ctree,
       clist->undo_unselection = NULL;
     }
 
-  for (rows = 1, list_end = (GList *)node; list_end->next;
-       list_end = list_end->next)
-    rows++;
+  rows = NODE_ROWS (node);
+  list_end = (GList *) gtk_ctree_last_visible (ctree, node);
 
   GTK_CTREE_ROW (node)->parent = parent;
   GTK_CTREE_ROW (node)->sibling = sibling;
+  visible_descendants_changed (parent, rows);
 
   if (!parent || (parent && (gtk_ctree_is_viewable (ctree, parent) &&
 			     GTK_CTREE_ROW (parent)->expanded)))
@@ -2187,13 +2338,14 @@ gtk_ctree_link (GtkCTree     *ctree,
       clist->row_list_end->next == (GList *)node)
     clist->row_list_end = list_end;
 
-  if (visible && update_focus_row)
+  if (visible)
     {
       gint pos;
-	  
-      pos = g_list_position (clist->row_list, (GList *)node);
-  
-      if (pos <= clist->focus_row)
+
+      pos = gtk_ctree_node_row (ctree, node);
+      _gtk_clist_row_index_insert (clist, pos, (GList *)node, rows);
+
+      if (update_focus_row && pos <= clist->focus_row)
 	{
 	  clist->focus_row += rows;
 	  clist->undo_anchor = clist->focus_row;
@@ -2208,7 +2360,7 @@ gtk_ctree_unlink (GtkCTree     *ctree,
 {
   GtkCList *clist;
   gint rows;
-  gint level;
+  gint pos = 0;
   gint visible;
   GtkCTreeNode *work;
   GtkCTreeNode *parent;
@@ -2241,24 +2393,16 @@ gtk_ctree_unlink (GtkCTree     *ctree,
     clist->row_list_end = (GList *) (GTK_CTREE_NODE_PREV (node));
 
   /* update list */
-  rows = 0;
-  level = GTK_CTREE_ROW (node)->level;
-  work = GTK_CTREE_NODE_NEXT (node);
-  while (work && GTK_CTREE_ROW (work)->level > level)
-    {
-      work = GTK_CTREE_NODE_NEXT (work);
-      rows++;
-    }
+  rows = NODE_ROWS (node) - 1;
+  work = GTK_CTREE_NODE_NEXT (gtk_ctree_last_visible (ctree, node));
 
   if (visible)
     {
+      pos = gtk_ctree_node_row (ctree, node);
       clist->rows -= (rows + 1);
 
       if (update_focus_row)
 	{
-	  gint pos;
-	  
-	  pos = g_list_position (clist->row_list, (GList *)node);
 	  if (pos + rows < clist->focus_row)
 	    clist->focus_row -= (rows + 1);
 	  else if (pos <= clist->focus_row)
@@ -2289,8 +2433,12 @@ gtk_ctree_unlink (GtkCTree     *ctree,
       list->next = (GList *)work;
     }
 
+  if (visible)
+    _gtk_clist_row_index_remove (clist, pos, rows + 1);
+
   /* update tree */
   parent = GTK_CTREE_ROW (node)->parent;
+  visible_descendants_changed (parent, -(rows + 1));
   if (parent)
     {
       if (GTK_CTREE_ROW (parent)->children == node)
@@ -2345,7 +2493,7 @@ real_row_move (GtkCList *clist,
     return;
 
   ctree = GTK_CTREE (clist);
-  node = GTK_CTREE_NODE (g_list_nth (clist->row_list, source_row));
+  node = GTK_CTREE_NODE (_gtk_clist_row_element (clist, source_row));
 
   if (source_row < dest_row)
     {
@@ -2368,7 +2516,7 @@ real_row_move (GtkCList *clist,
     {
       GtkCTreeNode *sibling;
 
-      sibling = GTK_CTREE_NODE (g_list_nth (clist->row_list, dest_row));
+      sibling = GTK_CTREE_NODE (_gtk_clist_row_element (clist, dest_row));
       gtk_ctree_move (ctree, node, GTK_CTREE_ROW (sibling)->parent, sibling);
     }
   else
@@ -2435,7 +2583,7 @@ real_tree_move (GtkCTree     *ctree,
 
   work = NULL;
   if (gtk_ctree_is_viewable (ctree, node))
-    work = GTK_CTREE_NODE (g_list_nth (clist->row_list, clist->focus_row));
+    work = GTK_CTREE_NODE (_gtk_clist_row_element (clist, clist->focus_row));
       
   gtk_ctree_unlink (ctree, node, FALSE);
   gtk_ctree_link (ctree, node, new_parent, new_sibling, FALSE);
@@ -2444,7 +2592,7 @@ real_tree_move (GtkCTree     *ctree,
     {
       while (work &&  !gtk_ctree_is_viewable (ctree, work))
 	work = GTK_CTREE_ROW (work)->parent;
-      clist->focus_row = g_list_position (clist->row_list, (GList *)work);
+      clist->focus_row = gtk_ctree_node_row (ctree, work);
       clist->undo_anchor = clist->focus_row;
     }
 
@@ -2474,8 +2622,8 @@ change_focus_row_expansion (GtkCTree          *ctree,
     return;
   
   if (!(node =
-	GTK_CTREE_NODE (g_list_nth (clist->row_list, clist->focus_row))) ||
-      GTK_CTREE_ROW (node)->is_leaf || !(GTK_CTREE_ROW (node)->children))
+	GTK_CTREE_NODE (_gtk_clist_row_element (clist, clist->focus_row))) ||
+      GTK_CTREE_ROW (node)->is_leaf || !NODE_HAS_CHILDREN (node))
     return;
 
   switch (action)
@@ -2509,7 +2657,6 @@ real_tree_expand (GtkCTree     *ctree,
   GtkCTreeNode *work;
   GtkRequisition requisition;
   gboolean visible;
-  gint level;
 
   g_return_if_fail (ctree != NULL);
   g_return_if_fail (GTK_IS_CTREE (ctree));
@@ -2518,11 +2665,15 @@ real_tree_expand (GtkCTree     *ctree,
     return;
 
   clist = GTK_CLIST (ctree);
+
+  if (GTK_CTREE_ROW (node)->lazy)
+    tree_populate (ctree, node);
   
   GTK_CLIST_CLASS_FW (clist)->resync_selection (clist, NULL);
 
   GTK_CTREE_ROW (node)->expanded = TRUE;
-  level = GTK_CTREE_ROW (node)->level;
+  visible_descendants_changed (GTK_CTREE_ROW (node)->parent,
+			       GTK_CTREE_ROW (node)->visible_descendants);
 
   visible = gtk_ctree_is_viewable (ctree, node);
   /* get cell width if tree_column is auto resized */
@@ -2599,12 +2750,11 @@ real_tree_expand (GtkCTree     *ctree,
 	    }
 	}
       else
-	while (work)
-	  {
-	    list = (GList *)work;
-	    work = GTK_CTREE_NODE_NEXT (work);
-	    tmp++;
-	  }
+	{
+	  /* the children chain ends with the last visible descendant */
+	  tmp = GTK_CTREE_ROW (node)->visible_descendants;
+	  list = (GList *)gtk_ctree_last_visible (ctree, node);
+	}
 
       list->next = (GList *)GTK_CTREE_NODE_NEXT (node);
 
@@ -2623,6 +2773,12 @@ real_tree_expand (GtkCTree     *ctree,
 
       if (visible)
 	{
+	  /* the children's rows go in right below node */
+	  row = gtk_ctree_node_row (ctree, node);
+	  _gtk_clist_row_index_insert (clist, row + 1,
+				       (GList *)GTK_CTREE_ROW (node)->children,
+				       tmp);
+
 	  /* resize auto_resize columns if needed */
 	  for (i = 0; i < clist->columns; i++)
 	    if (clist->column[i].auto_resize &&
@@ -2631,7 +2787,6 @@ real_tree_expand (GtkCTree     *ctree,
 	  g_free (cell_width);
 
 	  /* update focus_row position */
-	  row = g_list_position (clist->row_list, (GList *)node);
 	  if (row < clist->focus_row)
 	    clist->focus_row += tmp;
 
@@ -2653,7 +2808,6 @@ real_tree_collapse (GtkCTree     *ctree,
   GtkCTreeNode *work;
   GtkRequisition requisition;
   gboolean visible;
-  gint level;
 
   g_return_if_fail (ctree != NULL);
   g_return_if_fail (GTK_IS_CTREE (ctree));
@@ -2667,7 +2821,8 @@ real_tree_collapse (GtkCTree     *ctree,
   GTK_CLIST_CLASS_FW (clist)->resync_selection (clist, NULL);
   
   GTK_CTREE_ROW (node)->expanded = FALSE;
-  level = GTK_CTREE_ROW (node)->level;
+  visible_descendants_changed (GTK_CTREE_ROW (node)->parent,
+			       -GTK_CTREE_ROW (node)->visible_descendants);
 
   visible = gtk_ctree_is_viewable (ctree, node);
   /* get cell width if tree_column is auto resized */
@@ -2714,15 +2869,16 @@ real_tree_collapse (GtkCTree     *ctree,
   work = GTK_CTREE_ROW (node)->children;
   if (work)
     {
-      gint tmp = 0;
+      gint tmp;
       gint row;
       GList *list;
 
-      while (work && GTK_CTREE_ROW (work)->level > level)
-	{
-	  work = GTK_CTREE_NODE_NEXT (work);
-	  tmp++;
-	}
+      /* node is collapsed already, so look for the end of its former
+       * children chain below its last child */
+      tmp = GTK_CTREE_ROW (node)->visible_descendants;
+      while (GTK_CTREE_ROW (work)->sibling)
+	work = GTK_CTREE_ROW (work)->sibling;
+      work = GTK_CTREE_NODE_NEXT (gtk_ctree_last_visible (ctree, work));
 
       if (work)
 	{
@@ -2742,10 +2898,12 @@ real_tree_collapse (GtkCTree     *ctree,
 
       if (visible)
 	{
+	  row = gtk_ctree_node_row (ctree, node);
+	  _gtk_clist_row_index_remove (clist, row + 1, tmp);
+
 	  /* resize auto_resize columns if needed */
 	  auto_resize_columns (clist);
 
-	  row = g_list_position (clist->row_list, (GList *)node);
 	  if (row < clist->focus_row)
 	    clist->focus_row -= tmp;
 	  clist->rows -= tmp;
@@ -3077,6 +3235,8 @@ set_node_info (GtkCTree     *ctree,
 
   GTK_CTREE_ROW (node)->is_leaf  = is_leaf;
   GTK_CTREE_ROW (node)->expanded = (is_leaf) ? FALSE : expanded;
+  if (is_leaf)
+    GTK_CTREE_ROW (node)->lazy = FALSE;
 
   if (GTK_CTREE_ROW (node)->expanded)
     gtk_ctree_node_set_pixtext (ctree, node, ctree->tree_column,
@@ -3092,6 +3252,8 @@ tree_delete (GtkCTree     *ctree,
 	     gpointer      data)
 {
   tree_unselect (ctree,  node, NULL);
+  row_data_index_remove (ctree, node, GTK_CTREE_ROW (node)->row.data);
+  populate_jobs_remove_node (ctree, node);
   row_delete (ctree, GTK_CTREE_ROW (node));
   g_list_free_1 ((GList *)node);
 }
@@ -3101,6 +3263,8 @@ tree_delete_row (GtkCTree     *ctree,
 		 GtkCTreeNode *node, 
 		 gpointer      data)
 {
+  row_data_index_remove (ctree, node, GTK_CTREE_ROW (node)->row.data);
+  populate_jobs_remove_node (ctree, node);
   row_delete (ctree, GTK_CTREE_ROW (node));
   g_list_free_1 ((GList *)node);
 }
@@ -3213,6 +3377,8 @@ row_new (GtkCTree *ctree)
 
   ctree_row->level         = 0;
   ctree_row->expanded      = FALSE;
+  ctree_row->lazy          = FALSE;
+  ctree_row->visible_descendants = 0;
   ctree_row->parent        = NULL;
   ctree_row->sibling       = NULL;
   ctree_row->children      = NULL;
@@ -3292,7 +3458,7 @@ real_select_row (GtkCList *clist,
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CTREE (clist));
   
-  if ((node = g_list_nth (clist->row_list, row)) &&
+  if ((node = _gtk_clist_row_element (clist, row)) &&
       GTK_CTREE_ROW (node)->row.selectable)
     gtk_signal_emit (GTK_OBJECT (clist), ctree_signals[TREE_SELECT_ROW],
 		     node, column);
@@ -3309,7 +3475,7 @@ real_unselect_row (GtkCList *clist,
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CTREE (clist));
 
-  if ((node = g_list_nth (clist->row_list, row)))
+  if ((node = _gtk_clist_row_element (clist, row)))
     gtk_signal_emit (GTK_OBJECT (clist), ctree_signals[TREE_UNSELECT_ROW],
 		     node, column);
 }
@@ -3369,6 +3535,8 @@ real_tree_select (GtkCTree     *ctree,
     }
   else
     clist->selection_end = g_list_append (clist->selection_end, node)->next;
+  g_hash_table_insert (gtk_ctree_get_private (ctree)->selection_links,
+		       node, clist->selection_end);
 
   tree_draw_node (ctree, node);
 }
@@ -3378,7 +3546,9 @@ real_tree_unselect (GtkCTree     *ctree,
 		    GtkCTreeNode *node,
 		    gint          column)
 {
+  GtkCTreePrivate *private;
   GtkCList *clist;
+  GList *link;
 
   g_return_if_fail (ctree != NULL);
   g_return_if_fail (GTK_IS_CTREE (ctree));
@@ -3391,7 +3561,16 @@ real_tree_unselect (GtkCTree     *ctree,
   if (clist->selection_end && clist->selection_end->data == node)
     clist->selection_end = clist->selection_end->prev;
 
-  clist->selection = g_list_remove (clist->selection, node);
+  private = gtk_ctree_get_private (ctree);
+  link = g_hash_table_lookup (private->selection_links, node);
+  if (link)
+    {
+      g_hash_table_remove (private->selection_links, node);
+      clist->selection = g_list_remove_link (clist->selection, link);
+      g_list_free_1 (link);
+    }
+  else
+    clist->selection = g_list_remove (clist->selection, node);
   
   GTK_CTREE_ROW (node)->row.state = GTK_STATE_NORMAL;
 
@@ -3479,7 +3658,7 @@ real_unselect_all (GtkCList *clist)
 	{
 	  gtk_ctree_select
 	    (ctree,
-	     GTK_CTREE_NODE (g_list_nth (clist->row_list, clist->focus_row)));
+	     GTK_CTREE_NODE (_gtk_clist_row_element (clist, clist->focus_row)));
 	  return;
 	}
       break;
@@ -3629,7 +3808,7 @@ real_insert_row (GtkCList *clist,
   g_return_val_if_fail (clist != NULL, -1);
   g_return_val_if_fail (GTK_IS_CTREE (clist), -1);
 
-  sibling = GTK_CTREE_NODE (g_list_nth (clist->row_list, row));
+  sibling = GTK_CTREE_NODE (_gtk_clist_row_element (clist, row));
   if (sibling)
     parent = GTK_CTREE_ROW (sibling)->parent;
 
@@ -3637,7 +3816,7 @@ real_insert_row (GtkCList *clist,
 				NULL, NULL, NULL, NULL, TRUE, FALSE);
 
   if (GTK_CLIST_AUTO_SORT (clist) || !sibling)
-    return g_list_position (clist->row_list, (GList *) node);
+    return gtk_ctree_node_row (GTK_CTREE (clist), node);
   
   return row;
 }
@@ -3850,7 +4029,7 @@ real_remove_row (GtkCList *clist,
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CTREE (clist));
 
-  node = GTK_CTREE_NODE (g_list_nth (clist->row_list, row));
+  node = GTK_CTREE_NODE (_gtk_clist_row_element (clist, row));
 
   if (node)
     gtk_ctree_remove_node (GTK_CTREE (clist), node);
@@ -3901,10 +4080,13 @@ real_clear (GtkCList *clist)
 
   ctree = GTK_CTREE (clist);
 
+  populate_jobs_free (ctree, FALSE);
+
   /* remove all rows */
   work = GTK_CTREE_NODE (clist->row_list);
   clist->row_list = NULL;
   clist->row_list_end = NULL;
+  _gtk_clist_row_list_changed (clist, 0);
 
   GTK_CLIST_SET_FLAG (clist, CLIST_AUTO_RESIZE_BLOCKED);
   while (work)
@@ -3917,6 +4099,7 @@ real_clear (GtkCList *clist)
   GTK_CLIST_UNSET_FLAG (clist, CLIST_AUTO_RESIZE_BLOCKED);
 
   parent_class->clear (clist);
+  selection_links_rebuild (ctree);
 }
 
 
@@ -4134,7 +4317,7 @@ gtk_ctree_node_nth (GtkCTree *ctree,
   if ((row < 0) || (row >= GTK_CLIST(ctree)->rows))
     return NULL;
  
-  return GTK_CTREE_NODE (g_list_nth (GTK_CLIST (ctree)->row_list, row));
+  return GTK_CTREE_NODE (_gtk_clist_row_element (GTK_CLIST (ctree), row));
 }
 
 gboolean
@@ -4176,15 +4359,77 @@ gtk_ctree_is_ancestor (GtkCTree     *ctree,
   return FALSE;
 }
 
+/* orders two nodes of the tree as a pre-order walk would meet them */
+static gint
+node_preorder_compare (gconstpointer a,
+		       gconstpointer b)
+{
+  GtkCTreeNode *node1 = (GtkCTreeNode *) a;
+  GtkCTreeNode *node2 = (GtkCTreeNode *) b;
+  GtkCTreeNode *work;
+
+  if (node1 == node2)
+    return 0;
+
+  while (GTK_CTREE_ROW (node1)->level > GTK_CTREE_ROW (node2)->level)
+    node1 = GTK_CTREE_ROW (node1)->parent;
+  while (GTK_CTREE_ROW (node2)->level > GTK_CTREE_ROW (node1)->level)
+    node2 = GTK_CTREE_ROW (node2)->parent;
+
+  /* one is an ancestor of the other */
+  if (node1 == node2)
+    return (GTK_CTREE_ROW ((GtkCTreeNode *) a)->level <
+	    GTK_CTREE_ROW ((GtkCTreeNode *) b)->level) ? -1 : 1;
+
+  while (GTK_CTREE_ROW (node1)->parent != GTK_CTREE_ROW (node2)->parent)
+    {
+      node1 = GTK_CTREE_ROW (node1)->parent;
+      node2 = GTK_CTREE_ROW (node2)->parent;
+    }
+
+  for (work = node1; work; work = GTK_CTREE_ROW (work)->sibling)
+    if (work == node2)
+      return -1;
+
+  return 1;
+}
+
+/* the indexed nodes holding data, NULL if there is no index */
+static GList *
+row_data_index_lookup (GtkCTree *ctree,
+		       gpointer  data,
+		       gboolean *indexed)
+{
+  GtkCTreePrivate *private;
+
+  private = gtk_ctree_get_private (ctree);
+  *indexed = (private->row_data_index && data);
+
+  return *indexed ? g_hash_table_lookup (private->row_data_index, data) : NULL;
+}
+
 GtkCTreeNode *
 gtk_ctree_find_by_row_data (GtkCTree     *ctree,
 			    GtkCTreeNode *node,
 			    gpointer      data)
 {
   GtkCTreeNode *work;
+  GList *list;
+  gboolean indexed;
   
   if (!node)
-    node = GTK_CTREE_NODE (GTK_CLIST (ctree)->row_list);
+    {
+      list = row_data_index_lookup (ctree, data, &indexed);
+      if (indexed)
+	{
+	  for (work = NULL; list; list = list->next)
+	    if (!work || node_preorder_compare (list->data, work) < 0)
+	      work = list->data;
+	  return work;
+	}
+
+      node = GTK_CTREE_NODE (GTK_CLIST (ctree)->row_list);
+    }
   
   while (node)
     {
@@ -4205,13 +4450,20 @@ gtk_ctree_find_all_by_row_data (GtkCTree     *ctree,
 				gpointer      data)
 {
   GList *list = NULL;
+  gboolean indexed;
 
   g_return_val_if_fail (ctree != NULL, NULL);
   g_return_val_if_fail (GTK_IS_CTREE (ctree), NULL);
 
   /* if node == NULL then look in the whole tree */
   if (!node)
-    node = GTK_CTREE_NODE (GTK_CLIST (ctree)->row_list);
+    {
+      list = row_data_index_lookup (ctree, data, &indexed);
+      if (indexed)
+	return g_list_sort (g_list_copy (list), node_preorder_compare);
+
+      node = GTK_CTREE_NODE (GTK_CLIST (ctree)->row_list);
+    }
 
   while (node)
     {
@@ -4296,6 +4548,79 @@ gtk_ctree_find_all_by_row_data_custom (GtkCTree     *ctree,
   return list;
 }
 
+static void
+row_data_index_add (GtkCTree     *ctree,
+		    GtkCTreeNode *node,
+		    gpointer      data)
+{
+  GtkCTreePrivate *private;
+  GList *list;
+
+  private = gtk_ctree_get_private (ctree);
+  if (!private->row_data_index || !data)
+    return;
+
+  list = g_hash_table_lookup (private->row_data_index, data);
+  g_hash_table_insert (private->row_data_index, data,
+		       g_list_prepend (list, node));
+}
+
+static void
+row_data_index_remove (GtkCTree     *ctree,
+		       GtkCTreeNode *node,
+		       gpointer      data)
+{
+  GtkCTreePrivate *private;
+  GList *list;
+
+  private = gtk_ctree_get_private (ctree);
+  if (!private->row_data_index || !data)
+    return;
+
+  list = g_hash_table_lookup (private->row_data_index, data);
+  list = g_list_remove (list, node);
+  if (list)
+    g_hash_table_insert (private->row_data_index, data, list);
+  else
+    g_hash_table_remove (private->row_data_index, data);
+}
+
+static void
+row_data_index_add_node (GtkCTree     *ctree,
+			 GtkCTreeNode *node,
+			 gpointer      data)
+{
+  row_data_index_add (ctree, node, GTK_CTREE_ROW (node)->row.data);
+}
+
+void
+gtk_ctree_set_row_data_indexed (GtkCTree *ctree,
+				gboolean  indexed)
+{
+  GtkCTreePrivate *private;
+
+  g_return_if_fail (ctree != NULL);
+  g_return_if_fail (GTK_IS_CTREE (ctree));
+
+  private = gtk_ctree_get_private (ctree);
+  if ((private->row_data_index != NULL) == (indexed != FALSE))
+    return;
+
+  if (indexed)
+    {
+      private->row_data_index = g_hash_table_new (g_direct_hash,
+						  g_direct_equal);
+      gtk_ctree_pre_recursive (ctree, NULL, row_data_index_add_node, NULL);
+    }
+  else
+    {
+      g_hash_table_foreach (private->row_data_index,
+			    row_data_index_free_nodes, NULL);
+      g_hash_table_destroy (private->row_data_index);
+      private->row_data_index = NULL;
+    }
+}
+
 gboolean
 gtk_ctree_is_hot_spot (GtkCTree *ctree, 
 		       gint      x, 
@@ -4309,7 +4634,8 @@ gtk_ctree_is_hot_spot (GtkCTree *ctree,
   g_return_val_if_fail (GTK_IS_CTREE (ctree), FALSE);
 
   if (gtk_clist_get_selection_info (GTK_CLIST (ctree), x, y, &row, &column))
-    if ((node = GTK_CTREE_NODE(g_list_nth (GTK_CLIST (ctree)->row_list, row))))
+    if ((node = GTK_CTREE_NODE (_gtk_clist_row_element (GTK_CLIST (ctree),
+							 row))))
       return ctree_is_hot_spot (ctree, node, row, x, y);
 
   return FALSE;
@@ -5219,6 +5545,9 @@ gtk_ctree_node_set_row_data_full (GtkCTree         *ctree,
   GTK_CTREE_ROW (node)->row.data = data;
   GTK_CTREE_ROW (node)->row.destroy = destroy;
 
+  row_data_index_remove (ctree, node, ddata);
+  row_data_index_add (ctree, node, data);
+
   if (dnotify)
     dnotify (ddata);
 }
@@ -5252,7 +5581,7 @@ gtk_ctree_node_moveto (GtkCTree     *ctree,
     node = GTK_CTREE_ROW (node)->parent;
 
   if (node)
-    row = g_list_position (clist->row_list, (GList *)node);
+    row = gtk_ctree_node_row (ctree, node);
   
   gtk_clist_moveto (clist, row, column, row_align, col_align);
 }
@@ -5265,7 +5594,7 @@ GtkVisibility gtk_ctree_node_is_visible (GtkCTree     *ctree,
   g_return_val_if_fail (ctree != NULL, 0);
   g_return_val_if_fail (node != NULL, 0);
   
-  row = g_list_position (GTK_CLIST (ctree)->row_list, (GList*) node);
+  row = gtk_ctree_node_row (ctree, node);
   return gtk_clist_row_is_visible (GTK_CLIST (ctree), row);
 }
 
@@ -5478,46 +5807,71 @@ tree_sort (GtkCTree     *ctree,
 	   GtkCTreeNode *node,
 	   gpointer      data)
 {
-  GtkCTreeNode *list_start;
-  GtkCTreeNode *cmp;
   GtkCTreeNode *work;
+  GList **elements;
+  GList *prev;
+  GList *after;
   GtkCList *clist;
+  gboolean visible;
+  gint n;
+  gint i;
 
   clist = GTK_CLIST (ctree);
 
   if (node)
-    list_start = GTK_CTREE_ROW (node)->children;
+    work = GTK_CTREE_ROW (node)->children;
   else
-    list_start = GTK_CTREE_NODE (clist->row_list);
+    work = GTK_CTREE_NODE (clist->row_list);
 
-  while (list_start)
-    {
-      cmp = list_start;
-      work = GTK_CTREE_ROW (cmp)->sibling;
-      while (work)
-	{
-	  if (clist->sort_type == GTK_SORT_ASCENDING)
-	    {
-	      if (clist->compare 
-		  (clist, GTK_CTREE_ROW (work), GTK_CTREE_ROW (cmp)) < 0)
-		cmp = work;
-	    }
-	  else
-	    {
-	      if (clist->compare 
-		  (clist, GTK_CTREE_ROW (work), GTK_CTREE_ROW (cmp)) > 0)
-		cmp = work;
-	    }
-	  work = GTK_CTREE_ROW (work)->sibling;
-	}
-      if (cmp == list_start)
-	list_start = GTK_CTREE_ROW (cmp)->sibling;
-      else
-	{
-	  gtk_ctree_unlink (ctree, cmp, FALSE);
-	  gtk_ctree_link (ctree, cmp, node, list_start, FALSE);
-	}
-    }
+  for (n = 0; work; work = GTK_CTREE_ROW (work)->sibling)
+    n++;
+  if (n < 2)
+    return;
+
+  elements = g_new (GList *, n);
+  if (node)
+    work = GTK_CTREE_ROW (node)->children;
+  else
+    work = GTK_CTREE_NODE (clist->row_list);
+  for (i = 0; work; i++, work = GTK_CTREE_ROW (work)->sibling)
+    elements[i] = (GList *)work;
+
+  after = (GList *)GTK_CTREE_NODE_NEXT
+    (gtk_ctree_last_visible (ctree, GTK_CTREE_NODE (elements[n - 1])));
+  visible = (!node || (GTK_CTREE_ROW (node)->expanded &&
+		       gtk_ctree_is_viewable (ctree, node)));
+
+  _gtk_clist_sort_elements (clist, elements, n);
+
+  /* splice the siblings back in their new order, each one followed
+   * by the rows of its expanded descendants */
+  prev = (GList *)node;
+  for (i = 0; i < n; i++)
+    {
+      elements[i]->prev = prev;
+      if (i > 0 || (node && GTK_CTREE_ROW (node)->expanded))
+	prev->next = elements[i];
+      GTK_CTREE_ROW (elements[i])->sibling =
+	(i < n - 1) ? GTK_CTREE_NODE (elements[i + 1]) : NULL;
+      prev = (GList *)gtk_ctree_last_visible (ctree,
+					      GTK_CTREE_NODE (elements[i]));
+    }
+  prev->next = after;
+  if (after)
+    after->prev = prev;
+  else if (visible)
+    clist->row_list_end = prev;
+
+  if (node)
+    GTK_CTREE_ROW (node)->children = GTK_CTREE_NODE (elements[0]);
+  else
+    clist->row_list = elements[0];
+
+  if (visible)
+    _gtk_clist_row_list_changed (clist,
+				 node ? gtk_ctree_node_row (ctree, node) + 1 : 0);
+
+  g_free (elements);
 }
 
 void
@@ -5546,7 +5900,7 @@ gtk_ctree_sort_recursive (GtkCTree     *ctree,
 
   if (!node || (node && gtk_ctree_is_viewable (ctree, node)))
     focus_node =
-      GTK_CTREE_NODE (g_list_nth (clist->row_list, clist->focus_row));
+      GTK_CTREE_NODE (_gtk_clist_row_element (clist, clist->focus_row));
       
   gtk_ctree_post_recursive (ctree, node, GTK_CTREE_FUNC (tree_sort), NULL);
 
@@ -5555,7 +5909,7 @@ gtk_ctree_sort_recursive (GtkCTree     *ctree,
 
   if (focus_node)
     {
-      clist->focus_row = g_list_position (clist->row_list,(GList *)focus_node);
+      clist->focus_row = gtk_ctree_node_row (ctree, focus_node);
       clist->undo_anchor = clist->focus_row;
     }
 
@@ -5594,13 +5948,13 @@ gtk_ctree_sort_node (GtkCTree     *ctree,
 
   if (!node || (node && gtk_ctree_is_viewable (ctree, node)))
     focus_node = GTK_CTREE_NODE
-      (g_list_nth (clist->row_list, clist->focus_row));
+      (_gtk_clist_row_element (clist, clist->focus_row));
 
   tree_sort (ctree, node, NULL);
 
   if (focus_node)
     {
-      clist->focus_row = g_list_position (clist->row_list,(GList *)focus_node);
+      clist->focus_row = gtk_ctree_node_row (ctree, focus_node);
       clist->undo_anchor = clist->focus_row;
     }
 
@@ -5616,7 +5970,7 @@ fake_unselect_all (GtkCList *clist,
   GList *list;
   GList *focus_node = NULL;
 
-  if (row >= 0 && (focus_node = g_list_nth (clist->row_list, row)))
+  if (row >= 0 && (focus_node = _gtk_clist_row_element (clist, row)))
     {
       if (GTK_CTREE_ROW (focus_node)->row.state == GTK_STATE_NORMAL &&
 	  GTK_CTREE_ROW (focus_node)->row.selectable)
@@ -5633,6 +5987,7 @@ fake_unselect_all (GtkCList *clist,
   clist->undo_selection = clist->selection;
   clist->selection = NULL;
   clist->selection_end = NULL;
+  selection_links_rebuild (GTK_CTREE (clist));
   
   for (list = clist->undo_selection; list; list = list->next)
     {
@@ -5649,19 +6004,36 @@ selection_find (GtkCList *clist,
 		gint      row_number,
 		GList    *row_list_element)
 {
-  return g_list_find (clist->selection, row_list_element);
+  return g_hash_table_lookup
+    (gtk_ctree_get_private (GTK_CTREE (clist))->selection_links,
+     row_list_element);
+}
+
+/* for when clist->selection got replaced wholesale */
+static void
+selection_links_rebuild (GtkCTree *ctree)
+{
+  GtkCTreePrivate *private;
+  GList *list;
+
+  private = gtk_ctree_get_private (ctree);
+  g_hash_table_destroy (private->selection_links);
+  private->selection_links = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (list = GTK_CLIST (ctree)->selection; list; list = list->next)
+    g_hash_table_insert (private->selection_links, list->data, list);
 }
 
 static void
 resync_selection (GtkCList *clist, GdkEvent *event)
 {
   GtkCTree *ctree;
+  GHashTable *range;
   GList *list;
   GtkCTreeNode *node;
   gint i;
   gint e;
   gint row;
-  gboolean unselect;
 
   g_return_if_fail (clist != NULL);
   g_return_if_fail (GTK_IS_CTREE (clist));
@@ -5685,6 +6057,15 @@ resync_selection (GtkCList *clist, GdkEvent *event)
       clist->selection = clist->undo_selection;
       clist->selection_end = g_list_last (clist->selection);
       clist->undo_selection = list;
+      selection_links_rebuild (ctree);
+
+      /* the nodes of rows i to e, rather than looking up the row of
+       * every selected node */
+      range = g_hash_table_new (g_direct_hash, g_direct_equal);
+      for (node = GTK_CTREE_NODE (_gtk_clist_row_element (clist, i)), row = i;
+	   node && row <= e; node = GTK_CTREE_NODE_NEXT (node), row++)
+	g_hash_table_insert (range, node, node);
+
       list = clist->selection;
 
       while (list)
@@ -5692,15 +6073,8 @@ resync_selection (GtkCList *clist, GdkEvent *event)
 	  node = list->data;
 	  list = list->next;
 	  
-	  unselect = TRUE;
-
-	  if (gtk_ctree_is_viewable (ctree, node))
-	    {
-	      row = g_list_position (clist->row_list, (GList *)node);
-	      if (row >= i && row <= e)
-		unselect = FALSE;
-	    }
-	  if (unselect && GTK_CTREE_ROW (node)->row.selectable)
+	  if (!g_hash_table_lookup (range, node) &&
+	      GTK_CTREE_ROW (node)->row.selectable)
 	    {
 	      GTK_CTREE_ROW (node)->row.state = GTK_STATE_SELECTED;
 	      gtk_ctree_unselect (ctree, node);
@@ -5708,15 +6082,17 @@ resync_selection (GtkCList *clist, GdkEvent *event)
 						      node);
 	    }
 	}
+
+      g_hash_table_destroy (range);
     }    
 
   if (clist->anchor < clist->drag_pos)
     {
-      for (node = GTK_CTREE_NODE (g_list_nth (clist->row_list, i)); i <= e;
+      for (node = GTK_CTREE_NODE (_gtk_clist_row_element (clist, i)); i <= e;
 	   i++, node = GTK_CTREE_NODE_NEXT (node))
 	if (GTK_CTREE_ROW (node)->row.selectable)
 	  {
-	    if (g_list_find (clist->selection, node))
+	    if (selection_find (clist, -1, (GList *) node))
 	      {
 		if (GTK_CTREE_ROW (node)->row.state == GTK_STATE_NORMAL)
 		  {
@@ -5736,11 +6112,11 @@ resync_selection (GtkCList *clist, GdkEvent *event)
     }
   else
     {
-      for (node = GTK_CTREE_NODE (g_list_nth (clist->row_list, e)); i <= e;
+      for (node = GTK_CTREE_NODE (_gtk_clist_row_element (clist, e)); i <= e;
 	   e--, node = GTK_CTREE_NODE_PREV (node))
 	if (GTK_CTREE_ROW (node)->row.selectable)
 	  {
-	    if (g_list_find (clist->selection, node))
+	    if (selection_find (clist, -1, (GList *) node))
 	      {
 		if (GTK_CTREE_ROW (node)->row.state == GTK_STATE_NORMAL)
 		  {
@@ -5832,6 +6208,244 @@ gtk_ctree_set_drag_compare_func (GtkCTree                *ctree,
   ctree->drag_compare = cmp_func;
 }
 
+void
+gtk_ctree_set_populate_func (GtkCTree             *ctree,
+			     GtkCTreePopulateFunc  func,
+			     gpointer              data,
+			     GtkDestroyNotify      destroy)
+{
+  GtkCTreePrivate *private;
+
+  g_return_if_fail (ctree != NULL);
+  g_return_if_fail (GTK_IS_CTREE (ctree));
+
+  private = gtk_ctree_get_private (ctree);
+
+  /* nodes still loading would never be finished by the new func */
+  populate_jobs_free (ctree, TRUE);
+
+  if (private->populate_destroy)
+    private->populate_destroy (private->populate_data);
+
+  private->populate_func = func;
+  private->populate_data = data;
+  private->populate_destroy = destroy;
+}
+
+void
+gtk_ctree_set_populate_async (GtkCTree    *ctree,
+			      const gchar *placeholder)
+{
+  GtkCTreePrivate *private;
+
+  g_return_if_fail (ctree != NULL);
+  g_return_if_fail (GTK_IS_CTREE (ctree));
+
+  private = gtk_ctree_get_private (ctree);
+  g_free (private->placeholder);
+  private->placeholder = g_strdup (placeholder);
+}
+
+void
+gtk_ctree_node_set_lazy (GtkCTree     *ctree,
+			 GtkCTreeNode *node,
+			 gboolean      lazy)
+{
+  g_return_if_fail (ctree != NULL);
+  g_return_if_fail (GTK_IS_CTREE (ctree));
+  g_return_if_fail (node != NULL);
+  g_return_if_fail (!lazy || !GTK_CTREE_ROW (node)->is_leaf);
+
+  lazy = lazy != FALSE;
+  if (GTK_CTREE_ROW (node)->lazy == lazy)
+    return;
+
+  GTK_CTREE_ROW (node)->lazy = lazy;
+
+  if (lazy && GTK_CTREE_ROW (node)->expanded)
+    {
+      /* already open, so load right away */
+      tree_populate (ctree, node);
+      return;
+    }
+
+  tree_draw_node (ctree, node);
+}
+
+gboolean
+gtk_ctree_node_get_lazy (GtkCTree     *ctree,
+			 GtkCTreeNode *node)
+{
+  g_return_val_if_fail (ctree != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_CTREE (ctree), FALSE);
+  g_return_val_if_fail (node != NULL, FALSE);
+
+  return GTK_CTREE_ROW (node)->lazy;
+}
+
+/* LAZY NODES
+ *   tree_populate
+ *   populate_idle
+ *   populate_jobs_free
+ *   populate_jobs_remove_node
+ */
+static void
+tree_populate (GtkCTree     *ctree,
+	       GtkCTreeNode *node)
+{
+  GtkCTreePrivate *private;
+  GtkCList *clist;
+
+  private = gtk_ctree_get_private (ctree);
+  if (!private->populate_func)
+    return;
+
+  clist = GTK_CLIST (ctree);
+  GTK_CTREE_ROW (node)->lazy = FALSE;
+
+  if (private->placeholder)
+    {
+      PopulateJob *job;
+      gchar **text;
+
+      text = g_new0 (gchar *, clist->columns);
+      text[ctree->tree_column] = private->placeholder;
+
+      job = g_new (PopulateJob, 1);
+      job->node = node;
+      job->placeholder = gtk_ctree_insert_node (ctree, node, NULL, text, 5,
+						NULL, NULL, NULL, NULL,
+						TRUE, FALSE);
+      gtk_ctree_node_set_selectable (ctree, job->placeholder, FALSE);
+      g_free (text);
+
+      private->populate_jobs = g_list_append (private->populate_jobs, job);
+      if (!private->populate_idle)
+	private->populate_idle =
+	  gtk_idle_add ((GtkFunction) populate_idle, ctree);
+    }
+  else
+    {
+      gtk_clist_freeze (clist);
+      while (private->populate_func (ctree, node, private->populate_data))
+	;
+      gtk_clist_thaw (clist);
+    }
+}
+
+static gint
+populate_idle (GtkCTree *ctree)
+{
+  GtkCTreePrivate *private;
+  PopulateJob *job;
+  GtkCList *clist;
+  gboolean more;
+  gboolean retval;
+
+  GDK_THREADS_ENTER ();
+
+  private = gtk_ctree_get_private (ctree);
+  clist = GTK_CLIST (ctree);
+
+  job = private->populate_jobs->data;
+  private->populate_current = job;
+
+  gtk_clist_freeze (clist);
+
+  more = private->populate_func (ctree, job->node, private->populate_data);
+
+  /* the func may have removed the node, or cleared the whole tree */
+  if (private->populate_current == job)
+    {
+      if (!more)
+	{
+	  private->populate_jobs = g_list_remove (private->populate_jobs, job);
+	  if (job->placeholder)
+	    gtk_ctree_remove_node (ctree, job->placeholder);
+	  g_free (job);
+	}
+      else if (job->placeholder &&
+	       GTK_CTREE_ROW (job->placeholder)->sibling &&
+	       !GTK_CLIST_AUTO_SORT (clist))
+	{
+	  /* keep the placeholder below the children loaded so far */
+	  gtk_ctree_unlink (ctree, job->placeholder, TRUE);
+	  gtk_ctree_link (ctree, job->placeholder, job->node, NULL, TRUE);
+	}
+    }
+  private->populate_current = NULL;
+
+  gtk_clist_thaw (clist);
+
+  retval = private->populate_jobs != NULL;
+  if (!retval)
+    private->populate_idle = 0;
+
+  GDK_THREADS_LEAVE ();
+
+  return retval;
+}
+
+static void
+populate_jobs_free (GtkCTree *ctree,
+		    gboolean  remove_placeholders)
+{
+  GtkCTreePrivate *private;
+  PopulateJob *job;
+
+  private = gtk_ctree_get_private (ctree);
+
+  if (private->populate_idle)
+    {
+      gtk_idle_remove (private->populate_idle);
+      private->populate_idle = 0;
+    }
+  private->populate_current = NULL;
+
+  while (private->populate_jobs)
+    {
+      job = private->populate_jobs->data;
+      private->populate_jobs = g_list_remove (private->populate_jobs, job);
+      if (remove_placeholders && job->placeholder)
+	gtk_ctree_remove_node (ctree, job->placeholder);
+      g_free (job);
+    }
+}
+
+static void
+populate_jobs_remove_node (GtkCTree     *ctree,
+			   GtkCTreeNode *node)
+{
+  GtkCTreePrivate *private;
+  PopulateJob *job;
+  GList *list;
+
+  private = gtk_ctree_get_private (ctree);
+
+  for (list = private->populate_jobs; list; list = list->next)
+    {
+      job = list->data;
+      if (job->placeholder == node)
+	job->placeholder = NULL;
+      else if (job->node == node)
+	break;
+    }
+  if (!list)
+    return;
+
+  if (private->populate_current == job)
+    private->populate_current = NULL;
+  private->populate_jobs = g_list_remove_link (private->populate_jobs, list);
+  g_list_free_1 (list);
+  g_free (job);
+
+  if (!private->populate_jobs && private->populate_idle)
+    {
+      gtk_idle_remove (private->populate_idle);
+      private->populate_idle = 0;
+    }
+}
+
 static gboolean
 check_drag (GtkCTree        *ctree,
 	    GtkCTreeNode    *drag_source,
@@ -5925,8 +6539,8 @@ drag_dest_cell (GtkCList         *clist,
       y_delta = y - ROW_TOP_YPIXEL (clist, dest_info->cell.row);
       
       if (GTK_CLIST_DRAW_DRAG_RECT(clist) &&
-	  !GTK_CTREE_ROW (g_list_nth (clist->row_list,
-				      dest_info->cell.row))->is_leaf)
+	  !GTK_CTREE_ROW (_gtk_clist_row_element (clist,
+						  dest_info->cell.row))->is_leaf)
 	{
 	  dest_info->insert_pos = GTK_CLIST_DRAG_INTO;
 	  h = clist->row_height / 4;
@@ -5971,8 +6585,8 @@ gtk_ctree_drag_begin (GtkWidget	     *widget,
       GtkCTreeNode *node;
 
       GTK_CLIST_SET_FLAG (clist, CLIST_USE_DRAG_ICONS);
-      node = GTK_CTREE_NODE (g_list_nth (clist->row_list,
-					 clist->click_cell.row));
+      node = GTK_CTREE_NODE (_gtk_clist_row_element (clist,
+						     clist->click_cell.row));
       if (node)
 	{
 	  if (GTK_CELL_PIXTEXT
@@ -6045,10 +6659,10 @@ gtk_ctree_drag_motion (GtkWidget      *widget,
 	  GtkCTreeNode *drag_source;
 	  GtkCTreeNode *drag_target;
 
-	  drag_source = GTK_CTREE_NODE (g_list_nth (clist->row_list,
-						    clist->click_cell.row));
-	  drag_target = GTK_CTREE_NODE (g_list_nth (clist->row_list,
-						    new_info.cell.row));
+	  drag_source = GTK_CTREE_NODE (_gtk_clist_row_element
+					 (clist, clist->click_cell.row));
+	  drag_target = GTK_CTREE_NODE (_gtk_clist_row_element
+					 (clist, new_info.cell.row));
 
 	  if (gtk_drag_get_source_widget (context) != widget ||
 	      !check_drag (ctree, drag_source, drag_target,
@@ -6069,7 +6683,7 @@ gtk_ctree_drag_motion (GtkWidget      *widget,
 	      if (dest_info->cell.row >= 0)
 		GTK_CLIST_CLASS_FW (clist)->draw_drag_highlight
 		  (clist,
-		   g_list_nth (clist->row_list, dest_info->cell.row)->data,
+		   _gtk_clist_row_element (clist, dest_info->cell.row)->data,
 		   dest_info->cell.row, dest_info->insert_pos);
 
 	      dest_info->insert_pos  = new_info.insert_pos;
@@ -6078,7 +6692,7 @@ gtk_ctree_drag_motion (GtkWidget      *widget,
 
 	      GTK_CLIST_CLASS_FW (clist)->draw_drag_highlight
 		(clist,
-		 g_list_nth (clist->row_list, dest_info->cell.row)->data,
+		 _gtk_clist_row_element (clist, dest_info->cell.row)->data,
 		 dest_info->cell.row, dest_info->insert_pos);
 
 	      gdk_drag_status (context, context->suggested_action, time);
@@ -6131,10 +6745,10 @@ gtk_ctree_drag_data_received (GtkWidget        *widget,
 
 	  drag_dest_cell (clist, x, y, &dest_info);
 	  
-	  source_node = GTK_CTREE_NODE (g_list_nth (clist->row_list,
-						    source_info->row));
-	  dest_node = GTK_CTREE_NODE (g_list_nth (clist->row_list,
-						  dest_info.cell.row));
+	  source_node = GTK_CTREE_NODE (_gtk_clist_row_element
+					 (clist, source_info->row));
+	  dest_node = GTK_CTREE_NODE (_gtk_clist_row_element
+				       (clist, dest_info.cell.row));
 
 	  if (!source_node || !dest_node)
 	    return;
@@ -102,6 +102,12 @@ typedef gboolean (*GtkCTreeCompareDragFunc) (GtkCTree     *ctree,
                                              GtkCTreeNode *new_parent,
                                              GtkCTreeNode *new_sibling);
 
+/* inserts (a batch of) the children of a lazy node, returns TRUE
+ * as long as there are more to come */
+typedef gboolean (*GtkCTreePopulateFunc) (GtkCTree     *ctree,
+                                          GtkCTreeNode *node,
+                                          gpointer      data);
+
 struct _GtkCTree
 {
   GtkCList clist;
@@ -158,6 +164,10 @@ struct _GtkCTreeRow
   
   guint is_leaf  : 1;
   guint expanded : 1;
+  guint lazy     : 1;
+
+  /* number of rows shown below this node while it is expanded */
+  gint visible_descendants;
 };
 
 struct _GtkCTreeNode {
@@ -258,6 +268,11 @@ GList * gtk_ctree_find_all_by_row_data_custom    (GtkCTree     *ctree,
 						  GtkCTreeNode *node,
 						  gpointer      data,
 						  GCompareFunc  func);
+/* keep a table from row data to nodes, so that searching the whole
+ * tree (node == NULL) by row data doesn't have to walk it.  Only
+ * sees row data set with gtk_ctree_node_set_row_data[_full]. */
+void gtk_ctree_set_row_data_indexed              (GtkCTree     *ctree,
+						  gboolean      indexed);
 gboolean gtk_ctree_is_hot_spot                   (GtkCTree     *ctree,
 					          gint          x,
 					          gint          y);
@@ -421,6 +436,24 @@ void gtk_ctree_set_expander_style    (GtkCTree                *ctree,
 void gtk_ctree_set_drag_compare_func (GtkCTree     	      *ctree,
 				      GtkCTreeCompareDragFunc  cmp_func);
 
+/* A lazy node shows an expander before it has any children; they are
+ * inserted by the populate func when the node is first expanded.
+ * The func is called until it returns FALSE, unless a placeholder is
+ * set with gtk_ctree_set_populate_async(): then the placeholder row
+ * is shown below the node and the func is called once per idle
+ * until it is done.  A NULL placeholder populates synchronously. */
+void gtk_ctree_set_populate_func     (GtkCTree                *ctree,
+				      GtkCTreePopulateFunc     func,
+				      gpointer                 data,
+				      GtkDestroyNotify         destroy);
+void gtk_ctree_set_populate_async    (GtkCTree                *ctree,
+				      const gchar             *placeholder);
+void gtk_ctree_node_set_lazy         (GtkCTree                *ctree,
+				      GtkCTreeNode            *node,
+				      gboolean                 lazy);
+gboolean gtk_ctree_node_get_lazy     (GtkCTree                *ctree,
+				      GtkCTreeNode            *node);
+
 /***********************************************************
  *             Tree sorting functions                      *
  ***********************************************************/
@@ -46,6 +46,19 @@ enum {
   ARG_VISIBILITY
 };
 
+typedef struct _GtkEntryPrivate GtkEntryPrivate;
+
+struct _GtkEntryPrivate
+{
+  /* Widths in font of the characters below 256, or below 128 when
+   * use_wchar is set, and of the invisible character.  Only valid
+   * while font is the style's font. */
+  GdkFont  *font;
+  gboolean  use_wchar;
+  gint16    char_widths[256];
+  gint16    invisible_width;
+};
+
 
 static void gtk_entry_class_init          (GtkEntryClass     *klass);
 static void gtk_entry_init                (GtkEntry          *entry);
@@ -156,10 +169,15 @@ static gint gtk_entry_find_position       (GtkEntry          *entry,
 					   gint               position);
 static void gtk_entry_set_position_from_editable (GtkEditable *editable,
 						  gint         position);
+static void gtk_entry_private_destroy     (GtkEntryPrivate   *private);
+static GtkEntryPrivate *gtk_entry_get_widths (GtkEntry       *entry);
 
 static GtkWidgetClass *parent_class = NULL;
 static GdkAtom ctext_atom = GDK_NONE;
 
+static const gchar *private_key = "gtk-entry-private";
+static guint private_key_id = 0;
+
 static const GtkTextFunction control_keys[26] =
 {
   (GtkTextFunction)gtk_move_beginning_of_line,    /* a */
@@ -258,6 +276,8 @@ gtk_entry_class_init (GtkEntryClass *class)
   editable_class = (GtkEditableClass*) class;
   parent_class = gtk_type_class (GTK_TYPE_EDITABLE);
 
+  private_key_id = g_quark_from_static_string (private_key);
+
   gtk_object_add_arg_type ("GtkEntry::max_length", GTK_TYPE_UINT, GTK_ARG_READWRITE, ARG_MAX_LENGTH);
   gtk_object_add_arg_type ("GtkEntry::visibility", GTK_TYPE_BOOL, GTK_ARG_READWRITE, ARG_VISIBILITY);
 
@@ -347,6 +367,10 @@ gtk_entry_get_arg (GtkObject      *object,
 static void
 gtk_entry_init (GtkEntry *entry)
 {
+  gtk_object_set_data_by_id_full (GTK_OBJECT (entry), private_key_id,
+				  g_new0 (GtkEntryPrivate, 1),
+				  (GtkDestroyNotify) gtk_entry_private_destroy);
+
   GTK_WIDGET_SET_FLAGS (entry, GTK_CAN_FOCUS);
 
   entry->text_area = NULL;
@@ -387,6 +411,71 @@ gtk_entry_get_invisible_char (GtkEntry *entry)
   return ch;
 }
 
+static void
+gtk_entry_private_destroy (GtkEntryPrivate *private)
+{
+  if (private->font)
+    gdk_font_unref (private->font);
+  g_free (private);
+}
+
+/* Make sure the width table is for the current font and encoding. */
+static GtkEntryPrivate *
+gtk_entry_get_widths (GtkEntry *entry)
+{
+  GtkEntryPrivate *private;
+  GdkFont *font;
+  gint i;
+
+  private = gtk_object_get_data_by_id (GTK_OBJECT (entry), private_key_id);
+  font = GTK_WIDGET (entry)->style->font;
+
+  if (private->font != font || private->use_wchar != entry->use_wchar)
+    {
+      gdk_font_ref (font);
+      if (private->font)
+	gdk_font_unref (private->font);
+      private->font = font;
+      private->use_wchar = entry->use_wchar;
+
+      if (entry->use_wchar)
+	{
+	  /* Only ASCII is in the table: its GdkWChar codes are the
+	   * same in every locale, the rest depends on the encoding */
+	  for (i = 0; i < 128; i++)
+	    private->char_widths[i] = gdk_char_width_wc (font, i);
+	  private->invisible_width =
+	    gdk_char_width_wc (font, gtk_entry_get_invisible_char (entry));
+	}
+      else
+	{
+	  for (i = 0; i < 256; i++)
+	    private->char_widths[i] = gdk_char_width (font, (gchar) i);
+	  private->invisible_width = private->char_widths['*'];
+	}
+    }
+
+  return private;
+}
+
+/* The width of character i of the text, shown or not */
+static inline gint
+gtk_entry_char_width (GtkEntry        *entry,
+		      GtkEntryPrivate *private,
+		      gint             i)
+{
+  GdkWChar ch;
+
+  if (!GTK_EDITABLE (entry)->visible)
+    return private->invisible_width;
+
+  ch = entry->text[i];
+  if (ch < (entry->use_wchar ? 128 : 256))
+    return private->char_widths[ch];
+  else
+    return gdk_char_width_wc (private->font, ch);
+}
+
 /*
  * Draws the string, noting that if entry->use_wchar is false, then
  * the text is not really wide characters, but narrow characters
@@ -1723,6 +1812,7 @@ gtk_entry_insert_text (GtkEditable *editable,
   guchar *new_text_nt;
   gint insertion_length;
   GdkWChar *insertion_text;
+  GdkWChar insertion_buffer[64];
   
   GtkEntry *entry;
   GtkWidget *widget;
@@ -1741,9 +1831,9 @@ gtk_entry_insert_text (GtkEditable *editable,
 	entry->use_wchar = TRUE;
     }
 
+  new_text_nt = (guchar *)new_text;
   if (new_text_length < 0)
     {
-      new_text_nt = (gchar *)new_text;
       new_text_length = strlen (new_text);
       if (new_text_length <= 0) return;
     }
@@ -1751,7 +1841,7 @@ gtk_entry_insert_text (GtkEditable *editable,
     {
       return;
     }
-  else
+  else if (entry->use_wchar)
     {
       /* make a null-terminated copy of new_text */
       new_text_nt = g_new (gchar, new_text_length + 1);
@@ -1769,13 +1859,19 @@ gtk_entry_insert_text (GtkEditable *editable,
   else
     max_length = MIN (2047, entry->text_max_length);
 
-  /* Convert to wide characters */
-  insertion_text = g_new (GdkWChar, new_text_length);
+  /* Convert to wide characters; typing goes through insertion_buffer
+   * rather than the heap. */
+  if (new_text_length <= sizeof (insertion_buffer) / sizeof (GdkWChar))
+    insertion_text = insertion_buffer;
+  else
+    insertion_text = g_new (GdkWChar, new_text_length);
   if (entry->use_wchar)
     insertion_length = gdk_mbstowcs (insertion_text, new_text_nt,
 				     new_text_length);
   else
-    for (insertion_length=0; new_text_nt[insertion_length]; insertion_length++)
+    for (insertion_length=0;
+	 insertion_length < new_text_length && new_text_nt[insertion_length];
+	 insertion_length++)
       insertion_text[insertion_length] = new_text_nt[insertion_length];
   if (new_text_nt != (guchar *)new_text)
     g_free (new_text_nt);
@@ -1787,7 +1883,8 @@ gtk_entry_insert_text (GtkEditable *editable,
   /* Don't insert anything, if there was nothing to insert. */
   if (insertion_length <= 0)
     {
-      g_free(insertion_text);
+      if (insertion_text != insertion_buffer)
+	g_free (insertion_text);
       return;
     }
 
@@ -1810,39 +1907,32 @@ gtk_entry_insert_text (GtkEditable *editable,
     gtk_entry_grow_text (entry);
 
   text = entry->text;
-  for (i = last_pos - 1; i >= end_pos; i--)
-    text[i] = text[i- (end_pos - start_pos)];
-  for (i = start_pos; i < end_pos; i++)
-    text[i] = insertion_text[i - start_pos];
-  g_free (insertion_text);
+  g_memmove (text + end_pos, text + start_pos,
+	     (entry->text_length - start_pos) * sizeof (GdkWChar));
+  memcpy (text + start_pos, insertion_text, insertion_length * sizeof (GdkWChar));
+  if (insertion_text != insertion_buffer)
+    g_free (insertion_text);
 
-  /* Fix up the the character offsets */
+  /* Fix up the the character offsets, only from the insertion on */
   
   if (GTK_WIDGET_REALIZED (entry))
     {
-      gint offset = 0;
+      GtkEntryPrivate *private = gtk_entry_get_widths (entry);
+      gint offset = entry->char_offset[start_pos];
+      gint width;
       
-      for (i = last_pos; i >= end_pos; i--)
-	entry->char_offset[i] = entry->char_offset[i - insertion_length];
+      g_memmove (entry->char_offset + end_pos, entry->char_offset + start_pos,
+		 (entry->text_length - start_pos + 1) * sizeof (gint));
       
-      for (i=start_pos; i<end_pos; i++)
+      for (i = start_pos; i < end_pos; i++)
 	{
-	  GdkWChar ch;
-
-	  entry->char_offset[i] = entry->char_offset[start_pos] + offset;
-
-	  if (editable->visible)
-	    ch = entry->text[i];
-	  else 
-	    ch = gtk_entry_get_invisible_char (entry);
-
-	  if (entry->use_wchar)
-	    offset += gdk_char_width_wc (GTK_WIDGET (entry)->style->font, ch);
-	  else
-	    offset += gdk_char_width (GTK_WIDGET (entry)->style->font, ch);
+	  entry->char_offset[i] = offset;
+	  offset += gtk_entry_char_width (entry, private, i);
 	}
+      
+      width = offset - entry->char_offset[start_pos];
       for (i = end_pos; i <= last_pos; i++)
-	entry->char_offset[i] += offset;
+	entry->char_offset[i] += width;
     }
 
   entry->text_length += insertion_length;
@@ -1852,29 +1942,20 @@ gtk_entry_insert_text (GtkEditable *editable,
   gtk_entry_queue_draw (entry);
 }
 
-/* Recompute the x offsets of all characters in the buffer */
+/* Recompute the x offsets of all characters in the buffer.  Only
+ * needed when the font or visibility changes; edits fix up the
+ * offsets from the edit point on. */
 static void
 gtk_entry_recompute_offsets (GtkEntry *entry)
 {
+  GtkEntryPrivate *private = gtk_entry_get_widths (entry);
   gint i;
   gint offset = 0;
-  GtkEditable *editable = GTK_EDITABLE (entry);
 
   for (i=0; i<entry->text_length; i++)
     {
-      GdkWChar ch;
-
       entry->char_offset[i] = offset;
-
-      if (editable->visible)
-	ch = entry->text[i];
-      else
-	ch = gtk_entry_get_invisible_char (entry);
-
-      if (entry->use_wchar)
-	offset += gdk_char_width_wc (GTK_WIDGET (entry)->style->font, ch);
-      else
-	offset += gdk_char_width (GTK_WIDGET (entry)->style->font, ch);
+      offset += gtk_entry_char_width (entry, private, i);
     }
   
   entry->char_offset[i] = offset;
@@ -1921,8 +2002,8 @@ gtk_entry_delete_text (GtkEditable *editable,
 	    entry->char_offset[start_pos+i] = entry->char_offset[end_pos+i] - deletion_width;
 	}
 
-      for (i = end_pos; i < entry->text_length; i++)
-        text[i - deletion_length] = text[i];
+      g_memmove (text + start_pos, text + end_pos,
+		 (entry->text_length - end_pos) * sizeof (GdkWChar));
 
       for (i = entry->text_length - deletion_length; i < entry->text_length; i++)
         text[i] = '\0';
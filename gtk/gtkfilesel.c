@@ -61,6 +61,10 @@
 #define FILE_LIST_WIDTH  180
 #define FILE_LIST_HEIGHT 180
 
+/* How long an idle call may spend stat()ing entries of unknown type,
+ * in seconds; at least one entry is looked at per call */
+#define SCAN_TIME        0.02
+
 /* The Hurd doesn't define either PATH_MAX or MAXPATHLEN, so we put this
  * in here, since the rest of the code in the file does require some
  * fixed maximum.
@@ -101,6 +105,10 @@ typedef struct _PossibleCompletion PossibleCompletion;
  * match by first_diff_index()
  */
 #define PATTERN_MATCH -1
+/* The is_dir of an entry whose type readdir() didn't tell us, until
+ * somebody needs it and stats it.
+ */
+#define DIR_UNKNOWN -1
 /* The arguments used by all fnmatch() calls below
  */
 #define FNMATCH_FLAGS (FNM_PATHNAME | FNM_PERIOD)
@@ -132,6 +140,7 @@ struct _CompletionDir
 
   struct _CompletionDir *cmpl_parent;
   gint cmpl_index;
+  gint cmpl_end;		/* one past the last entry cmpl_text can match */
   gchar *cmpl_text;
 };
 
@@ -145,7 +154,7 @@ struct _CompletionDir
  */
 struct _CompletionDirEntry
 {
-  gint is_dir;
+  gint is_dir;			/* TRUE, FALSE or DIR_UNKNOWN */
   gchar *entry_name;
 };
 
@@ -191,6 +200,10 @@ struct _CompletionState
 
   struct _CompletionDir *reference_dir; /* initial directory */
 
+  /* if set, entries of the completion directory itself are returned
+   * with is_directory DIR_UNKNOWN rather than stat()ed */
+  gboolean defer_types;
+
   GList* directory_storage;
   GList* directory_sent_storage;
 
@@ -229,6 +242,11 @@ static gint                cmpl_is_directory      (PossibleCompletion*);
  */
 static PossibleCompletion* cmpl_next_completion   (CompletionState*);
 
+/* The index of the current completion among the entries of the
+ * completion directory, or -1 if it comes from a subdirectory.
+ */
+static gint                cmpl_this_entry_index  (CompletionState*);
+
 /* Updating completions: the return value of cmpl_updated_text() will
  * be text_to_complete completed as much as possible after the most
  * recent call to cmpl_completion_matches.  For the present
@@ -284,6 +302,10 @@ static gchar*         find_parent_dir_fullname    (gchar* dirname);
 static CompletionDir* attach_dir           (CompletionDirSent* sent,
 					    gchar* dir_name,
 					    CompletionState *cmpl_state);
+static gint           cmpl_entry_is_dir    (CompletionDir* dir, gint index);
+static void           cmpl_entry_range     (CompletionDirSent* sent,
+					    gchar* pat, gint len,
+					    gint* first, gint* last);
 static void           free_dir_sent (CompletionDirSent* sent);
 static void           free_dir      (CompletionDir  *dir);
 static void           prune_memory_usage(CompletionState *cmpl_state);
@@ -328,6 +350,8 @@ static void gtk_file_selection_populate      (GtkFileSelection      *fs,
 					      gboolean               try_complete,
 					      gboolean               reset_entry);
 static void gtk_file_selection_abort         (GtkFileSelection      *fs);
+static void gtk_file_selection_scan_stop     (GtkFileSelection      *fs);
+static gint gtk_file_selection_scan_idle     (gpointer               data);
 
 static void gtk_file_selection_update_history_menu (GtkFileSelection       *fs,
 						    gchar                  *current_dir);
@@ -338,8 +362,30 @@ static void gtk_file_selection_rename_file (GtkWidget *widget, gpointer data);
 
 
 
+typedef struct _GtkFileSelectionPrivate GtkFileSelectionPrivate;
+
+/* The entries of the listed directory that still have to be stat()ed
+ * to know which list they go in, and the entry each row shows.
+ */
+struct _GtkFileSelectionPrivate
+{
+  guint          scan_idle;
+  CompletionDir *scan_dir;
+  GArray        *scan_pending;
+  guint          scan_next;
+  GTimer        *scan_timer;
+  GArray        *dir_rows;
+  gint           dir_rows_start;	/* the row dir_rows begins at */
+  GArray        *file_rows;
+  gint           dir_list_width;
+  gint           file_list_width;
+};
+
 static GtkWindowClass *parent_class = NULL;
 
+static const gchar *private_key = "gtk-file-selection-private";
+static guint private_key_id = 0;
+
 /* Saves errno when something cmpl does fails. */
 static gint cmpl_errno;
 
@@ -378,6 +424,18 @@ gtk_file_selection_class_init (GtkFileSelectionClass *class)
   parent_class = gtk_type_class (GTK_TYPE_WINDOW);
 
   object_class->destroy = gtk_file_selection_destroy;
+
+  private_key_id = g_quark_from_static_string (private_key);
+}
+
+static void
+gtk_file_selection_private_destroy (GtkFileSelectionPrivate *private)
+{
+  g_array_free (private->scan_pending, TRUE);
+  g_array_free (private->dir_rows, TRUE);
+  g_timer_destroy (private->scan_timer);
+  g_array_free (private->file_rows, TRUE);
+  g_free (private);
 }
 
 static void
@@ -392,7 +450,16 @@ gtk_file_selection_init (GtkFileSelection *filesel)
 
   char *dir_title [2];
   char *file_title [2];
+  GtkFileSelectionPrivate *private;
   
+  private = g_new0 (GtkFileSelectionPrivate, 1);
+  private->scan_pending = g_array_new (FALSE, FALSE, sizeof (gint));
+  private->dir_rows = g_array_new (FALSE, FALSE, sizeof (gint));
+  private->scan_timer = g_timer_new ();
+  private->file_rows = g_array_new (FALSE, FALSE, sizeof (gint));
+  gtk_object_set_data_by_id_full (GTK_OBJECT (filesel), private_key_id, private,
+				  (GtkDestroyNotify) gtk_file_selection_private_destroy);
+
   filesel->cmpl_state = cmpl_init_state ();
 
   /* The dialog-sized vertical box  */
@@ -706,8 +773,12 @@ gtk_file_selection_destroy (GtkObject *object)
       filesel->history_list = NULL;
     }
   
-  cmpl_free_state (filesel->cmpl_state);
-  filesel->cmpl_state = NULL;
+  if (filesel->cmpl_state)
+    {
+      gtk_file_selection_scan_stop (filesel);
+      cmpl_free_state (filesel->cmpl_state);
+      filesel->cmpl_state = NULL;
+    }
 
   if (GTK_OBJECT_CLASS (parent_class)->destroy)
     (* GTK_OBJECT_CLASS (parent_class)->destroy) (object);
@@ -1305,18 +1376,28 @@ gtk_file_selection_populate (GtkFileSelection *fs,
   gint selection_index = -1;
   gint file_list_width;
   gint dir_list_width;
+  gint index;
+  GtkFileSelectionPrivate *private;
   
   g_return_if_fail (fs != NULL);
   g_return_if_fail (GTK_IS_FILE_SELECTION (fs));
 
   rem_path = rel_path = g_strdup (rel_path);
   
+  /* Whatever was still being looked at belongs to the old listing */
+  gtk_file_selection_scan_stop (fs);
+  private = gtk_object_get_data_by_id (GTK_OBJECT (fs), private_key_id);
+  
+  /* Just listing a directory doesn't need to know the type of every
+   * entry before anything is shown, while completing does. */
   cmpl_state = (CompletionState*) fs->cmpl_state;
+  cmpl_state->defer_types = !try_complete;
   poss = cmpl_completion_matches (rel_path, &rem_path, cmpl_state);
 
   if (!cmpl_state_okay (cmpl_state))
     {
       /* Something went wrong. */
+      cmpl_state->defer_types = FALSE;
       gtk_file_selection_abort (fs);
       return;
     }
@@ -1342,6 +1423,9 @@ gtk_file_selection_populate (GtkFileSelection *fs,
   file_list_width = 1;
   gtk_clist_set_column_width(GTK_CLIST(fs->file_list),0,file_list_width);
 
+  /* The directories that are found go after ./ and ../ */
+  private->dir_rows_start = GTK_CLIST (fs->dir_list)->rows;
+
   while (poss)
     {
       if (cmpl_is_a_completion (poss))
@@ -1349,10 +1433,15 @@ gtk_file_selection_populate (GtkFileSelection *fs,
           possible_count += 1;
 
           filename = cmpl_this_completion (poss);
+	  index = cmpl_this_entry_index (cmpl_state);
 
 	  text[0] = filename;
 	  
-          if (cmpl_is_directory (poss))
+          if (cmpl_is_directory (poss) == DIR_UNKNOWN)
+	    {
+	      g_array_append_val (private->scan_pending, index);
+	    }
+          else if (cmpl_is_directory (poss))
             {
               if (strcmp (filename, "./") != 0 &&
                   strcmp (filename, "../") != 0)
@@ -1360,6 +1449,7 @@ gtk_file_selection_populate (GtkFileSelection *fs,
 		  int width = gdk_string_width(fs->dir_list->style->font,
 					       filename);
 		  row = gtk_clist_append (GTK_CLIST (fs->dir_list), text);
+		  g_array_append_val (private->dir_rows, index);
 		  if(width > dir_list_width)
 		    {
 		      dir_list_width = width;
@@ -1373,6 +1463,7 @@ gtk_file_selection_populate (GtkFileSelection *fs,
 	      int width = gdk_string_width(fs->file_list->style->font,
 				           filename);
 	      row = gtk_clist_append (GTK_CLIST (fs->file_list), text);
+	      g_array_append_val (private->file_rows, index);
 	      if(width > file_list_width)
 	        {
 	          file_list_width = width;
@@ -1388,7 +1479,18 @@ gtk_file_selection_populate (GtkFileSelection *fs,
   gtk_clist_thaw (GTK_CLIST (fs->dir_list));
   gtk_clist_thaw (GTK_CLIST (fs->file_list));
 
-  /* File lists are set. */
+  cmpl_state->defer_types = FALSE;
+  
+  /* File lists are set, except for the entries found by the scan */
+
+  if (private->scan_pending->len > 0)
+    {
+      private->scan_dir = cmpl_state->completion_dir;
+      private->scan_next = 0;
+      private->dir_list_width = dir_list_width;
+      private->file_list_width = file_list_width;
+      private->scan_idle = gtk_idle_add (gtk_file_selection_scan_idle, fs);
+    }
 
   g_assert (cmpl_state->reference_dir);
 
@@ -1458,6 +1560,132 @@ gtk_file_selection_populate (GtkFileSelection *fs,
   g_free (rel_path);
 }
 
+static void
+gtk_file_selection_scan_stop (GtkFileSelection *fs)
+{
+  GtkFileSelectionPrivate *private;
+
+  private = gtk_object_get_data_by_id (GTK_OBJECT (fs), private_key_id);
+
+  if (private->scan_idle)
+    {
+      gtk_idle_remove (private->scan_idle);
+      private->scan_idle = 0;
+    }
+
+  private->scan_dir = NULL;
+  g_array_set_size (private->scan_pending, 0);
+  g_array_set_size (private->dir_rows, 0);
+  g_array_set_size (private->file_rows, 0);
+}
+
+/* Where the row for entry index goes in a list whose rows show the
+ * entries in rows, which are sorted like the entries themselves. */
+static gint
+gtk_file_selection_scan_row (GArray *rows,
+			     gint    index)
+{
+  gint lower = 0;
+  gint upper = rows->len;
+  gint middle;
+
+  while (lower < upper)
+    {
+      middle = (lower + upper) / 2;
+      if (g_array_index (rows, gint, middle) < index)
+	lower = middle + 1;
+      else
+	upper = middle;
+    }
+
+  return lower;
+}
+
+/* Stat a batch of the entries populate couldn't place and put them in
+ * the dir or file list, where they would have been in the first place.
+ */
+static gint
+gtk_file_selection_scan_idle (gpointer data)
+{
+  GtkFileSelection *fs;
+  GtkFileSelectionPrivate *private;
+  CompletionDirEntry *entry;
+  GArray *rows;
+  GtkCList *clist;
+  gchar *text[2];
+  gint *width;
+  gint index;
+  gint row;
+  gint w;
+
+  GDK_THREADS_ENTER ();
+
+  fs = GTK_FILE_SELECTION (data);
+  private = gtk_object_get_data_by_id (GTK_OBJECT (fs), private_key_id);
+
+  gtk_clist_freeze (GTK_CLIST (fs->dir_list));
+  gtk_clist_freeze (GTK_CLIST (fs->file_list));
+
+  g_timer_start (private->scan_timer);
+  text[1] = NULL;
+
+  /* stat() can take long, e.g. on NFS, so stop once time is up */
+  for (; private->scan_next < private->scan_pending->len; private->scan_next++)
+    {
+      if (g_timer_elapsed (private->scan_timer, NULL) > SCAN_TIME)
+	break;
+
+      index = g_array_index (private->scan_pending, gint, private->scan_next);
+      entry = &private->scan_dir->sent->entries[index];
+
+      if (cmpl_entry_is_dir (private->scan_dir, index))
+	{
+	  clist = GTK_CLIST (fs->dir_list);
+	  rows = private->dir_rows;
+	  width = &private->dir_list_width;
+	  text[0] = g_strconcat (entry->entry_name, "/", NULL);
+	  row = gtk_file_selection_scan_row (rows, index);
+	  gtk_clist_insert (clist, private->dir_rows_start + row, text);
+	}
+      else
+	{
+	  clist = GTK_CLIST (fs->file_list);
+	  rows = private->file_rows;
+	  width = &private->file_list_width;
+	  text[0] = g_strdup (entry->entry_name);
+	  row = gtk_file_selection_scan_row (rows, index);
+	  gtk_clist_insert (clist, row, text);
+	}
+
+      g_array_insert_val (rows, row, index);
+
+      w = gdk_string_width (GTK_WIDGET (clist)->style->font, text[0]);
+      if (w > *width)
+	{
+	  *width = w;
+	  gtk_clist_set_column_width (clist, 0, w);
+	}
+
+      g_free (text[0]);
+    }
+
+  gtk_clist_thaw (GTK_CLIST (fs->dir_list));
+  gtk_clist_thaw (GTK_CLIST (fs->file_list));
+
+  if (private->scan_next == private->scan_pending->len)
+    {
+      private->scan_idle = 0;
+      gtk_file_selection_scan_stop (fs);
+      GDK_THREADS_LEAVE ();
+
+      return FALSE;
+    }
+
+  GDK_THREADS_LEAVE ();
+
+  return TRUE;
+}
+
 static void
 gtk_file_selection_abort (GtkFileSelection *fs)
 {
@@ -1563,6 +1791,18 @@ cmpl_is_directory (PossibleCompletion* pc)
   return pc->is_directory;
 }
 
+static gint
+cmpl_this_entry_index (CompletionState* cmpl_state)
+{
+  CompletionDir *dir = cmpl_state->active_completion_dir;
+
+  if (cmpl_state->user_completion_index >= 0 ||
+      !dir || dir != cmpl_state->completion_dir)
+    return -1;
+
+  return dir->cmpl_index;
+}
+
 static gint
 cmpl_is_a_completion (PossibleCompletion* pc)
 {
@@ -1599,6 +1839,7 @@ cmpl_init_state (void)
 tryagain:
 
   new_state->reference_dir = NULL;
+  new_state->defer_types = FALSE;
   new_state->completion_dir = NULL;
   new_state->active_completion_dir = NULL;
   new_state->directory_storage = NULL;
@@ -1955,26 +2196,23 @@ open_relative_dir(gchar* dir_name,
   return open_dir(path_buf, cmpl_state);
 }
 
-/* after the cache lookup fails, really open a new directory */
+/* after the cache lookup fails, really open a new directory.  The
+ * directory is read once; entries are only stat()ed here if readdir()
+ * doesn't give their type, and then only later, by whoever needs it.
+ */
 static CompletionDirSent*
 open_new_dir(gchar* dir_name, struct stat* sbuf, gboolean stat_subdirs)
 {
   CompletionDirSent* sent;
   DIR* directory;
-  gchar *buffer_ptr;
   struct dirent *dirent_ptr;
   gint buffer_size = 0;
+  gint buffer_alloc = 0;
+  gint entry_alloc = 0;
   gint entry_count = 0;
   gint i;
-  struct stat ent_sbuf;
-  char path_buf[MAXPATHLEN*2];
   gint path_buf_len;
 
-  sent = g_new(CompletionDirSent, 1);
-  sent->mtime = sbuf->st_mtime;
-  sent->inode = sbuf->st_ino;
-  sent->device = sbuf->st_dev;
-
   path_buf_len = strlen(dir_name);
 
   if (path_buf_len > MAXPATHLEN)
@@ -1983,8 +2221,6 @@ open_new_dir(gchar* dir_name, struct stat* sbuf, gboolean stat_subdirs)
       return NULL;
     }
 
-  strcpy(path_buf, dir_name);
-
   directory = opendir(dir_name);
 
   if(!directory)
@@ -1993,66 +2229,145 @@ open_new_dir(gchar* dir_name, struct stat* sbuf, gboolean stat_subdirs)
       return NULL;
     }
 
+  sent = g_new(CompletionDirSent, 1);
+  sent->mtime = sbuf->st_mtime;
+  sent->inode = sbuf->st_ino;
+  sent->device = sbuf->st_dev;
+  sent->name_buffer = NULL;
+  sent->entries = NULL;
+
   while((dirent_ptr = readdir(directory)) != NULL)
     {
+      CompletionDirEntry *entry;
       int entry_len = strlen(dirent_ptr->d_name);
-      buffer_size += entry_len + 1;
-      entry_count += 1;
 
       if(path_buf_len + entry_len + 2 >= MAXPATHLEN)
 	{
 	  cmpl_errno = CMPL_ERRNO_TOO_LONG;
  	  closedir(directory);
+	  free_dir_sent(sent);
 	  return NULL;
 	}
+
+      if (buffer_size + entry_len + 1 > buffer_alloc)
+	{
+	  buffer_alloc = MAX (2 * buffer_alloc, buffer_size + entry_len + 1);
+	  buffer_alloc = MAX (buffer_alloc, 1024);
+	  sent->name_buffer = g_realloc(sent->name_buffer, buffer_alloc);
+	}
+      if (entry_count == entry_alloc)
+	{
+	  entry_alloc = MAX (2 * entry_alloc, 64);
+	  sent->entries = g_realloc(sent->entries,
+				    entry_alloc * sizeof(CompletionDirEntry));
+	}
+
+      entry = &sent->entries[entry_count];
+
+      /* Names move with name_buffer, so this is an offset for now */
+      entry->entry_name = GINT_TO_POINTER (buffer_size);
+      strcpy(sent->name_buffer + buffer_size, dirent_ptr->d_name);
+      buffer_size += entry_len + 1;
+
+      if (!stat_subdirs ||
+	  strcmp (dirent_ptr->d_name, ".") == 0 ||
+	  strcmp (dirent_ptr->d_name, "..") == 0)
+	entry->is_dir = 1;
+      else
+#ifdef DT_DIR
+	/* Symlinks have to be followed to know what they point to */
+	switch (dirent_ptr->d_type)
+	  {
+	  case DT_DIR:
+	    entry->is_dir = 1;
+	    break;
+	  case DT_UNKNOWN:
+	  case DT_LNK:
+	    entry->is_dir = DIR_UNKNOWN;
+	    break;
+	  default:
+	    entry->is_dir = 0;
+	    break;
+	  }
+#else
+	entry->is_dir = DIR_UNKNOWN;
+#endif
+
+      entry_count += 1;
     }
 
-  sent->name_buffer = g_new(gchar, buffer_size);
-  sent->entries = g_new(CompletionDirEntry, entry_count);
+  closedir(directory);
+
   sent->entry_count = entry_count;
+  for(i = 0; i < entry_count; i += 1)
+    sent->entries[i].entry_name =
+      sent->name_buffer + GPOINTER_TO_INT (sent->entries[i].entry_name);
 
-  buffer_ptr = sent->name_buffer;
+  qsort(sent->entries, sent->entry_count, sizeof(CompletionDirEntry), compare_cmpl_dir);
 
-  rewinddir(directory);
+  return sent;
+}
 
-  for(i = 0; i < entry_count; i += 1)
+/* Whether entry index of dir is a directory, stat()ing it if that
+ * isn't known yet. */
+static gint
+cmpl_entry_is_dir(CompletionDir* dir, gint index)
+{
+  CompletionDirEntry *entry = &dir->sent->entries[index];
+  struct stat ent_sbuf;
+  gchar *path;
+
+  if (entry->is_dir == DIR_UNKNOWN)
     {
-      dirent_ptr = readdir(directory);
+      path = g_strconcat(dir->fullname, "/", entry->entry_name, NULL);
 
-      if(!dirent_ptr)
-	{
-	  cmpl_errno = errno;
-	  closedir(directory);
-	  return NULL;
-	}
+      /* stat may fail, and we don't mind, since it could be a
+       * dangling symlink. */
+      entry->is_dir = stat(path, &ent_sbuf) >= 0 && S_ISDIR(ent_sbuf.st_mode);
 
-      strcpy(buffer_ptr, dirent_ptr->d_name);
-      sent->entries[i].entry_name = buffer_ptr;
-      buffer_ptr += strlen(dirent_ptr->d_name);
-      *buffer_ptr = 0;
-      buffer_ptr += 1;
+      g_free(path);
+    }
 
-      path_buf[path_buf_len] = '/';
-      strcpy(path_buf + path_buf_len + 1, dirent_ptr->d_name);
+  return entry->is_dir;
+}
 
-      if (stat_subdirs)
-	{
-	  if(stat(path_buf, &ent_sbuf) >= 0 && S_ISDIR(ent_sbuf.st_mode))
-	    sent->entries[i].is_dir = 1;
-	  else
-	    /* stat may fail, and we don't mind, since it could be a
-	     * dangling symlink. */
-	    sent->entries[i].is_dir = 0;
-	}
-      else
-	sent->entries[i].is_dir = 1;
-    }
+/* The entries of sent that the first len characters of the pattern pat
+ * can match are those from *first up to *last, since they must start
+ * with whatever pat has before its first wildcard, and the entries are
+ * sorted.
+ */
+static void
+cmpl_entry_range(CompletionDirSent* sent, gchar* pat, gint len,
+		 gint* first, gint* last)
+{
+  gint prefix_len = 0;
+  gint lower, upper, middle;
 
-  qsort(sent->entries, sent->entry_count, sizeof(CompletionDirEntry), compare_cmpl_dir);
+  while(prefix_len < len && !strchr("*?[\\", pat[prefix_len]))
+    prefix_len += 1;
 
-  closedir(directory);
+  lower = 0;
+  upper = sent->entry_count;
+  while(lower < upper)
+    {
+      middle = (lower + upper) / 2;
+      if(strncmp(sent->entries[middle].entry_name, pat, prefix_len) < 0)
+	lower = middle + 1;
+      else
+	upper = middle;
+    }
+  *first = lower;
 
-  return sent;
+  upper = sent->entry_count;
+  while(lower < upper)
+    {
+      middle = (lower + upper) / 2;
+      if(strncmp(sent->entries[middle].entry_name, pat, prefix_len) == 0)
+	lower = middle + 1;
+      else
+	upper = middle;
+    }
+  *last = lower;
 }
 
 static gboolean
@@ -2448,17 +2763,19 @@ find_completion_dir(gchar* text_to_complete,
       gint len = first_slash - *remaining_text;
       gint found = 0;
       gchar *found_name = NULL;         /* Quiet gcc */
-      gint i;
+      gint i, last;
       gchar* pat_buf = g_new (gchar, len + 1);
 
       strncpy(pat_buf, *remaining_text, len);
       pat_buf[len] = 0;
 
-      for(i = 0; i < dir->sent->entry_count; i += 1)
+      cmpl_entry_range(dir->sent, pat_buf, len, &i, &last);
+
+      for(; i < last; i += 1)
 	{
-	  if(dir->sent->entries[i].is_dir &&
-	     fnmatch(pat_buf, dir->sent->entries[i].entry_name,
-		     FNMATCH_FLAGS)!= FNM_NOMATCH)
+	  if(fnmatch(pat_buf, dir->sent->entries[i].entry_name,
+		     FNMATCH_FLAGS)!= FNM_NOMATCH &&
+	     cmpl_entry_is_dir(dir, i))
 	    {
 	      if(found)
 		{
@@ -2559,9 +2876,21 @@ attempt_file_completion(CompletionState *cmpl_state)
   gchar *pat_buf, *first_slash;
   CompletionDir *dir = cmpl_state->active_completion_dir;
 
-  dir->cmpl_index += 1;
+  g_assert(dir->cmpl_text);
+
+  /* Only look at the entries that can match at all */
+  if(dir->cmpl_index < 0)
+    {
+      first_slash = strchr(dir->cmpl_text, '/');
+      cmpl_entry_range(dir->sent, dir->cmpl_text,
+		       first_slash ? first_slash - dir->cmpl_text
+		                   : strlen(dir->cmpl_text),
+		       &dir->cmpl_index, &dir->cmpl_end);
+    }
+  else
+    dir->cmpl_index += 1;
 
-  if(dir->cmpl_index == dir->sent->entry_count)
+  if(dir->cmpl_index == dir->cmpl_end)
     {
       if(dir->cmpl_parent == NULL)
 	{
@@ -2577,8 +2906,6 @@ attempt_file_completion(CompletionState *cmpl_state)
 	}
     }
 
-  g_assert(dir->cmpl_text);
-
   first_slash = strchr(dir->cmpl_text, '/');
 
   if(first_slash)
@@ -2600,10 +2927,10 @@ attempt_file_completion(CompletionState *cmpl_state)
 
   if(first_slash)
     {
-      if(dir->sent->entries[dir->cmpl_index].is_dir)
+      if(fnmatch(pat_buf, dir->sent->entries[dir->cmpl_index].entry_name,
+		 FNMATCH_FLAGS) != FNM_NOMATCH)
 	{
-	  if(fnmatch(pat_buf, dir->sent->entries[dir->cmpl_index].entry_name,
-		     FNMATCH_FLAGS) != FNM_NOMATCH)
+	  if(cmpl_entry_is_dir(dir, dir->cmpl_index))
 	    {
 	      CompletionDir* new_dir;
 
@@ -2654,8 +2981,13 @@ attempt_file_completion(CompletionState *cmpl_state)
 	(fnmatch(pat_buf, dir->sent->entries[dir->cmpl_index].entry_name,
 		 FNMATCH_FLAGS) != FNM_NOMATCH);
 
+      /* Only a completion needs its type, unless it is deferred */
+      if(cmpl_state->the_completion.is_a_completion &&
+	 !(cmpl_state->defer_types && dir->cmpl_parent == NULL))
+	cmpl_entry_is_dir(dir, dir->cmpl_index);
+
       cmpl_state->the_completion.is_directory = dir->sent->entries[dir->cmpl_index].is_dir;
-      if(dir->sent->entries[dir->cmpl_index].is_dir)
+      if(dir->sent->entries[dir->cmpl_index].is_dir > 0)
 	append_completion_text("/", cmpl_state);
 
       g_free (pat_buf);
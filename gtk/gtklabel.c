@@ -66,6 +66,24 @@ struct _GtkLabelULine
   GtkLabelULine *next;
 };
 
+typedef struct _GtkLabelPrivate GtkLabelPrivate;
+struct _GtkLabelPrivate
+{
+  /* Words freed since the text was last split, kept to be used
+   * again by the next split */
+  GtkLabelWord *free_words;
+
+  /* Layout of label->words as wrapped for the requested width and
+   * padding below; only valid until the words are freed */
+  gboolean layout_valid;
+  gint longest_paragraph;
+  gint layout_width;
+  gint layout_xpad;
+  gint layout_ypad;
+  gint max_width;
+  GtkRequisition requisition;
+};
+
 static void gtk_label_class_init   (GtkLabelClass  *klass);
 static void gtk_label_init	   (GtkLabel	   *label);
 static void gtk_label_set_arg	   (GtkObject	   *object,
@@ -82,11 +100,12 @@ static void gtk_label_style_set    (GtkWidget      *widget,
 static gint gtk_label_expose	   (GtkWidget	   *widget,
 				    GdkEventExpose *event);
 
-static GtkLabelWord*  gtk_label_word_alloc          (void);
+static GtkLabelWord*  gtk_label_word_alloc          (GtkLabel     *label);
 static GtkLabelULine* gtk_label_uline_alloc         (void);
 static void           gtk_label_free_words          (GtkLabel     *label);
 static void           gtk_label_free_ulines         (GtkLabelWord *word);
 static gint           gtk_label_split_text          (GtkLabel     *label);
+static void           gtk_label_private_destroy     (GtkLabelPrivate *private);
 
 
 static GtkMiscClass *parent_class = NULL;
@@ -94,6 +113,9 @@ static GtkMiscClass *parent_class = NULL;
 static GMemChunk *word_chunk = NULL;
 static GMemChunk *uline_chunk = NULL;
 
+static const gchar *private_key = "gtk-label-private";
+static guint private_key_id = 0;
+
 GtkType
 gtk_label_get_type (void)
 {
@@ -131,6 +153,8 @@ gtk_label_class_init (GtkLabelClass *class)
   
   parent_class = gtk_type_class (GTK_TYPE_MISC);
   
+  private_key_id = g_quark_from_static_string (private_key);
+  
   gtk_object_add_arg_type ("GtkLabel::label", GTK_TYPE_STRING, GTK_ARG_READWRITE, ARG_LABEL);
   gtk_object_add_arg_type ("GtkLabel::pattern", GTK_TYPE_STRING, GTK_ARG_READWRITE, ARG_PATTERN);
   gtk_object_add_arg_type ("GtkLabel::justify", GTK_TYPE_JUSTIFICATION, GTK_ARG_READWRITE, ARG_JUSTIFY);
@@ -205,6 +229,10 @@ gtk_label_get_arg (GtkObject	  *object,
 static void
 gtk_label_init (GtkLabel *label)
 {
+  gtk_object_set_data_by_id_full (GTK_OBJECT (label), private_key_id,
+				  g_new0 (GtkLabelPrivate, 1),
+				  (GtkDestroyNotify) gtk_label_private_destroy);
+
   GTK_WIDGET_SET_FLAGS (label, GTK_NO_WINDOW);
   
   label->label = NULL;
@@ -384,14 +412,25 @@ gtk_label_free_ulines (GtkLabelWord *word)
 }
 
 static GtkLabelWord*
-gtk_label_word_alloc (void)
+gtk_label_word_alloc (GtkLabel *label)
 {
+  GtkLabelPrivate *private;
   GtkLabelWord * word;
   
-  if (!word_chunk)
-    word_chunk = g_mem_chunk_create (GtkLabelWord, 32, G_ALLOC_AND_FREE);
-  
-  word = g_chunk_new0 (GtkLabelWord, word_chunk);
+  private = gtk_object_get_data_by_id (GTK_OBJECT (label), private_key_id);
+  if (private->free_words)
+    {
+      word = private->free_words;
+      private->free_words = word->next;
+      memset (word, 0, sizeof (GtkLabelWord));
+    }
+  else
+    {
+      if (!word_chunk)
+	word_chunk = g_mem_chunk_create (GtkLabelWord, 32, G_ALLOC_AND_FREE);
+      
+      word = g_chunk_new0 (GtkLabelWord, word_chunk);
+    }
   
   word->beginning = NULL;
   word->next = NULL;
@@ -403,6 +442,11 @@ gtk_label_word_alloc (void)
 static void
 gtk_label_free_words (GtkLabel *label)
 {
+  GtkLabelPrivate *private;
+  
+  private = gtk_object_get_data_by_id (GTK_OBJECT (label), private_key_id);
+  private->layout_valid = FALSE;
+  
   while (label->words)
     {
       GtkLabelWord *word = label->words;
@@ -411,8 +455,23 @@ gtk_label_free_words (GtkLabel *label)
 
       gtk_label_free_ulines (word);
 
+      word->next = private->free_words;
+      private->free_words = word;
+    }
+}
+
+static void
+gtk_label_private_destroy (GtkLabelPrivate *private)
+{
+  while (private->free_words)
+    {
+      GtkLabelWord *word = private->free_words;
+
+      private->free_words = word->next;
       g_chunk_free (word, word_chunk);
     }
+  
+  g_free (private);
 }
 
 static gint
@@ -436,7 +495,7 @@ gtk_label_split_text (GtkLabel *label)
   
   while (*str)
     {
-      word = gtk_label_word_alloc ();
+      word = gtk_label_word_alloc (label);
       
       if (str == label->label_wc || str[-1] == '\n')
 	{
@@ -486,7 +545,7 @@ gtk_label_split_text (GtkLabel *label)
    */
   if (str == label->label_wc || str[-1] == '\n')
     {
-      word = gtk_label_word_alloc ();
+      word = gtk_label_word_alloc (label);
       
       word->space = 0;
       word->beginning = str;
@@ -521,7 +580,7 @@ gtk_label_split_text_wrapped (GtkLabel *label)
   str = label->label_wc;
   while (*str)
     {
-      word = gtk_label_word_alloc ();
+      word = gtk_label_word_alloc (label);
       
       if (str == label->label_wc || str[-1] == '\n')
 	{
@@ -799,22 +858,39 @@ gtk_label_size_request (GtkWidget      *widget,
    *     5. gtk_misc_set_padding has changed xpad.
    *     6.  maybe others?...
    *
-   * Too much of a pain to detect all these case, so always re-fill.  I
-   * don't think it's really that slow.
+   * Those are the inputs the wrapped layout is cached under, so the
+   * words are only split again when they have been freed, and wrapped
+   * again when the requested width or the padding changes.
    */
   
   if (label->wrap)
     {
+      GtkLabelPrivate *private;
       GtkWidgetAuxInfo *aux_info;
       gint longest_paragraph;
+      gint layout_width;
       
-      longest_paragraph = gtk_label_split_text_wrapped (label);
+      private = gtk_object_get_data_by_id (GTK_OBJECT (label), private_key_id);
       
       aux_info = gtk_object_get_data (GTK_OBJECT (widget), "gtk-aux-info");
-      if (aux_info && aux_info->width > 0)
+      layout_width = aux_info && aux_info->width > 0 ? aux_info->width : 0;
+      
+      if (!label->words)
+	private->longest_paragraph = gtk_label_split_text_wrapped (label);
+      else if (private->layout_valid &&
+	       private->layout_width == layout_width &&
+	       private->layout_xpad == label->misc.xpad &&
+	       private->layout_ypad == label->misc.ypad)
 	{
-	  label->max_width = MAX (aux_info->width - 2 * label->misc.xpad, 1);
-	  gtk_label_split_text_wrapped (label);
+	  label->max_width = private->max_width;
+	  *requisition = private->requisition;
+	  return;
+	}
+      longest_paragraph = private->longest_paragraph;
+      
+      if (layout_width > 0)
+	{
+	  label->max_width = MAX (layout_width - 2 * label->misc.xpad, 1);
 	}
       else
 	{
@@ -834,6 +910,13 @@ gtk_label_size_request (GtkWidget      *widget,
 	    }
 	}
       gtk_label_finalize_lines_wrap (label, requisition, label->max_width);
+      
+      private->layout_valid = TRUE;
+      private->layout_width = layout_width;
+      private->layout_xpad = label->misc.xpad;
+      private->layout_ypad = label->misc.ypad;
+      private->max_width = label->max_width;
+      private->requisition = *requisition;
     }
   else if (!label->words)
     {
@@ -96,6 +96,7 @@ gtk_list_item_get_type (void)
       };
 
       list_item_type = gtk_type_unique (gtk_item_get_type (), &list_item_info);
+      gtk_type_set_chunk_alloc (list_item_type, 16);
     }
 
   return list_item_type;
@@ -220,7 +220,7 @@ gtk_misc_set_padding (GtkMisc *misc,
       requisition->width += misc->xpad * 2;
       requisition->height += misc->ypad * 2;
       
-      if (GTK_WIDGET_DRAWABLE (misc))
+      if (GTK_WIDGET_VISIBLE (misc))
 	gtk_widget_queue_resize (GTK_WIDGET (misc));
     }
 }
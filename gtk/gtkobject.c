@@ -29,12 +29,32 @@
 #include <stdio.h>
 #include "gtkobject.h"
 #include "gtksignal.h"
+#include "gtkargcollector.c"
 
 
 enum {
   DESTROY,
   LAST_SIGNAL
 };
+typedef void (*GtkObjectSetArgFunc) (GtkObject *object,
+				     GtkArg    *arg,
+				     guint      arg_id);
+
+typedef struct _GtkObjectArgPlanEntry GtkObjectArgPlanEntry;
+
+struct _GtkObjectArgPlanEntry
+{
+  GtkArgInfo	     *info;
+  GtkObjectSetArgFunc set_arg;
+};
+
+struct _GtkObjectArgPlan
+{
+  GtkType		 object_type;
+  guint			 n_args;
+  GtkObjectArgPlanEntry *entries;
+};
+
 enum {
   ARG_0,
   ARG_USER_DATA,
@@ -60,6 +80,12 @@ static void           gtk_object_shutdown        (GtkObject      *object);
 static void           gtk_object_real_destroy    (GtkObject      *object);
 static void           gtk_object_finalize        (GtkObject      *object);
 static void           gtk_object_notify_weaks    (GtkObject      *object);
+static void           gtk_object_data_set        (GtkObject      *object,
+						  GQuark          data_id,
+						  gpointer        data,
+						  GtkDestroyNotify destroy,
+						  gboolean        notify);
+static void           gtk_object_data_clear      (GtkObject      *object);
 
 static guint object_signals[LAST_SIGNAL] = { 0 };
 
@@ -210,7 +236,7 @@ gtk_object_init (GtkObject      *object,
     GTK_OBJECT_FLAGS (object) |= GTK_CONSTRUCTED;
 
   object->ref_count = 1;
-  g_datalist_init (&object->object_data);
+  object->object_data = NULL;
 
 #ifdef G_ENABLE_DEBUG
   if (gtk_debug_flags & GTK_DEBUG_OBJECTS)
@@ -267,7 +293,7 @@ gtk_object_finalize (GtkObject *object)
 {
   gtk_object_notify_weaks (object);
 
-  g_datalist_clear (&object->object_data);
+  gtk_object_data_clear (object);
   
   gtk_type_free (GTK_OBJECT_TYPE (object), object);
 }
@@ -756,6 +782,192 @@ gtk_object_set (GtkObject *object,
     }
 }
 
+GtkObjectArgPlan*
+gtk_object_arg_plan_new (GtkType      object_type,
+			 const gchar *first_arg_name,
+			 ...)
+{
+  GtkObjectArgPlan *plan;
+  GSList *name_list = NULL;
+  GSList *slist;
+  gchar **arg_names;
+  const gchar *name;
+  va_list var_args;
+  guint n_args = 0;
+  guint i;
+
+  va_start (var_args, first_arg_name);
+  for (name = first_arg_name; name; name = va_arg (var_args, gchar*))
+    {
+      name_list = g_slist_prepend (name_list, (gchar*) name);
+      n_args++;
+    }
+  va_end (var_args);
+
+  arg_names = g_new (gchar*, n_args);
+  i = n_args;
+  for (slist = name_list; slist; slist = slist->next)
+    arg_names[--i] = slist->data;
+  g_slist_free (name_list);
+
+  plan = gtk_object_arg_plan_newv (object_type, n_args, arg_names);
+  g_free (arg_names);
+
+  return plan;
+}
+
+GtkObjectArgPlan*
+gtk_object_arg_plan_newv (GtkType      object_type,
+			  guint	       n_args,
+			  gchar	     **arg_names)
+{
+  GtkObjectArgPlan *plan;
+  guint i;
+
+  g_return_val_if_fail (GTK_FUNDAMENTAL_TYPE (object_type) == GTK_TYPE_OBJECT, NULL);
+  if (n_args)
+    g_return_val_if_fail (arg_names != NULL, NULL);
+
+  /* the argument setup happens in the gtk_*_class_init() functions
+   */
+  gtk_type_class (object_type);
+
+  plan = g_new (GtkObjectArgPlan, 1);
+  plan->object_type = object_type;
+  plan->n_args = n_args;
+  plan->entries = g_new (GtkObjectArgPlanEntry, n_args);
+
+  for (i = 0; i < n_args; i++)
+    {
+      GtkObjectClass *oclass;
+      GtkArgInfo *info;
+      gchar *error;
+
+      error = gtk_arg_get_info (object_type,
+				object_arg_info_ht,
+				arg_names[i],
+				&info);
+      if (!error && !(info->arg_flags & GTK_ARG_WRITABLE))
+	error = g_strconcat ("argument \"", info->full_name, "\" is not writable", NULL);
+      if (error)
+	{
+	  g_warning ("gtk_object_arg_plan_new(): %s", error);
+	  g_free (error);
+	  gtk_object_arg_plan_destroy (plan);
+
+	  return NULL;
+	}
+
+      oclass = gtk_type_class (info->class_type);
+      g_assert (oclass->set_arg != NULL);
+      plan->entries[i].info = info;
+      plan->entries[i].set_arg = oclass->set_arg;
+    }
+
+  return plan;
+}
+
+void
+gtk_object_arg_plan_destroy (GtkObjectArgPlan *plan)
+{
+  g_return_if_fail (plan != NULL);
+
+  g_free (plan->entries);
+  g_free (plan);
+}
+
+static void
+gtk_object_arg_plan_apply (GtkObject	    *object,
+			   GtkObjectArgPlan *plan,
+			   const gchar	    *func_name,
+			   va_list	     var_args)
+{
+  GtkObjectArgPlanEntry *entry;
+  GtkObjectArgPlanEntry *bound;
+
+  bound = plan->entries + plan->n_args;
+  for (entry = plan->entries; entry < bound; entry++)
+    {
+      GtkArgInfo *info = entry->info;
+      GtkArg arg_value;
+      GtkArg *arg = &arg_value;
+      gchar *error;
+
+      arg->type = info->type;
+      arg->name = info->name;
+      GTK_ARG_COLLECT_VALUE (arg, var_args, error);
+      if (error)
+	{
+	  /* we can't skip the remaining values, the var_args
+	   * list is out of sync once collection failed
+	   */
+	  g_warning ("%s(): %s", func_name, error);
+	  g_free (error);
+	  return;
+	}
+
+      if (info->arg_flags & GTK_ARG_CONSTRUCT_ONLY &&
+	  GTK_OBJECT_CONSTRUCTED (object))
+	{
+	  g_warning ("%s(): cannot set argument \"%s\" for constructed object",
+		     func_name,
+		     info->full_name);
+	  continue;
+	}
+
+      entry->set_arg (object, arg, info->arg_id);
+      if (!GTK_OBJECT_CONSTRUCTED (object) &&
+	  (info->arg_flags & GTK_ARG_CONSTRUCT_ONLY ||
+	   info->arg_flags & GTK_ARG_CONSTRUCT))
+	{
+	  GSList *slist;
+	  
+	  slist = gtk_object_get_data_by_id (object, quark_carg_history);
+	  gtk_object_set_data_by_id (object,
+				     quark_carg_history,
+				     g_slist_prepend (slist, info));
+	}
+    }
+}
+
+void
+gtk_object_set_by_plan (GtkObject	 *object,
+			GtkObjectArgPlan *plan,
+			...)
+{
+  va_list var_args;
+
+  g_return_if_fail (object != NULL);
+  g_return_if_fail (GTK_IS_OBJECT (object));
+  g_return_if_fail (plan != NULL);
+  g_return_if_fail (gtk_type_is_a (GTK_OBJECT_TYPE (object), plan->object_type));
+
+  va_start (var_args, plan);
+  gtk_object_arg_plan_apply (object, plan, "gtk_object_set_by_plan", var_args);
+  va_end (var_args);
+}
+
+GtkObject*
+gtk_object_new_by_plan (GtkObjectArgPlan *plan,
+			...)
+{
+  GtkObject *object;
+  va_list var_args;
+
+  g_return_val_if_fail (plan != NULL, NULL);
+
+  object = gtk_type_new (plan->object_type);
+
+  va_start (var_args, plan);
+  gtk_object_arg_plan_apply (object, plan, "gtk_object_new_by_plan", var_args);
+  va_end (var_args);
+
+  if (!GTK_OBJECT_CONSTRUCTED (object))
+    gtk_object_default_construct (object);
+
+  return object;
+}
+
 void
 gtk_object_arg_set (GtkObject  *object,
 		    GtkArg     *arg,
@@ -1014,6 +1226,256 @@ gtk_object_query_args (GtkType        class_type,
  *
  *****************************************/
 
+/* an object's keyed data is kept in a small array that is searched
+ * linearly, as long as it holds no more than OBJECT_DATA_LIST_MAX
+ * entries. objects with more keys, e.g. widgets carrying signal
+ * handlers, aux info, tooltips and drag sites, switch to an open
+ * addressed hash table with linear probing, keyed by the quark.
+ */
+#define	OBJECT_DATA_LIST_MAX		(8)
+#define	OBJECT_DATA_TABLE_MIN		(32)
+#define	OBJECT_DATA_IS_TABLE(odata)	((odata)->n_slots > OBJECT_DATA_LIST_MAX)
+#define	OBJECT_DATA_HASH(odata, id)	((((id) * 2654435769U) >> 12) & ((odata)->n_slots - 1))
+
+typedef struct _GtkObjectData      GtkObjectData;
+typedef struct _GtkObjectDataEntry GtkObjectDataEntry;
+
+/* the object_data field keeps its GData type for compatibility */
+#define	OBJECT_DATA(object)		((GtkObjectData*) (object)->object_data)
+
+struct _GtkObjectDataEntry
+{
+  GQuark	   id;
+  gpointer	   data;
+  GtkDestroyNotify destroy;
+};
+
+struct _GtkObjectData
+{
+  guint		     n_entries;
+  guint		     n_slots;
+  GtkObjectDataEntry entries[1];	/* flexible array */
+};
+
+static GtkObjectData*
+gtk_object_data_new (guint n_slots)
+{
+  GtkObjectData *odata;
+
+  odata = g_malloc0 (sizeof (GtkObjectData) +
+		     (n_slots - 1) * sizeof (GtkObjectDataEntry));
+  odata->n_entries = 0;
+  odata->n_slots = n_slots;
+
+  return odata;
+}
+
+static GtkObjectDataEntry*
+gtk_object_data_lookup (GtkObjectData *odata,
+			GQuark	       data_id)
+{
+  GtkObjectDataEntry *entry;
+
+  if (!odata || !data_id)
+    return NULL;
+
+  if (OBJECT_DATA_IS_TABLE (odata))
+    {
+      guint i;
+
+      i = OBJECT_DATA_HASH (odata, data_id);
+      for (entry = odata->entries + i; entry->id; entry = odata->entries + i)
+	{
+	  if (entry->id == data_id)
+	    return entry;
+	  i = (i + 1) & (odata->n_slots - 1);
+	}
+    }
+  else
+    {
+      GtkObjectDataEntry *bound;
+
+      bound = odata->entries + odata->n_entries;
+      for (entry = odata->entries; entry < bound; entry++)
+	if (entry->id == data_id)
+	  return entry;
+    }
+
+  return NULL;
+}
+
+/* insert an entry into a table that is known not to contain data_id
+ * and to have at least one free slot
+ */
+static void
+gtk_object_data_table_insert (GtkObjectData	 *odata,
+			      GtkObjectDataEntry *new_entry)
+{
+  guint i;
+
+  i = OBJECT_DATA_HASH (odata, new_entry->id);
+  while (odata->entries[i].id)
+    i = (i + 1) & (odata->n_slots - 1);
+  odata->entries[i] = *new_entry;
+  odata->n_entries++;
+}
+
+static GtkObjectData*
+gtk_object_data_resize (GtkObjectData *odata,
+			guint	       n_slots)
+{
+  GtkObjectData *new_odata;
+  guint i;
+
+  new_odata = gtk_object_data_new (n_slots);
+
+  if (OBJECT_DATA_IS_TABLE (new_odata))
+    {
+      for (i = 0; i < odata->n_slots; i++)
+	if (odata->entries[i].id)
+	  gtk_object_data_table_insert (new_odata, odata->entries + i);
+    }
+  else
+    for (i = 0; i < odata->n_slots; i++)
+      if (odata->entries[i].id)
+	new_odata->entries[new_odata->n_entries++] = odata->entries[i];
+  
+  g_free (odata);
+
+  return new_odata;
+}
+
+/* remove an entry, the caller is responsible for notification
+ */
+static void
+gtk_object_data_remove_entry (GtkObject		 *object,
+			      GtkObjectDataEntry *entry)
+{
+  GtkObjectData *odata = OBJECT_DATA (object);
+
+  odata->n_entries--;
+
+  if (OBJECT_DATA_IS_TABLE (odata))
+    {
+      guint mask = odata->n_slots - 1;
+      guint hole = entry - odata->entries;
+      guint i = hole;
+
+      /* backward shift deletion, so no tombstones are needed
+       */
+      while (1)
+	{
+	  guint home;
+
+	  i = (i + 1) & mask;
+	  if (!odata->entries[i].id)
+	    break;
+	  home = OBJECT_DATA_HASH (odata, odata->entries[i].id);
+	  if (((i - home) & mask) >= ((i - hole) & mask))
+	    {
+	      odata->entries[hole] = odata->entries[i];
+	      hole = i;
+	    }
+	}
+      odata->entries[hole].id = 0;
+      odata->entries[hole].data = NULL;
+      odata->entries[hole].destroy = NULL;
+
+      if (odata->n_entries <= OBJECT_DATA_LIST_MAX / 2)
+	object->object_data = (GData*) gtk_object_data_resize (odata, OBJECT_DATA_LIST_MAX);
+    }
+  else
+    {
+      *entry = odata->entries[odata->n_entries];
+      odata->entries[odata->n_entries].id = 0;
+      odata->entries[odata->n_entries].data = NULL;
+      odata->entries[odata->n_entries].destroy = NULL;
+      if (!odata->n_entries)
+	{
+	  g_free (odata);
+	  object->object_data = NULL;
+	}
+    }
+}
+
+static void
+gtk_object_data_set (GtkObject	      *object,
+		     GQuark	       data_id,
+		     gpointer	       data,
+		     GtkDestroyNotify  destroy,
+		     gboolean	       notify)
+{
+  GtkObjectData *odata = OBJECT_DATA (object);
+  GtkObjectDataEntry *entry;
+
+  entry = gtk_object_data_lookup (odata, data_id);
+  if (entry)
+    {
+      GtkObjectDataEntry old_entry = *entry;
+
+      /* the destroy notifier may change the object's data, so all
+       * structures need to be updated before it is invoked
+       */
+      if (data)
+	{
+	  entry->data = data;
+	  entry->destroy = destroy;
+	}
+      else
+	gtk_object_data_remove_entry (object, entry);
+
+      if (notify && old_entry.destroy)
+	old_entry.destroy (old_entry.data);
+    }
+  else if (data)
+    {
+      GtkObjectDataEntry new_entry;
+
+      new_entry.id = data_id;
+      new_entry.data = data;
+      new_entry.destroy = destroy;
+
+      if (!odata)
+	odata = gtk_object_data_new (2);
+      else if (OBJECT_DATA_IS_TABLE (odata))
+	{
+	  if ((odata->n_entries + 1) * 2 > odata->n_slots)
+	    odata = gtk_object_data_resize (odata, odata->n_slots * 2);
+	}
+      else if (odata->n_entries == odata->n_slots)
+	odata = gtk_object_data_resize (odata, (odata->n_slots < OBJECT_DATA_LIST_MAX ?
+						odata->n_slots * 2 :
+						OBJECT_DATA_TABLE_MIN));
+      object->object_data = (GData*) odata;
+
+      if (OBJECT_DATA_IS_TABLE (odata))
+	gtk_object_data_table_insert (odata, &new_entry);
+      else
+	odata->entries[odata->n_entries++] = new_entry;
+    }
+}
+
+static void
+gtk_object_data_clear (GtkObject *object)
+{
+  /* destroy notifiers may add new data, which is cleared in turn
+   */
+  while (object->object_data)
+    {
+      GtkObjectData *odata;
+      guint i;
+
+      odata = OBJECT_DATA (object);
+      object->object_data = NULL;
+
+      for (i = odata->n_slots; i > 0; i--)
+	if (odata->entries[i - 1].id && odata->entries[i - 1].destroy)
+	  odata->entries[i - 1].destroy (odata->entries[i - 1].data);
+
+      g_free (odata);
+    }
+}
+
 void
 gtk_object_set_data_by_id (GtkObject        *object,
 			   GQuark	     data_id,
@@ -1022,7 +1484,7 @@ gtk_object_set_data_by_id (GtkObject        *object,
   g_return_if_fail (object != NULL);
   g_return_if_fail (GTK_IS_OBJECT (object));
   
-  g_datalist_id_set_data (&object->object_data, data_id, data);
+  gtk_object_data_set (object, data_id, data, NULL, TRUE);
 }
 
 void
@@ -1034,7 +1496,7 @@ gtk_object_set_data (GtkObject        *object,
   g_return_if_fail (GTK_IS_OBJECT (object));
   g_return_if_fail (key != NULL);
   
-  g_datalist_set_data (&object->object_data, key, data);
+  gtk_object_data_set (object, g_quark_from_string (key), data, NULL, TRUE);
 }
 
 void
@@ -1046,7 +1508,7 @@ gtk_object_set_data_by_id_full (GtkObject        *object,
   g_return_if_fail (object != NULL);
   g_return_if_fail (GTK_IS_OBJECT (object));
 
-  g_datalist_id_set_data_full (&object->object_data, data_id, data, destroy);
+  gtk_object_data_set (object, data_id, data, destroy, TRUE);
 }
 
 void
@@ -1059,28 +1521,36 @@ gtk_object_set_data_full (GtkObject        *object,
   g_return_if_fail (GTK_IS_OBJECT (object));
   g_return_if_fail (key != NULL);
 
-  g_datalist_set_data_full (&object->object_data, key, data, destroy);
+  gtk_object_data_set (object, g_quark_from_string (key), data, destroy, TRUE);
 }
 
 gpointer
 gtk_object_get_data_by_id (GtkObject   *object,
 			   GQuark       data_id)
 {
+  GtkObjectDataEntry *entry;
+
   g_return_val_if_fail (object != NULL, NULL);
   g_return_val_if_fail (GTK_IS_OBJECT (object), NULL);
 
-  return g_datalist_id_get_data (&object->object_data, data_id);
+  entry = gtk_object_data_lookup (OBJECT_DATA (object), data_id);
+
+  return entry ? entry->data : NULL;
 }
 
 gpointer
 gtk_object_get_data (GtkObject   *object,
 		     const gchar *key)
 {
+  GtkObjectDataEntry *entry;
+
   g_return_val_if_fail (object != NULL, NULL);
   g_return_val_if_fail (GTK_IS_OBJECT (object), NULL);
   g_return_val_if_fail (key != NULL, NULL);
 
-  return g_datalist_get_data (&object->object_data, key);
+  entry = gtk_object_data_lookup (OBJECT_DATA (object), g_quark_try_string (key));
+
+  return entry ? entry->data : NULL;
 }
 
 void
@@ -1090,7 +1560,7 @@ gtk_object_remove_data_by_id (GtkObject   *object,
   g_return_if_fail (object != NULL);
   g_return_if_fail (GTK_IS_OBJECT (object));
 
-  g_datalist_id_remove_data (&object->object_data, data_id);
+  gtk_object_data_set (object, data_id, NULL, NULL, TRUE);
 }
 
 void
@@ -1101,7 +1571,7 @@ gtk_object_remove_data (GtkObject   *object,
   g_return_if_fail (GTK_IS_OBJECT (object));
   g_return_if_fail (key != NULL);
 
-  g_datalist_remove_data (&object->object_data, key);
+  gtk_object_data_set (object, g_quark_try_string (key), NULL, NULL, TRUE);
 }
 
 void
@@ -1111,7 +1581,7 @@ gtk_object_remove_no_notify_by_id (GtkObject      *object,
   g_return_if_fail (object != NULL);
   g_return_if_fail (GTK_IS_OBJECT (object));
 
-  g_datalist_id_remove_no_notify (&object->object_data, key_id);
+  gtk_object_data_set (object, key_id, NULL, NULL, FALSE);
 }
 
 void
@@ -1122,7 +1592,7 @@ gtk_object_remove_no_notify (GtkObject       *object,
   g_return_if_fail (GTK_IS_OBJECT (object));
   g_return_if_fail (key != NULL);
 
-  g_datalist_remove_no_notify (&object->object_data, key);
+  gtk_object_data_set (object, g_quark_try_string (key), NULL, NULL, FALSE);
 }
 
 void
@@ -1135,16 +1605,20 @@ gtk_object_set_user_data (GtkObject *object,
   if (!quark_user_data)
     quark_user_data = g_quark_from_static_string ("user_data");
 
-  g_datalist_id_set_data (&object->object_data, quark_user_data, data);
+  gtk_object_data_set (object, quark_user_data, data, NULL, TRUE);
 }
 
 gpointer
 gtk_object_get_user_data (GtkObject *object)
 {
+  GtkObjectDataEntry *entry;
+
   g_return_val_if_fail (object != NULL, NULL);
   g_return_val_if_fail (GTK_IS_OBJECT (object), NULL);
 
-  return g_datalist_id_get_data (&object->object_data, quark_user_data);
+  entry = gtk_object_data_lookup (OBJECT_DATA (object), quark_user_data);
+
+  return entry ? entry->data : NULL;
 }
 
 /*******************************************
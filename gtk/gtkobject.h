@@ -115,6 +115,7 @@ typedef enum
 } GtkArgFlags;
 
 typedef struct _GtkObjectClass	GtkObjectClass;
+typedef struct _GtkObjectArgPlan GtkObjectArgPlan;
 
 
 /* The GtkObject structure is the base of the Gtk+ objects hierarchy,
@@ -140,8 +141,10 @@ struct _GtkObject
    */
   guint ref_count;
   
-  /* A list of keyed data pointers, used for e.g. the list of signal
-   * handlers or an object's user_data.
+  /* The keyed data pointers, used for e.g. the list of signal
+   * handlers or an object's user_data. Despite its type this is no
+   * longer a GData list but private storage, use the
+   * gtk_object_*_data* functions to access it.
    */
   GData *object_data;
 };
@@ -264,6 +267,28 @@ void	gtk_object_setv		(GtkObject	*object,
 				 guint		n_args,
 				 GtkArg		*args);
 
+/* Argument plans resolve a NULL terminated list of argument names
+ * for an object type once, so objects of that type (or derived types)
+ * can repeatedly be created or modified without looking up the
+ * names again. gtk_object_new_by_plan() and gtk_object_set_by_plan()
+ * take the argument values in the plan's order, in the same form as
+ * gtk_object_set() does, just without the names:
+ * (GtkObjectArgPlan *plan, ARG_VALUES, [repeatedly ARG_VALUES])
+ * gtk_object_new_by_plan() works for widgets just like gtk_widget_new().
+ */
+GtkObjectArgPlan* gtk_object_arg_plan_new  (GtkType	      object_type,
+					    const gchar	     *first_arg_name,
+					    ...);
+GtkObjectArgPlan* gtk_object_arg_plan_newv (GtkType	      object_type,
+					    guint	      n_args,
+					    gchar	    **arg_names);
+void	   gtk_object_arg_plan_destroy	   (GtkObjectArgPlan *plan);
+GtkObject* gtk_object_new_by_plan	   (GtkObjectArgPlan *plan,
+					    ...);
+void	   gtk_object_set_by_plan	   (GtkObject	     *object,
+					    GtkObjectArgPlan *plan,
+					    ...);
+
 /* Allocate a GtkArg array of size nargs that hold the
  * names and types of the args that can be used with
  * gtk_object_set/gtk_object_get. if (arg_flags!=NULL),
@@ -49,7 +49,8 @@ typedef enum
   PRIVATE_GTK_HAS_SHAPE_MASK	= 1 <<  5,
   PRIVATE_GTK_IN_REPARENT       = 1 <<  6,
   PRIVATE_GTK_IS_OFFSCREEN      = 1 <<  7,
-  PRIVATE_GTK_FULLDRAW_PENDING  = 1 <<  8
+  PRIVATE_GTK_FULLDRAW_PENDING  = 1 <<  8,
+  PRIVATE_GTK_REQUEST_NEEDED    = 1 <<  9
 } GtkPrivateFlags;
 
 /* Macros for extracting a widgets private_flags from GtkWidget.
@@ -64,6 +65,7 @@ typedef enum
 #define GTK_WIDGET_IN_REPARENT(obj)	  ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_IN_REPARENT) != 0)
 #define GTK_WIDGET_IS_OFFSCREEN(obj)	  ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_IS_OFFSCREEN) != 0)
 #define GTK_WIDGET_FULLDRAW_PENDING(obj)  ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_FULLDRAW_PENDING) != 0)
+#define GTK_WIDGET_REQUEST_NEEDED(obj)	  ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_REQUEST_NEEDED) != 0)
 
 /* Macros for setting and clearing private widget flags.
  * we use a preprocessor string concatenation here for a clear
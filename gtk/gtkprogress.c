@@ -478,6 +478,10 @@ gtk_progress_set_adjustment (GtkProgress   *progress,
 			      (GtkSignalFunc) gtk_progress_value_changed,
 			      (gpointer) progress);
         }
+
+      /* the text is measured at the upper bound */
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (progress)))
+	gtk_widget_queue_resize (GTK_WIDGET (progress));
     }
 }
 
@@ -506,7 +510,11 @@ gtk_progress_configure (GtkProgress *progress,
 
   gtk_signal_emit_by_name (GTK_OBJECT (adj), "value_changed");
   if (changed)
-    gtk_signal_emit_by_name (GTK_OBJECT (progress->adjustment), "changed");
+    {
+      gtk_signal_emit_by_name (GTK_OBJECT (progress->adjustment), "changed");
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (progress)))
+	gtk_widget_queue_resize (GTK_WIDGET (progress));
+    }
 }
 
 void
@@ -577,7 +585,7 @@ gtk_progress_set_show_text (GtkProgress *progress,
     {
       progress->show_text = show_text;
 
-      if (GTK_WIDGET_DRAWABLE (GTK_WIDGET (progress)))
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (progress)))
 	gtk_widget_queue_resize (GTK_WIDGET (progress));
     }
 }
@@ -597,7 +605,7 @@ gtk_progress_set_text_alignment (GtkProgress *progress,
       progress->x_align = x_align;
       progress->y_align = y_align;
 
-      if (GTK_WIDGET_DRAWABLE (GTK_WIDGET (progress)))
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (progress)))
 	gtk_widget_queue_resize (GTK_WIDGET (progress));
     }
 }
@@ -615,7 +623,7 @@ gtk_progress_set_format_string (GtkProgress *progress,
 	g_free (progress->format);
       progress->format = g_strdup (format);
 
-      if (GTK_WIDGET_DRAWABLE (GTK_WIDGET (progress)))
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (progress)))
 	gtk_widget_queue_resize (GTK_WIDGET (progress));
     }
 }
@@ -656,7 +664,7 @@ gtk_progress_set_activity_mode (GtkProgress *progress,
 	GTK_PROGRESS_CLASS 
 	  (GTK_OBJECT (progress)->klass)->act_mode_enter (progress);
 
-      if (GTK_WIDGET_DRAWABLE (GTK_WIDGET (progress)))
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (progress)))
 	gtk_widget_queue_resize (GTK_WIDGET (progress));
     }
 }
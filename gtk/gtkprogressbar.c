@@ -768,7 +768,7 @@ gtk_progress_bar_set_orientation (GtkProgressBar           *pbar,
     {
       pbar->orientation = orientation;
 
-      if (GTK_WIDGET_DRAWABLE (GTK_WIDGET (pbar)))
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (pbar)))
 	gtk_widget_queue_resize (GTK_WIDGET (pbar));
     }
 }
@@ -784,7 +784,7 @@ gtk_progress_bar_set_bar_style (GtkProgressBar     *pbar,
     {
       pbar->bar_style = bar_style;
 
-      if (GTK_WIDGET_DRAWABLE (GTK_WIDGET (pbar)))
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (pbar)))
 	gtk_widget_queue_resize (GTK_WIDGET (pbar));
     }
 }
@@ -801,7 +801,7 @@ gtk_progress_bar_set_discrete_blocks (GtkProgressBar *pbar,
     {
       pbar->blocks = blocks;
 
-      if (GTK_WIDGET_DRAWABLE (GTK_WIDGET (pbar)))
+      if (GTK_WIDGET_VISIBLE (GTK_WIDGET (pbar)))
 	gtk_widget_queue_resize (GTK_WIDGET (pbar));
     }
 }
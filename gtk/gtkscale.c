@@ -257,7 +257,7 @@ gtk_scale_set_value_pos (GtkScale        *scale,
     {
       scale->value_pos = pos;
 
-      if (GTK_WIDGET_VISIBLE (scale) && GTK_WIDGET_MAPPED (scale))
+      if (GTK_WIDGET_VISIBLE (scale))
 	gtk_widget_queue_resize (GTK_WIDGET (scale));
     }
 }
@@ -25,6 +25,7 @@
  */
 
 #include "gtktable.h"
+#include "gtkprivate.h"
 
 enum
 {
@@ -50,6 +51,57 @@ enum
 };
   
 
+typedef struct _GtkTablePrivate   GtkTablePrivate;
+typedef struct _GtkTableLine      GtkTableLine;
+typedef struct _GtkTableChildInfo GtkTableChildInfo;
+
+/* GtkTableChildInfo extends the public GtkTableChild (which needs to be
+ * its first member) by the bookkeeping needed for the row and column
+ * buckets. width and height are the child requisition plus padding, as
+ * last seen by gtk_table_update_children().
+ */
+struct _GtkTableChildInfo
+{
+  GtkTableChild child;
+
+  GList *link;
+  GList *col_link;
+  GList *row_link;
+
+  GtkRequisition requisition;
+  gint width;
+  gint height;
+  guint visible : 1;
+  guint need_allocate : 1;
+};
+
+/* A GtkTableLine buckets the children which occupy a single row or
+ * column and keeps their aggregate requisition and expand/shrink
+ * counts, so a child change only touches the lines it is attached to.
+ * dirty lines need their requisition recomputed from the bucket.
+ */
+struct _GtkTableLine
+{
+  GList *children;
+  guint16 requisition;
+  guint n_visible;
+  guint n_expand;
+  guint n_noshrink;
+  gint offset;
+  guint dirty : 1;
+};
+
+struct _GtkTablePrivate
+{
+  GtkTableLine *rows;
+  GtkTableLine *cols;
+
+  /* children spanning multiple rows or columns, in table->children order */
+  GList *row_spanning;
+  GList *col_spanning;
+};
+
+
 static void gtk_table_class_init    (GtkTableClass  *klass);
 static void gtk_table_init	    (GtkTable	    *table);
 static void gtk_table_finalize	    (GtkObject	    *object);
@@ -97,9 +149,27 @@ static void gtk_table_size_allocate_init  (GtkTable *table);
 static void gtk_table_size_allocate_pass1 (GtkTable *table);
 static void gtk_table_size_allocate_pass2 (GtkTable *table);
 
+static GtkTablePrivate*	  gtk_table_get_private	       (GtkTable	  *table);
+static GtkTableChildInfo* gtk_table_get_child_info     (GtkTable	  *table,
+							GtkWidget	  *widget);
+static void		  gtk_table_child_link	       (GtkTablePrivate	  *private,
+							GtkTableChildInfo *info);
+static void		  gtk_table_child_unlink       (GtkTablePrivate	  *private,
+							GtkTableChildInfo *info);
+static void		  gtk_table_child_contribute   (GtkTablePrivate	  *private,
+							GtkTableChildInfo *info,
+							gboolean	   add);
+static void		  gtk_table_update_children    (GtkTable	  *table,
+							gboolean	   request);
+
 
 static GtkContainerClass *parent_class = NULL;
 
+static const gchar *private_key = "gtk-table-private";
+static guint        private_key_id = 0;
+static const gchar *child_info_key = "gtk-table-child-info";
+static guint        child_info_key_id = 0;
+
 
 GtkType
 gtk_table_get_type (void)
@@ -138,6 +208,9 @@ gtk_table_class_init (GtkTableClass *class)
   container_class = (GtkContainerClass*) class;
   
   parent_class = gtk_type_class (gtk_container_get_type ());
+
+  private_key_id = g_quark_from_static_string (private_key);
+  child_info_key_id = g_quark_from_static_string (child_info_key);
   
   gtk_object_add_arg_type ("GtkTable::n_rows", GTK_TYPE_UINT, GTK_ARG_READWRITE, ARG_N_ROWS);
   gtk_object_add_arg_type ("GtkTable::n_columns", GTK_TYPE_UINT, GTK_ARG_READWRITE, ARG_N_COLUMNS);
@@ -248,20 +321,30 @@ gtk_table_set_child_arg (GtkContainer   *container,
 			 guint           arg_id)
 {
   GtkTable *table;
+  GtkTablePrivate *private;
+  GtkTableChildInfo *info;
   GtkTableChild *table_child;
-  GList *list;
+  gboolean attach_changed;
 
   table = GTK_TABLE (container);
-  table_child = NULL;
-  for (list = table->children; list; list = list->next)
-    {
-      table_child = list->data;
-
-      if (table_child->widget == child)
-	break;
-    }
-  if (!list)
+  info = gtk_table_get_child_info (table, child);
+  if (!info)
     return;
+  table_child = &info->child;
+
+  /* take the child out of its buckets while it changes,
+   * gtk_table_update_children() picks up its requisition again.
+   */
+  attach_changed = (arg_id == CHILD_ARG_LEFT_ATTACH ||
+		    arg_id == CHILD_ARG_RIGHT_ATTACH ||
+		    arg_id == CHILD_ARG_TOP_ATTACH ||
+		    arg_id == CHILD_ARG_BOTTOM_ATTACH);
+  private = gtk_table_get_private (table);
+  gtk_table_child_contribute (private, info, FALSE);
+  if (attach_changed)
+    gtk_table_child_unlink (private, info);
+  info->visible = FALSE;
+  info->need_allocate = TRUE;
 
   switch (arg_id)
     {
@@ -318,6 +401,37 @@ gtk_table_set_child_arg (GtkContainer   *container,
     default:
       break;
     }
+
+  if (attach_changed)
+    gtk_table_child_link (private, info);
+  if (attach_changed &&
+      (table_child->left_attach != (table_child->right_attach - 1) ||
+       table_child->top_attach != (table_child->bottom_attach - 1)))
+    {
+      GList *list;
+
+      /* restore table->children order for the spanning lists */
+      g_list_free (private->row_spanning);
+      g_list_free (private->col_spanning);
+      private->row_spanning = NULL;
+      private->col_spanning = NULL;
+      for (list = g_list_last (table->children); list; list = list->prev)
+	{
+	  info = list->data;
+	  table_child = &info->child;
+	  if (table_child->left_attach != (table_child->right_attach - 1))
+	    {
+	      private->col_spanning = g_list_prepend (private->col_spanning, info);
+	      info->col_link = private->col_spanning;
+	    }
+	  if (table_child->top_attach != (table_child->bottom_attach - 1))
+	    {
+	      private->row_spanning = g_list_prepend (private->row_spanning, info);
+	      info->row_link = private->row_spanning;
+	    }
+	}
+    }
+
   if (GTK_WIDGET_VISIBLE (child) && GTK_WIDGET_VISIBLE (table))
     gtk_widget_queue_resize (child);
 }
@@ -328,21 +442,13 @@ gtk_table_get_child_arg (GtkContainer   *container,
 			 GtkArg         *arg,
 			 guint           arg_id)
 {
-  GtkTable *table;
+  GtkTableChildInfo *info;
   GtkTableChild *table_child;
-  GList *list;
 
-  table = GTK_TABLE (container);
-  table_child = NULL;
-  for (list = table->children; list; list = list->next)
-    {
-      table_child = list->data;
-
-      if (table_child->widget == child)
-	break;
-    }
-  if (!list)
+  info = gtk_table_get_child_info (GTK_TABLE (container), child);
+  if (!info)
     return;
+  table_child = &info->child;
 
   switch (arg_id)
     {
@@ -380,10 +486,32 @@ gtk_table_get_child_arg (GtkContainer   *container,
     }
 }
 
+static void
+gtk_table_private_destroy (GtkTablePrivate *private)
+{
+  g_list_free (private->row_spanning);
+  g_list_free (private->col_spanning);
+  g_free (private->rows);
+  g_free (private->cols);
+  g_free (private);
+}
+
+static GtkTablePrivate*
+gtk_table_get_private (GtkTable *table)
+{
+  return gtk_object_get_data_by_id (GTK_OBJECT (table), private_key_id);
+}
+
 static void
 gtk_table_init (GtkTable *table)
 {
+  GtkTablePrivate *private;
+
   GTK_WIDGET_SET_FLAGS (table, GTK_NO_WINDOW);
+
+  private = g_new0 (GtkTablePrivate, 1);
+  gtk_object_set_data_by_id_full (GTK_OBJECT (table), private_key_id, private,
+				  (GtkDestroyNotify) gtk_table_private_destroy);
   
   table->children = NULL;
   table->rows = NULL;
@@ -432,17 +560,24 @@ gtk_table_resize (GtkTable *table,
   if (n_rows != table->nrows ||
       n_cols != table->ncols)
     {
+      GtkTablePrivate *private;
       GList *list;
-      
-      for (list = table->children; list; list = list->next)
-	{
-	  GtkTableChild *child;
-	  
-	  child = list->data;
-	  
-	  n_rows = MAX (n_rows, child->bottom_attach);
-	  n_cols = MAX (n_cols, child->right_attach);
-	}
+
+      private = gtk_table_get_private (table);
+
+      /* all children fit into the current size, so we only need
+       * to check them if the table is supposed to shrink.
+       */
+      if (n_rows < table->nrows || n_cols < table->ncols)
+	for (list = table->children; list; list = list->next)
+	  {
+	    GtkTableChild *child;
+	    
+	    child = list->data;
+	    
+	    n_rows = MAX (n_rows, child->bottom_attach);
+	    n_cols = MAX (n_cols, child->right_attach);
+	  }
       
       if (n_rows != table->nrows)
 	{
@@ -451,6 +586,7 @@ gtk_table_resize (GtkTable *table,
 	  i = table->nrows;
 	  table->nrows = n_rows;
 	  table->rows = g_realloc (table->rows, table->nrows * sizeof (GtkTableRowCol));
+	  private->rows = g_realloc (private->rows, table->nrows * sizeof (GtkTableLine));
 	  
 	  for (; i < table->nrows; i++)
 	    {
@@ -461,6 +597,14 @@ gtk_table_resize (GtkTable *table,
 	      table->rows[i].need_shrink = 0;
 	      table->rows[i].expand = 0;
 	      table->rows[i].shrink = 0;
+
+	      private->rows[i].children = NULL;
+	      private->rows[i].requisition = 0;
+	      private->rows[i].n_visible = 0;
+	      private->rows[i].n_expand = 0;
+	      private->rows[i].n_noshrink = 0;
+	      private->rows[i].offset = 0;
+	      private->rows[i].dirty = FALSE;
 	    }
 	}
 
@@ -471,6 +615,7 @@ gtk_table_resize (GtkTable *table,
 	  i = table->ncols;
 	  table->ncols = n_cols;
 	  table->cols = g_realloc (table->cols, table->ncols * sizeof (GtkTableRowCol));
+	  private->cols = g_realloc (private->cols, table->ncols * sizeof (GtkTableLine));
 	  
 	  for (; i < table->ncols; i++)
 	    {
@@ -481,6 +626,14 @@ gtk_table_resize (GtkTable *table,
 	      table->cols[i].need_shrink = 0;
 	      table->cols[i].expand = 0;
 	      table->cols[i].shrink = 0;
+
+	      private->cols[i].children = NULL;
+	      private->cols[i].requisition = 0;
+	      private->cols[i].n_visible = 0;
+	      private->cols[i].n_expand = 0;
+	      private->cols[i].n_noshrink = 0;
+	      private->cols[i].offset = 0;
+	      private->cols[i].dirty = FALSE;
 	    }
 	}
     }
@@ -498,6 +651,7 @@ gtk_table_attach (GtkTable	  *table,
 		  guint		   xpadding,
 		  guint		   ypadding)
 {
+  GtkTableChildInfo *info;
   GtkTableChild *table_child;
   
   g_return_if_fail (table != NULL);
@@ -517,7 +671,8 @@ gtk_table_attach (GtkTable	  *table,
   if (bottom_attach >= table->nrows)
     gtk_table_resize (table, bottom_attach, table->ncols);
   
-  table_child = g_new (GtkTableChild, 1);
+  info = g_new (GtkTableChildInfo, 1);
+  table_child = &info->child;
   table_child->widget = child;
   table_child->left_attach = left_attach;
   table_child->right_attach = right_attach;
@@ -532,7 +687,17 @@ gtk_table_attach (GtkTable	  *table,
   table_child->yfill = (yoptions & GTK_FILL) != 0;
   table_child->ypadding = ypadding;
   
+  info->requisition.width = 0;
+  info->requisition.height = 0;
+  info->width = 0;
+  info->height = 0;
+  info->visible = FALSE;
+  info->need_allocate = TRUE;
+  
   table->children = g_list_prepend (table->children, table_child);
+  info->link = table->children;
+  gtk_table_child_link (gtk_table_get_private (table), info);
+  gtk_object_set_data_by_id (GTK_OBJECT (child), child_info_key_id, info);
   
   gtk_widget_set_parent (child, GTK_WIDGET (table));
   
@@ -848,35 +1013,33 @@ gtk_table_remove (GtkContainer *container,
 		  GtkWidget    *widget)
 {
   GtkTable *table;
-  GtkTableChild *child;
-  GList *children;
+  GtkTablePrivate *private;
+  GtkTableChildInfo *info;
+  gboolean was_visible;
   
   g_return_if_fail (container != NULL);
   g_return_if_fail (GTK_IS_TABLE (container));
   g_return_if_fail (widget != NULL);
   
   table = GTK_TABLE (container);
-  children = table->children;
+  info = gtk_table_get_child_info (table, widget);
+  if (!info)
+    return;
+
+  was_visible = GTK_WIDGET_VISIBLE (widget);
+
+  gtk_object_remove_data_by_id (GTK_OBJECT (widget), child_info_key_id);
+  gtk_widget_unparent (widget);
+
+  private = gtk_table_get_private (table);
+  gtk_table_child_contribute (private, info, FALSE);
+  gtk_table_child_unlink (private, info);
+  table->children = g_list_remove_link (table->children, info->link);
+  g_list_free_1 (info->link);
+  g_free (info);
   
-  while (children)
-    {
-      child = children->data;
-      children = children->next;
-      
-      if (child->widget == widget)
-	{
-	  gboolean was_visible = GTK_WIDGET_VISIBLE (widget);
-	  
-	  gtk_widget_unparent (widget);
-	  
-	  table->children = g_list_remove (table->children, child);
-	  g_free (child);
-	  
-	  if (was_visible && GTK_WIDGET_VISIBLE (container))
-	    gtk_widget_queue_resize (GTK_WIDGET (container));
-	  break;
-	}
-    }
+  if (was_visible && GTK_WIDGET_VISIBLE (container))
+    gtk_widget_queue_resize (GTK_WIDGET (container));
 }
 
 static void
@@ -905,64 +1068,235 @@ gtk_table_forall (GtkContainer *container,
     }
 }
 
+static GtkTableChildInfo*
+gtk_table_get_child_info (GtkTable  *table,
+			  GtkWidget *widget)
+{
+  if (widget->parent != GTK_WIDGET (table))
+    return NULL;
+
+  return gtk_object_get_data_by_id (GTK_OBJECT (widget), child_info_key_id);
+}
+
 static void
-gtk_table_size_request_init (GtkTable *table)
+gtk_table_child_link (GtkTablePrivate   *private,
+		      GtkTableChildInfo *info)
 {
   GtkTableChild *child;
-  GList *children;
-  gint row, col;
-  
-  for (row = 0; row < table->nrows; row++)
-    table->rows[row].requisition = 0;
-  for (col = 0; col < table->ncols; col++)
-    table->cols[col].requisition = 0;
-  
-  children = table->children;
-  while (children)
+  GtkTableLine *line;
+
+  child = &info->child;
+
+  if (child->left_attach == (child->right_attach - 1))
     {
-      child = children->data;
-      children = children->next;
-      
-      if (GTK_WIDGET_VISIBLE (child->widget))
-	gtk_widget_size_request (child->widget, NULL);
+      line = &private->cols[child->left_attach];
+      line->children = g_list_prepend (line->children, info);
+      info->col_link = line->children;
+    }
+  else
+    {
+      private->col_spanning = g_list_prepend (private->col_spanning, info);
+      info->col_link = private->col_spanning;
+    }
+
+  if (child->top_attach == (child->bottom_attach - 1))
+    {
+      line = &private->rows[child->top_attach];
+      line->children = g_list_prepend (line->children, info);
+      info->row_link = line->children;
+    }
+  else
+    {
+      private->row_spanning = g_list_prepend (private->row_spanning, info);
+      info->row_link = private->row_spanning;
     }
 }
 
 static void
-gtk_table_size_request_pass1 (GtkTable *table)
+gtk_table_child_unlink (GtkTablePrivate   *private,
+			GtkTableChildInfo *info)
 {
   GtkTableChild *child;
+  GList **list;
+
+  child = &info->child;
+
+  if (child->left_attach == (child->right_attach - 1))
+    list = &private->cols[child->left_attach].children;
+  else
+    list = &private->col_spanning;
+  *list = g_list_remove_link (*list, info->col_link);
+  g_list_free_1 (info->col_link);
+  info->col_link = NULL;
+
+  if (child->top_attach == (child->bottom_attach - 1))
+    list = &private->rows[child->top_attach].children;
+  else
+    list = &private->row_spanning;
+  *list = g_list_remove_link (*list, info->row_link);
+  g_list_free_1 (info->row_link);
+  info->row_link = NULL;
+}
+
+static void
+gtk_table_line_contribute (GtkTableLine *line,
+			   gint		 size,
+			   gboolean	 expand,
+			   gboolean	 shrink,
+			   gboolean	 add)
+{
+  if (add)
+    {
+      line->n_visible += 1;
+      if (expand)
+	line->n_expand += 1;
+      if (!shrink)
+	line->n_noshrink += 1;
+      line->requisition = MAX (line->requisition, size);
+    }
+  else
+    {
+      line->n_visible -= 1;
+      if (expand)
+	line->n_expand -= 1;
+      if (!shrink)
+	line->n_noshrink -= 1;
+      if (size >= line->requisition)
+	line->dirty = TRUE;
+    }
+}
+
+/* Add or remove the contribution of a visible single row or
+ * column child to its line.
+ */
+static void
+gtk_table_child_contribute (GtkTablePrivate   *private,
+			    GtkTableChildInfo *info,
+			    gboolean	       add)
+{
+  GtkTableChild *child;
+
+  if (!info->visible)
+    return;
+
+  child = &info->child;
+
+  if (child->left_attach == (child->right_attach - 1))
+    gtk_table_line_contribute (&private->cols[child->left_attach],
+			       info->width, child->xexpand, child->xshrink, add);
+  if (child->top_attach == (child->bottom_attach - 1))
+    gtk_table_line_contribute (&private->rows[child->top_attach],
+			       info->height, child->yexpand, child->yshrink, add);
+}
+
+/* Bring the buckets up to date with the children. Only children which
+ * have been queued for a resize, changed their visibility or have been
+ * requested by somebody else since the last run are looked at closely,
+ * and only the lines they occupy are invalidated.
+ */
+static void
+gtk_table_update_children (GtkTable *table,
+			   gboolean  request)
+{
+  GtkTablePrivate *private;
+  GtkTableChildInfo *info;
+  GtkWidget *widget;
   GList *children;
-  gint width;
-  gint height;
+  gboolean changed;
+
+  private = gtk_table_get_private (table);
   
   children = table->children;
   while (children)
     {
-      child = children->data;
+      info = children->data;
       children = children->next;
-      
-      if (GTK_WIDGET_VISIBLE (child->widget))
-	{
-	  GtkRequisition child_requisition;
-	  gtk_widget_get_child_requisition (child->widget, &child_requisition);
+      widget = info->child.widget;
 
-	  /* Child spans a single column.
-	   */
-	  if (child->left_attach == (child->right_attach - 1))
+      if (GTK_WIDGET_VISIBLE (widget))
+	{
+	  if (request && GTK_WIDGET_REQUEST_NEEDED (widget))
 	    {
-	      width = child_requisition.width + child->xpadding * 2;
-	      table->cols[child->left_attach].requisition = MAX (table->cols[child->left_attach].requisition, width);
+	      gtk_widget_size_request (widget, NULL);
+	      changed = TRUE;
 	    }
-	  
-	  /* Child spans a single row.
-	   */
-	  if (child->top_attach == (child->bottom_attach - 1))
+	  else
+	    changed = (!info->visible ||
+		       widget->requisition.width != info->requisition.width ||
+		       widget->requisition.height != info->requisition.height);
+
+	  if (changed)
 	    {
-	      height = child_requisition.height + child->ypadding * 2;
-	      table->rows[child->top_attach].requisition = MAX (table->rows[child->top_attach].requisition, height);
+	      GtkRequisition child_requisition;
+
+	      gtk_widget_get_child_requisition (widget, &child_requisition);
+
+	      gtk_table_child_contribute (private, info, FALSE);
+	      info->requisition = widget->requisition;
+	      info->width = child_requisition.width + info->child.xpadding * 2;
+	      info->height = child_requisition.height + info->child.ypadding * 2;
+	      info->visible = TRUE;
+	      info->need_allocate = TRUE;
+	      gtk_table_child_contribute (private, info, TRUE);
 	    }
 	}
+      else if (info->visible)
+	{
+	  gtk_table_child_contribute (private, info, FALSE);
+	  info->visible = FALSE;
+	}
+    }
+}
+
+static void
+gtk_table_line_update (GtkTableLine *line,
+		       gboolean	     vertical)
+{
+  GtkTableChildInfo *info;
+  GList *children;
+
+  line->requisition = 0;
+
+  for (children = line->children; children; children = children->next)
+    {
+      info = children->data;
+
+      if (info->visible)
+	line->requisition = MAX (line->requisition,
+				 vertical ? info->height : info->width);
+    }
+
+  line->dirty = FALSE;
+}
+
+static void
+gtk_table_size_request_init (GtkTable *table)
+{
+  gtk_table_update_children (table, TRUE);
+}
+
+static void
+gtk_table_size_request_pass1 (GtkTable *table)
+{
+  GtkTablePrivate *private;
+  gint row, col;
+
+  private = gtk_table_get_private (table);
+
+  /* The lines hold the maximum requisition of the children spanning
+   * a single row or column, only recompute the invalidated ones.
+   */
+  for (col = 0; col < table->ncols; col++)
+    {
+      if (private->cols[col].dirty)
+	gtk_table_line_update (&private->cols[col], FALSE);
+      table->cols[col].requisition = private->cols[col].requisition;
+    }
+  for (row = 0; row < table->nrows; row++)
+    {
+      if (private->rows[row].dirty)
+	gtk_table_line_update (&private->rows[row], TRUE);
+      table->rows[row].requisition = private->rows[row].requisition;
     }
 }
 
@@ -993,90 +1327,88 @@ gtk_table_size_request_pass2 (GtkTable *table)
 static void
 gtk_table_size_request_pass3 (GtkTable *table)
 {
+  GtkTablePrivate *private;
+  GtkTableChildInfo *info;
   GtkTableChild *child;
   GList *children;
   gint width, height;
   gint row, col;
   gint extra;
   
-  children = table->children;
-  while (children)
+  private = gtk_table_get_private (table);
+
+  /* Children spanning multiple columns.
+   */
+  for (children = private->col_spanning; children; children = children->next)
     {
-      child = children->data;
-      children = children->next;
+      info = children->data;
+      child = &info->child;
       
-      if (GTK_WIDGET_VISIBLE (child->widget))
+      if (!info->visible)
+	continue;
+
+      /* Check and see if there is already enough space
+       *  for the child.
+       */
+      width = 0;
+      for (col = child->left_attach; col < child->right_attach; col++)
 	{
-	  /* Child spans multiple columns.
-	   */
-	  if (child->left_attach != (child->right_attach - 1))
+	  width += table->cols[col].requisition;
+	  if ((col + 1) < child->right_attach)
+	    width += table->cols[col].spacing;
+	}
+      
+      /* If we need to request more space for this child to fill
+       *  its requisition, then divide up the needed space evenly
+       *  amongst the columns it spans.
+       */
+      if (width < info->width)
+	{
+	  width = info->width - width;
+	  
+	  for (col = child->left_attach; col < child->right_attach; col++)
 	    {
-	      GtkRequisition child_requisition;
-
-	      gtk_widget_get_child_requisition (child->widget, &child_requisition);
-	      
-	      /* Check and see if there is already enough space
-	       *  for the child.
-	       */
-	      width = 0;
-	      for (col = child->left_attach; col < child->right_attach; col++)
-		{
-		  width += table->cols[col].requisition;
-		  if ((col + 1) < child->right_attach)
-		    width += table->cols[col].spacing;
-		}
-	      
-	      /* If we need to request more space for this child to fill
-	       *  its requisition, then divide up the needed space evenly
-	       *  amongst the columns it spans.
-	       */
-	      if (width < child_requisition.width + child->xpadding * 2)
-		{
-		  width = child_requisition.width + child->xpadding * 2 - width;
-		  
-		  for (col = child->left_attach; col < child->right_attach; col++)
-		    {
-		      extra = width / (child->right_attach - col);
-		      table->cols[col].requisition += extra;
-		      width -= extra;
-		    }
-		}
+	      extra = width / (child->right_attach - col);
+	      table->cols[col].requisition += extra;
+	      width -= extra;
 	    }
+	}
+    }
+  
+  /* Children spanning multiple rows.
+   */
+  for (children = private->row_spanning; children; children = children->next)
+    {
+      info = children->data;
+      child = &info->child;
+      
+      if (!info->visible)
+	continue;
+
+      /* Check and see if there is already enough space
+       *  for the child.
+       */
+      height = 0;
+      for (row = child->top_attach; row < child->bottom_attach; row++)
+	{
+	  height += table->rows[row].requisition;
+	  if ((row + 1) < child->bottom_attach)
+	    height += table->rows[row].spacing;
+	}
+      
+      /* If we need to request more space for this child to fill
+       *  its requisition, then divide up the needed space evenly
+       *  amongst the rows it spans.
+       */
+      if (height < info->height)
+	{
+	  height = info->height - height;
 	  
-	  /* Child spans multiple rows.
-	   */
-	  if (child->top_attach != (child->bottom_attach - 1))
+	  for (row = child->top_attach; row < child->bottom_attach; row++)
 	    {
-	      GtkRequisition child_requisition;
-
-	      gtk_widget_get_child_requisition (child->widget, &child_requisition);
-
-	      /* Check and see if there is already enough space
-	       *  for the child.
-	       */
-	      height = 0;
-	      for (row = child->top_attach; row < child->bottom_attach; row++)
-		{
-		  height += table->rows[row].requisition;
-		  if ((row + 1) < child->bottom_attach)
-		    height += table->rows[row].spacing;
-		}
-	      
-	      /* If we need to request more space for this child to fill
-	       *  its requisition, then divide up the needed space evenly
-	       *  amongst the columns it spans.
-	       */
-	      if (height < child_requisition.height + child->ypadding * 2)
-		{
-		  height = child_requisition.height + child->ypadding * 2 - height;
-		  
-		  for (row = child->top_attach; row < child->bottom_attach; row++)
-		    {
-		      extra = height / (child->bottom_attach - row);
-		      table->rows[row].requisition += extra;
-		      height -= extra;
-		    }
-		}
+	      extra = height / (child->bottom_attach - row);
+	      table->rows[row].requisition += extra;
+	      height -= extra;
 	    }
 	}
     }
@@ -1085,155 +1417,129 @@ gtk_table_size_request_pass3 (GtkTable *table)
 static void
 gtk_table_size_allocate_init (GtkTable *table)
 {
+  GtkTablePrivate *private;
+  GtkTableChildInfo *info;
   GtkTableChild *child;
   GList *children;
   gint row, col;
   gint has_expand;
   gint has_shrink;
   
+  private = gtk_table_get_private (table);
+
+  /* We usually got requested just before, but catch up with
+   * visibility changes if not.
+   */
+  gtk_table_update_children (table, FALSE);
+
   /* Initialize the rows and cols.
    *  By default, rows and cols do not expand and do shrink.
    *  Those values are modified by the children that occupy
-   *  the rows and cols.
+   *  the rows and cols, for children occupying a single
+   *  row or column they are kept up to date in the lines.
    */
   for (col = 0; col < table->ncols; col++)
     {
       table->cols[col].allocation = table->cols[col].requisition;
       table->cols[col].need_expand = FALSE;
       table->cols[col].need_shrink = TRUE;
-      table->cols[col].expand = FALSE;
-      table->cols[col].shrink = TRUE;
-      table->cols[col].empty = TRUE;
+      table->cols[col].expand = private->cols[col].n_expand > 0;
+      table->cols[col].shrink = private->cols[col].n_noshrink == 0;
+      table->cols[col].empty = private->cols[col].n_visible == 0;
     }
   for (row = 0; row < table->nrows; row++)
     {
       table->rows[row].allocation = table->rows[row].requisition;
       table->rows[row].need_expand = FALSE;
       table->rows[row].need_shrink = TRUE;
-      table->rows[row].expand = FALSE;
-      table->rows[row].shrink = TRUE;
-      table->rows[row].empty = TRUE;
+      table->rows[row].expand = private->rows[row].n_expand > 0;
+      table->rows[row].shrink = private->rows[row].n_noshrink == 0;
+      table->rows[row].empty = private->rows[row].n_visible == 0;
     }
   
-  /* Loop over all the children and adjust the row and col values
-   *  based on whether the children want to be allowed to expand
-   *  or shrink. This loop handles children that occupy a single
-   *  row or column.
+  /* Loop over the children which span multiple rows or columns.
    */
-  children = table->children;
-  while (children)
+  for (children = private->col_spanning; children; children = children->next)
     {
-      child = children->data;
-      children = children->next;
+      info = children->data;
+      child = &info->child;
       
-      if (GTK_WIDGET_VISIBLE (child->widget))
+      if (!info->visible)
+	continue;
+
+      for (col = child->left_attach; col < child->right_attach; col++)
+	table->cols[col].empty = FALSE;
+      
+      if (child->xexpand)
 	{
-	  if (child->left_attach == (child->right_attach - 1))
-	    {
-	      if (child->xexpand)
-		table->cols[child->left_attach].expand = TRUE;
-	      
-	      if (!child->xshrink)
-		table->cols[child->left_attach].shrink = FALSE;
-	      
-	      table->cols[child->left_attach].empty = FALSE;
-	    }
+	  has_expand = FALSE;
+	  for (col = child->left_attach; col < child->right_attach; col++)
+	    if (table->cols[col].expand)
+	      {
+		has_expand = TRUE;
+		break;
+	      }
 	  
-	  if (child->top_attach == (child->bottom_attach - 1))
-	    {
-	      if (child->yexpand)
-		table->rows[child->top_attach].expand = TRUE;
-	      
-	      if (!child->yshrink)
-		table->rows[child->top_attach].shrink = FALSE;
-
-	      table->rows[child->top_attach].empty = FALSE;
-	    }
+	  if (!has_expand)
+	    for (col = child->left_attach; col < child->right_attach; col++)
+	      table->cols[col].need_expand = TRUE;
+	}
+      
+      if (!child->xshrink)
+	{
+	  has_shrink = TRUE;
+	  for (col = child->left_attach; col < child->right_attach; col++)
+	    if (!table->cols[col].shrink)
+	      {
+		has_shrink = FALSE;
+		break;
+	      }
+	  
+	  if (has_shrink)
+	    for (col = child->left_attach; col < child->right_attach; col++)
+	      table->cols[col].need_shrink = FALSE;
 	}
     }
   
-  /* Loop over all the children again and this time handle children
-   *  which span multiple rows or columns.
-   */
-  children = table->children;
-  while (children)
+  for (children = private->row_spanning; children; children = children->next)
     {
-      child = children->data;
-      children = children->next;
+      info = children->data;
+      child = &info->child;
       
-      if (GTK_WIDGET_VISIBLE (child->widget))
+      if (!info->visible)
+	continue;
+
+      for (row = child->top_attach; row < child->bottom_attach; row++)
+	table->rows[row].empty = FALSE;
+      
+      if (child->yexpand)
 	{
-	  if (child->left_attach != (child->right_attach - 1))
-	    {
-	      for (col = child->left_attach; col < child->right_attach; col++)
-		table->cols[col].empty = FALSE;
-
-	      if (child->xexpand)
-		{
-		  has_expand = FALSE;
-		  for (col = child->left_attach; col < child->right_attach; col++)
-		    if (table->cols[col].expand)
-		      {
-			has_expand = TRUE;
-			break;
-		      }
-		  
-		  if (!has_expand)
-		    for (col = child->left_attach; col < child->right_attach; col++)
-		      table->cols[col].need_expand = TRUE;
-		}
-	      
-	      if (!child->xshrink)
-		{
-		  has_shrink = TRUE;
-		  for (col = child->left_attach; col < child->right_attach; col++)
-		    if (!table->cols[col].shrink)
-		      {
-			has_shrink = FALSE;
-			break;
-		      }
-		  
-		  if (has_shrink)
-		    for (col = child->left_attach; col < child->right_attach; col++)
-		      table->cols[col].need_shrink = FALSE;
-		}
-	    }
+	  has_expand = FALSE;
+	  for (row = child->top_attach; row < child->bottom_attach; row++)
+	    if (table->rows[row].expand)
+	      {
+		has_expand = TRUE;
+		break;
+	      }
 	  
-	  if (child->top_attach != (child->bottom_attach - 1))
-	    {
-	      for (row = child->top_attach; row < child->bottom_attach; row++)
-		table->rows[row].empty = FALSE;
-
-	      if (child->yexpand)
-		{
-		  has_expand = FALSE;
-		  for (row = child->top_attach; row < child->bottom_attach; row++)
-		    if (table->rows[row].expand)
-		      {
-			has_expand = TRUE;
-			break;
-		      }
-		  
-		  if (!has_expand)
-		    for (row = child->top_attach; row < child->bottom_attach; row++)
-		      table->rows[row].need_expand = TRUE;
-		}
-	      
-	      if (!child->yshrink)
-		{
-		  has_shrink = TRUE;
-		  for (row = child->top_attach; row < child->bottom_attach; row++)
-		    if (!table->rows[row].shrink)
-		      {
-			has_shrink = FALSE;
-			break;
-		      }
-		  
-		  if (has_shrink)
-		    for (row = child->top_attach; row < child->bottom_attach; row++)
-		      table->rows[row].need_shrink = FALSE;
-		}
-	    }
+	  if (!has_expand)
+	    for (row = child->top_attach; row < child->bottom_attach; row++)
+	      table->rows[row].need_expand = TRUE;
+	}
+      
+      if (!child->yshrink)
+	{
+	  has_shrink = TRUE;
+	  for (row = child->top_attach; row < child->bottom_attach; row++)
+	    if (!table->rows[row].shrink)
+	      {
+		has_shrink = FALSE;
+		break;
+	      }
+	  
+	  if (has_shrink)
+	    for (row = child->top_attach; row < child->bottom_attach; row++)
+	      table->rows[row].need_shrink = FALSE;
 	}
     }
   
@@ -1476,6 +1782,8 @@ gtk_table_size_allocate_pass1 (GtkTable *table)
 static void
 gtk_table_size_allocate_pass2 (GtkTable *table)
 {
+  GtkTablePrivate *private;
+  GtkTableChildInfo *info;
   GtkTableChild *child;
   GList *children;
   gint max_width;
@@ -1484,47 +1792,43 @@ gtk_table_size_allocate_pass2 (GtkTable *table)
   gint row, col;
   GtkAllocation allocation;
   
+  private = gtk_table_get_private (table);
+
+  /* Compute the line offsets once, instead of summing up
+   *  the preceding rows and columns for every child.
+   */
+  x = GTK_WIDGET (table)->allocation.x + GTK_CONTAINER (table)->border_width;
+  for (col = 0; col < table->ncols; col++)
+    {
+      private->cols[col].offset = x;
+      x += table->cols[col].allocation;
+      x += table->cols[col].spacing;
+    }
+  
+  y = GTK_WIDGET (table)->allocation.y + GTK_CONTAINER (table)->border_width;
+  for (row = 0; row < table->nrows; row++)
+    {
+      private->rows[row].offset = y;
+      y += table->rows[row].allocation;
+      y += table->rows[row].spacing;
+    }
+  
   children = table->children;
   while (children)
     {
-      child = children->data;
+      info = children->data;
+      child = &info->child;
       children = children->next;
       
       if (GTK_WIDGET_VISIBLE (child->widget))
 	{
-	  GtkRequisition child_requisition;
-	  gtk_widget_get_child_requisition (child->widget, &child_requisition);
-
-	  x = GTK_WIDGET (table)->allocation.x + GTK_CONTAINER (table)->border_width;
-	  y = GTK_WIDGET (table)->allocation.y + GTK_CONTAINER (table)->border_width;
-	  max_width = 0;
-	  max_height = 0;
-	  
-	  for (col = 0; col < child->left_attach; col++)
-	    {
-	      x += table->cols[col].allocation;
-	      x += table->cols[col].spacing;
-	    }
+	  x = private->cols[child->left_attach].offset;
+	  max_width = (private->cols[child->right_attach - 1].offset +
+		       table->cols[child->right_attach - 1].allocation - x);
 	  
-	  for (col = child->left_attach; col < child->right_attach; col++)
-	    {
-	      max_width += table->cols[col].allocation;
-	      if ((col + 1) < child->right_attach)
-		max_width += table->cols[col].spacing;
-	    }
-	  
-	  for (row = 0; row < child->top_attach; row++)
-	    {
-	      y += table->rows[row].allocation;
-	      y += table->rows[row].spacing;
-	    }
-	  
-	  for (row = child->top_attach; row < child->bottom_attach; row++)
-	    {
-	      max_height += table->rows[row].allocation;
-	      if ((row + 1) < child->bottom_attach)
-		max_height += table->rows[row].spacing;
-	    }
+	  y = private->rows[child->top_attach].offset;
+	  max_height = (private->rows[child->bottom_attach - 1].offset +
+			table->rows[child->bottom_attach - 1].allocation - y);
 	  
 	  if (child->xfill)
 	    {
@@ -1533,7 +1837,7 @@ gtk_table_size_allocate_pass2 (GtkTable *table)
 	    }
 	  else
 	    {
-	      allocation.width = child_requisition.width;
+	      allocation.width = info->width - child->xpadding * 2;
 	      allocation.x = x + (max_width - allocation.width) / 2;
 	    }
 	  
@@ -1544,11 +1848,22 @@ gtk_table_size_allocate_pass2 (GtkTable *table)
 	    }
 	  else
 	    {
-	      allocation.height = child_requisition.height;
+	      allocation.height = info->height - child->ypadding * 2;
 	      allocation.y = y + (max_height - allocation.height) / 2;
 	    }
 	  
-	  gtk_widget_size_allocate (child->widget, &allocation);
+	  /* children which didn't change themselves and keep their
+	   * allocation don't need to be reallocated.
+	   */
+	  if (info->need_allocate ||
+	      allocation.x != child->widget->allocation.x ||
+	      allocation.y != child->widget->allocation.y ||
+	      allocation.width != child->widget->allocation.width ||
+	      allocation.height != child->widget->allocation.height)
+	    {
+	      info->need_allocate = FALSE;
+	      gtk_widget_size_allocate (child->widget, &allocation);
+	    }
 	}
     }
 }
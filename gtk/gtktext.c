@@ -25,7 +25,10 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "gdk/gdkkeysyms.h"
 #include "gdk/gdki18n.h"
 #include "gtkmain.h"
@@ -36,7 +39,9 @@
 #include "line-arrow.xbm"
 
 
-#define INITIAL_BUFFER_SIZE      1024
+#define INITIAL_CHUNK_SIZE       256
+#define MAX_CHUNK_SIZE           2048
+/* The text is kept in chunks of at most this many characters */
 #define INITIAL_LINE_CACHE_SIZE  256
 #define MIN_GAP_SIZE             256
 #define LINE_DELIM               '\n'
@@ -50,6 +55,11 @@
 #define SCROLL_TIME              100
 #define FREEZE_LENGTH            1024        
 /* Freeze text when inserting or deleting more than this many characters */
+#define STREAM_CHUNK_SIZE        4096
+#define STREAM_MAX_PENDING       (64 * 1024)
+/* Stop reading a stream while this much is waiting to be appended */
+#define STREAM_FRAME_TIME        40
+/* Streamed text is appended at most once per this many milliseconds */
 
 #define SET_PROPERTY_MARK(m, p, o)  do {                   \
                                       (m)->property = (p); \
@@ -66,6 +76,8 @@
 #define MARK_OFFSET(mark)           ((mark)->offset)
 #define MARK_PROPERTY_LENGTH(mark)  (MARK_CURRENT_PROPERTY(mark)->length)
 
+#define PROP_TOTAL(node)            ((node) ? ((TextProperty*) (node))->total : 0)
+
 
 #define MARK_CURRENT_FONT(text, mark) \
   ((MARK_CURRENT_PROPERTY(mark)->flags & PROPERTY_FONT) ? \
@@ -84,7 +96,10 @@
          MARK_CURRENT_PROPERTY(mark)->font : \
          text->current_font)
 
-#define TEXT_LENGTH(t)              ((t)->text_end - (t)->gap_size)
+#define TEXT_LENGTH(t)              ((t)->text_end)
+#define TEXT_CHAR_SIZE(t)           ((t)->use_wchar ? sizeof (GdkWChar) : 1)
+#define CHUNK_TOTAL(node)           ((node) ? ((TextChunk*) (node))->total : 0)
+#define CHUNK_CHAR_SIZE(c)          ((c)->wide ? sizeof (GdkWChar) : 1)
 #define FONT_HEIGHT(f)              ((f)->ascent + (f)->descent)
 #define LINE_HEIGHT(l)              ((l).font_ascent + (l).font_descent)
 #define LINE_CONTAINS(l, i)         ((l).start.index <= (i) && (l).end.index >= (i))
@@ -101,14 +116,21 @@ enum {
   ARG_WORD_WRAP
 };
 
+typedef struct _TextTreeNode          TextTreeNode;
 typedef struct _TextProperty          TextProperty;
 typedef struct _TabStopMark           TabStopMark;
 typedef struct _PrevTabCont           PrevTabCont;
 typedef struct _FetchLinesData        FetchLinesData;
 typedef struct _LineParams            LineParams;
-typedef struct _SetVerticalScrollData SetVerticalScrollData;
+typedef struct _TextChunk             TextChunk;
+typedef struct _TextParagraph         TextParagraph;
+typedef struct _ParagraphScanData     ParagraphScanData;
+typedef struct _LineSearchData        LineSearchData;
+typedef struct _GtkTextPrivate        GtkTextPrivate;
+typedef struct _TextSearch            TextSearch;
 
 typedef gint (*LineIteratorFunction) (GtkText* text, LineParams* lp, void* data);
+typedef void (*TextTreeUpdate) (TextTreeNode *node);
 
 typedef enum
 {
@@ -116,11 +138,132 @@ typedef enum
   FetchLinesCount
 } FLType;
 
-struct _SetVerticalScrollData {
+struct _TextSearch {
+  gconstpointer needle;
+  guint length;
+  guint char_size;
+
+  /* Horspool shifts, indexed by the low byte of a character */
+  guint skip[256];
+
+  gint (*find) (const TextSearch *search, gconstpointer haystack, guint n);
+};
+
+struct _LineSearchData {
   gint pixel_height;
-  gint last_didnt_wrap;
-  gint last_line_start;
+  guint end_index;
+  gboolean by_pixel;
+  guint target_index;
+  gint target_pixel;
   GtkPropertyMark mark;
+  gint line_height;
+};
+
+/* The properties and the paragraphs are both kept in treaps in text
+ * order.  Each of them starts with a TextTreeNode, and the
+ * TextTreeUpdate passed along with it recomputes the sums over its
+ * subtree from those of its children.
+ */
+struct _TextTreeNode
+{
+  TextTreeNode *parent;
+  TextTreeNode *left;
+  TextTreeNode *right;
+  guint priority;
+};
+
+/* The text is kept in chunks of at most MAX_CHUNK_SIZE characters,
+ * whose treap sums their lengths.  An edit only moves characters
+ * within the chunks it touches, however far it is from the last one.
+ * Only an empty text has an empty chunk.
+ *
+ * Each chunk has an encoding of its own: while use_wchar is set, in
+ * compact storage only the chunks holding characters outside ASCII
+ * are kept as GdkWChar.
+ */
+struct _TextChunk
+{
+  TextTreeNode node;
+  
+  guint length;
+  guint total;
+  
+  /* Characters allocated */
+  guint size;
+  gboolean wide;
+  union { GdkWChar *wc; guchar *ch; } text;
+};
+
+/* A paragraph is one line of text up to and including its newline;
+ * the last one also covers the end-of-text position.  The paragraph
+ * treap sums characters and pixel heights, so that offsets and scroll
+ * positions map to lines without laying out all the text before them.
+ */
+struct _TextParagraph
+{
+  TextTreeNode node;
+
+  guint chars;
+  guint height;
+
+  guint total_chars;
+  guint total_height;
+
+  /* Non-NULL while height needs to be measured again. */
+  GList *dirty_link;
+};
+
+struct _ParagraphScanData {
+  GtkTextPrivate *private;
+  TextParagraph *last;
+  guint start;
+  guint height;
+};
+
+struct _GtkTextPrivate
+{
+  /* Root of the text chunks, and the chunk last looked up along with
+   * the index it starts at */
+  TextChunk *chunks;
+  TextChunk *chunk_cache;
+  guint      chunk_cache_start;
+  
+  /* Root of the paragraph index, NULL until it is built */
+  TextParagraph *paragraphs;
+  GList *dirty;
+
+  /* Layout the paragraph heights were measured for */
+  gint  layout_width;
+  guint layout_flags;
+
+  /* Nonzero while line_start_cache must not be rebuilt under
+   * someone walking it */
+  gint  cache_locked;
+
+  /* Number of newlines in the text */
+  guint newlines;
+
+  /* Streamed text: read from stream_fd, or asked of stream_func,
+   * into pending and appended once per frame by stream_timeout */
+  gint              stream_fd;
+  guint             stream_input;
+  GtkTextStreamFunc stream_func;
+  gpointer          stream_data;
+  GtkDestroyNotify  stream_destroy;
+  guint             stream_timeout;
+  gboolean          stream_eof;
+  gchar            *pending;
+  guint             pending_len;
+  guint             pending_size;
+
+  /* Streaming trims lines off the top past this, unless it is 0 */
+  guint max_lines;
+
+  /* Number of characters outside ASCII.  While it is 0 the text is
+   * handled one byte a character even with a fontset, unless compact
+   * storage has been turned off. */
+  guint    wide_chars;
+  gboolean compact;
 };
 
 struct _GtkTextFont
@@ -140,6 +283,14 @@ typedef enum {
 
 struct _TextProperty
 {
+  /* The properties also form a treap, so that the property containing
+   * a given index can be found without walking the whole list.  total
+   * is the length of the subtree rooted here.
+   */
+  TextTreeNode node;
+  GList *link;
+  guint total;
+
   /* Font. */
   GtkTextFont* font;
 
@@ -256,8 +407,22 @@ static gint  gtk_text_focus_in          (GtkWidget         *widget,
 static gint  gtk_text_focus_out         (GtkWidget         *widget,
 				         GdkEventFocus     *event);
 
-static void move_gap (GtkText* text, guint index);
-static void make_forward_space (GtkText* text, guint len);
+static TextChunk *chunk_new (GtkText *text, guint size);
+static TextChunk *text_chunk_find (GtkText *text, guint index, guint *start);
+static void text_chunk_insert (GtkText *text, guint index,
+			       gconstpointer chars, guint n);
+static void text_chunk_delete (GtkText *text, guint index, guint n);
+static void text_chunk_copy (GtkText *text, guint index, guint n,
+			     gpointer dest);
+static gpointer text_chunk_fetch (GtkText *text, guint index, guint n);
+static guint count_wide_chars (GtkText* text, guint index, guint nchars);
+static void text_chunks_fit (GtkText *text);
+static void widen_text (GtkText* text);
+static void narrow_text (GtkText* text);
+
+/* Treaps */
+static TextTreeNode *text_tree_next (TextTreeNode *node);
+static TextTreeNode *text_tree_prev (TextTreeNode *node);
 
 /* Property management */
 static GtkTextFont* get_text_font (GdkFont* gfont);
@@ -268,6 +433,9 @@ static void insert_text_property (GtkText* text, GdkFont* font,
 static TextProperty* new_text_property (GtkText *text, GdkFont* font, 
 					GdkColor* fore, GdkColor* back, guint length);
 static void destroy_text_property (TextProperty *prop);
+static void prop_tree_insert         (GList *link);
+static void prop_tree_remove         (TextProperty *prop);
+static void prop_tree_length_changed (TextProperty *prop);
 static void init_properties      (GtkText *text);
 static void realize_property     (GtkText *text, TextProperty *prop);
 static void realize_properties   (GtkText *text);
@@ -301,6 +469,7 @@ static LineParams find_line_params (GtkText* text,
 				    const PrevTabCont *tab_cont,
 				    PrevTabCont *next_cont);
 static void recompute_geometry (GtkText* text);
+static void fill_line_cache (GtkText* text, const GtkPropertyMark *start_mark);
 static void insert_expose (GtkText* text, guint old_pixels, gint nchars, guint new_line_count);
 static void delete_expose (GtkText* text,
 			   guint nchars,
@@ -308,6 +477,7 @@ static void delete_expose (GtkText* text,
 			   guint old_pixels);
 static GdkGC *create_bg_gc (GtkText *text);
 static void clear_area (GtkText *text, GdkRectangle *area);
+static void expand_scratch_buffer (GtkText* text, guint len);
 static void draw_line (GtkText* text,
 		       gint pixel_height,
 		       LineParams* lp);
@@ -332,13 +502,33 @@ static void adjust_adj  (GtkText* text, GtkAdjustment* adj);
 static void scroll_up   (GtkText* text, gint diff);
 static void scroll_down (GtkText* text, gint diff);
 static void scroll_int  (GtkText* text, gint diff);
+static void scroll_jump (GtkText* text, gint diff);
 
 static void process_exposes (GtkText *text);
 
+/* Streaming. */
+static void stream_detach (GtkText *text);
+
 /* Cache Management. */
 static void   free_cache        (GtkText* text);
 static GList* remove_cache_line (GtkText* text, GList* list);
 
+/* Paragraph Index. */
+static GtkTextPrivate *gtk_text_get_private (GtkText *text);
+static void gtk_text_private_destroy (GtkTextPrivate *private);
+static void text_lines_invalidate (GtkText *text);
+static void text_lines_update     (GtkText *text);
+static void text_lines_insert     (GtkText *text, guint index, guint nchars);
+static void text_lines_delete     (GtkText *text, guint index, guint nchars);
+static TextParagraph *paragraph_find_index (GtkTextPrivate *private,
+					    guint index,
+					    guint *start,
+					    gint *top);
+static GtkPropertyMark find_line_at_index (GtkText *text, guint index,
+					   gint *top, gint *line_height);
+static GtkPropertyMark find_line_at_pixel (GtkText *text, gint pixel,
+					   gint *top);
+
 /* Key Motion. */
 static void move_cursor_buffer_ver (GtkText *text, int dir);
 static void move_cursor_page_ver (GtkText *text, int dir);
@@ -437,6 +627,10 @@ static void gtk_text_show_props (GtkText* test,
 /* Memory Management. */
 static GMemChunk  *params_mem_chunk    = NULL;
 static GMemChunk  *text_property_chunk = NULL;
+static GMemChunk  *paragraph_chunk     = NULL;
+
+static const gchar *private_key = "gtk-text-private";
+static guint        private_key_id = 0;
 
 static GtkWidgetClass *parent_class = NULL;
 
@@ -543,6 +737,8 @@ gtk_text_class_init (GtkTextClass *class)
   editable_class = (GtkEditableClass*) class;
   parent_class = gtk_type_class (GTK_TYPE_EDITABLE);
 
+  private_key_id = g_quark_from_static_string (private_key);
+
   gtk_object_add_arg_type ("GtkText::hadjustment",
 			   GTK_TYPE_ADJUSTMENT,
 			   GTK_ARG_READWRITE | GTK_ARG_CONSTRUCT,
@@ -675,6 +871,14 @@ gtk_text_get_arg (GtkObject        *object,
 static void
 gtk_text_init (GtkText *text)
 {
+  GtkTextPrivate *private;
+
+  private = g_new0 (GtkTextPrivate, 1);
+  private->stream_fd = -1;
+  private->compact = TRUE;
+  gtk_object_set_data_by_id_full (GTK_OBJECT (text), private_key_id, private,
+				  (GtkDestroyNotify) gtk_text_private_destroy);
+
   GTK_WIDGET_SET_FLAGS (text, GTK_CAN_FOCUS);
 
   text->text_area = NULL;
@@ -686,8 +890,9 @@ gtk_text_init (GtkText *text)
   text->line_arrow_bitmap = NULL;
   
   text->use_wchar = FALSE;
-  text->text.ch = g_new (guchar, INITIAL_BUFFER_SIZE);
-  text->text_len = INITIAL_BUFFER_SIZE;
+  text->text.ch = NULL;
+  text->text_len = 0;
+  private->chunks = chunk_new (text, INITIAL_CHUNK_SIZE);
  
   text->scratch_buffer.ch = NULL;
   text->scratch_buffer_len = 0;
@@ -916,10 +1121,20 @@ gtk_text_thaw (GtkText *text)
   g_return_if_fail (GTK_IS_TEXT (text));
   
   if (text->freeze_count)
-    if (!(--text->freeze_count) && GTK_WIDGET_REALIZED (text))
+    if (!(--text->freeze_count))
       {
-	recompute_geometry (text);
-	gtk_widget_queue_draw (GTK_WIDGET (text));
+	GtkTextPrivate *private = gtk_text_get_private (text);
+	
+	/* Only narrowed here, so that typing and deleting a single
+	 * wide character doesn't go over all the chunks each time. */
+	if (text->use_wchar && private->compact && private->wide_chars == 0)
+	  narrow_text (text);
+	
+	if (GTK_WIDGET_REALIZED (text))
+	  {
+	    recompute_geometry (text);
+	    gtk_widget_queue_draw (GTK_WIDGET (text));
+	  }
       }
   draw_cursor (text, FALSE);
 }
@@ -933,6 +1148,7 @@ gtk_text_insert (GtkText    *text,
 		 gint        nchars)
 {
   GtkEditable *editable = GTK_EDITABLE (text);
+  GtkTextPrivate *private;
   gboolean frozen = FALSE;
   
   gint new_line_count = 1;
@@ -940,6 +1156,7 @@ gtk_text_insert (GtkText    *text,
   guint length;
   guint i;
   gint numwcs;
+  union { GdkWChar *wc; const guchar *ch; } buffer;
   
   g_return_if_fail (text != NULL);
   g_return_if_fail (GTK_IS_TEXT (text));
@@ -952,6 +1169,7 @@ gtk_text_insert (GtkText    *text,
       nchars = strlen (chars);
     }
   length = nchars;
+  private = gtk_text_get_private (text);
   
   if (!text->freeze_count && (length > FREEZE_LENGTH))
     {
@@ -965,27 +1183,33 @@ gtk_text_insert (GtkText    *text,
       old_height = total_line_height (text, text->current_line, 1);
     }
   
-  if ((TEXT_LENGTH (text) == 0) && (text->use_wchar == FALSE))
+  /* With a fontset the text is handled as GdkWChar, but in compact
+   * storage only from the first character outside ASCII on, and even
+   * then only the chunks holding such characters are kept that wide.
+   * Text that is already there can be widened only if it is all
+   * ASCII. */
+  if (!text->use_wchar && private->wide_chars == 0)
     {
       GtkWidget *widget;
       widget = GTK_WIDGET (text);
       gtk_widget_ensure_style (widget);
       if ((widget->style) && (widget->style->font->type == GDK_FONT_FONTSET))
  	{
- 	  text->use_wchar = TRUE;
- 	  g_free (text->text.ch);
- 	  text->text.wc = g_new (GdkWChar, INITIAL_BUFFER_SIZE);
- 	  text->text_len = INITIAL_BUFFER_SIZE;
- 	  if (text->scratch_buffer.ch)
- 	    g_free (text->scratch_buffer.ch);
- 	  text->scratch_buffer.wc = NULL;
- 	  text->scratch_buffer_len = 0;
+	  gboolean ascii = TRUE;
+	  
+	  if (private->compact)
+	    for (i = 0; i < length; i++)
+	      if ((guchar) chars[i] > 0x7f)
+		{
+		  ascii = FALSE;
+		  break;
+		}
+	  
+	  if (!private->compact || !ascii)
+	    widen_text (text);
  	}
     }
  
-  move_gap (text, text->point.index);
-  make_forward_space (text, length);
- 
   if (text->use_wchar)
     {
       char *chars_nt = (char *)chars;
@@ -995,8 +1219,8 @@ gtk_text_insert (GtkText    *text,
 	  memcpy (chars_nt, chars, length);
 	  chars_nt[length] = 0;
 	}
-      numwcs = gdk_mbstowcs (text->text.wc + text->gap_position, chars_nt,
- 			     length);
+      buffer.wc = g_new (GdkWChar, length);
+      numwcs = gdk_mbstowcs (buffer.wc, chars_nt, length);
       if (chars_nt != chars)
 	g_free(chars_nt);
       if (numwcs < 0)
@@ -1005,7 +1229,7 @@ gtk_text_insert (GtkText    *text,
   else
     {
       numwcs = length;
-      memcpy(text->text.ch + text->gap_position, chars, length);
+      buffer.ch = (const guchar*) chars;
     }
  
   if (!text->freeze_count && (text->line_start_cache != NULL))
@@ -1013,13 +1237,13 @@ gtk_text_insert (GtkText    *text,
       if (text->use_wchar)
  	{
  	  for (i=0; i<numwcs; i++)
- 	    if (text->text.wc[text->gap_position + i] == '\n')
+ 	    if (buffer.wc[i] == '\n')
  	      new_line_count++;
 	}
       else
  	{
  	  for (i=0; i<numwcs; i++)
- 	    if (text->text.ch[text->gap_position + i] == '\n')
+ 	    if (buffer.ch[i] == '\n')
  	      new_line_count++;
  	}
     }
@@ -1028,8 +1252,10 @@ gtk_text_insert (GtkText    *text,
     {
       insert_text_property (text, font, fore, back, numwcs);
    
-      text->gap_size -= numwcs;
-      text->gap_position += numwcs;
+      text_chunk_insert (text, text->point.index, buffer.ch, numwcs);
+
+      text_lines_insert (text, text->point.index, numwcs);
+      private->wide_chars += count_wide_chars (text, text->point.index, numwcs);
    
       if (text->point.index < text->first_line_start_index)
  	text->first_line_start_index += numwcs;
@@ -1047,6 +1273,9 @@ gtk_text_insert (GtkText    *text,
 	insert_expose (text, old_height, numwcs, new_line_count);
     }
 
+  if (text->use_wchar)
+    g_free (buffer.wc);
+
   if (frozen)
     gtk_text_thaw (text);
 }
@@ -1072,6 +1301,7 @@ gtk_text_forward_delete (GtkText *text,
 {
   guint old_lines, old_height;
   GtkEditable *editable = GTK_EDITABLE (text);
+  GtkTextPrivate *private;
   gboolean frozen = FALSE;
   
   g_return_val_if_fail (text != NULL, 0);
@@ -1080,6 +1310,8 @@ gtk_text_forward_delete (GtkText *text,
   if (text->point.index + nchars > TEXT_LENGTH (text) || nchars <= 0)
     return FALSE;
   
+  private = gtk_text_get_private (text);
+  
   if (!text->freeze_count && nchars > FREEZE_LENGTH)
     {
       gtk_text_freeze (text);
@@ -1123,9 +1355,10 @@ gtk_text_forward_delete (GtkText *text,
     move_mark_n (&text->cursor_mark, 
 		 -MIN(nchars, text->cursor_mark.index - text->point.index));
   
-  move_gap (text, text->point.index);
+  text_lines_delete (text, text->point.index, nchars);
+  private->wide_chars -= count_wide_chars (text, text->point.index, nchars);
   
-  text->gap_size += nchars;
+  text_chunk_delete (text, text->point.index, nchars);
   
   delete_text_property (text, nchars);
   
@@ -1142,2062 +1375,3470 @@ gtk_text_forward_delete (GtkText *text,
 }
 
 static void
-gtk_text_set_position (GtkEditable *editable,
-		       gint position)
+stream_pending_reserve (GtkTextPrivate *private, guint len)
 {
-  GtkText *text = (GtkText *) editable;
-  
-  undraw_cursor (text, FALSE);
-  text->cursor_mark = find_mark (text, position);
-  find_cursor (text, TRUE);
-  draw_cursor (text, FALSE);
-  gtk_editable_select_region (editable, 0, 0);
+  if (private->pending_len + len > private->pending_size)
+    {
+      while (private->pending_len + len > private->pending_size)
+	private->pending_size = MAX (2 * private->pending_size, STREAM_CHUNK_SIZE);
+      
+      private->pending = g_realloc (private->pending, private->pending_size);
+    }
 }
 
-static gchar *    
-gtk_text_get_chars (GtkEditable   *editable,
-		    gint           start_pos,
-		    gint           end_pos)
+/* The number of characters to take off the start of the text to
+ * get it down to max_lines lines. */
+static guint
+stream_trim_length (GtkText *text)
 {
-  GtkText *text;
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  guint length = TEXT_LENGTH (text);
+  guint lines = private->newlines;
+  guint i;
+  
+  if (length > 0 && GTK_TEXT_INDEX (text, length - 1) != LINE_DELIM)
+    lines += 1;
+  
+  if (!private->max_lines || lines <= private->max_lines)
+    return 0;
+  
+  lines -= private->max_lines;
+  
+  for (i = 0; lines > 0; i++)
+    if (GTK_TEXT_INDEX (text, i) == LINE_DELIM)
+      lines -= 1;
+  
+  return i;
+}
 
-  gchar *retval;
+/* Take lines off the start of the text to get it down to max_lines.
+ * Chunks that go entirely are dropped without touching the rest of the
+ * text, and the point stays on the same character if that is left.
+ */
+static void
+stream_trim (GtkText *text)
+{
+  guint trim = stream_trim_length (text);
+  guint point;
   
-  g_return_val_if_fail (editable != NULL, NULL);
-  g_return_val_if_fail (GTK_IS_TEXT (editable), NULL);
-  text = GTK_TEXT (editable);
+  if (trim == 0)
+    return;
   
-  if (end_pos < 0)
-    end_pos = TEXT_LENGTH (text);
+  gtk_text_freeze (text);
   
-  if ((start_pos < 0) || 
-      (end_pos > TEXT_LENGTH (text)) || 
-      (end_pos < start_pos))
-    return NULL;
+  point = text->point.index;
+  text->point = find_mark (text, 0);
+  gtk_text_forward_delete (text, trim);
+  text->point = find_mark (text, point > trim ? point - trim : 0);
   
-  move_gap (text, TEXT_LENGTH (text));
-  make_forward_space (text, 1);
+  gtk_text_thaw (text);
+}
 
-  if (text->use_wchar)
-    {
-      GdkWChar ch;
-      ch = text->text.wc[end_pos];
-      text->text.wc[end_pos] = 0;
-      retval = gdk_wcstombs (text->text.wc + start_pos);
-      text->text.wc[end_pos] = ch;
-    }
-  else
+/* The length of the longest start of the len bytes at str that doesn't
+ * end in the middle of a multibyte character.  Invalid bytes count as
+ * characters of their own unless they might be cut off at the end. */
+static guint
+stream_whole_chars (const gchar *str,
+		    guint        len)
+{
+  guint i = 0;
+  gint n;
+  
+  mblen (NULL, 0);
+  
+  while (i < len)
     {
-      guchar ch;
-      ch = text->text.ch[end_pos];
-      text->text.ch[end_pos] = 0;
-      retval = g_strdup (text->text.ch + start_pos);
-      text->text.ch[end_pos] = ch;
+      n = mblen (str + i, len - i);
+      if (n < 0 && len - i < MB_CUR_MAX)
+	break;
+      i += MAX (n, 1);
     }
-
-  return retval;
+  
+  return i;
 }
 
-
-static void
-gtk_text_destroy (GtkObject *object)
+/* Append what is pending to the text, trimming it to max_lines, and
+ * keep the view at the bottom if it was there.  Returns whether
+ * anything was appended.
+ */
+static gboolean
+stream_flush (GtkText *text)
 {
-  GtkText *text;
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  GtkWidget *widget = GTK_WIDGET (text);
+  gboolean at_end = FALSE;
+  guint length;
+  guint point;
   
-  g_return_if_fail (object != NULL);
-  g_return_if_fail (GTK_IS_TEXT (object));
+  length = private->pending_len;
   
-  text = (GtkText*) object;
-
-  gtk_signal_disconnect_by_data (GTK_OBJECT (text->hadj), text);
-  gtk_signal_disconnect_by_data (GTK_OBJECT (text->vadj), text);
-
-  if (text->timer)
+  /* A chunk can end in the middle of a multibyte character, so only
+   * hand over whole lines if they will go through gdk_mbstowcs(). */
+  if (!private->stream_eof &&
+      (text->use_wchar ||
+       (widget->style && widget->style->font->type == GDK_FONT_FONTSET)))
     {
-      gtk_timeout_remove (text->timer);
-      text->timer = 0;
+      while (length > 0 && private->pending[length - 1] != LINE_DELIM)
+	length -= 1;
+      
+      /* Nothing more is read while the buffer is full, so a line that
+       * doesn't fit has to be split. */
+      if (length == 0 && private->pending_len >= STREAM_MAX_PENDING)
+	length = stream_whole_chars (private->pending, private->pending_len);
     }
   
-  GTK_OBJECT_CLASS(parent_class)->destroy (object);
+  if (length == 0)
+    return FALSE;
+  
+  if (text->line_start_cache && !text->freeze_count)
+    at_end = (text->vadj->value + 1 >=
+	      text->vadj->upper - text->vadj->page_size);
+  
+  gtk_text_freeze (text);
+  
+  point = text->point.index;
+  gtk_text_set_point (text, TEXT_LENGTH (text));
+  gtk_text_insert (text, NULL, NULL, NULL, private->pending, length);
+  
+  private->pending_len -= length;
+  g_memmove (private->pending, private->pending + length, private->pending_len);
+  
+  gtk_text_set_point (text, point);
+  stream_trim (text);
+  gtk_text_thaw (text);
+  
+  if (at_end && !text->freeze_count)
+    gtk_adjustment_set_value (text->vadj,
+			      text->vadj->upper - text->vadj->page_size);
+  
+  return TRUE;
 }
 
 static void
-gtk_text_finalize (GtkObject *object)
+stream_input (gpointer          data,
+	      gint              source,
+	      GdkInputCondition condition);
+
+static gint
+stream_timeout (gpointer data)
 {
   GtkText *text;
-  GList *tmp_list;
-  
-  g_return_if_fail (object != NULL);
-  g_return_if_fail (GTK_IS_TEXT (object));
+  GtkTextPrivate *private;
+  gboolean flushed;
+  gint n;
   
-  text = (GtkText *)object;
+  GDK_THREADS_ENTER ();
   
-  gtk_object_unref (GTK_OBJECT (text->hadj));
-  gtk_object_unref (GTK_OBJECT (text->vadj));
-
-  /* Clean up the internal structures */
-  if (text->use_wchar)
-    g_free (text->text.wc);
-  else
-    g_free (text->text.ch);
+  text = GTK_TEXT (data);
+  private = gtk_text_get_private (text);
   
-  tmp_list = text->text_properties;
-  while (tmp_list)
+  /* Ask the producer for at most a frame's worth of text */
+  while (private->stream_func && !private->stream_eof &&
+	 private->pending_len < STREAM_MAX_PENDING)
     {
-      destroy_text_property (tmp_list->data);
-      tmp_list = tmp_list->next;
+      stream_pending_reserve (private, STREAM_CHUNK_SIZE);
+      
+      n = (* private->stream_func) (text,
+				    private->pending + private->pending_len,
+				    STREAM_CHUNK_SIZE,
+				    private->stream_data);
+      
+      if (n < 0)
+	private->stream_eof = TRUE;
+      else if (n == 0)
+	break;
+      else
+	private->pending_len += MIN (n, STREAM_CHUNK_SIZE);
     }
-
-  if (text->current_font)
-    text_font_unref (text->current_font);
   
-  g_list_free (text->text_properties);
+  flushed = stream_flush (text);
   
-  if (text->use_wchar)
+  if (private->stream_eof && private->pending_len == 0)
     {
-      if (text->scratch_buffer.wc)
-	g_free (text->scratch_buffer.wc);
+      private->stream_timeout = 0;
+      stream_detach (text);
+      
+      GDK_THREADS_LEAVE ();
+      
+      return FALSE;
     }
-  else
+  
+  if (private->stream_fd >= 0 && !private->stream_eof)
     {
-      if (text->scratch_buffer.ch)
-	g_free (text->scratch_buffer.ch);
+      /* Start reading again once most of what we stopped reading for
+       * has gone into the text */
+      if (!private->stream_input &&
+	  private->pending_len < STREAM_MAX_PENDING / 2)
+	private->stream_input = gtk_input_add_full (private->stream_fd,
+						     GDK_INPUT_READ,
+						     stream_input,
+						     NULL, text, NULL);
+      
+      /* Nothing left to do until more input arrives */
+      if (!flushed && private->stream_input)
+	{
+	  private->stream_timeout = 0;
+	  
+	  GDK_THREADS_LEAVE ();
+	  
+	  return FALSE;
+	}
     }
   
-  g_list_free (text->tab_stops);
+  GDK_THREADS_LEAVE ();
   
-  GTK_OBJECT_CLASS(parent_class)->finalize (object);
+  return TRUE;
 }
 
 static void
-gtk_text_realize (GtkWidget *widget)
+stream_input (gpointer          data,
+	      gint              source,
+	      GdkInputCondition condition)
 {
   GtkText *text;
-  GtkEditable *editable;
-  GdkWindowAttr attributes;
-  gint attributes_mask;
+  GtkTextPrivate *private;
+  gint n;
   
-  g_return_if_fail (widget != NULL);
-  g_return_if_fail (GTK_IS_TEXT (widget));
+  GDK_THREADS_ENTER ();
   
-  text = GTK_TEXT (widget);
-  editable = GTK_EDITABLE (widget);
-  GTK_WIDGET_SET_FLAGS (text, GTK_REALIZED);
+  text = GTK_TEXT (data);
+  private = gtk_text_get_private (text);
   
-  attributes.window_type = GDK_WINDOW_CHILD;
-  attributes.x = widget->allocation.x;
-  attributes.y = widget->allocation.y;
-  attributes.width = widget->allocation.width;
-  attributes.height = widget->allocation.height;
-  attributes.wclass = GDK_INPUT_OUTPUT;
-  attributes.visual = gtk_widget_get_visual (widget);
-  attributes.colormap = gtk_widget_get_colormap (widget);
-  attributes.event_mask = gtk_widget_get_events (widget);
-  attributes.event_mask |= (GDK_EXPOSURE_MASK |
-			    GDK_BUTTON_PRESS_MASK |
-			    GDK_BUTTON_RELEASE_MASK |
-			    GDK_BUTTON_MOTION_MASK |
-			    GDK_ENTER_NOTIFY_MASK |
-			    GDK_LEAVE_NOTIFY_MASK |
-			    GDK_KEY_PRESS_MASK);
-  attributes_mask = GDK_WA_X | GDK_WA_Y | GDK_WA_VISUAL | GDK_WA_COLORMAP;
+  stream_pending_reserve (private, STREAM_CHUNK_SIZE);
+  n = read (source, private->pending + private->pending_len, STREAM_CHUNK_SIZE);
   
-  widget->window = gdk_window_new (gtk_widget_get_parent_window (widget), &attributes, attributes_mask);
-  gdk_window_set_user_data (widget->window, text);
+  if (n > 0)
+    private->pending_len += n;
+  else if (n == 0 || (errno != EINTR && errno != EAGAIN))
+    private->stream_eof = TRUE;
   
-  attributes.x = (widget->style->klass->xthickness + TEXT_BORDER_ROOM);
-  attributes.y = (widget->style->klass->ythickness + TEXT_BORDER_ROOM);
-  attributes.width = MAX (1, (gint)widget->allocation.width - (gint)attributes.x * 2);
-  attributes.height = MAX (1, (gint)widget->allocation.height - (gint)attributes.y * 2);
+  /* Leave the rest in the pipe until we have caught up */
+  if (private->stream_eof || private->pending_len >= STREAM_MAX_PENDING)
+    {
+      gtk_input_remove (private->stream_input);
+      private->stream_input = 0;
+    }
+  
+  if (!private->stream_timeout)
+    private->stream_timeout = gtk_timeout_add (STREAM_FRAME_TIME,
+					       stream_timeout, text);
+  
+  GDK_THREADS_LEAVE ();
+}
 
-  attributes.cursor = gdk_cursor_new (GDK_XTERM);
-  attributes_mask |= GDK_WA_CURSOR;
+/* Stop streaming without appending what is pending. */
+static void
+stream_detach (GtkText *text)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  GtkDestroyNotify destroy = private->stream_destroy;
+  gpointer data = private->stream_data;
   
-  text->text_area = gdk_window_new (widget->window, &attributes, attributes_mask);
-  gdk_window_set_user_data (text->text_area, text);
+  if (private->stream_input)
+    gtk_input_remove (private->stream_input);
+  if (private->stream_timeout)
+    gtk_timeout_remove (private->stream_timeout);
+  
+  private->stream_fd = -1;
+  private->stream_input = 0;
+  private->stream_func = NULL;
+  private->stream_data = NULL;
+  private->stream_destroy = NULL;
+  private->stream_timeout = 0;
+  private->stream_eof = FALSE;
+  private->pending_len = 0;
+  
+  if (destroy)
+    destroy (data);
+}
 
-  gdk_cursor_destroy (attributes.cursor); /* The X server will keep it around as long as necessary */
+void
+gtk_text_stream_fd (GtkText         *text,
+		    gint             fd,
+		    gpointer         data,
+		    GtkDestroyNotify destroy)
+{
+  GtkTextPrivate *private;
   
-  widget->style = gtk_style_attach (widget->style, widget->window);
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (GTK_IS_TEXT (text));
+  g_return_if_fail (fd >= 0);
   
-  /* Can't call gtk_style_set_background here because it's handled specially */
-  gdk_window_set_background (widget->window, &widget->style->base[GTK_WIDGET_STATE (widget)]);
-  gdk_window_set_background (text->text_area, &widget->style->base[GTK_WIDGET_STATE (widget)]);
+  gtk_text_stream_stop (text);
+  
+  private = gtk_text_get_private (text);
+  private->stream_fd = fd;
+  private->stream_data = data;
+  private->stream_destroy = destroy;
+  private->stream_input = gtk_input_add_full (fd, GDK_INPUT_READ,
+					      stream_input,
+					      NULL, text, NULL);
+}
 
-  if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
-    text->bg_gc = create_bg_gc (text);
+void
+gtk_text_stream_func (GtkText          *text,
+		      GtkTextStreamFunc func,
+		      gpointer          data,
+		      GtkDestroyNotify  destroy)
+{
+  GtkTextPrivate *private;
   
-  text->line_wrap_bitmap = gdk_bitmap_create_from_data (text->text_area,
-							(gchar*) line_wrap_bits,
-							line_wrap_width,
-							line_wrap_height);
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (GTK_IS_TEXT (text));
+  g_return_if_fail (func != NULL);
   
-  text->line_arrow_bitmap = gdk_bitmap_create_from_data (text->text_area,
-							 (gchar*) line_arrow_bits,
-							 line_arrow_width,
-							 line_arrow_height);
+  gtk_text_stream_stop (text);
   
-  text->gc = gdk_gc_new (text->text_area);
-  gdk_gc_set_exposures (text->gc, TRUE);
-  gdk_gc_set_foreground (text->gc, &widget->style->text[GTK_STATE_NORMAL]);
+  private = gtk_text_get_private (text);
+  private->stream_func = func;
+  private->stream_data = data;
+  private->stream_destroy = destroy;
+  private->stream_timeout = gtk_timeout_add (STREAM_FRAME_TIME,
+					     stream_timeout, text);
+}
+
+void
+gtk_text_stream_stop (GtkText *text)
+{
+  GtkTextPrivate *private;
   
-#ifdef USE_XIM
-  if (gdk_im_ready () && (editable->ic_attr = gdk_ic_attr_new ()) != NULL)
-    {
-      gint width, height;
-      GdkColormap *colormap;
-      GdkEventMask mask;
-      GdkICAttr *attr = editable->ic_attr;
-      GdkICAttributesType attrmask = GDK_IC_ALL_REQ;
-      GdkIMStyle style;
-      GdkIMStyle supported_style = GDK_IM_PREEDIT_NONE | 
-	                           GDK_IM_PREEDIT_NOTHING |
-	                           GDK_IM_PREEDIT_POSITION |
-	                           GDK_IM_STATUS_NONE |
-	                           GDK_IM_STATUS_NOTHING;
-      
-      if (widget->style && widget->style->font->type != GDK_FONT_FONTSET)
-	supported_style &= ~GDK_IM_PREEDIT_POSITION;
-      
-      attr->style = style = gdk_im_decide_style (supported_style);
-      attr->client_window = text->text_area;
-
-      if ((colormap = gtk_widget_get_colormap (widget)) !=
-	  gtk_widget_get_default_colormap ())
-	{
-	  attrmask |= GDK_IC_PREEDIT_COLORMAP;
-	  attr->preedit_colormap = colormap;
-	}
-
-      switch (style & GDK_IM_PREEDIT_MASK)
-	{
-	case GDK_IM_PREEDIT_POSITION:
-	  if (widget->style && widget->style->font->type != GDK_FONT_FONTSET)
-	    {
-	      g_warning ("over-the-spot style requires fontset");
-	      break;
-	    }
-
-	  attrmask |= GDK_IC_PREEDIT_POSITION_REQ;
-	  gdk_window_get_size (text->text_area, &width, &height);
-	  attr->spot_location.x = 0;
-	  attr->spot_location.y = height;
-	  attr->preedit_area.x = 0;
-	  attr->preedit_area.y = 0;
-	  attr->preedit_area.width = width;
-	  attr->preedit_area.height = height;
-	  attr->preedit_fontset = widget->style->font;
-	  
-	  break;
-	}
-      editable->ic = gdk_ic_new (attr, attrmask);
-      
-      if (editable->ic == NULL)
-	g_warning ("Can't create input context.");
-      else
-	{
-	  mask = gdk_window_get_events (text->text_area);
-	  mask |= gdk_ic_get_events (editable->ic);
-	  gdk_window_set_events (text->text_area, mask);
-	  
-	  if (GTK_WIDGET_HAS_FOCUS (widget))
-	    gdk_im_begin (editable->ic, text->text_area);
-	}
-    }
-#endif
-
-  realize_properties (text);
-  gdk_window_show (text->text_area);
-  init_properties (text);
-
-  if (editable->selection_start_pos != editable->selection_end_pos)
-    gtk_editable_claim_selection (editable, TRUE, GDK_CURRENT_TIME);
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (GTK_IS_TEXT (text));
   
-  recompute_geometry (text);
+  private = gtk_text_get_private (text);
+  
+  /* Whatever was already read still goes in */
+  private->stream_eof = TRUE;
+  stream_flush (text);
+  
+  stream_detach (text);
 }
 
-static void 
-gtk_text_style_set (GtkWidget *widget,
-		    GtkStyle  *previous_style)
+void
+gtk_text_set_max_lines (GtkText *text,
+			guint    max_lines)
 {
-  GtkText *text = GTK_TEXT (widget);
-
-  if (GTK_WIDGET_REALIZED (widget))
-    {
-      gdk_window_set_background (widget->window, &widget->style->base[GTK_WIDGET_STATE (widget)]);
-      gdk_window_set_background (text->text_area, &widget->style->base[GTK_WIDGET_STATE (widget)]);
-      
-      if (text->bg_gc)
-	{
-	  gdk_gc_destroy (text->bg_gc);
-	  text->bg_gc = NULL;
-	}
-
-      if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
-	text->bg_gc = create_bg_gc (text);
-
-      recompute_geometry (text);
-    }
-
-  if (text->current_font)
-    text_font_unref (text->current_font);
-  text->current_font = get_text_font (widget->style->font);
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (GTK_IS_TEXT (text));
+  
+  gtk_text_get_private (text)->max_lines = max_lines;
+  
+  stream_trim (text);
 }
 
-static void
-gtk_text_state_changed (GtkWidget   *widget,
-			GtkStateType previous_state)
+guint
+gtk_text_get_max_lines (GtkText *text)
 {
-  GtkText *text = GTK_TEXT (widget);
+  g_return_val_if_fail (text != NULL, 0);
+  g_return_val_if_fail (GTK_IS_TEXT (text), 0);
   
-  if (GTK_WIDGET_REALIZED (widget))
-    {
-      gdk_window_set_background (widget->window, &widget->style->base[GTK_WIDGET_STATE (widget)]);
-      gdk_window_set_background (text->text_area, &widget->style->base[GTK_WIDGET_STATE (widget)]);
-    }
+  return gtk_text_get_private (text)->max_lines;
 }
 
-static void
-gtk_text_unrealize (GtkWidget *widget)
+void
+gtk_text_set_compact_storage (GtkText  *text,
+			      gboolean  compact)
 {
-  GtkText *text;
+  GtkTextPrivate *private;
+  GtkWidget *widget;
   
-  g_return_if_fail (widget != NULL);
-  g_return_if_fail (GTK_IS_TEXT (widget));
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (GTK_IS_TEXT (text));
   
-  text = GTK_TEXT (widget);
-
-#ifdef USE_XIM
-  if (GTK_EDITABLE (widget)->ic)
+  private = gtk_text_get_private (text);
+  widget = GTK_WIDGET (text);
+  
+  private->compact = (compact != FALSE);
+  
+  if (text->use_wchar)
     {
-      gdk_ic_destroy (GTK_EDITABLE (widget)->ic);
-      GTK_EDITABLE (widget)->ic = NULL;
+      if (private->compact && private->wide_chars == 0 && !text->freeze_count)
+	narrow_text (text);
+      else
+	text_chunks_fit (text);
     }
-  if (GTK_EDITABLE (widget)->ic_attr)
+  else if (!private->compact)
     {
-      gdk_ic_attr_destroy (GTK_EDITABLE (widget)->ic_attr);
-      GTK_EDITABLE (widget)->ic_attr = NULL;
+      gtk_widget_ensure_style (widget);
+      if (widget->style && widget->style->font->type == GDK_FONT_FONTSET)
+	widen_text (text);
     }
-#endif
+}
 
-  gdk_window_set_user_data (text->text_area, NULL);
-  gdk_window_destroy (text->text_area);
-  text->text_area = NULL;
+gboolean
+gtk_text_get_compact_storage (GtkText *text)
+{
+  g_return_val_if_fail (text != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (text), FALSE);
   
-  gdk_gc_destroy (text->gc);
-  text->gc = NULL;
+  return gtk_text_get_private (text)->compact;
+}
 
-  if (text->bg_gc)
+/* Each of these returns the offset of the first (or last) match in
+ * the n characters at haystack, or -1.
+ */
+static gint
+search_ch_forward (const TextSearch *search, gconstpointer haystack, guint n)
+{
+  const guchar *hay = haystack;
+  const guchar *needle = search->needle;
+  guint m = search->length;
+  const guchar *p;
+  guint i;
+  
+  if (n < m)
+    return -1;
+  
+  if (m == 1)
     {
-      gdk_gc_destroy (text->bg_gc);
-      text->bg_gc = NULL;
+      p = memchr (hay, needle[0], n);
+      return p ? p - hay : -1;
     }
   
-  gdk_pixmap_unref (text->line_wrap_bitmap);
-  gdk_pixmap_unref (text->line_arrow_bitmap);
-
-  unrealize_properties (text);
-
-  free_cache (text);
-
-  if (GTK_WIDGET_CLASS (parent_class)->unrealize)
-    (* GTK_WIDGET_CLASS (parent_class)->unrealize) (widget);
+  for (i = 0; i <= n - m; i += search->skip[hay[i + m - 1]])
+    if (hay[i + m - 1] == needle[m - 1] &&
+	memcmp (hay + i, needle, m - 1) == 0)
+      return i;
+  
+  return -1;
 }
 
-static void
-clear_focus_area (GtkText *text, gint area_x, gint area_y, gint area_width, gint area_height)
+static gint
+search_ch_backward (const TextSearch *search, gconstpointer haystack, guint n)
 {
-  GtkWidget *widget = GTK_WIDGET (text);
-  GdkGC *gc;
-  
-  gint ythick = TEXT_BORDER_ROOM + widget->style->klass->ythickness;
-  gint xthick = TEXT_BORDER_ROOM + widget->style->klass->xthickness;
+  const guchar *hay = haystack;
+  const guchar *needle = search->needle;
+  guint m = search->length;
+  guint shift;
+  guint i;
   
-  gint width, height;
-
-  if (area_width == 0 || area_height == 0)
-    return;
+  if (n < m)
+    return -1;
   
-  if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
+  for (i = n - m; ; i -= shift)
     {
-      gdk_window_get_size (widget->style->bg_pixmap[GTK_STATE_NORMAL], &width, &height);
+      if (hay[i] == needle[0] &&
+	  memcmp (hay + i + 1, needle + 1, m - 1) == 0)
+	return i;
       
-      gdk_gc_set_ts_origin (text->bg_gc,
-			    (- (gint)text->first_onscreen_hor_pixel + xthick) % width,
-			    (- (gint)text->first_onscreen_ver_pixel + ythick) % height);
-
-      gc = text->bg_gc;
+      shift = search->skip[hay[i]];
+      if (i < shift)
+	return -1;
     }
-  else
-    gc = widget->style->bg_gc[widget->state];
-
-
-  gdk_draw_rectangle (GTK_WIDGET (text)->window, gc, TRUE,
-		      area_x, area_y, area_width, area_height);
 }
 
-static void
-gtk_text_draw_focus (GtkWidget *widget)
+static gint
+search_wc_forward (const TextSearch *search, gconstpointer haystack, guint n)
 {
-  GtkText *text;
-  gint width, height;
-  gint x, y;
+  const GdkWChar *hay = haystack;
+  const GdkWChar *needle = search->needle;
+  guint m = search->length;
+  guint i;
   
-  g_return_if_fail (widget != NULL);
-  g_return_if_fail (GTK_IS_TEXT (widget));
+  if (n < m)
+    return -1;
   
-  text = GTK_TEXT (widget);
+  for (i = 0; i <= n - m; i += search->skip[hay[i + m - 1] & 0xff])
+    if (hay[i + m - 1] == needle[m - 1] &&
+	memcmp (hay + i, needle, (m - 1) * sizeof (GdkWChar)) == 0)
+      return i;
   
-  if (GTK_WIDGET_DRAWABLE (widget))
+  return -1;
+}
+
+static gint
+search_wc_backward (const TextSearch *search, gconstpointer haystack, guint n)
+{
+  const GdkWChar *hay = haystack;
+  const GdkWChar *needle = search->needle;
+  guint m = search->length;
+  guint shift;
+  guint i;
+  
+  if (n < m)
+    return -1;
+  
+  for (i = n - m; ; i -= shift)
     {
-      gint ythick = widget->style->klass->ythickness;
-      gint xthick = widget->style->klass->xthickness;
-      gint xextra = TEXT_BORDER_ROOM;
-      gint yextra = TEXT_BORDER_ROOM;
+      if (hay[i] == needle[0] &&
+	  memcmp (hay + i + 1, needle + 1, (m - 1) * sizeof (GdkWChar)) == 0)
+	return i;
       
-      TDEBUG (("in gtk_text_draw_focus\n"));
+      shift = search->skip[hay[i] & 0xff];
+      if (i < shift)
+	return -1;
+    }
+}
+
+/* Look for the needle in the index range [from, to) of the text,
+ * which is searched where it lies in each chunk.  Only the few
+ * characters around a chunk boundary that a match could straddle are
+ * copied.  narrow is the same search for chunks kept narrower than
+ * the text, or NULL if the needle can't be found in them.
+ */
+static gint
+text_search_range (GtkText *text,
+		   const TextSearch *search, const TextSearch *narrow,
+		   guint from, guint to, gboolean forward)
+{
+  guint size = search->char_size;
+  guint m = search->length;
+  const TextSearch *within;
+  TextChunk *chunk;
+  gchar *window;
+  guint start, end, boundary;
+  guint lo, hi;
+  gint result = -1;
+  gint found;
+  
+  if (to < from + m)
+    return -1;
+  
+  window = g_malloc (2 * m * size);
+  chunk = text_chunk_find (text, forward ? from : to - 1, &start);
+  
+  while (chunk)
+    {
+      end = start + chunk->length;
+      
+      /* Within the chunk */
+      within = chunk->wide == text->use_wchar ? search : narrow;
+      lo = MAX (from, start);
+      hi = MIN (to, end);
+      if (within && hi >= lo + m)
+	{
+	  found = within->find (within, chunk->text.ch + (lo - start) * within->char_size,
+				hi - lo);
+	  if (found >= 0)
+	    {
+	      result = lo + found;
+	      break;
+	    }
+	}
       
-      x = 0;
-      y = 0;
-      width = widget->allocation.width;
-      height = widget->allocation.height;
+      /* Across the boundary with the chunk searched next */
+      boundary = forward ? end : start;
+      lo = MAX (from, boundary > m - 1 ? boundary - (m - 1) : 0);
+      hi = MIN (to, boundary + m - 1);
+      if (lo < boundary && hi > boundary && hi >= lo + m)
+	{
+	  text_chunk_copy (text, lo, hi - lo, window);
+	  found = search->find (search, window, hi - lo);
+	  if (found >= 0)
+	    {
+	      result = lo + found;
+	      break;
+	    }
+	}
       
-      if (GTK_WIDGET_HAS_FOCUS (widget))
+      if (forward ? end >= to : start <= from)
+	break;
+      
+      if (forward)
 	{
-	  x += 1;
-	  y += 1;
-	  width -=  2;
-	  height -= 2;
-	  xextra -= 1;
-	  yextra -= 1;
-
-	  gtk_paint_focus (widget->style, widget->window,
-			   NULL, widget, "text",
-			   0, 0,
-			   widget->allocation.width - 1,
-			   widget->allocation.height - 1);
+	  chunk = (TextChunk*) text_tree_next ((TextTreeNode*) chunk);
+	  start = end;
+	}
+      else
+	{
+	  chunk = (TextChunk*) text_tree_prev ((TextTreeNode*) chunk);
+	  start -= chunk->length;
+	}
+    }
+  
+  g_free (window);
+  
+  return result;
+}
+
+static gint
+text_search (GtkText *text, const gchar *string,
+	     guint from, guint to, gboolean forward)
+{
+  TextSearch search;
+  TextSearch narrow;
+  GdkWChar *wc = NULL;
+  gboolean ascii = TRUE;
+  guchar c;
+  gint len;
+  gint result;
+  gint i;
+  
+  len = strlen (string);
+  
+  if (text->use_wchar)
+    {
+      wc = g_new (GdkWChar, len + 1);
+      len = gdk_mbstowcs (wc, string, len + 1);
+      if (len < 0)
+	{
+	  g_free (wc);
+	  return -1;
 	}
-
-      gtk_paint_shadow (widget->style, widget->window,
-			GTK_STATE_NORMAL, GTK_SHADOW_IN,
-			NULL, widget, "text",
-			x, y, width, height);
-
-      x += xthick; 
-      y += ythick;
-      width -= 2 * xthick;
-      height -= 2 * ythick;
       
-      /* top rect */
-      clear_focus_area (text, x, y, width, yextra);
-      /* left rect */
-      clear_focus_area (text, x, y + yextra, 
-			xextra, y + height - 2 * yextra);
-      /* right rect */
-      clear_focus_area (text, x + width - xextra, y + yextra, 
-			xextra, height - 2 * ythick);
-      /* bottom rect */
-      clear_focus_area (text, x, x + height - yextra, width, yextra);
+      search.needle = wc;
+      search.char_size = sizeof (GdkWChar);
+      search.find = forward ? search_wc_forward : search_wc_backward;
     }
   else
     {
-      TDEBUG (("in gtk_text_draw_focus (undrawable !!!)\n"));
+      search.needle = string;
+      search.char_size = sizeof (guchar);
+      search.find = forward ? search_ch_forward : search_ch_backward;
     }
-}
-
-static void
-gtk_text_size_request (GtkWidget      *widget,
-		       GtkRequisition *requisition)
-{
-  gint xthickness;
-  gint ythickness;
-  gint char_height;
-  gint char_width;
   
-  g_return_if_fail (widget != NULL);
-  g_return_if_fail (GTK_IS_TEXT (widget));
-  g_return_if_fail (requisition != NULL);
+  search.length = len;
   
-  xthickness = widget->style->klass->xthickness + TEXT_BORDER_ROOM;
-  ythickness = widget->style->klass->ythickness + TEXT_BORDER_ROOM;
+  if (len == 0)
+    {
+      g_free (wc);
+      return forward ? from : to;
+    }
   
-  char_height = MIN_TEXT_HEIGHT_LINES * (widget->style->font->ascent +
-					 widget->style->font->descent);
+  for (i = 0; i < 256; i++)
+    search.skip[i] = len;
   
-  char_width = MIN_TEXT_WIDTH_LINES * (gdk_text_width (widget->style->font,
-						       "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
-						       26)
-				       / 26);
+  /* Forward searches shift on the character under the end of the
+   * needle, backward ones on the one under its start. */
+  if (forward)
+    for (i = 0; i < len - 1; i++)
+      {
+	c = wc ? wc[i] & 0xff : ((guchar*) string)[i];
+	search.skip[c] = len - 1 - i;
+      }
+  else
+    for (i = len - 1; i > 0; i--)
+      {
+	c = wc ? wc[i] & 0xff : ((guchar*) string)[i];
+	search.skip[c] = i;
+      }
   
-  requisition->width  = char_width  + xthickness * 2;
-  requisition->height = char_height + ythickness * 2;
+  /* An ASCII needle is the same bytes in chunks kept one byte a
+   * character, and shifts the same way */
+  if (wc)
+    for (i = 0; i < len; i++)
+      if (wc[i] > 0x7f)
+	ascii = FALSE;
+  
+  if (wc && ascii)
+    {
+      narrow = search;
+      narrow.needle = string;
+      narrow.char_size = sizeof (guchar);
+      narrow.find = forward ? search_ch_forward : search_ch_backward;
+    }
+  
+  result = text_search_range (text, &search, wc && ascii ? &narrow : NULL,
+			      from, to, forward);
+  
+  g_free (wc);
+  
+  return result;
 }
 
-static void
-gtk_text_size_allocate (GtkWidget     *widget,
-			GtkAllocation *allocation)
+gint
+gtk_text_search_forward (GtkText     *text,
+			 const gchar *string,
+			 guint        start)
 {
-  GtkText *text;
-  GtkEditable *editable;
-  
-  g_return_if_fail (widget != NULL);
-  g_return_if_fail (GTK_IS_TEXT (widget));
-  g_return_if_fail (allocation != NULL);
+  g_return_val_if_fail (text != NULL, -1);
+  g_return_val_if_fail (GTK_IS_TEXT (text), -1);
+  g_return_val_if_fail (string != NULL, -1);
   
-  text = GTK_TEXT (widget);
-  editable = GTK_EDITABLE (widget);
+  if (start > TEXT_LENGTH (text))
+    return -1;
   
-  widget->allocation = *allocation;
-  if (GTK_WIDGET_REALIZED (widget))
-    {
-      gdk_window_move_resize (widget->window,
-			      allocation->x, allocation->y,
-			      allocation->width, allocation->height);
-      
-      gdk_window_move_resize (text->text_area,
-			      widget->style->klass->xthickness + TEXT_BORDER_ROOM,
-			      widget->style->klass->ythickness + TEXT_BORDER_ROOM,
-			      MAX (1, (gint)widget->allocation.width - (gint)(widget->style->klass->xthickness +
-							  (gint)TEXT_BORDER_ROOM) * 2),
-			      MAX (1, (gint)widget->allocation.height - (gint)(widget->style->klass->ythickness +
-							   (gint)TEXT_BORDER_ROOM) * 2));
-      
-#ifdef USE_XIM
-      if (editable->ic && (gdk_ic_get_style (editable->ic) & GDK_IM_PREEDIT_POSITION))
-	{
-	  gint width, height;
-	  
-	  gdk_window_get_size (text->text_area, &width, &height);
-	  editable->ic_attr->preedit_area.width = width;
-	  editable->ic_attr->preedit_area.height = height;
+  return text_search (text, string, start, TEXT_LENGTH (text), TRUE);
+}
 
-	  gdk_ic_set_attr (editable->ic,
-	      		   editable->ic_attr, GDK_IC_PREEDIT_AREA);
-	}
-#endif
-      
-      recompute_geometry (text);
-    }
+gint
+gtk_text_search_backward (GtkText     *text,
+			  const gchar *string,
+			  guint        start)
+{
+  g_return_val_if_fail (text != NULL, -1);
+  g_return_val_if_fail (GTK_IS_TEXT (text), -1);
+  g_return_val_if_fail (string != NULL, -1);
+  
+  return text_search (text, string, 0, MIN (start, TEXT_LENGTH (text)), FALSE);
 }
 
 static void
-gtk_text_draw (GtkWidget    *widget,
-	       GdkRectangle *area)
+gtk_text_set_position (GtkEditable *editable,
+		       gint position)
 {
-  g_return_if_fail (widget != NULL);
-  g_return_if_fail (GTK_IS_TEXT (widget));
-  g_return_if_fail (area != NULL);
+  GtkText *text = (GtkText *) editable;
   
-  if (GTK_WIDGET_DRAWABLE (widget))
-    {
-      expose_text (GTK_TEXT (widget), area, TRUE);
-      gtk_widget_draw_focus (widget);
-    }
+  undraw_cursor (text, FALSE);
+  text->cursor_mark = find_mark (text, position);
+  find_cursor (text, TRUE);
+  draw_cursor (text, FALSE);
+  gtk_editable_select_region (editable, 0, 0);
 }
 
-static gint
-gtk_text_expose (GtkWidget      *widget,
-		 GdkEventExpose *event)
+static gchar *    
+gtk_text_get_chars (GtkEditable   *editable,
+		    gint           start_pos,
+		    gint           end_pos)
 {
-  g_return_val_if_fail (widget != NULL, FALSE);
-  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
-  g_return_val_if_fail (event != NULL, FALSE);
+  GtkText *text;
+
+  gchar *retval;
   
-  if (event->window == GTK_TEXT (widget)->text_area)
+  g_return_val_if_fail (editable != NULL, NULL);
+  g_return_val_if_fail (GTK_IS_TEXT (editable), NULL);
+  text = GTK_TEXT (editable);
+  
+  if (end_pos < 0)
+    end_pos = TEXT_LENGTH (text);
+  
+  if ((start_pos < 0) || 
+      (end_pos > TEXT_LENGTH (text)) || 
+      (end_pos < start_pos))
+    return NULL;
+  
+  if (text->use_wchar)
     {
-      TDEBUG (("in gtk_text_expose (expose)\n"));
-      expose_text (GTK_TEXT (widget), &event->area, TRUE);
+      GdkWChar *wc;
+      wc = g_new (GdkWChar, end_pos - start_pos + 1);
+      text_chunk_copy (text, start_pos, end_pos - start_pos, wc);
+      wc[end_pos - start_pos] = 0;
+      retval = gdk_wcstombs (wc);
+      g_free (wc);
     }
-  else if (event->count == 0)
+  else
     {
-      TDEBUG (("in gtk_text_expose (focus)\n"));
-      gtk_widget_draw_focus (widget);
+      retval = g_new (gchar, end_pos - start_pos + 1);
+      text_chunk_copy (text, start_pos, end_pos - start_pos, retval);
+      retval[end_pos - start_pos] = 0;
     }
-  
-  return FALSE;
+
+  return retval;
 }
 
-static gint
-gtk_text_scroll_timeout (gpointer data)
+
+static void
+gtk_text_destroy (GtkObject *object)
 {
   GtkText *text;
-  GdkEventMotion event;
-  gint x, y;
-  GdkModifierType mask;
   
-  GDK_THREADS_ENTER ();
-
-  text = GTK_TEXT (data);
-  
-  text->timer = 0;
-  gdk_window_get_pointer (text->text_area, &x, &y, &mask);
+  g_return_if_fail (object != NULL);
+  g_return_if_fail (GTK_IS_TEXT (object));
   
-  if (mask & (GDK_BUTTON1_MASK | GDK_BUTTON3_MASK))
+  text = (GtkText*) object;
+
+  gtk_signal_disconnect_by_data (GTK_OBJECT (text->hadj), text);
+  gtk_signal_disconnect_by_data (GTK_OBJECT (text->vadj), text);
+
+  if (text->timer)
     {
-      event.is_hint = 0;
-      event.x = x;
-      event.y = y;
-      event.state = mask;
-      
-      gtk_text_motion_notify (GTK_WIDGET (text), &event);
+      gtk_timeout_remove (text->timer);
+      text->timer = 0;
     }
 
-  GDK_THREADS_LEAVE ();
+  stream_detach (text);
   
-  return FALSE;
+  GTK_OBJECT_CLASS(parent_class)->destroy (object);
 }
 
-static gint
-gtk_text_button_press (GtkWidget      *widget,
-		       GdkEventButton *event)
+static void
+gtk_text_finalize (GtkObject *object)
 {
   GtkText *text;
-  GtkEditable *editable;
-  static GdkAtom ctext_atom = GDK_NONE;
+  GList *tmp_list;
   
-  g_return_val_if_fail (widget != NULL, FALSE);
-  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
-  g_return_val_if_fail (event != NULL, FALSE);
+  g_return_if_fail (object != NULL);
+  g_return_if_fail (GTK_IS_TEXT (object));
   
-  if (ctext_atom == GDK_NONE)
-    ctext_atom = gdk_atom_intern ("COMPOUND_TEXT", FALSE);
+  text = (GtkText *)object;
   
-  text = GTK_TEXT (widget);
-  editable = GTK_EDITABLE (widget);
+  gtk_object_unref (GTK_OBJECT (text->hadj));
+  gtk_object_unref (GTK_OBJECT (text->vadj));
+
+  /* Clean up the internal structures, the text goes with the
+   * private data */
+  tmp_list = text->text_properties;
+  while (tmp_list)
+    {
+      destroy_text_property (tmp_list->data);
+      tmp_list = tmp_list->next;
+    }
+
+  if (text->current_font)
+    text_font_unref (text->current_font);
   
-  if (text->button && (event->button != text->button))
-    return FALSE;
+  g_list_free (text->text_properties);
   
-  text->button = event->button;
+  if (text->use_wchar)
+    {
+      if (text->scratch_buffer.wc)
+	g_free (text->scratch_buffer.wc);
+    }
+  else
+    {
+      if (text->scratch_buffer.ch)
+	g_free (text->scratch_buffer.ch);
+    }
   
-  if (!GTK_WIDGET_HAS_FOCUS (widget))
-    gtk_widget_grab_focus (widget);
+  g_list_free (text->tab_stops);
   
-  if (event->button == 1)
-    {
-      switch (event->type)
-	{
-	case GDK_BUTTON_PRESS:
-	  gtk_grab_add (widget);
-	  
-	  undraw_cursor (text, FALSE);
-	  find_mouse_cursor (text, (gint)event->x, (gint)event->y);
-	  draw_cursor (text, FALSE);
-	  
-	  /* Set it now, so we display things right. We'll unset it
-	   * later if things don't work out */
-	  editable->has_selection = TRUE;
-	  gtk_text_set_selection (GTK_EDITABLE(text),
-				  text->cursor_mark.index,
-				  text->cursor_mark.index);
-	  
-	  break;
-	  
-	case GDK_2BUTTON_PRESS:
-	  gtk_text_select_word (text, event->time);
-	  break;
-	  
-	case GDK_3BUTTON_PRESS:
-	  gtk_text_select_line (text, event->time);
-	  break;
-	  
-	default:
-	  break;
-	}
-    }
-  else if (event->type == GDK_BUTTON_PRESS)
-    {
-      if ((event->button == 2) && editable->editable)
-	{
-	  if (editable->selection_start_pos == editable->selection_end_pos ||
-	      editable->has_selection)
-	    {
-	      undraw_cursor (text, FALSE);
-	      find_mouse_cursor (text, (gint)event->x, (gint)event->y);
-	      draw_cursor (text, FALSE);
-	      
-	    }
-	  
-	  gtk_selection_convert (widget, GDK_SELECTION_PRIMARY,
-				 ctext_atom, event->time);
-	}
-      else
-	{
-	  gtk_grab_add (widget);
-	  
-	  undraw_cursor (text, FALSE);
-	  find_mouse_cursor (text, event->x, event->y);
-	  draw_cursor (text, FALSE);
-	  
-	  gtk_text_set_selection (GTK_EDITABLE(text),
-				  text->cursor_mark.index,
-				  text->cursor_mark.index);
-	  
-	  editable->has_selection = FALSE;
-	  if (gdk_selection_owner_get (GDK_SELECTION_PRIMARY) == widget->window)
-	    gtk_selection_owner_set (NULL, GDK_SELECTION_PRIMARY, event->time);
-	}
-    }
-  
-  return FALSE;
+  GTK_OBJECT_CLASS(parent_class)->finalize (object);
 }
 
-static gint
-gtk_text_button_release (GtkWidget      *widget,
-			 GdkEventButton *event)
+static void
+gtk_text_realize (GtkWidget *widget)
 {
   GtkText *text;
   GtkEditable *editable;
-  g_return_val_if_fail (widget != NULL, FALSE);
-  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
-  g_return_val_if_fail (event != NULL, FALSE);
+  GdkWindowAttr attributes;
+  gint attributes_mask;
+  
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_TEXT (widget));
   
   text = GTK_TEXT (widget);
+  editable = GTK_EDITABLE (widget);
+  GTK_WIDGET_SET_FLAGS (text, GTK_REALIZED);
   
-  gtk_grab_remove (widget);
+  attributes.window_type = GDK_WINDOW_CHILD;
+  attributes.x = widget->allocation.x;
+  attributes.y = widget->allocation.y;
+  attributes.width = widget->allocation.width;
+  attributes.height = widget->allocation.height;
+  attributes.wclass = GDK_INPUT_OUTPUT;
+  attributes.visual = gtk_widget_get_visual (widget);
+  attributes.colormap = gtk_widget_get_colormap (widget);
+  attributes.event_mask = gtk_widget_get_events (widget);
+  attributes.event_mask |= (GDK_EXPOSURE_MASK |
+			    GDK_BUTTON_PRESS_MASK |
+			    GDK_BUTTON_RELEASE_MASK |
+			    GDK_BUTTON_MOTION_MASK |
+			    GDK_ENTER_NOTIFY_MASK |
+			    GDK_LEAVE_NOTIFY_MASK |
+			    GDK_KEY_PRESS_MASK);
+  attributes_mask = GDK_WA_X | GDK_WA_Y | GDK_WA_VISUAL | GDK_WA_COLORMAP;
   
-  if (text->button != event->button)
-    return FALSE;
+  widget->window = gdk_window_new (gtk_widget_get_parent_window (widget), &attributes, attributes_mask);
+  gdk_window_set_user_data (widget->window, text);
   
-  text->button = 0;
+  attributes.x = (widget->style->klass->xthickness + TEXT_BORDER_ROOM);
+  attributes.y = (widget->style->klass->ythickness + TEXT_BORDER_ROOM);
+  attributes.width = MAX (1, (gint)widget->allocation.width - (gint)attributes.x * 2);
+  attributes.height = MAX (1, (gint)widget->allocation.height - (gint)attributes.y * 2);
+
+  attributes.cursor = gdk_cursor_new (GDK_XTERM);
+  attributes_mask |= GDK_WA_CURSOR;
   
-  if (text->timer)
-    {
-      gtk_timeout_remove (text->timer);
-      text->timer = 0;
-    }
+  text->text_area = gdk_window_new (widget->window, &attributes, attributes_mask);
+  gdk_window_set_user_data (text->text_area, text);
+
+  gdk_cursor_destroy (attributes.cursor); /* The X server will keep it around as long as necessary */
   
-  if (event->button == 1)
+  widget->style = gtk_style_attach (widget->style, widget->window);
+  
+  /* Can't call gtk_style_set_background here because it's handled specially */
+  gdk_window_set_background (widget->window, &widget->style->base[GTK_WIDGET_STATE (widget)]);
+  gdk_window_set_background (text->text_area, &widget->style->base[GTK_WIDGET_STATE (widget)]);
+
+  if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
+    text->bg_gc = create_bg_gc (text);
+  
+  text->line_wrap_bitmap = gdk_bitmap_create_from_data (text->text_area,
+							(gchar*) line_wrap_bits,
+							line_wrap_width,
+							line_wrap_height);
+  
+  text->line_arrow_bitmap = gdk_bitmap_create_from_data (text->text_area,
+							 (gchar*) line_arrow_bits,
+							 line_arrow_width,
+							 line_arrow_height);
+  
+  text->gc = gdk_gc_new (text->text_area);
+  gdk_gc_set_exposures (text->gc, TRUE);
+  gdk_gc_set_foreground (text->gc, &widget->style->text[GTK_STATE_NORMAL]);
+  
+#ifdef USE_XIM
+  if (gdk_im_ready () && (editable->ic_attr = gdk_ic_attr_new ()) != NULL)
     {
-      text = GTK_TEXT (widget);
-      editable = GTK_EDITABLE (widget);
+      gint width, height;
+      GdkColormap *colormap;
+      GdkEventMask mask;
+      GdkICAttr *attr = editable->ic_attr;
+      GdkICAttributesType attrmask = GDK_IC_ALL_REQ;
+      GdkIMStyle style;
+      GdkIMStyle supported_style = GDK_IM_PREEDIT_NONE | 
+	                           GDK_IM_PREEDIT_NOTHING |
+	                           GDK_IM_PREEDIT_POSITION |
+	                           GDK_IM_STATUS_NONE |
+	                           GDK_IM_STATUS_NOTHING;
       
-      gtk_grab_remove (widget);
+      if (widget->style && widget->style->font->type != GDK_FONT_FONTSET)
+	supported_style &= ~GDK_IM_PREEDIT_POSITION;
       
-      editable->has_selection = FALSE;
-      if (editable->selection_start_pos != editable->selection_end_pos)
+      attr->style = style = gdk_im_decide_style (supported_style);
+      attr->client_window = text->text_area;
+
+      if ((colormap = gtk_widget_get_colormap (widget)) !=
+	  gtk_widget_get_default_colormap ())
 	{
-	  if (gtk_selection_owner_set (widget,
-				       GDK_SELECTION_PRIMARY,
-				       event->time))
-	    editable->has_selection = TRUE;
-	  else
-	    gtk_text_update_text (editable, editable->selection_start_pos,
-				  editable->selection_end_pos);
+	  attrmask |= GDK_IC_PREEDIT_COLORMAP;
+	  attr->preedit_colormap = colormap;
+	}
+
+      switch (style & GDK_IM_PREEDIT_MASK)
+	{
+	case GDK_IM_PREEDIT_POSITION:
+	  if (widget->style && widget->style->font->type != GDK_FONT_FONTSET)
+	    {
+	      g_warning ("over-the-spot style requires fontset");
+	      break;
+	    }
+
+	  attrmask |= GDK_IC_PREEDIT_POSITION_REQ;
+	  gdk_window_get_size (text->text_area, &width, &height);
+	  attr->spot_location.x = 0;
+	  attr->spot_location.y = height;
+	  attr->preedit_area.x = 0;
+	  attr->preedit_area.y = 0;
+	  attr->preedit_area.width = width;
+	  attr->preedit_area.height = height;
+	  attr->preedit_fontset = widget->style->font;
+	  
+	  break;
 	}
+      editable->ic = gdk_ic_new (attr, attrmask);
+      
+      if (editable->ic == NULL)
+	g_warning ("Can't create input context.");
       else
 	{
-	  if (gdk_selection_owner_get (GDK_SELECTION_PRIMARY) == widget->window)
-	    gtk_selection_owner_set (NULL, GDK_SELECTION_PRIMARY, event->time);
+	  mask = gdk_window_get_events (text->text_area);
+	  mask |= gdk_ic_get_events (editable->ic);
+	  gdk_window_set_events (text->text_area, mask);
+	  
+	  if (GTK_WIDGET_HAS_FOCUS (widget))
+	    gdk_im_begin (editable->ic, text->text_area);
 	}
     }
-  else if (event->button == 3)
-    {
-      gtk_grab_remove (widget);
-    }
-  
-  undraw_cursor (text, FALSE);
-  find_cursor (text, TRUE);
-  draw_cursor (text, FALSE);
+#endif
+
+  realize_properties (text);
+  gdk_window_show (text->text_area);
+  init_properties (text);
+  text_lines_invalidate (text);
+
+  if (editable->selection_start_pos != editable->selection_end_pos)
+    gtk_editable_claim_selection (editable, TRUE, GDK_CURRENT_TIME);
   
-  return FALSE;
+  recompute_geometry (text);
 }
 
-static gint
-gtk_text_motion_notify (GtkWidget      *widget,
-			GdkEventMotion *event)
+static void 
+gtk_text_style_set (GtkWidget *widget,
+		    GtkStyle  *previous_style)
 {
-  GtkText *text;
-  gint x, y;
-  gint height;
-  GdkModifierType mask;
-  
-  g_return_val_if_fail (widget != NULL, FALSE);
-  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
-  g_return_val_if_fail (event != NULL, FALSE);
-  
-  text = GTK_TEXT (widget);
-  
-  x = event->x;
-  y = event->y;
-  mask = event->state;
-  if (event->is_hint || (text->text_area != event->window))
+  GtkText *text = GTK_TEXT (widget);
+
+  if (GTK_WIDGET_REALIZED (widget))
     {
-      gdk_window_get_pointer (text->text_area, &x, &y, &mask);
-    }
-  
-  if ((text->button == 0) ||
-      !(mask & (GDK_BUTTON1_MASK | GDK_BUTTON3_MASK)))
-    return FALSE;
-  
-  gdk_window_get_size (text->text_area, NULL, &height);
-  
-  if ((y < 0) || (y > height))
-    {
-      if (text->timer == 0)
+      gdk_window_set_background (widget->window, &widget->style->base[GTK_WIDGET_STATE (widget)]);
+      gdk_window_set_background (text->text_area, &widget->style->base[GTK_WIDGET_STATE (widget)]);
+      
+      if (text->bg_gc)
 	{
-	  text->timer = gtk_timeout_add (SCROLL_TIME, 
-					 gtk_text_scroll_timeout,
-					 text);
-	  
-	  if (y < 0)
-	    scroll_int (text, y/2);
-	  else
-	    scroll_int (text, (y - height)/2);
+	  gdk_gc_destroy (text->bg_gc);
+	  text->bg_gc = NULL;
 	}
-      else
-	return FALSE;
+
+      if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
+	text->bg_gc = create_bg_gc (text);
+
+      recompute_geometry (text);
     }
+
+  if (text->current_font)
+    text_font_unref (text->current_font);
+  text->current_font = get_text_font (widget->style->font);
+
+  /* The paragraph heights depend on the font */
+  text_lines_invalidate (text);
+}
+
+static void
+gtk_text_state_changed (GtkWidget   *widget,
+			GtkStateType previous_state)
+{
+  GtkText *text = GTK_TEXT (widget);
   
-  undraw_cursor (GTK_TEXT (widget), FALSE);
-  find_mouse_cursor (GTK_TEXT (widget), x, y);
-  draw_cursor (GTK_TEXT (widget), FALSE);
-  
-  gtk_text_set_selection (GTK_EDITABLE(text), 
-			  GTK_EDITABLE(text)->selection_start_pos,
-			  text->cursor_mark.index);
-  
-  return FALSE;
+  if (GTK_WIDGET_REALIZED (widget))
+    {
+      gdk_window_set_background (widget->window, &widget->style->base[GTK_WIDGET_STATE (widget)]);
+      gdk_window_set_background (text->text_area, &widget->style->base[GTK_WIDGET_STATE (widget)]);
+    }
 }
 
-static void 
-gtk_text_insert_text    (GtkEditable       *editable,
-			 const gchar       *new_text,
-			 gint               new_text_length,
-			 gint              *position)
+static void
+gtk_text_unrealize (GtkWidget *widget)
 {
-  GtkText *text = GTK_TEXT (editable);
-  GdkFont *font;
-  GdkColor *fore, *back;
+  GtkText *text;
+  
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_TEXT (widget));
+  
+  text = GTK_TEXT (widget);
 
-  TextProperty *property;
+#ifdef USE_XIM
+  if (GTK_EDITABLE (widget)->ic)
+    {
+      gdk_ic_destroy (GTK_EDITABLE (widget)->ic);
+      GTK_EDITABLE (widget)->ic = NULL;
+    }
+  if (GTK_EDITABLE (widget)->ic_attr)
+    {
+      gdk_ic_attr_destroy (GTK_EDITABLE (widget)->ic_attr);
+      GTK_EDITABLE (widget)->ic_attr = NULL;
+    }
+#endif
 
-  gtk_text_set_point (text, *position);
+  gdk_window_set_user_data (text->text_area, NULL);
+  gdk_window_destroy (text->text_area);
+  text->text_area = NULL;
+  
+  gdk_gc_destroy (text->gc);
+  text->gc = NULL;
 
-  property = MARK_CURRENT_PROPERTY (&text->point);
-  font = property->flags & PROPERTY_FONT ? property->font->gdk_font : NULL; 
-  fore = property->flags & PROPERTY_FOREGROUND ? &property->fore_color : NULL; 
-  back = property->flags & PROPERTY_BACKGROUND ? &property->back_color : NULL; 
+  if (text->bg_gc)
+    {
+      gdk_gc_destroy (text->bg_gc);
+      text->bg_gc = NULL;
+    }
   
-  gtk_text_insert (text, font, fore, back, new_text, new_text_length);
+  gdk_pixmap_unref (text->line_wrap_bitmap);
+  gdk_pixmap_unref (text->line_arrow_bitmap);
 
-  *position = text->point.index;
+  unrealize_properties (text);
+
+  free_cache (text);
+  text_lines_invalidate (text);
+
+  if (GTK_WIDGET_CLASS (parent_class)->unrealize)
+    (* GTK_WIDGET_CLASS (parent_class)->unrealize) (widget);
 }
 
-static void 
-gtk_text_delete_text    (GtkEditable       *editable,
-			 gint               start_pos,
-			 gint               end_pos)
+static void
+clear_focus_area (GtkText *text, gint area_x, gint area_y, gint area_width, gint area_height)
 {
-  GtkText *text;
-  
-  g_return_if_fail (start_pos >= 0);
+  GtkWidget *widget = GTK_WIDGET (text);
+  GdkGC *gc;
   
-  text = GTK_TEXT (editable);
+  gint ythick = TEXT_BORDER_ROOM + widget->style->klass->ythickness;
+  gint xthick = TEXT_BORDER_ROOM + widget->style->klass->xthickness;
   
-  gtk_text_set_point (text, start_pos);
-  if (end_pos < 0)
-    end_pos = TEXT_LENGTH (text);
+  gint width, height;
+
+  if (area_width == 0 || area_height == 0)
+    return;
   
-  if (end_pos > start_pos)
-    gtk_text_forward_delete (text, end_pos - start_pos);
+  if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
+    {
+      gdk_window_get_size (widget->style->bg_pixmap[GTK_STATE_NORMAL], &width, &height);
+      
+      gdk_gc_set_ts_origin (text->bg_gc,
+			    (- (gint)text->first_onscreen_hor_pixel + xthick) % width,
+			    (- (gint)text->first_onscreen_ver_pixel + ythick) % height);
+
+      gc = text->bg_gc;
+    }
+  else
+    gc = widget->style->bg_gc[widget->state];
+
+
+  gdk_draw_rectangle (GTK_WIDGET (text)->window, gc, TRUE,
+		      area_x, area_y, area_width, area_height);
 }
 
-static gint
-gtk_text_key_press (GtkWidget   *widget,
-		    GdkEventKey *event)
+static void
+gtk_text_draw_focus (GtkWidget *widget)
 {
   GtkText *text;
-  GtkEditable *editable;
-  gchar key;
-  gint return_val;
-  gint position;
-  
-  g_return_val_if_fail (widget != NULL, FALSE);
-  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
-  g_return_val_if_fail (event != NULL, FALSE);
+  gint width, height;
+  gint x, y;
   
-  return_val = FALSE;
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_TEXT (widget));
   
   text = GTK_TEXT (widget);
-  editable = GTK_EDITABLE (widget);
-  
-  key = event->keyval;
-  return_val = TRUE;
   
-  if ((GTK_EDITABLE(text)->editable == FALSE))
-    {
-      switch (event->keyval)
-	{
-	case GDK_Home:      
-	  if (event->state & GDK_CONTROL_MASK)
-	    scroll_int (text, -text->vadj->value);
-	  else
-	    return_val = FALSE;
-	  break;
-	case GDK_End:
-	  if (event->state & GDK_CONTROL_MASK)
-	    scroll_int (text, +text->vadj->upper); 
-	  else
-	    return_val = FALSE;
-	  break;
-	case GDK_Page_Up:   scroll_int (text, -text->vadj->page_increment); break;
-	case GDK_Page_Down: scroll_int (text, +text->vadj->page_increment); break;
-	case GDK_Up:        scroll_int (text, -KEY_SCROLL_PIXELS); break;
-	case GDK_Down:      scroll_int (text, +KEY_SCROLL_PIXELS); break;
-	case GDK_Return:
-	  if (event->state & GDK_CONTROL_MASK)
-	    gtk_signal_emit_by_name (GTK_OBJECT (text), "activate");
-	  else
-	    return_val = FALSE;
-	  break;
-	default:
-	  return_val = FALSE;
-	  break;
-	}
-    }
-  else
+  if (GTK_WIDGET_DRAWABLE (widget))
     {
-      gint extend_selection;
-      gint extend_start;
-      guint initial_pos = editable->current_pos;
+      gint ythick = widget->style->klass->ythickness;
+      gint xthick = widget->style->klass->xthickness;
+      gint xextra = TEXT_BORDER_ROOM;
+      gint yextra = TEXT_BORDER_ROOM;
       
-      text->point = find_mark (text, text->cursor_mark.index);
+      TDEBUG (("in gtk_text_draw_focus\n"));
       
-      extend_selection = event->state & GDK_SHIFT_MASK;
-      extend_start = FALSE;
+      x = 0;
+      y = 0;
+      width = widget->allocation.width;
+      height = widget->allocation.height;
       
-      if (extend_selection)
+      if (GTK_WIDGET_HAS_FOCUS (widget))
 	{
-	  editable->has_selection = TRUE;
-	  
-	  if (editable->selection_start_pos == editable->selection_end_pos)
-	    {
-	      editable->selection_start_pos = text->point.index;
-	      editable->selection_end_pos = text->point.index;
-	    }
-	  
-	  extend_start = (text->point.index == editable->selection_start_pos);
+	  x += 1;
+	  y += 1;
+	  width -=  2;
+	  height -= 2;
+	  xextra -= 1;
+	  yextra -= 1;
+
+	  gtk_paint_focus (widget->style, widget->window,
+			   NULL, widget, "text",
+			   0, 0,
+			   widget->allocation.width - 1,
+			   widget->allocation.height - 1);
 	}
+
+      gtk_paint_shadow (widget->style, widget->window,
+			GTK_STATE_NORMAL, GTK_SHADOW_IN,
+			NULL, widget, "text",
+			x, y, width, height);
+
+      x += xthick; 
+      y += ythick;
+      width -= 2 * xthick;
+      height -= 2 * ythick;
       
-      switch (event->keyval)
-	{
-	case GDK_Home:
-	  if (event->state & GDK_CONTROL_MASK)
-	    move_cursor_buffer_ver (text, -1);
-	  else
-	    gtk_text_move_beginning_of_line (text);
-	  break;
-	case GDK_End:
-	  if (event->state & GDK_CONTROL_MASK)
-	    move_cursor_buffer_ver (text, +1);
-	  else
-	    gtk_text_move_end_of_line (text);
-	  break;
-	case GDK_Page_Up:   move_cursor_page_ver (text, -1); break;
-	case GDK_Page_Down: move_cursor_page_ver (text, +1); break;
-	  /* CUA has Ctrl-Up/Ctrl-Down as paragraph up down */
-	case GDK_Up:        move_cursor_ver (text, -1); break;
-	case GDK_Down:      move_cursor_ver (text, +1); break;
-	case GDK_Left:
-	  if (event->state & GDK_CONTROL_MASK)
-	    gtk_text_move_backward_word (text);
-	  else
-	    move_cursor_hor (text, -1); 
+      /* top rect */
+      clear_focus_area (text, x, y, width, yextra);
+      /* left rect */
+      clear_focus_area (text, x, y + yextra, 
+			xextra, y + height - 2 * yextra);
+      /* right rect */
+      clear_focus_area (text, x + width - xextra, y + yextra, 
+			xextra, height - 2 * ythick);
+      /* bottom rect */
+      clear_focus_area (text, x, x + height - yextra, width, yextra);
+    }
+  else
+    {
+      TDEBUG (("in gtk_text_draw_focus (undrawable !!!)\n"));
+    }
+}
+
+static void
+gtk_text_size_request (GtkWidget      *widget,
+		       GtkRequisition *requisition)
+{
+  gint xthickness;
+  gint ythickness;
+  gint char_height;
+  gint char_width;
+  
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_TEXT (widget));
+  g_return_if_fail (requisition != NULL);
+  
+  xthickness = widget->style->klass->xthickness + TEXT_BORDER_ROOM;
+  ythickness = widget->style->klass->ythickness + TEXT_BORDER_ROOM;
+  
+  char_height = MIN_TEXT_HEIGHT_LINES * (widget->style->font->ascent +
+					 widget->style->font->descent);
+  
+  char_width = MIN_TEXT_WIDTH_LINES * (gdk_text_width (widget->style->font,
+						       "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+						       26)
+				       / 26);
+  
+  requisition->width  = char_width  + xthickness * 2;
+  requisition->height = char_height + ythickness * 2;
+}
+
+static void
+gtk_text_size_allocate (GtkWidget     *widget,
+			GtkAllocation *allocation)
+{
+  GtkText *text;
+  GtkEditable *editable;
+  
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_TEXT (widget));
+  g_return_if_fail (allocation != NULL);
+  
+  text = GTK_TEXT (widget);
+  editable = GTK_EDITABLE (widget);
+  
+  widget->allocation = *allocation;
+  if (GTK_WIDGET_REALIZED (widget))
+    {
+      gdk_window_move_resize (widget->window,
+			      allocation->x, allocation->y,
+			      allocation->width, allocation->height);
+      
+      gdk_window_move_resize (text->text_area,
+			      widget->style->klass->xthickness + TEXT_BORDER_ROOM,
+			      widget->style->klass->ythickness + TEXT_BORDER_ROOM,
+			      MAX (1, (gint)widget->allocation.width - (gint)(widget->style->klass->xthickness +
+							  (gint)TEXT_BORDER_ROOM) * 2),
+			      MAX (1, (gint)widget->allocation.height - (gint)(widget->style->klass->ythickness +
+							   (gint)TEXT_BORDER_ROOM) * 2));
+      
+#ifdef USE_XIM
+      if (editable->ic && (gdk_ic_get_style (editable->ic) & GDK_IM_PREEDIT_POSITION))
+	{
+	  gint width, height;
+	  
+	  gdk_window_get_size (text->text_area, &width, &height);
+	  editable->ic_attr->preedit_area.width = width;
+	  editable->ic_attr->preedit_area.height = height;
+
+	  gdk_ic_set_attr (editable->ic,
+	      		   editable->ic_attr, GDK_IC_PREEDIT_AREA);
+	}
+#endif
+      
+      recompute_geometry (text);
+    }
+}
+
+static void
+gtk_text_draw (GtkWidget    *widget,
+	       GdkRectangle *area)
+{
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_TEXT (widget));
+  g_return_if_fail (area != NULL);
+  
+  if (GTK_WIDGET_DRAWABLE (widget))
+    {
+      expose_text (GTK_TEXT (widget), area, TRUE);
+      gtk_widget_draw_focus (widget);
+    }
+}
+
+static gint
+gtk_text_expose (GtkWidget      *widget,
+		 GdkEventExpose *event)
+{
+  g_return_val_if_fail (widget != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+  
+  if (event->window == GTK_TEXT (widget)->text_area)
+    {
+      TDEBUG (("in gtk_text_expose (expose)\n"));
+      expose_text (GTK_TEXT (widget), &event->area, TRUE);
+    }
+  else if (event->count == 0)
+    {
+      TDEBUG (("in gtk_text_expose (focus)\n"));
+      gtk_widget_draw_focus (widget);
+    }
+  
+  return FALSE;
+}
+
+static gint
+gtk_text_scroll_timeout (gpointer data)
+{
+  GtkText *text;
+  GdkEventMotion event;
+  gint x, y;
+  GdkModifierType mask;
+  
+  GDK_THREADS_ENTER ();
+
+  text = GTK_TEXT (data);
+  
+  text->timer = 0;
+  gdk_window_get_pointer (text->text_area, &x, &y, &mask);
+  
+  if (mask & (GDK_BUTTON1_MASK | GDK_BUTTON3_MASK))
+    {
+      event.is_hint = 0;
+      event.x = x;
+      event.y = y;
+      event.state = mask;
+      
+      gtk_text_motion_notify (GTK_WIDGET (text), &event);
+    }
+
+  GDK_THREADS_LEAVE ();
+  
+  return FALSE;
+}
+
+static gint
+gtk_text_button_press (GtkWidget      *widget,
+		       GdkEventButton *event)
+{
+  GtkText *text;
+  GtkEditable *editable;
+  static GdkAtom ctext_atom = GDK_NONE;
+  
+  g_return_val_if_fail (widget != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+  
+  if (ctext_atom == GDK_NONE)
+    ctext_atom = gdk_atom_intern ("COMPOUND_TEXT", FALSE);
+  
+  text = GTK_TEXT (widget);
+  editable = GTK_EDITABLE (widget);
+  
+  if (text->button && (event->button != text->button))
+    return FALSE;
+  
+  text->button = event->button;
+  
+  if (!GTK_WIDGET_HAS_FOCUS (widget))
+    gtk_widget_grab_focus (widget);
+  
+  if (event->button == 1)
+    {
+      switch (event->type)
+	{
+	case GDK_BUTTON_PRESS:
+	  gtk_grab_add (widget);
+	  
+	  undraw_cursor (text, FALSE);
+	  find_mouse_cursor (text, (gint)event->x, (gint)event->y);
+	  draw_cursor (text, FALSE);
+	  
+	  /* Set it now, so we display things right. We'll unset it
+	   * later if things don't work out */
+	  editable->has_selection = TRUE;
+	  gtk_text_set_selection (GTK_EDITABLE(text),
+				  text->cursor_mark.index,
+				  text->cursor_mark.index);
+	  
 	  break;
-	case GDK_Right:     
-	  if (event->state & GDK_CONTROL_MASK)
-	    gtk_text_move_forward_word (text);
-	  else
-	    move_cursor_hor (text, +1); 
+	  
+	case GDK_2BUTTON_PRESS:
+	  gtk_text_select_word (text, event->time);
 	  break;
 	  
-	case GDK_BackSpace:
-	  if (event->state & GDK_CONTROL_MASK)
-	    gtk_text_delete_backward_word (text);
-	  else
-	    gtk_text_delete_backward_character (text);
+	case GDK_3BUTTON_PRESS:
+	  gtk_text_select_line (text, event->time);
 	  break;
-	case GDK_Clear:
-	  gtk_text_delete_line (text);
+	  
+	default:
 	  break;
-	case GDK_Insert:
-	  if (event->state & GDK_SHIFT_MASK)
+	}
+    }
+  else if (event->type == GDK_BUTTON_PRESS)
+    {
+      if ((event->button == 2) && editable->editable)
+	{
+	  if (editable->selection_start_pos == editable->selection_end_pos ||
+	      editable->has_selection)
 	    {
-	      extend_selection = FALSE;
-	      gtk_editable_paste_clipboard (editable);
-	    }
-	  else if (event->state & GDK_CONTROL_MASK)
-	    {
-	      gtk_editable_copy_clipboard (editable);
+	      undraw_cursor (text, FALSE);
+	      find_mouse_cursor (text, (gint)event->x, (gint)event->y);
+	      draw_cursor (text, FALSE);
+	      
 	    }
+	  
+	  gtk_selection_convert (widget, GDK_SELECTION_PRIMARY,
+				 ctext_atom, event->time);
+	}
+      else
+	{
+	  gtk_grab_add (widget);
+	  
+	  undraw_cursor (text, FALSE);
+	  find_mouse_cursor (text, event->x, event->y);
+	  draw_cursor (text, FALSE);
+	  
+	  gtk_text_set_selection (GTK_EDITABLE(text),
+				  text->cursor_mark.index,
+				  text->cursor_mark.index);
+	  
+	  editable->has_selection = FALSE;
+	  if (gdk_selection_owner_get (GDK_SELECTION_PRIMARY) == widget->window)
+	    gtk_selection_owner_set (NULL, GDK_SELECTION_PRIMARY, event->time);
+	}
+    }
+  
+  return FALSE;
+}
+
+static gint
+gtk_text_button_release (GtkWidget      *widget,
+			 GdkEventButton *event)
+{
+  GtkText *text;
+  GtkEditable *editable;
+  g_return_val_if_fail (widget != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+  
+  text = GTK_TEXT (widget);
+  
+  gtk_grab_remove (widget);
+  
+  if (text->button != event->button)
+    return FALSE;
+  
+  text->button = 0;
+  
+  if (text->timer)
+    {
+      gtk_timeout_remove (text->timer);
+      text->timer = 0;
+    }
+  
+  if (event->button == 1)
+    {
+      text = GTK_TEXT (widget);
+      editable = GTK_EDITABLE (widget);
+      
+      gtk_grab_remove (widget);
+      
+      editable->has_selection = FALSE;
+      if (editable->selection_start_pos != editable->selection_end_pos)
+	{
+	  if (gtk_selection_owner_set (widget,
+				       GDK_SELECTION_PRIMARY,
+				       event->time))
+	    editable->has_selection = TRUE;
 	  else
-	    {
-	      /* gtk_toggle_insert(text) -- IMPLEMENT */
-	    }
-	  break;
-	case GDK_Delete:
+	    gtk_text_update_text (editable, editable->selection_start_pos,
+				  editable->selection_end_pos);
+	}
+      else
+	{
+	  if (gdk_selection_owner_get (GDK_SELECTION_PRIMARY) == widget->window)
+	    gtk_selection_owner_set (NULL, GDK_SELECTION_PRIMARY, event->time);
+	}
+    }
+  else if (event->button == 3)
+    {
+      gtk_grab_remove (widget);
+    }
+  
+  undraw_cursor (text, FALSE);
+  find_cursor (text, TRUE);
+  draw_cursor (text, FALSE);
+  
+  return FALSE;
+}
+
+static gint
+gtk_text_motion_notify (GtkWidget      *widget,
+			GdkEventMotion *event)
+{
+  GtkText *text;
+  gint x, y;
+  gint height;
+  GdkModifierType mask;
+  
+  g_return_val_if_fail (widget != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+  
+  text = GTK_TEXT (widget);
+  
+  x = event->x;
+  y = event->y;
+  mask = event->state;
+  if (event->is_hint || (text->text_area != event->window))
+    {
+      gdk_window_get_pointer (text->text_area, &x, &y, &mask);
+    }
+  
+  if ((text->button == 0) ||
+      !(mask & (GDK_BUTTON1_MASK | GDK_BUTTON3_MASK)))
+    return FALSE;
+  
+  gdk_window_get_size (text->text_area, NULL, &height);
+  
+  if ((y < 0) || (y > height))
+    {
+      if (text->timer == 0)
+	{
+	  text->timer = gtk_timeout_add (SCROLL_TIME, 
+					 gtk_text_scroll_timeout,
+					 text);
+	  
+	  if (y < 0)
+	    scroll_int (text, y/2);
+	  else
+	    scroll_int (text, (y - height)/2);
+	}
+      else
+	return FALSE;
+    }
+  
+  undraw_cursor (GTK_TEXT (widget), FALSE);
+  find_mouse_cursor (GTK_TEXT (widget), x, y);
+  draw_cursor (GTK_TEXT (widget), FALSE);
+  
+  gtk_text_set_selection (GTK_EDITABLE(text), 
+			  GTK_EDITABLE(text)->selection_start_pos,
+			  text->cursor_mark.index);
+  
+  return FALSE;
+}
+
+static void 
+gtk_text_insert_text    (GtkEditable       *editable,
+			 const gchar       *new_text,
+			 gint               new_text_length,
+			 gint              *position)
+{
+  GtkText *text = GTK_TEXT (editable);
+  GdkFont *font;
+  GdkColor *fore, *back;
+
+  TextProperty *property;
+
+  gtk_text_set_point (text, *position);
+
+  property = MARK_CURRENT_PROPERTY (&text->point);
+  font = property->flags & PROPERTY_FONT ? property->font->gdk_font : NULL; 
+  fore = property->flags & PROPERTY_FOREGROUND ? &property->fore_color : NULL; 
+  back = property->flags & PROPERTY_BACKGROUND ? &property->back_color : NULL; 
+  
+  gtk_text_insert (text, font, fore, back, new_text, new_text_length);
+
+  *position = text->point.index;
+}
+
+static void 
+gtk_text_delete_text    (GtkEditable       *editable,
+			 gint               start_pos,
+			 gint               end_pos)
+{
+  GtkText *text;
+  
+  g_return_if_fail (start_pos >= 0);
+  
+  text = GTK_TEXT (editable);
+  
+  gtk_text_set_point (text, start_pos);
+  if (end_pos < 0)
+    end_pos = TEXT_LENGTH (text);
+  
+  if (end_pos > start_pos)
+    gtk_text_forward_delete (text, end_pos - start_pos);
+}
+
+static gint
+gtk_text_key_press (GtkWidget   *widget,
+		    GdkEventKey *event)
+{
+  GtkText *text;
+  GtkEditable *editable;
+  gchar key;
+  gint return_val;
+  gint position;
+  
+  g_return_val_if_fail (widget != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+  
+  return_val = FALSE;
+  
+  text = GTK_TEXT (widget);
+  editable = GTK_EDITABLE (widget);
+  
+  key = event->keyval;
+  return_val = TRUE;
+  
+  if ((GTK_EDITABLE(text)->editable == FALSE))
+    {
+      switch (event->keyval)
+	{
+	case GDK_Home:      
 	  if (event->state & GDK_CONTROL_MASK)
-	    gtk_text_delete_forward_word (text);
-	  else if (event->state & GDK_SHIFT_MASK)
-	    {
-	      extend_selection = FALSE;
-	      gtk_editable_cut_clipboard (editable);
-	    }
+	    scroll_int (text, -text->vadj->value);
 	  else
-	    gtk_text_delete_forward_character (text);
+	    return_val = FALSE;
 	  break;
-	case GDK_Tab:
-	  position = text->point.index;
-	  gtk_editable_insert_text (editable, "\t", 1, &position);
+	case GDK_End:
+	  if (event->state & GDK_CONTROL_MASK)
+	    scroll_int (text, +text->vadj->upper); 
+	  else
+	    return_val = FALSE;
 	  break;
+	case GDK_Page_Up:   scroll_int (text, -text->vadj->page_increment); break;
+	case GDK_Page_Down: scroll_int (text, +text->vadj->page_increment); break;
+	case GDK_Up:        scroll_int (text, -KEY_SCROLL_PIXELS); break;
+	case GDK_Down:      scroll_int (text, +KEY_SCROLL_PIXELS); break;
 	case GDK_Return:
 	  if (event->state & GDK_CONTROL_MASK)
 	    gtk_signal_emit_by_name (GTK_OBJECT (text), "activate");
 	  else
-	    {
-	      position = text->point.index;
-	      gtk_editable_insert_text (editable, "\n", 1, &position);
-	    }
-	  break;
-	case GDK_Escape:
-	  /* Don't insert literally */
-	  return_val = FALSE;
+	    return_val = FALSE;
 	  break;
-	  
 	default:
 	  return_val = FALSE;
+	  break;
+	}
+    }
+  else
+    {
+      gint extend_selection;
+      gint extend_start;
+      guint initial_pos = editable->current_pos;
+      
+      text->point = find_mark (text, text->cursor_mark.index);
+      
+      extend_selection = event->state & GDK_SHIFT_MASK;
+      extend_start = FALSE;
+      
+      if (extend_selection)
+	{
+	  editable->has_selection = TRUE;
+	  
+	  if (editable->selection_start_pos == editable->selection_end_pos)
+	    {
+	      editable->selection_start_pos = text->point.index;
+	      editable->selection_end_pos = text->point.index;
+	    }
+	  
+	  extend_start = (text->point.index == editable->selection_start_pos);
+	}
+      
+      switch (event->keyval)
+	{
+	case GDK_Home:
+	  if (event->state & GDK_CONTROL_MASK)
+	    move_cursor_buffer_ver (text, -1);
+	  else
+	    gtk_text_move_beginning_of_line (text);
+	  break;
+	case GDK_End:
+	  if (event->state & GDK_CONTROL_MASK)
+	    move_cursor_buffer_ver (text, +1);
+	  else
+	    gtk_text_move_end_of_line (text);
+	  break;
+	case GDK_Page_Up:   move_cursor_page_ver (text, -1); break;
+	case GDK_Page_Down: move_cursor_page_ver (text, +1); break;
+	  /* CUA has Ctrl-Up/Ctrl-Down as paragraph up down */
+	case GDK_Up:        move_cursor_ver (text, -1); break;
+	case GDK_Down:      move_cursor_ver (text, +1); break;
+	case GDK_Left:
+	  if (event->state & GDK_CONTROL_MASK)
+	    gtk_text_move_backward_word (text);
+	  else
+	    move_cursor_hor (text, -1); 
+	  break;
+	case GDK_Right:     
+	  if (event->state & GDK_CONTROL_MASK)
+	    gtk_text_move_forward_word (text);
+	  else
+	    move_cursor_hor (text, +1); 
+	  break;
+	  
+	case GDK_BackSpace:
+	  if (event->state & GDK_CONTROL_MASK)
+	    gtk_text_delete_backward_word (text);
+	  else
+	    gtk_text_delete_backward_character (text);
+	  break;
+	case GDK_Clear:
+	  gtk_text_delete_line (text);
+	  break;
+	case GDK_Insert:
+	  if (event->state & GDK_SHIFT_MASK)
+	    {
+	      extend_selection = FALSE;
+	      gtk_editable_paste_clipboard (editable);
+	    }
+	  else if (event->state & GDK_CONTROL_MASK)
+	    {
+	      gtk_editable_copy_clipboard (editable);
+	    }
+	  else
+	    {
+	      /* gtk_toggle_insert(text) -- IMPLEMENT */
+	    }
+	  break;
+	case GDK_Delete:
+	  if (event->state & GDK_CONTROL_MASK)
+	    gtk_text_delete_forward_word (text);
+	  else if (event->state & GDK_SHIFT_MASK)
+	    {
+	      extend_selection = FALSE;
+	      gtk_editable_cut_clipboard (editable);
+	    }
+	  else
+	    gtk_text_delete_forward_character (text);
+	  break;
+	case GDK_Tab:
+	  position = text->point.index;
+	  gtk_editable_insert_text (editable, "\t", 1, &position);
+	  break;
+	case GDK_Return:
+	  if (event->state & GDK_CONTROL_MASK)
+	    gtk_signal_emit_by_name (GTK_OBJECT (text), "activate");
+	  else
+	    {
+	      position = text->point.index;
+	      gtk_editable_insert_text (editable, "\n", 1, &position);
+	    }
+	  break;
+	case GDK_Escape:
+	  /* Don't insert literally */
+	  return_val = FALSE;
+	  break;
+	  
+	default:
+	  return_val = FALSE;
+	  
+	  if (event->state & GDK_CONTROL_MASK)
+	    {
+	      if ((key >= 'A') && (key <= 'Z'))
+		key -= 'A' - 'a';
+	      
+	      if ((key >= 'a') && (key <= 'z') && control_keys[(int) (key - 'a')])
+		{
+		  (* control_keys[(int) (key - 'a')]) (editable, event->time);
+		  return_val = TRUE;
+		}
+	      
+	      break;
+	    }
+	  else if (event->state & GDK_MOD1_MASK)
+	    {
+	      if ((key >= 'A') && (key <= 'Z'))
+		key -= 'A' - 'a';
+	      
+	      if ((key >= 'a') && (key <= 'z') && alt_keys[(int) (key - 'a')])
+		{
+		  (* alt_keys[(int) (key - 'a')]) (editable, event->time);
+		  return_val = TRUE;
+		}
+	      
+	      break;
+	    }
+	  else if (event->length > 0)
+	    {
+	      extend_selection = FALSE;
+	      
+	      gtk_editable_delete_selection (editable);
+	      position = text->point.index;
+	      gtk_editable_insert_text (editable, event->string, event->length, &position);
+	      
+	      return_val = TRUE;
+	    }
+	  else
+	    return_val = FALSE;
+	}
+      
+      if (return_val && (editable->current_pos != initial_pos))
+	{
+	  if (extend_selection)
+	    {
+	      if (editable->current_pos < editable->selection_start_pos)
+		gtk_text_set_selection (editable, editable->current_pos,
+					editable->selection_end_pos);
+	      else if (editable->current_pos > editable->selection_end_pos)
+		gtk_text_set_selection (editable, editable->selection_start_pos,
+					editable->current_pos);
+	      else
+		{
+		  if (extend_start)
+		    gtk_text_set_selection (editable, editable->current_pos,
+					    editable->selection_end_pos);
+		  else
+		    gtk_text_set_selection (editable, editable->selection_start_pos,
+					    editable->current_pos);
+		}
+	    }
+	  else
+	    gtk_text_set_selection (editable, 0, 0);
+	  
+	  gtk_editable_claim_selection (editable,
+					editable->selection_start_pos != editable->selection_end_pos,
+					event->time);
+	}
+    }
+  
+  return return_val;
+}
+
+static gint
+gtk_text_focus_in (GtkWidget     *widget,
+		   GdkEventFocus *event)
+{
+  g_return_val_if_fail (widget != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+  
+  TDEBUG (("in gtk_text_focus_in\n"));
+  
+  GTK_WIDGET_SET_FLAGS (widget, GTK_HAS_FOCUS);
+  gtk_widget_draw_focus (widget);
+  
+#ifdef USE_XIM
+  if (GTK_EDITABLE(widget)->ic)
+    gdk_im_begin (GTK_EDITABLE(widget)->ic, GTK_TEXT(widget)->text_area);
+#endif
+  
+  draw_cursor (GTK_TEXT(widget), TRUE);
+  
+  return FALSE;
+}
+
+static gint
+gtk_text_focus_out (GtkWidget     *widget,
+		    GdkEventFocus *event)
+{
+  g_return_val_if_fail (widget != NULL, FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
+  g_return_val_if_fail (event != NULL, FALSE);
+  
+  TDEBUG (("in gtk_text_focus_out\n"));
+  
+  GTK_WIDGET_UNSET_FLAGS (widget, GTK_HAS_FOCUS);
+  gtk_widget_draw_focus (widget);
+  
+  undraw_cursor (GTK_TEXT(widget), TRUE);
+  
+#ifdef USE_XIM
+  gdk_im_end ();
+#endif
+  
+  return FALSE;
+}
+
+static void
+gtk_text_adjustment (GtkAdjustment *adjustment,
+		     GtkText       *text)
+{
+  gfloat old_val;
+  
+  g_return_if_fail (adjustment != NULL);
+  g_return_if_fail (GTK_IS_ADJUSTMENT (adjustment));
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (GTK_IS_TEXT (text));
+
+  /* Clamp the value here, because we'll get really confused
+   * if someone tries to move the adjusment outside of the
+   * allowed bounds
+   */
+  old_val = adjustment->value;
+
+  adjustment->value = MIN (adjustment->value, adjustment->upper - adjustment->page_size);
+  adjustment->value = MAX (adjustment->value, 0.0);
+
+  if (adjustment->value != old_val)
+    {
+      gtk_signal_handler_block_by_func (GTK_OBJECT (adjustment),
+					GTK_SIGNAL_FUNC (gtk_text_adjustment),
+					text);
+      gtk_adjustment_changed (adjustment);
+      gtk_signal_handler_unblock_by_func (GTK_OBJECT (adjustment),
+					  GTK_SIGNAL_FUNC (gtk_text_adjustment),
+					  text);
+    }
+  
+  /* Just ignore it if we haven't been size-allocated and realized yet */
+  if (text->line_start_cache == NULL) 
+    return;
+  
+  if (adjustment == text->hadj)
+    {
+      g_warning ("horizontal scrolling not implemented");
+    }
+  else
+    {
+      gint diff = ((gint)adjustment->value) - text->last_ver_value;
+      gint height;
+      
+      if (diff != 0)
+	{
+	  undraw_cursor (text, FALSE);
+	  
+	  gdk_window_get_size (text->text_area, NULL, &height);
+	  
+	  /* Nothing that is on screen now will be after a scroll this
+	   * big, so go straight to the new position.
+	   */
+	  if (ABS (diff) > height &&
+	      !gtk_text_get_private (text)->cache_locked)
+	    scroll_jump (text, diff);
+	  else if (diff > 0)
+	    scroll_down (text, diff);
+	  else /* if (diff < 0) */
+	    scroll_up (text, diff);
+	  
+	  draw_cursor (text, FALSE);
+	  
+	  text->last_ver_value = adjustment->value;
+	}
+    }
+}
+
+static void
+gtk_text_disconnect (GtkAdjustment *adjustment,
+		     GtkText       *text)
+{
+  g_return_if_fail (adjustment != NULL);
+  g_return_if_fail (GTK_IS_ADJUSTMENT (adjustment));
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (GTK_IS_TEXT (text));
+
+  if (adjustment == text->hadj)
+    gtk_text_set_adjustments (text, NULL, text->vadj);
+  if (adjustment == text->vadj)
+    gtk_text_set_adjustments (text, text->hadj, NULL);
+}
+
+
+static GtkPropertyMark
+find_this_line_start_mark (GtkText* text, guint point_position, const GtkPropertyMark* near)
+{
+  GtkPropertyMark mark;
+  
+  mark = find_mark_near (text, point_position, near);
+  
+  while (mark.index > 0 &&
+	 GTK_TEXT_INDEX (text, mark.index - 1) != LINE_DELIM)
+    decrement_mark (&mark);
+  
+  return mark;
+}
+
+static void
+init_tab_cont (GtkText* text, PrevTabCont* tab_cont)
+{
+  tab_cont->pixel_offset          = 0;
+  tab_cont->tab_start.tab_stops   = text->tab_stops;
+  tab_cont->tab_start.to_next_tab = (gulong) text->tab_stops->data;
+  
+  if (!tab_cont->tab_start.to_next_tab)
+    tab_cont->tab_start.to_next_tab = text->default_tab_width;
+}
+
+static void
+line_params_iterate (GtkText* text,
+		     const GtkPropertyMark* mark0,
+		     const PrevTabCont* tab_mark0,
+		     gint8 alloc,
+		     void* data,
+		     LineIteratorFunction iter)
+     /* mark0 MUST be a real line start.  if ALLOC, allocate line params
+      * from a mem chunk.  DATA is passed to ITER_CALL, which is called
+      * for each line following MARK, iteration continues unless ITER_CALL
+      * returns TRUE. */
+{
+  GtkPropertyMark mark = *mark0;
+  PrevTabCont  tab_conts[2];
+  LineParams   *lp, lpbuf;
+  gint         tab_cont_index = 0;
+  
+  if (tab_mark0)
+    tab_conts[0] = *tab_mark0;
+  else
+    init_tab_cont (text, tab_conts);
+  
+  for (;;)
+    {
+      if (alloc)
+	lp = g_chunk_new (LineParams, params_mem_chunk);
+      else
+	lp = &lpbuf;
+      
+      *lp = find_line_params (text, &mark, tab_conts + tab_cont_index,
+			      tab_conts + (tab_cont_index + 1) % 2);
+      
+      if ((*iter) (text, lp, data))
+	return;
+      
+      if (LAST_INDEX (text, lp->end))
+	break;
+      
+      mark = lp->end;
+      advance_mark (&mark);
+      tab_cont_index = (tab_cont_index + 1) % 2;
+    }
+}
+
+static gint
+fetch_lines_iterator (GtkText* text, LineParams* lp, void* data)
+{
+  FetchLinesData *fldata = (FetchLinesData*) data;
+  
+  fldata->new_lines = g_list_prepend (fldata->new_lines, lp);
+  
+  switch (fldata->fl_type)
+    {
+    case FetchLinesCount:
+      if (!text->line_wrap || !lp->wraps)
+	fldata->data += 1;
+      
+      if (fldata->data >= fldata->data_max)
+	return TRUE;
+      
+      break;
+    case FetchLinesPixels:
+      
+      fldata->data += LINE_HEIGHT(*lp);
+      
+      if (fldata->data >= fldata->data_max)
+	return TRUE;
+      
+      break;
+    }
+  
+  return FALSE;
+}
+
+static GList*
+fetch_lines (GtkText* text,
+	     const GtkPropertyMark* mark0,
+	     const PrevTabCont* tab_cont0,
+	     FLType fl_type,
+	     gint data)
+{
+  FetchLinesData fl_data;
+  
+  fl_data.new_lines = NULL;
+  fl_data.data      = 0;
+  fl_data.data_max  = data;
+  fl_data.fl_type   = fl_type;
+  
+  line_params_iterate (text, mark0, tab_cont0, TRUE, &fl_data, fetch_lines_iterator);
+  
+  return g_list_reverse (fl_data.new_lines);
+}
+
+static void
+fetch_lines_backward (GtkText* text)
+{
+  GList* new_lines = NULL, *new_line_start;
+  GtkPropertyMark mark;
+  
+  if (CACHE_DATA(text->line_start_cache).start.index == 0)
+    return;
+  
+  mark = find_this_line_start_mark (text,
+				    CACHE_DATA(text->line_start_cache).start.index - 1,
+				    &CACHE_DATA(text->line_start_cache).start);
+  
+  new_line_start = new_lines = fetch_lines (text, &mark, NULL, FetchLinesCount, 1);
+  
+  while (new_line_start->next)
+    new_line_start = new_line_start->next;
+  
+  new_line_start->next = text->line_start_cache;
+  text->line_start_cache->prev = new_line_start;
+}
+
+static void
+fetch_lines_forward (GtkText* text, gint line_count)
+{
+  GtkPropertyMark mark;
+  GList* line = text->line_start_cache;
+  
+  while(line->next)
+    line = line->next;
+  
+  mark = CACHE_DATA(line).end;
+  
+  if (LAST_INDEX (text, mark))
+    return;
+  
+  advance_mark(&mark);
+  
+  line->next = fetch_lines (text, &mark, &CACHE_DATA(line).tab_cont_next, FetchLinesCount, line_count);
+  
+  if (line->next)
+    line->next->prev = line;
+}
+
+/* Compute the number of lines, and vertical pixels for n characters
+ * starting from the point 
+ */
+static void
+compute_lines_pixels (GtkText* text, guint char_count,
+		      guint *lines, guint *pixels)
+{
+  GList *line = text->current_line;
+  gint chars_left = char_count;
+  
+  *lines = 0;
+  *pixels = 0;
+  
+  /* If chars_left == 0, that means we're joining two lines in a
+   * deletion, so add in the values for the next line as well 
+   */
+  for (; line && chars_left >= 0; line = line->next)
+    {
+      *pixels += LINE_HEIGHT(CACHE_DATA(line));
+      
+      if (line == text->current_line)
+	chars_left -= CACHE_DATA(line).end.index - text->point.index + 1;
+      else
+	chars_left -= CACHE_DATA(line).end.index - CACHE_DATA(line).start.index + 1;
+      
+      if (!text->line_wrap || !CACHE_DATA(line).wraps)
+	*lines += 1;
+      else
+	if (chars_left < 0)
+	  chars_left = 0;	/* force another loop */
+      
+      if (!line->next)
+	fetch_lines_forward (text, 1);
+    }
+}
+
+static gint
+total_line_height (GtkText* text, GList* line, gint line_count)
+{
+  gint height = 0;
+  
+  for (; line && line_count > 0; line = line->next)
+    {
+      height += LINE_HEIGHT(CACHE_DATA(line));
+      
+      if (!text->line_wrap || !CACHE_DATA(line).wraps)
+	line_count -= 1;
+      
+      if (!line->next)
+	fetch_lines_forward (text, line_count);
+    }
+  
+  return height;
+}
+
+static void
+swap_lines (GtkText* text, GList* old, GList* new, guint old_line_count)
+{
+  if (old == text->line_start_cache)
+    {
+      GList* last;
+      
+      for (; old_line_count > 0; old_line_count -= 1)
+	{
+	  while (text->line_start_cache &&
+		 text->line_wrap &&
+		 CACHE_DATA(text->line_start_cache).wraps)
+	    remove_cache_line(text, text->line_start_cache);
+	  
+	  remove_cache_line(text, text->line_start_cache);
+	}
+      
+      last = g_list_last (new);
+      
+      last->next = text->line_start_cache;
+      
+      if (text->line_start_cache)
+	text->line_start_cache->prev = last;
+      
+      text->line_start_cache = new;
+    }
+  else
+    {
+      GList *last;
+      
+      g_assert (old->prev);
+      
+      last = old->prev;
+      
+      for (; old_line_count > 0; old_line_count -= 1)
+	{
+	  while (old && text->line_wrap && CACHE_DATA(old).wraps)
+	    old = remove_cache_line (text, old);
+	  
+	  old = remove_cache_line (text, old);
+	}
+      
+      last->next = new;
+      new->prev = last;
+      
+      last = g_list_last (new);
+      
+      last->next = old;
+      
+      if (old)
+	old->prev = last;
+    }
+}
+
+static void
+correct_cache_delete (GtkText* text, gint nchars, gint lines)
+{
+  GList* cache = text->current_line;
+  gint i;
+  
+  for (i = 0; cache && i < lines; i += 1, cache = cache->next)
+    /* nothing */;
+  
+  for (; cache; cache = cache->next)
+    {
+      GtkPropertyMark *start = &CACHE_DATA(cache).start;
+      GtkPropertyMark *end = &CACHE_DATA(cache).end;
+      
+      start->index -= nchars;
+      end->index -= nchars;
+      
+      if (LAST_INDEX (text, text->point) &&
+	  start->index == text->point.index)
+	*start = text->point;
+      else if (start->property == text->point.property)
+	start->offset = start->index - (text->point.index - text->point.offset);
+      
+      if (LAST_INDEX (text, text->point) &&
+	  end->index == text->point.index)
+	*end = text->point;
+      if (end->property == text->point.property)
+	end->offset = end->index - (text->point.index - text->point.offset);
+      
+      /*TEXT_ASSERT_MARK(text, start, "start");*/
+      /*TEXT_ASSERT_MARK(text, end, "end");*/
+    }
+}
+
+static void
+delete_expose (GtkText* text, guint nchars, guint old_lines, guint old_pixels)
+{
+  GtkWidget *widget = GTK_WIDGET (text);
+  
+  gint pixel_height;
+  guint new_pixels = 0;
+  GdkRectangle rect;
+  GList* new_line = NULL;
+  gint width, height;
+  
+  text->cursor_virtual_x = 0;
+  
+  correct_cache_delete (text, nchars, old_lines);
+  
+  pixel_height = pixel_height_of(text, text->current_line) -
+    LINE_HEIGHT(CACHE_DATA(text->current_line));
+  
+  if (CACHE_DATA(text->current_line).start.index == text->point.index)
+    CACHE_DATA(text->current_line).start = text->point;
+  
+  new_line = fetch_lines (text,
+			  &CACHE_DATA(text->current_line).start,
+			  &CACHE_DATA(text->current_line).tab_cont,
+			  FetchLinesCount,
+			  1);
+  
+  swap_lines (text, text->current_line, new_line, old_lines);
+  
+  text->current_line = new_line;
+  
+  new_pixels = total_line_height (text, new_line, 1);
+  
+  gdk_window_get_size (text->text_area, &width, &height);
+  
+  if (old_pixels != new_pixels)
+    {
+      if (!widget->style->bg_pixmap[GTK_STATE_NORMAL])
+	{
+	  gdk_draw_pixmap (text->text_area,
+			   text->gc,
+			   text->text_area,
+			   0,
+			   pixel_height + old_pixels,
+			   0,
+			   pixel_height + new_pixels,
+			   width,
+			   height);
+	}
+      text->vadj->upper += new_pixels;
+      text->vadj->upper -= old_pixels;
+      adjust_adj (text, text->vadj);
+    }
+  
+  rect.x = 0;
+  rect.y = pixel_height;
+  rect.width = width;
+  rect.height = new_pixels;
+  
+  expose_text (text, &rect, FALSE);
+  gtk_text_draw_focus ( (GtkWidget *) text);
+  
+  text->cursor_mark = text->point;
+  
+  find_cursor (text, TRUE);
+  
+  if (old_pixels != new_pixels)
+    {
+      if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
+	{
+	  rect.x = 0;
+	  rect.y = pixel_height + new_pixels;
+	  rect.width = width;
+	  rect.height = height - rect.y;
 	  
-	  if (event->state & GDK_CONTROL_MASK)
-	    {
-	      if ((key >= 'A') && (key <= 'Z'))
-		key -= 'A' - 'a';
-	      
-	      if ((key >= 'a') && (key <= 'z') && control_keys[(int) (key - 'a')])
-		{
-		  (* control_keys[(int) (key - 'a')]) (editable, event->time);
-		  return_val = TRUE;
-		}
-	      
-	      break;
-	    }
-	  else if (event->state & GDK_MOD1_MASK)
+	  expose_text (text, &rect, FALSE);
+	}
+      else
+	process_exposes (text);
+    }
+  
+  TEXT_ASSERT (text);
+  TEXT_SHOW(text);
+}
+
+/* note, the point has already been moved forward */
+static void
+correct_cache_insert (GtkText* text, gint nchars)
+{
+  GList *cache;
+  GtkPropertyMark *start;
+  GtkPropertyMark *end;
+  
+  /* If we inserted a property exactly at the beginning of the
+   * line, we have to correct here, or fetch_lines will
+   * fetch junk.
+   */
+  start = &CACHE_DATA(text->current_line).start;
+  if (start->index == text->point.index - nchars)
+    {
+      *start = text->point;
+      move_mark_n (start, -nchars);
+    }
+
+  /* Now correct the offsets, and check for start or end marks that
+   * are after the point, yet point to a property before the point's
+   * property. This indicates that they are meant to point to the
+   * second half of a property we split in insert_text_property(), so
+   * we fix them up that way.  
+   */
+  cache = text->current_line->next;
+  
+  for (; cache; cache = cache->next)
+    {
+      start = &CACHE_DATA(cache).start;
+      end = &CACHE_DATA(cache).end;
+      
+      if (LAST_INDEX (text, text->point) &&
+	  start->index == text->point.index)
+	*start = text->point;
+      else
+	{
+	  if (start->property == text->point.property)
 	    {
-	      if ((key >= 'A') && (key <= 'Z'))
-		key -= 'A' - 'a';
-	      
-	      if ((key >= 'a') && (key <= 'z') && alt_keys[(int) (key - 'a')])
-		{
-		  (* alt_keys[(int) (key - 'a')]) (editable, event->time);
-		  return_val = TRUE;
-		}
-	      
-	      break;
+	      start->offset += nchars;
+	      start->index += nchars;
 	    }
-	  else if (event->length > 0)
+	  else if (start->property->next &&
+		   (start->property->next->next == text->point.property))
 	    {
-	      extend_selection = FALSE;
-	      
-	      gtk_editable_delete_selection (editable);
-	      position = text->point.index;
-	      gtk_editable_insert_text (editable, event->string, event->length, &position);
-	      
-	      return_val = TRUE;
+	      /* We split the property, and this is the second half */
+	      start->offset -= MARK_CURRENT_PROPERTY (start)->length;
+	      start->index += nchars;
+	      start->property = text->point.property;
 	    }
 	  else
-	    return_val = FALSE;
+	    start->index += nchars;
 	}
       
-      if (return_val && (editable->current_pos != initial_pos))
+      if (LAST_INDEX (text, text->point) &&
+	  end->index == text->point.index)
+	*end = text->point;
+      else
 	{
-	  if (extend_selection)
+	  if (end->property == text->point.property)
 	    {
-	      if (editable->current_pos < editable->selection_start_pos)
-		gtk_text_set_selection (editable, editable->current_pos,
-					editable->selection_end_pos);
-	      else if (editable->current_pos > editable->selection_end_pos)
-		gtk_text_set_selection (editable, editable->selection_start_pos,
-					editable->current_pos);
-	      else
-		{
-		  if (extend_start)
-		    gtk_text_set_selection (editable, editable->current_pos,
-					    editable->selection_end_pos);
-		  else
-		    gtk_text_set_selection (editable, editable->selection_start_pos,
-					    editable->current_pos);
-		}
+	      end->offset += nchars;
+	      end->index += nchars;
+	    }
+	  else if (end->property->next &&
+		   (end->property->next->next == text->point.property))
+	    {
+	      /* We split the property, and this is the second half */
+	      end->offset -= MARK_CURRENT_PROPERTY (end)->length;
+	      end->index += nchars;
+	      end->property = text->point.property;
 	    }
 	  else
-	    gtk_text_set_selection (editable, 0, 0);
-	  
-	  gtk_editable_claim_selection (editable,
-					editable->selection_start_pos != editable->selection_end_pos,
-					event->time);
+	    end->index += nchars;
 	}
+      
+      /*TEXT_ASSERT_MARK(text, start, "start");*/
+      /*TEXT_ASSERT_MARK(text, end, "end");*/
     }
-  
-  return return_val;
 }
 
-static gint
-gtk_text_focus_in (GtkWidget     *widget,
-		   GdkEventFocus *event)
+
+static void
+insert_expose (GtkText* text, guint old_pixels, gint nchars,
+	       guint new_line_count)
 {
-  g_return_val_if_fail (widget != NULL, FALSE);
-  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
-  g_return_val_if_fail (event != NULL, FALSE);
+  GtkWidget *widget = GTK_WIDGET (text);
   
-  TDEBUG (("in gtk_text_focus_in\n"));
+  gint pixel_height;
+  guint new_pixels = 0;
+  GdkRectangle rect;
+  GList* new_lines = NULL;
+  gint width, height;
   
-  GTK_WIDGET_SET_FLAGS (widget, GTK_HAS_FOCUS);
-  gtk_widget_draw_focus (widget);
+  text->cursor_virtual_x = 0;
   
-#ifdef USE_XIM
-  if (GTK_EDITABLE(widget)->ic)
-    gdk_im_begin (GTK_EDITABLE(widget)->ic, GTK_TEXT(widget)->text_area);
-#endif
+  undraw_cursor (text, FALSE);
   
-  draw_cursor (GTK_TEXT(widget), TRUE);
+  correct_cache_insert (text, nchars);
   
-  return FALSE;
-}
-
-static gint
-gtk_text_focus_out (GtkWidget     *widget,
-		    GdkEventFocus *event)
-{
-  g_return_val_if_fail (widget != NULL, FALSE);
-  g_return_val_if_fail (GTK_IS_TEXT (widget), FALSE);
-  g_return_val_if_fail (event != NULL, FALSE);
+  TEXT_SHOW_ADJ (text, text->vadj, "vadj");
   
-  TDEBUG (("in gtk_text_focus_out\n"));
+  pixel_height = pixel_height_of(text, text->current_line) -
+    LINE_HEIGHT(CACHE_DATA(text->current_line));
   
-  GTK_WIDGET_UNSET_FLAGS (widget, GTK_HAS_FOCUS);
-  gtk_widget_draw_focus (widget);
+  new_lines = fetch_lines (text,
+			   &CACHE_DATA(text->current_line).start,
+			   &CACHE_DATA(text->current_line).tab_cont,
+			   FetchLinesCount,
+			   new_line_count);
   
-  undraw_cursor (GTK_TEXT(widget), TRUE);
+  swap_lines (text, text->current_line, new_lines, 1);
   
-#ifdef USE_XIM
-  gdk_im_end ();
-#endif
+  text->current_line = new_lines;
   
-  return FALSE;
-}
-
-static void
-gtk_text_adjustment (GtkAdjustment *adjustment,
-		     GtkText       *text)
-{
-  gfloat old_val;
+  new_pixels = total_line_height (text, new_lines, new_line_count);
   
-  g_return_if_fail (adjustment != NULL);
-  g_return_if_fail (GTK_IS_ADJUSTMENT (adjustment));
-  g_return_if_fail (text != NULL);
-  g_return_if_fail (GTK_IS_TEXT (text));
-
-  /* Clamp the value here, because we'll get really confused
-   * if someone tries to move the adjusment outside of the
-   * allowed bounds
-   */
-  old_val = adjustment->value;
-
-  adjustment->value = MIN (adjustment->value, adjustment->upper - adjustment->page_size);
-  adjustment->value = MAX (adjustment->value, 0.0);
-
-  if (adjustment->value != old_val)
+  gdk_window_get_size (text->text_area, &width, &height);
+  
+  if (old_pixels != new_pixels)
     {
-      gtk_signal_handler_block_by_func (GTK_OBJECT (adjustment),
-					GTK_SIGNAL_FUNC (gtk_text_adjustment),
-					text);
-      gtk_adjustment_changed (adjustment);
-      gtk_signal_handler_unblock_by_func (GTK_OBJECT (adjustment),
-					  GTK_SIGNAL_FUNC (gtk_text_adjustment),
-					  text);
+      if (!widget->style->bg_pixmap[GTK_STATE_NORMAL])
+	{
+	  gdk_draw_pixmap (text->text_area,
+			   text->gc,
+			   text->text_area,
+			   0,
+			   pixel_height + old_pixels,
+			   0,
+			   pixel_height + new_pixels,
+			   width,
+			   height + (old_pixels - new_pixels) - pixel_height);
+	  
+	}
+      text->vadj->upper += new_pixels;
+      text->vadj->upper -= old_pixels;
+      adjust_adj (text, text->vadj);
     }
   
-  /* Just ignore it if we haven't been size-allocated and realized yet */
-  if (text->line_start_cache == NULL) 
-    return;
+  rect.x = 0;
+  rect.y = pixel_height;
+  rect.width = width;
+  rect.height = new_pixels;
+  
+  expose_text (text, &rect, FALSE);
+  gtk_text_draw_focus ( (GtkWidget *) text);
+  
+  text->cursor_mark = text->point;
+  
+  find_cursor (text, TRUE);
   
-  if (adjustment == text->hadj)
-    {
-      g_warning ("horizontal scrolling not implemented");
-    }
-  else
+  draw_cursor (text, FALSE);
+  
+  if (old_pixels != new_pixels)
     {
-      gint diff = ((gint)adjustment->value) - text->last_ver_value;
-      
-      if (diff != 0)
+      if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
 	{
-	  undraw_cursor (text, FALSE);
-	  
-	  if (diff > 0)
-	    scroll_down (text, diff);
-	  else /* if (diff < 0) */
-	    scroll_up (text, diff);
-	  
-	  draw_cursor (text, FALSE);
+	  rect.x = 0;
+	  rect.y = pixel_height + new_pixels;
+	  rect.width = width;
+	  rect.height = height - rect.y;
 	  
-	  text->last_ver_value = adjustment->value;
+	  expose_text (text, &rect, FALSE);
 	}
+      else
+	process_exposes (text);
     }
+  
+  TEXT_SHOW_ADJ (text, text->vadj, "vadj");
+  TEXT_ASSERT (text);
+  TEXT_SHOW(text);
 }
 
-static void
-gtk_text_disconnect (GtkAdjustment *adjustment,
-		     GtkText       *text)
-{
-  g_return_if_fail (adjustment != NULL);
-  g_return_if_fail (GTK_IS_ADJUSTMENT (adjustment));
-  g_return_if_fail (text != NULL);
-  g_return_if_fail (GTK_IS_TEXT (text));
+/* Text property functions */
 
-  if (adjustment == text->hadj)
-    gtk_text_set_adjustments (text, NULL, text->vadj);
-  if (adjustment == text->vadj)
-    gtk_text_set_adjustments (text, text->hadj, NULL);
+static guint
+font_hash (gconstpointer font)
+{
+  return gdk_font_id ((const GdkFont*) font);
 }
 
+static GHashTable *font_cache_table = NULL;
 
-static GtkPropertyMark
-find_this_line_start_mark (GtkText* text, guint point_position, const GtkPropertyMark* near)
+static GtkTextFont*
+get_text_font (GdkFont* gfont)
 {
-  GtkPropertyMark mark;
+  GtkTextFont* tf;
+  gint i;
   
-  mark = find_mark_near (text, point_position, near);
+  if (!font_cache_table)
+    font_cache_table = g_hash_table_new (font_hash, (GCompareFunc) gdk_font_equal);
   
-  while (mark.index > 0 &&
-	 GTK_TEXT_INDEX (text, mark.index - 1) != LINE_DELIM)
-    decrement_mark (&mark);
+  tf = g_hash_table_lookup (font_cache_table, gfont);
   
-  return mark;
-}
+  if (tf)
+    {
+      tf->ref_count++;
+      return tf;
+    }
 
-static void
-init_tab_cont (GtkText* text, PrevTabCont* tab_cont)
-{
-  tab_cont->pixel_offset          = 0;
-  tab_cont->tab_start.tab_stops   = text->tab_stops;
-  tab_cont->tab_start.to_next_tab = (gulong) text->tab_stops->data;
+  tf = g_new (GtkTextFont, 1);
+  tf->ref_count = 1;
+
+  tf->gdk_font = gfont;
+  gdk_font_ref (gfont);
   
-  if (!tab_cont->tab_start.to_next_tab)
-    tab_cont->tab_start.to_next_tab = text->default_tab_width;
+  for(i = 0; i < 256; i += 1)
+    tf->char_widths[i] = gdk_char_width (gfont, (char)i);
+  
+  g_hash_table_insert (font_cache_table, gfont, tf);
+  
+  return tf;
 }
 
 static void
-line_params_iterate (GtkText* text,
-		     const GtkPropertyMark* mark0,
-		     const PrevTabCont* tab_mark0,
-		     gint8 alloc,
-		     void* data,
-		     LineIteratorFunction iter)
-     /* mark0 MUST be a real line start.  if ALLOC, allocate line params
-      * from a mem chunk.  DATA is passed to ITER_CALL, which is called
-      * for each line following MARK, iteration continues unless ITER_CALL
-      * returns TRUE. */
+text_font_unref (GtkTextFont *text_font)
 {
-  GtkPropertyMark mark = *mark0;
-  PrevTabCont  tab_conts[2];
-  LineParams   *lp, lpbuf;
-  gint         tab_cont_index = 0;
-  
-  if (tab_mark0)
-    tab_conts[0] = *tab_mark0;
-  else
-    init_tab_cont (text, tab_conts);
-  
-  for (;;)
+  text_font->ref_count--;
+  if (text_font->ref_count == 0)
     {
-      if (alloc)
-	lp = g_chunk_new (LineParams, params_mem_chunk);
-      else
-	lp = &lpbuf;
-      
-      *lp = find_line_params (text, &mark, tab_conts + tab_cont_index,
-			      tab_conts + (tab_cont_index + 1) % 2);
-      
-      if ((*iter) (text, lp, data))
-	return;
-      
-      if (LAST_INDEX (text, lp->end))
-	break;
-      
-      mark = lp->end;
-      advance_mark (&mark);
-      tab_cont_index = (tab_cont_index + 1) % 2;
+      g_hash_table_remove (font_cache_table, text_font->gdk_font);
+      gdk_font_unref (text_font->gdk_font);
+      g_free (text_font);
     }
 }
 
 static gint
-fetch_lines_iterator (GtkText* text, LineParams* lp, void* data)
+text_properties_equal (TextProperty* prop, GdkFont* font, GdkColor *fore, GdkColor *back)
 {
-  FetchLinesData *fldata = (FetchLinesData*) data;
-  
-  fldata->new_lines = g_list_prepend (fldata->new_lines, lp);
-  
-  switch (fldata->fl_type)
+  if (prop->flags & PROPERTY_FONT)
     {
-    case FetchLinesCount:
-      if (!text->line_wrap || !lp->wraps)
-	fldata->data += 1;
-      
-      if (fldata->data >= fldata->data_max)
-	return TRUE;
-      
-      break;
-    case FetchLinesPixels:
-      
-      fldata->data += LINE_HEIGHT(*lp);
-      
-      if (fldata->data >= fldata->data_max)
-	return TRUE;
+      gboolean retval;
+      GtkTextFont *text_font;
+
+      if (!font)
+	return FALSE;
+
+      text_font = get_text_font (font);
+
+      retval = (prop->font == text_font);
+      text_font_unref (text_font);
       
-      break;
+      if (!retval)
+	return FALSE;
     }
-  
-  return FALSE;
-}
+  else
+    if (font != NULL)
+      return FALSE;
 
-static GList*
-fetch_lines (GtkText* text,
-	     const GtkPropertyMark* mark0,
-	     const PrevTabCont* tab_cont0,
-	     FLType fl_type,
-	     gint data)
-{
-  FetchLinesData fl_data;
-  
-  fl_data.new_lines = NULL;
-  fl_data.data      = 0;
-  fl_data.data_max  = data;
-  fl_data.fl_type   = fl_type;
-  
-  line_params_iterate (text, mark0, tab_cont0, TRUE, &fl_data, fetch_lines_iterator);
+  if (prop->flags & PROPERTY_FOREGROUND)
+    {
+      if (!fore || !gdk_color_equal (&prop->fore_color, fore))
+	return FALSE;
+    }
+  else
+    if (fore != NULL)
+      return FALSE;
+
+  if (prop->flags & PROPERTY_BACKGROUND)
+    {
+      if (!back || !gdk_color_equal (&prop->back_color, back))
+	return FALSE;
+    }
+  else
+    if (back != NULL)
+      return FALSE;
   
-  return g_list_reverse (fl_data.new_lines);
+  return TRUE;
 }
 
 static void
-fetch_lines_backward (GtkText* text)
+realize_property (GtkText *text, TextProperty *prop)
 {
-  GList* new_lines = NULL, *new_line_start;
-  GtkPropertyMark mark;
-  
-  if (CACHE_DATA(text->line_start_cache).start.index == 0)
-    return;
-  
-  mark = find_this_line_start_mark (text,
-				    CACHE_DATA(text->line_start_cache).start.index - 1,
-				    &CACHE_DATA(text->line_start_cache).start);
-  
-  new_line_start = new_lines = fetch_lines (text, &mark, NULL, FetchLinesCount, 1);
-  
-  while (new_line_start->next)
-    new_line_start = new_line_start->next;
+  GdkColormap *colormap = gtk_widget_get_colormap (GTK_WIDGET (text));
+
+  if (prop->flags & PROPERTY_FOREGROUND)
+    gdk_colormap_alloc_color (colormap, &prop->fore_color, FALSE, FALSE);
   
-  new_line_start->next = text->line_start_cache;
-  text->line_start_cache->prev = new_line_start;
+  if (prop->flags & PROPERTY_BACKGROUND)
+    gdk_colormap_alloc_color (colormap, &prop->back_color, FALSE, FALSE);
 }
 
 static void
-fetch_lines_forward (GtkText* text, gint line_count)
+realize_properties (GtkText *text)
 {
-  GtkPropertyMark mark;
-  GList* line = text->line_start_cache;
-  
-  while(line->next)
-    line = line->next;
-  
-  mark = CACHE_DATA(line).end;
-  
-  if (LAST_INDEX (text, mark))
-    return;
-  
-  advance_mark(&mark);
-  
-  line->next = fetch_lines (text, &mark, &CACHE_DATA(line).tab_cont_next, FetchLinesCount, line_count);
-  
-  if (line->next)
-    line->next->prev = line;
+  GList *tmp_list = text->text_properties;
+
+  while (tmp_list)
+    {
+      realize_property (text, tmp_list->data);
+      
+      tmp_list = tmp_list->next;
+    }
 }
 
-/* Compute the number of lines, and vertical pixels for n characters
- * starting from the point 
- */
 static void
-compute_lines_pixels (GtkText* text, guint char_count,
-		      guint *lines, guint *pixels)
+unrealize_property (GtkText *text, TextProperty *prop)
 {
-  GList *line = text->current_line;
-  gint chars_left = char_count;
-  
-  *lines = 0;
-  *pixels = 0;
+  GdkColormap *colormap = gtk_widget_get_colormap (GTK_WIDGET (text));
+
+  if (prop->flags & PROPERTY_FOREGROUND)
+    gdk_colormap_free_colors (colormap, &prop->fore_color, 1);
   
-  /* If chars_left == 0, that means we're joining two lines in a
-   * deletion, so add in the values for the next line as well 
-   */
-  for (; line && chars_left >= 0; line = line->next)
+  if (prop->flags & PROPERTY_BACKGROUND)
+    gdk_colormap_free_colors (colormap, &prop->back_color, 1);
+}
+
+static void
+unrealize_properties (GtkText *text)
+{
+  GList *tmp_list = text->text_properties;
+
+  while (tmp_list)
     {
-      *pixels += LINE_HEIGHT(CACHE_DATA(line));
-      
-      if (line == text->current_line)
-	chars_left -= CACHE_DATA(line).end.index - text->point.index + 1;
-      else
-	chars_left -= CACHE_DATA(line).end.index - CACHE_DATA(line).start.index + 1;
-      
-      if (!text->line_wrap || !CACHE_DATA(line).wraps)
-	*lines += 1;
-      else
-	if (chars_left < 0)
-	  chars_left = 0;	/* force another loop */
-      
-      if (!line->next)
-	fetch_lines_forward (text, 1);
+      unrealize_property (text, tmp_list->data);
+
+      tmp_list = tmp_list->next;
     }
 }
 
-static gint
-total_line_height (GtkText* text, GList* line, gint line_count)
+static TextProperty*
+new_text_property (GtkText *text, GdkFont *font, GdkColor* fore, 
+		   GdkColor* back, guint length)
 {
-  gint height = 0;
+  TextProperty *prop;
   
-  for (; line && line_count > 0; line = line->next)
+  if (text_property_chunk == NULL)
     {
-      height += LINE_HEIGHT(CACHE_DATA(line));
-      
-      if (!text->line_wrap || !CACHE_DATA(line).wraps)
-	line_count -= 1;
-      
-      if (!line->next)
-	fetch_lines_forward (text, line_count);
+      text_property_chunk = g_mem_chunk_new ("text property mem chunk",
+					     sizeof(TextProperty),
+					     1024*sizeof(TextProperty),
+					     G_ALLOC_AND_FREE);
     }
   
-  return height;
-}
+  prop = g_chunk_new(TextProperty, text_property_chunk);
 
-static void
-swap_lines (GtkText* text, GList* old, GList* new, guint old_line_count)
-{
-  if (old == text->line_start_cache)
+  prop->flags = 0;
+  if (font)
     {
-      GList* last;
-      
-      for (; old_line_count > 0; old_line_count -= 1)
-	{
-	  while (text->line_start_cache &&
-		 text->line_wrap &&
-		 CACHE_DATA(text->line_start_cache).wraps)
-	    remove_cache_line(text, text->line_start_cache);
-	  
-	  remove_cache_line(text, text->line_start_cache);
-	}
-      
-      last = g_list_last (new);
-      
-      last->next = text->line_start_cache;
-      
-      if (text->line_start_cache)
-	text->line_start_cache->prev = last;
-      
-      text->line_start_cache = new;
+      prop->flags |= PROPERTY_FONT;
+      prop->font = get_text_font (font);
     }
   else
+    prop->font = NULL;
+  
+  if (fore)
     {
-      GList *last;
-      
-      g_assert (old->prev);
-      
-      last = old->prev;
-      
-      for (; old_line_count > 0; old_line_count -= 1)
-	{
-	  while (old && text->line_wrap && CACHE_DATA(old).wraps)
-	    old = remove_cache_line (text, old);
-	  
-	  old = remove_cache_line (text, old);
-	}
-      
-      last->next = new;
-      new->prev = last;
-      
-      last = g_list_last (new);
-      
-      last->next = old;
+      prop->flags |= PROPERTY_FOREGROUND;
+      prop->fore_color = *fore;
+    }
       
-      if (old)
-	old->prev = last;
+  if (back)
+    {
+      prop->flags |= PROPERTY_BACKGROUND;
+      prop->back_color = *back;
     }
+
+  prop->length = length;
+
+  prop->node.parent = NULL;
+  prop->node.left = NULL;
+  prop->node.right = NULL;
+  prop->node.priority = 0;
+  prop->link = NULL;
+  prop->total = length;
+
+  if (GTK_WIDGET_REALIZED (text))
+    realize_property (text, prop);
+
+  return prop;
 }
 
 static void
-correct_cache_delete (GtkText* text, gint nchars, gint lines)
+destroy_text_property (TextProperty *prop)
 {
-  GList* cache = text->current_line;
-  gint i;
-  
-  for (i = 0; cache && i < lines; i += 1, cache = cache->next)
-    /* nothing */;
+  if (prop->font)
+    text_font_unref (prop->font);
   
-  for (; cache; cache = cache->next)
-    {
-      GtkPropertyMark *start = &CACHE_DATA(cache).start;
-      GtkPropertyMark *end = &CACHE_DATA(cache).end;
-      
-      start->index -= nchars;
-      end->index -= nchars;
-      
-      if (LAST_INDEX (text, text->point) &&
-	  start->index == text->point.index)
-	*start = text->point;
-      else if (start->property == text->point.property)
-	start->offset = start->index - (text->point.index - text->point.offset);
-      
-      if (LAST_INDEX (text, text->point) &&
-	  end->index == text->point.index)
-	*end = text->point;
-      if (end->property == text->point.property)
-	end->offset = end->index - (text->point.index - text->point.offset);
-      
-      /*TEXT_ASSERT_MARK(text, start, "start");*/
-      /*TEXT_ASSERT_MARK(text, end, "end");*/
-    }
+  g_mem_chunk_free (text_property_chunk, prop);
+}
+
+static guint
+text_tree_priority (void)
+{
+  static guint32 seed = 1;
+
+  seed = seed * 1103515245 + 12345;
+
+  return seed >> 8;
 }
 
+/* Must be called whenever the sums kept in node change, so that the
+ * subtree sums above it stay correct.
+ */
 static void
-delete_expose (GtkText* text, guint nchars, guint old_lines, guint old_pixels)
+text_tree_changed (TextTreeNode *node, TextTreeUpdate update)
 {
-  GtkWidget *widget = GTK_WIDGET (text);
-  
-  gint pixel_height;
-  guint new_pixels = 0;
-  GdkRectangle rect;
-  GList* new_line = NULL;
-  gint width, height;
-  
-  text->cursor_virtual_x = 0;
-  
-  correct_cache_delete (text, nchars, old_lines);
-  
-  pixel_height = pixel_height_of(text, text->current_line) -
-    LINE_HEIGHT(CACHE_DATA(text->current_line));
-  
-  if (CACHE_DATA(text->current_line).start.index == text->point.index)
-    CACHE_DATA(text->current_line).start = text->point;
-  
-  new_line = fetch_lines (text,
-			  &CACHE_DATA(text->current_line).start,
-			  &CACHE_DATA(text->current_line).tab_cont,
-			  FetchLinesCount,
-			  1);
-  
-  swap_lines (text, text->current_line, new_line, old_lines);
-  
-  text->current_line = new_line;
-  
-  new_pixels = total_line_height (text, new_line, 1);
-  
-  gdk_window_get_size (text->text_area, &width, &height);
-  
-  if (old_pixels != new_pixels)
-    {
-      if (!widget->style->bg_pixmap[GTK_STATE_NORMAL])
-	{
-	  gdk_draw_pixmap (text->text_area,
-			   text->gc,
-			   text->text_area,
-			   0,
-			   pixel_height + old_pixels,
-			   0,
-			   pixel_height + new_pixels,
-			   width,
-			   height);
-	}
-      text->vadj->upper += new_pixels;
-      text->vadj->upper -= old_pixels;
-      adjust_adj (text, text->vadj);
+  for (; node; node = node->parent)
+    update (node);
+}
+
+static TextTreeNode *
+text_tree_root (TextTreeNode *node)
+{
+  if (node)
+    while (node->parent)
+      node = node->parent;
+
+  return node;
+}
+
+static TextTreeNode *
+text_tree_first (TextTreeNode *node)
+{
+  if (node)
+    while (node->left)
+      node = node->left;
+
+  return node;
+}
+
+static TextTreeNode *
+text_tree_last (TextTreeNode *node)
+{
+  if (node)
+    while (node->right)
+      node = node->right;
+
+  return node;
+}
+
+static TextTreeNode *
+text_tree_next (TextTreeNode *node)
+{
+  if (node->right)
+    return text_tree_first (node->right);
+
+  while (node->parent && node->parent->right == node)
+    node = node->parent;
+
+  return node->parent;
+}
+
+static TextTreeNode *
+text_tree_prev (TextTreeNode *node)
+{
+  if (node->left)
+    return text_tree_last (node->left);
+
+  while (node->parent && node->parent->left == node)
+    node = node->parent;
+
+  return node->parent;
+}
+
+/* Rotate node above its parent, keeping the text order intact. */
+static void
+text_tree_rotate_up (TextTreeNode *node, TextTreeUpdate update)
+{
+  TextTreeNode *parent = node->parent;
+  TextTreeNode *grandparent = parent->parent;
+
+  if (parent->left == node)
+    {
+      parent->left = node->right;
+      if (node->right)
+	node->right->parent = parent;
+      node->right = parent;
     }
-  
-  rect.x = 0;
-  rect.y = pixel_height;
-  rect.width = width;
-  rect.height = new_pixels;
-  
-  expose_text (text, &rect, FALSE);
-  gtk_text_draw_focus ( (GtkWidget *) text);
-  
-  text->cursor_mark = text->point;
-  
-  find_cursor (text, TRUE);
-  
-  if (old_pixels != new_pixels)
+  else
     {
-      if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
-	{
-	  rect.x = 0;
-	  rect.y = pixel_height + new_pixels;
-	  rect.width = width;
-	  rect.height = height - rect.y;
-	  
-	  expose_text (text, &rect, FALSE);
-	}
+      parent->right = node->left;
+      if (node->left)
+	node->left->parent = parent;
+      node->left = parent;
+    }
+
+  parent->parent = node;
+  node->parent = grandparent;
+
+  if (grandparent)
+    {
+      if (grandparent->left == parent)
+	grandparent->left = node;
       else
-	process_exposes (text);
+	grandparent->right = node;
     }
-  
-  TEXT_ASSERT (text);
-  TEXT_SHOW(text);
+
+  update (parent);
+  update (node);
 }
 
-/* note, the point has already been moved forward */
-static void
-correct_cache_insert (GtkText* text, gint nchars)
+/* Link node into the tree right after prev, or, if prev is NULL,
+ * right before next.  With neither, node makes a tree of its own.
+ * Returns the root of the tree.
+ */
+static TextTreeNode *
+text_tree_insert (TextTreeNode *prev,
+		  TextTreeNode *next,
+		  TextTreeNode *node,
+		  TextTreeUpdate update)
 {
-  GList *cache;
-  GtkPropertyMark *start;
-  GtkPropertyMark *end;
-  
-  /* If we inserted a property exactly at the beginning of the
-   * line, we have to correct here, or fetch_lines will
-   * fetch junk.
-   */
-  start = &CACHE_DATA(text->current_line).start;
-  if (start->index == text->point.index - nchars)
-    {
-      *start = text->point;
-      move_mark_n (start, -nchars);
-    }
+  TextTreeNode *parent = NULL;
 
-  /* Now correct the offsets, and check for start or end marks that
-   * are after the point, yet point to a property before the point's
-   * property. This indicates that they are meant to point to the
-   * second half of a property we split in insert_text_property(), so
-   * we fix them up that way.  
-   */
-  cache = text->current_line->next;
-  
-  for (; cache; cache = cache->next)
+  node->left = NULL;
+  node->right = NULL;
+  node->priority = text_tree_priority ();
+  update (node);
+
+  if (prev)
     {
-      start = &CACHE_DATA(cache).start;
-      end = &CACHE_DATA(cache).end;
-      
-      if (LAST_INDEX (text, text->point) &&
-	  start->index == text->point.index)
-	*start = text->point;
+      if (prev->right)
+	{
+	  parent = text_tree_first (prev->right);
+	  parent->left = node;
+	}
       else
 	{
-	  if (start->property == text->point.property)
-	    {
-	      start->offset += nchars;
-	      start->index += nchars;
-	    }
-	  else if (start->property->next &&
-		   (start->property->next->next == text->point.property))
-	    {
-	      /* We split the property, and this is the second half */
-	      start->offset -= MARK_CURRENT_PROPERTY (start)->length;
-	      start->index += nchars;
-	      start->property = text->point.property;
-	    }
-	  else
-	    start->index += nchars;
+	  parent = prev;
+	  parent->right = node;
+	}
+    }
+  else if (next)
+    {
+      if (next->left)
+	{
+	  parent = text_tree_last (next->left);
+	  parent->right = node;
 	}
-      
-      if (LAST_INDEX (text, text->point) &&
-	  end->index == text->point.index)
-	*end = text->point;
       else
 	{
-	  if (end->property == text->point.property)
-	    {
-	      end->offset += nchars;
-	      end->index += nchars;
-	    }
-	  else if (end->property->next &&
-		   (end->property->next->next == text->point.property))
-	    {
-	      /* We split the property, and this is the second half */
-	      end->offset -= MARK_CURRENT_PROPERTY (end)->length;
-	      end->index += nchars;
-	      end->property = text->point.property;
-	    }
-	  else
-	    end->index += nchars;
+	  parent = next;
+	  parent->left = node;
 	}
-      
-      /*TEXT_ASSERT_MARK(text, start, "start");*/
-      /*TEXT_ASSERT_MARK(text, end, "end");*/
     }
-}
 
+  node->parent = parent;
+  text_tree_changed (parent, update);
 
-static void
-insert_expose (GtkText* text, guint old_pixels, gint nchars,
-	       guint new_line_count)
+  while (node->parent && node->parent->priority < node->priority)
+    text_tree_rotate_up (node, update);
+
+  return text_tree_root (node);
+}
+
+/* Unlink node from its tree.  Returns the root of what is left, NULL
+ * if node was alone.
+ */
+static TextTreeNode *
+text_tree_remove (TextTreeNode *node, TextTreeUpdate update)
 {
-  GtkWidget *widget = GTK_WIDGET (text);
-  
-  gint pixel_height;
-  guint new_pixels = 0;
-  GdkRectangle rect;
-  GList* new_lines = NULL;
-  gint width, height;
-  
-  text->cursor_virtual_x = 0;
-  
-  undraw_cursor (text, FALSE);
-  
-  correct_cache_insert (text, nchars);
-  
-  TEXT_SHOW_ADJ (text, text->vadj, "vadj");
-  
-  pixel_height = pixel_height_of(text, text->current_line) -
-    LINE_HEIGHT(CACHE_DATA(text->current_line));
-  
-  new_lines = fetch_lines (text,
-			   &CACHE_DATA(text->current_line).start,
-			   &CACHE_DATA(text->current_line).tab_cont,
-			   FetchLinesCount,
-			   new_line_count);
-  
-  swap_lines (text, text->current_line, new_lines, 1);
-  
-  text->current_line = new_lines;
-  
-  new_pixels = total_line_height (text, new_lines, new_line_count);
-  
-  gdk_window_get_size (text->text_area, &width, &height);
-  
-  if (old_pixels != new_pixels)
+  TextTreeNode *parent;
+  TextTreeNode *child;
+
+  while (node->left && node->right)
     {
-      if (!widget->style->bg_pixmap[GTK_STATE_NORMAL])
-	{
-	  gdk_draw_pixmap (text->text_area,
-			   text->gc,
-			   text->text_area,
-			   0,
-			   pixel_height + old_pixels,
-			   0,
-			   pixel_height + new_pixels,
-			   width,
-			   height + (old_pixels - new_pixels) - pixel_height);
-	  
-	}
-      text->vadj->upper += new_pixels;
-      text->vadj->upper -= old_pixels;
-      adjust_adj (text, text->vadj);
+      if (node->left->priority > node->right->priority)
+	text_tree_rotate_up (node->left, update);
+      else
+	text_tree_rotate_up (node->right, update);
     }
-  
-  rect.x = 0;
-  rect.y = pixel_height;
-  rect.width = width;
-  rect.height = new_pixels;
-  
-  expose_text (text, &rect, FALSE);
-  gtk_text_draw_focus ( (GtkWidget *) text);
-  
-  text->cursor_mark = text->point;
-  
-  find_cursor (text, TRUE);
-  
-  draw_cursor (text, FALSE);
-  
-  if (old_pixels != new_pixels)
+
+  parent = node->parent;
+  child = node->left ? node->left : node->right;
+
+  if (child)
+    child->parent = parent;
+
+  if (parent)
     {
-      if (widget->style->bg_pixmap[GTK_STATE_NORMAL])
-	{
-	  rect.x = 0;
-	  rect.y = pixel_height + new_pixels;
-	  rect.width = width;
-	  rect.height = height - rect.y;
-	  
-	  expose_text (text, &rect, FALSE);
-	}
+      if (parent->left == node)
+	parent->left = child;
       else
-	process_exposes (text);
+	parent->right = child;
     }
-  
-  TEXT_SHOW_ADJ (text, text->vadj, "vadj");
-  TEXT_ASSERT (text);
-  TEXT_SHOW(text);
+
+  node->parent = NULL;
+  node->left = NULL;
+  node->right = NULL;
+
+  text_tree_changed (parent, update);
+
+  return text_tree_root (parent ? parent : child);
 }
 
-/* Text property functions */
+static void
+prop_tree_update (TextTreeNode *node)
+{
+  ((TextProperty*) node)->total = (PROP_TOTAL (node->left) +
+				   ((TextProperty*) node)->length +
+				   PROP_TOTAL (node->right));
+}
 
-static guint
-font_hash (gconstpointer font)
+static void
+prop_tree_length_changed (TextProperty *prop)
 {
-  return gdk_font_id ((const GdkFont*) font);
+  text_tree_changed ((TextTreeNode*) prop, prop_tree_update);
 }
 
-static GHashTable *font_cache_table = NULL;
+/* Add the property held by link to the tree.  link must already be
+ * spliced into the property list next to a property that is in the
+ * tree, or be the only one.
+ */
+static void
+prop_tree_insert (GList *link)
+{
+  TextProperty *prop = link->data;
 
-static GtkTextFont*
-get_text_font (GdkFont* gfont)
+  prop->link = link;
+  text_tree_insert (link->prev ? link->prev->data : NULL,
+		    link->next ? link->next->data : NULL,
+		    (TextTreeNode*) prop, prop_tree_update);
+}
+
+static void
+prop_tree_remove (TextProperty *prop)
 {
-  GtkTextFont* tf;
-  gint i;
-  
-  if (!font_cache_table)
-    font_cache_table = g_hash_table_new (font_hash, (GCompareFunc) gdk_font_equal);
-  
-  tf = g_hash_table_lookup (font_cache_table, gfont);
-  
-  if (tf)
+  text_tree_remove ((TextTreeNode*) prop, prop_tree_update);
+  prop->link = NULL;
+}
+
+/* Find the property containing index, and the index at which that
+ * property starts.  Returns NULL if index is past the end.
+ */
+static TextProperty*
+prop_tree_find (GtkText *text, guint index, guint *start)
+{
+  TextTreeNode *node = text_tree_root (text->text_properties->data);
+  guint skip = 0;
+
+  while (node)
     {
-      tf->ref_count++;
-      return tf;
+      if (index < skip + PROP_TOTAL (node->left))
+	node = node->left;
+      else
+	{
+	  skip += PROP_TOTAL (node->left);
+	  if (index < skip + ((TextProperty*) node)->length)
+	    break;
+	  skip += ((TextProperty*) node)->length;
+	  node = node->right;
+	}
     }
 
-  tf = g_new (GtkTextFont, 1);
-  tf->ref_count = 1;
+  *start = skip;
 
-  tf->gdk_font = gfont;
-  gdk_font_ref (gfont);
+  return (TextProperty*) node;
+}
+
+static void
+chunk_update (TextTreeNode *node)
+{
+  ((TextChunk*) node)->total = (CHUNK_TOTAL (node->left) +
+				((TextChunk*) node)->length +
+				CHUNK_TOTAL (node->right));
+}
+
+static TextChunk *
+chunk_new (GtkText *text, guint size)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextChunk *chunk;
   
-  for(i = 0; i < 256; i += 1)
-    tf->char_widths[i] = gdk_char_width (gfont, (char)i);
+  chunk = g_new (TextChunk, 1);
+  chunk->node.parent = NULL;
+  chunk->node.left = NULL;
+  chunk->node.right = NULL;
+  chunk->length = 0;
+  chunk->total = 0;
+  chunk->size = size;
+  chunk->wide = text->use_wchar && !private->compact;
+  chunk->text.ch = g_malloc (size * CHUNK_CHAR_SIZE (chunk));
   
-  g_hash_table_insert (font_cache_table, gfont, tf);
+  text->text_len += size * CHUNK_CHAR_SIZE (chunk);
   
-  return tf;
+  return chunk;
 }
 
 static void
-text_font_unref (GtkTextFont *text_font)
+chunk_free (GtkText *text, TextChunk *chunk)
 {
-  text_font->ref_count--;
-  if (text_font->ref_count == 0)
-    {
-      g_hash_table_remove (font_cache_table, text_font->gdk_font);
-      gdk_font_unref (text_font->gdk_font);
-      g_free (text_font);
-    }
+  text->text_len -= chunk->size * CHUNK_CHAR_SIZE (chunk);
+  
+  g_free (chunk->text.ch);
+  g_free (chunk);
 }
 
-static gint
-text_properties_equal (TextProperty* prop, GdkFont* font, GdkColor *fore, GdkColor *back)
+static void
+chunk_free_all (TextTreeNode *node)
 {
-  if (prop->flags & PROPERTY_FONT)
+  if (node)
     {
-      gboolean retval;
-      GtkTextFont *text_font;
-
-      if (!font)
-	return FALSE;
+      chunk_free_all (node->left);
+      chunk_free_all (node->right);
+      g_free (((TextChunk*) node)->text.ch);
+      g_free (node);
+    }
+}
 
-      text_font = get_text_font (font);
+/* Make room for length characters in chunk. */
+static void
+chunk_reserve (GtkText *text, TextChunk *chunk, guint length)
+{
+  guint size = chunk->size;
+  
+  if (length <= size)
+    return;
+  
+  while (size < length)
+    size <<= 1;
+  size = MIN (size, MAX_CHUNK_SIZE);
+  
+  chunk->text.ch = g_realloc (chunk->text.ch, size * CHUNK_CHAR_SIZE (chunk));
+  text->text_len += (size - chunk->size) * CHUNK_CHAR_SIZE (chunk);
+  chunk->size = size;
+}
 
-      retval = (prop->font == text_font);
-      text_font_unref (text_font);
-      
-      if (!retval)
+static gboolean
+chunk_is_ascii (TextChunk *chunk)
+{
+  guint i;
+  
+  if (chunk->wide)
+    for (i = 0; i < chunk->length; i++)
+      if (chunk->text.wc[i] > 0x7f)
 	return FALSE;
-    }
-  else
-    if (font != NULL)
-      return FALSE;
+  
+  return TRUE;
+}
 
-  if (prop->flags & PROPERTY_FOREGROUND)
+/* Switch chunk to GdkWChar, or back to one byte a character, which
+ * it must then hold only ASCII for. */
+static void
+chunk_set_wide (GtkText *text, TextChunk *chunk, gboolean wide)
+{
+  GdkWChar *wc;
+  guchar *ch;
+  guint i;
+  
+  if (chunk->wide == wide)
+    return;
+  
+  if (wide)
     {
-      if (!fore || !gdk_color_equal (&prop->fore_color, fore))
-	return FALSE;
+      wc = g_new (GdkWChar, chunk->size);
+      for (i = 0; i < chunk->length; i++)
+	wc[i] = chunk->text.ch[i];
+      
+      g_free (chunk->text.ch);
+      chunk->text.wc = wc;
+      text->text_len += chunk->size * (sizeof (GdkWChar) - 1);
     }
   else
-    if (fore != NULL)
-      return FALSE;
-
-  if (prop->flags & PROPERTY_BACKGROUND)
     {
-      if (!back || !gdk_color_equal (&prop->back_color, back))
-	return FALSE;
+      ch = g_new (guchar, chunk->size);
+      for (i = 0; i < chunk->length; i++)
+	ch[i] = chunk->text.wc[i];
+      
+      g_free (chunk->text.wc);
+      chunk->text.ch = ch;
+      text->text_len -= chunk->size * (sizeof (GdkWChar) - 1);
     }
-  else
-    if (back != NULL)
-      return FALSE;
   
-  return TRUE;
+  chunk->wide = wide;
 }
 
+/* Widen chunk if it is to take the n characters at chars, which are
+ * in the text's encoding, and they aren't all ASCII. */
 static void
-realize_property (GtkText *text, TextProperty *prop)
+chunk_prepare (GtkText *text, TextChunk *chunk, gconstpointer chars, guint n)
 {
-  GdkColormap *colormap = gtk_widget_get_colormap (GTK_WIDGET (text));
+  const GdkWChar *wc = chars;
+  guint i;
+  
+  if (chunk->wide || !text->use_wchar)
+    return;
+  
+  for (i = 0; i < n; i++)
+    if (wc[i] > 0x7f)
+      {
+	chunk_set_wide (text, chunk, TRUE);
+	break;
+      }
+}
 
-  if (prop->flags & PROPERTY_FOREGROUND)
-    gdk_colormap_alloc_color (colormap, &prop->fore_color, FALSE, FALSE);
+/* Store the n characters at chars, in the text's encoding, at offset
+ * in chunk, which chunk_prepare() must have been called for. */
+static void
+chunk_store (GtkText *text, TextChunk *chunk, guint offset,
+	     gconstpointer chars, guint n)
+{
+  const GdkWChar *wc = chars;
+  guint i;
   
-  if (prop->flags & PROPERTY_BACKGROUND)
-    gdk_colormap_alloc_color (colormap, &prop->back_color, FALSE, FALSE);
+  if (chunk->wide == text->use_wchar)
+    memcpy (chunk->text.ch + offset * CHUNK_CHAR_SIZE (chunk), chars,
+	    n * CHUNK_CHAR_SIZE (chunk));
+  else
+    for (i = 0; i < n; i++)
+      chunk->text.ch[offset + i] = wc[i];
 }
 
+/* Copy n characters at offset in chunk to dest, in the text's
+ * encoding. */
 static void
-realize_properties (GtkText *text)
+chunk_load (GtkText *text, TextChunk *chunk, guint offset,
+	    guint n, gpointer dest)
 {
-  GList *tmp_list = text->text_properties;
+  GdkWChar *wc = dest;
+  guint i;
+  
+  if (chunk->wide == text->use_wchar)
+    memcpy (dest, chunk->text.ch + offset * CHUNK_CHAR_SIZE (chunk),
+	    n * CHUNK_CHAR_SIZE (chunk));
+  else
+    for (i = 0; i < n; i++)
+      wc[i] = chunk->text.ch[offset + i];
+}
 
-  while (tmp_list)
+/* Find the chunk holding index, and the index it starts at.  The end
+ * of the text is in the last chunk.
+ */
+static TextChunk *
+text_chunk_find (GtkText *text, guint index, guint *start)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextTreeNode *node;
+  TextChunk *chunk;
+  guint skip = 0;
+  
+  chunk = private->chunk_cache;
+  if (chunk &&
+      index >= private->chunk_cache_start &&
+      index < private->chunk_cache_start + chunk->length)
     {
-      realize_property (text, tmp_list->data);
+      *start = private->chunk_cache_start;
+      return chunk;
+    }
+  
+  node = (TextTreeNode*) private->chunks;
+  for (;;)
+    {
+      chunk = (TextChunk*) node;
       
-      tmp_list = tmp_list->next;
+      if (index < skip + CHUNK_TOTAL (node->left))
+	node = node->left;
+      else
+	{
+	  skip += CHUNK_TOTAL (node->left);
+	  if (index < skip + chunk->length || !node->right)
+	    break;
+	  skip += chunk->length;
+	  node = node->right;
+	}
     }
+  
+  private->chunk_cache = chunk;
+  private->chunk_cache_start = skip;
+  *start = skip;
+  
+  return chunk;
 }
 
-static void
-unrealize_property (GtkText *text, TextProperty *prop)
+GdkWChar
+gtk_text_get_char (GtkText *text,
+		   guint    index)
 {
-  GdkColormap *colormap = gtk_widget_get_colormap (GTK_WIDGET (text));
-
-  if (prop->flags & PROPERTY_FOREGROUND)
-    gdk_colormap_free_colors (colormap, &prop->fore_color, 1);
+  TextChunk *chunk;
+  guint start;
   
-  if (prop->flags & PROPERTY_BACKGROUND)
-    gdk_colormap_free_colors (colormap, &prop->back_color, 1);
+  chunk = text_chunk_find (text, index, &start);
+  
+  if (chunk->wide)
+    return chunk->text.wc[index - start];
+  else
+    return chunk->text.ch[index - start];
 }
 
+/* Copy the n characters at index to dest, in the text's encoding. */
 static void
-unrealize_properties (GtkText *text)
+text_chunk_copy (GtkText *text, guint index, guint n, gpointer dest)
 {
-  GList *tmp_list = text->text_properties;
-
-  while (tmp_list)
+  guchar *p = dest;
+  TextChunk *chunk;
+  guint offset;
+  guint start;
+  guint len;
+  
+  chunk = text_chunk_find (text, index, &start);
+  offset = index - start;
+  
+  while (n > 0)
     {
-      unrealize_property (text, tmp_list->data);
-
-      tmp_list = tmp_list->next;
+      len = MIN (n, chunk->length - offset);
+      chunk_load (text, chunk, offset, len, p);
+      p += len * TEXT_CHAR_SIZE (text);
+      n -= len;
+      
+      chunk = (TextChunk*) text_tree_next ((TextTreeNode*) chunk);
+      offset = 0;
     }
 }
 
-static TextProperty*
-new_text_property (GtkText *text, GdkFont *font, GdkColor* fore, 
-		   GdkColor* back, guint length)
+/* The n characters at index in one piece, in the text's encoding.
+ * They are only copied, into the scratch buffer, when they span a
+ * chunk boundary or are kept narrower than the text's encoding.
+ */
+static gpointer
+text_chunk_fetch (GtkText *text, guint index, guint n)
 {
-  TextProperty *prop;
+  TextChunk *chunk;
+  guint start;
   
-  if (text_property_chunk == NULL)
+  chunk = text_chunk_find (text, index, &start);
+  if (index + n <= start + chunk->length && chunk->wide == text->use_wchar)
+    return chunk->text.ch + (index - start) * CHUNK_CHAR_SIZE (chunk);
+  
+  expand_scratch_buffer (text, n);
+  text_chunk_copy (text, index, n, text->scratch_buffer.ch);
+  
+  return text->scratch_buffer.ch;
+}
+
+/* Append n characters, in the text's encoding, to chunk, going on in
+ * new chunks after it once it is full.  Returns the chunk the last of
+ * them went into.
+ */
+static TextChunk *
+chunk_append (GtkText *text, TextChunk *chunk, const guchar *chars, guint n)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextChunk *next;
+  guint len;
+  
+  while (n > 0)
     {
-      text_property_chunk = g_mem_chunk_new ("text property mem chunk",
-					     sizeof(TextProperty),
-					     1024*sizeof(TextProperty),
-					     G_ALLOC_AND_FREE);
+      if (chunk->length == MAX_CHUNK_SIZE)
+	{
+	  next = chunk_new (text, MAX (INITIAL_CHUNK_SIZE, MIN (n, MAX_CHUNK_SIZE)));
+	  private->chunks = (TextChunk*) text_tree_insert ((TextTreeNode*) chunk, NULL,
+							   (TextTreeNode*) next,
+							   chunk_update);
+	  chunk = next;
+	}
+      
+      len = MIN (n, MAX_CHUNK_SIZE - chunk->length);
+      chunk_prepare (text, chunk, chars, len);
+      chunk_reserve (text, chunk, chunk->length + len);
+      chunk_store (text, chunk, chunk->length, chars, len);
+      chunk->length += len;
+      text_tree_changed ((TextTreeNode*) chunk, chunk_update);
+      
+      chars += len * TEXT_CHAR_SIZE (text);
+      n -= len;
     }
   
-  prop = g_chunk_new(TextProperty, text_property_chunk);
+  return chunk;
+}
 
-  prop->flags = 0;
-  if (font)
-    {
-      prop->flags |= PROPERTY_FONT;
-      prop->font = get_text_font (font);
+/* Insert the n characters at chars, in the text's encoding, at
+ * index.  Only the chunk they go into is touched, unless it has to
+ * be split.
+ */
+static void
+text_chunk_insert (GtkText *text, guint index, gconstpointer chars, guint n)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextChunk *chunk;
+  guchar *tail;
+  guint tail_length;
+  guint char_size;
+  guint offset;
+  guint start;
+  
+  /* Text going in between two chunks is added to the first one */
+  chunk = text_chunk_find (text, index > 0 ? index - 1 : 0, &start);
+  offset = index - start;
+  private->chunk_cache = NULL;
+  
+  if (chunk->length + n <= MAX_CHUNK_SIZE)
+    {
+      chunk_prepare (text, chunk, chars, n);
+      chunk_reserve (text, chunk, chunk->length + n);
+      
+      char_size = CHUNK_CHAR_SIZE (chunk);
+      g_memmove (chunk->text.ch + (offset + n) * char_size,
+		 chunk->text.ch + offset * char_size,
+		 (chunk->length - offset) * char_size);
+      chunk_store (text, chunk, offset, chars, n);
+      chunk->length += n;
+      text_tree_changed ((TextTreeNode*) chunk, chunk_update);
     }
   else
-    prop->font = NULL;
-  
-  if (fore)
     {
-      prop->flags |= PROPERTY_FOREGROUND;
-      prop->fore_color = *fore;
-    }
+      tail_length = chunk->length - offset;
+      tail = g_malloc (tail_length * TEXT_CHAR_SIZE (text));
+      chunk_load (text, chunk, offset, tail_length, tail);
       
-  if (back)
-    {
-      prop->flags |= PROPERTY_BACKGROUND;
-      prop->back_color = *back;
+      chunk->length = offset;
+      chunk = chunk_append (text, chunk, chars, n);
+      chunk_append (text, chunk, tail, tail_length);
+      
+      g_free (tail);
     }
-
-  prop->length = length;
-
-  if (GTK_WIDGET_REALIZED (text))
-    realize_property (text, prop);
-
-  return prop;
+  
+  text->text_end += n;
 }
 
+/* Move the characters of a chunk that has got short into a neighbour
+ * with room for them. */
 static void
-destroy_text_property (TextProperty *prop)
+chunk_merge (GtkText *text, TextChunk *chunk)
 {
-  if (prop->font)
-    text_font_unref (prop->font);
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextChunk *next;
+  guchar *chars;
   
-  g_mem_chunk_free (text_property_chunk, prop);
+  if (chunk->length >= MAX_CHUNK_SIZE / 4)
+    return;
+  
+  next = (TextChunk*) text_tree_next ((TextTreeNode*) chunk);
+  if (!next || chunk->length + next->length > MAX_CHUNK_SIZE)
+    {
+      next = chunk;
+      chunk = (TextChunk*) text_tree_prev ((TextTreeNode*) chunk);
+      if (!chunk || chunk->length + next->length > MAX_CHUNK_SIZE)
+	return;
+    }
+  
+  private->chunks = (TextChunk*) text_tree_remove ((TextTreeNode*) next,
+						   chunk_update);
+  private->chunk_cache = NULL;
+  
+  chars = g_malloc (next->length * TEXT_CHAR_SIZE (text));
+  chunk_load (text, next, 0, next->length, chars);
+  chunk_append (text, chunk, chars, next->length);
+  
+  g_free (chars);
+  chunk_free (text, next);
 }
 
-/* Flop the memory between the point and the gap around like a
- * dead fish. */
+/* Delete the n characters at index.  Chunks that are deleted whole
+ * are just dropped, only those at either end have characters moved.
+ */
 static void
-move_gap (GtkText* text, guint index)
+text_chunk_delete (GtkText *text, guint index, guint n)
 {
-  if (text->gap_position < index)
-    {
-      gint diff = index - text->gap_position;
-      
-      if (text->use_wchar)
-	g_memmove (text->text.wc + text->gap_position,
-		   text->text.wc + text->gap_position + text->gap_size,
-		   diff*sizeof (GdkWChar));
-      else
-	g_memmove (text->text.ch + text->gap_position,
-		   text->text.ch + text->gap_position + text->gap_size,
-		   diff);
-      
-      text->gap_position = index;
-    }
-  else if (text->gap_position > index)
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextChunk *chunk;
+  TextChunk *next;
+  guint char_size;
+  guint offset;
+  guint start;
+  guint len;
+  
+  chunk = text_chunk_find (text, index, &start);
+  offset = index - start;
+  private->chunk_cache = NULL;
+  
+  text->text_end -= n;
+  
+  while (n > 0)
     {
-      gint diff = text->gap_position - index;
+      len = MIN (n, chunk->length - offset);
+      next = (TextChunk*) text_tree_next ((TextTreeNode*) chunk);
       
-      if (text->use_wchar)
-	g_memmove (text->text.wc + index + text->gap_size,
-		   text->text.wc + index,
-		   diff*sizeof (GdkWChar));
+      /* An empty text keeps one chunk */
+      if (len == chunk->length && private->chunks->total > len)
+	{
+	  private->chunks = (TextChunk*) text_tree_remove ((TextTreeNode*) chunk,
+							   chunk_update);
+	  chunk_free (text, chunk);
+	}
       else
-	g_memmove (text->text.ch + index + text->gap_size,
-		   text->text.ch + index,
-		   diff);
+	{
+	  char_size = CHUNK_CHAR_SIZE (chunk);
+	  g_memmove (chunk->text.ch + offset * char_size,
+		     chunk->text.ch + (offset + len) * char_size,
+		     (chunk->length - offset - len) * char_size);
+	  chunk->length -= len;
+	  text_tree_changed ((TextTreeNode*) chunk, chunk_update);
+	  
+	  if (chunk->wide && private->compact && chunk_is_ascii (chunk))
+	    chunk_set_wide (text, chunk, FALSE);
+	}
       
-      text->gap_position = index;
+      n -= len;
+      chunk = next;
+      offset = 0;
     }
+  
+  if (index > 0)
+    chunk_merge (text, text_chunk_find (text, index - 1, &start));
+  chunk_merge (text, text_chunk_find (text, index, &start));
+}
+
+/* The number of characters outside ASCII among the nchars at index. */
+static guint
+count_wide_chars (GtkText* text, guint index, guint nchars)
+{
+  guint count = 0;
+  guint i;
+  
+  for (i = index; i < index + nchars; i++)
+    if (GTK_TEXT_INDEX (text, i) > 0x7f)
+      count++;
+  
+  return count;
 }
 
-/* Increase the gap size. */
+/* Keep every chunk as GdkWChar if the text uses them and compact
+ * storage is off, otherwise each one that only holds ASCII one byte
+ * a character.
+ */
 static void
-make_forward_space (GtkText* text, guint len)
+text_chunks_fit (GtkText *text)
 {
-  if (text->gap_size < len)
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextTreeNode *node;
+  TextChunk *chunk;
+  
+  node = text_tree_first ((TextTreeNode*) private->chunks);
+  for (; node; node = text_tree_next (node))
     {
-      guint sum = MAX(2*len, MIN_GAP_SIZE) + text->text_end;
-      
-      if (sum >= text->text_len)
-	{
-	  guint i = 1;
-	  
-	  while (i <= sum) i <<= 1;
-	  
-	  if (text->use_wchar)
-	    text->text.wc = (GdkWChar *)g_realloc(text->text.wc,
-						  i*sizeof(GdkWChar));
-	  else
-	    text->text.ch = (guchar *)g_realloc(text->text.ch, i);
-	  text->text_len = i;
-	}
-      
-      if (text->use_wchar)
-	g_memmove (text->text.wc + text->gap_position + text->gap_size + 2*len,
-		   text->text.wc + text->gap_position + text->gap_size,
-		   (text->text_end - (text->gap_position + text->gap_size))
-		   *sizeof(GdkWChar));
-      else
-	g_memmove (text->text.ch + text->gap_position + text->gap_size + 2*len,
-		   text->text.ch + text->gap_position + text->gap_size,
-		   text->text_end - (text->gap_position + text->gap_size));
+      chunk = (TextChunk*) node;
       
-      text->text_end += len*2;
-      text->gap_size += len*2;
+      if (text->use_wchar && !private->compact)
+	chunk_set_wide (text, chunk, TRUE);
+      else if (chunk_is_ascii (chunk))
+	chunk_set_wide (text, chunk, FALSE);
     }
 }
 
+/* Hand out the text as GdkWChar.  Everything in it must be ASCII,
+ * which is the same in every locale's wide character set. */
+static void
+widen_text (GtkText* text)
+{
+  text->use_wchar = TRUE;
+  text_chunks_fit (text);
+  
+  g_free (text->scratch_buffer.ch);
+  text->scratch_buffer.wc = NULL;
+  text->scratch_buffer_len = 0;
+}
+
+/* Go back to one byte a character, once the text holds no characters
+ * outside ASCII. */
+static void
+narrow_text (GtkText* text)
+{
+  text->use_wchar = FALSE;
+  text_chunks_fit (text);
+  
+  g_free (text->scratch_buffer.wc);
+  text->scratch_buffer.ch = NULL;
+  text->scratch_buffer_len = 0;
+}
+
 /* Inserts into the text property list a list element that guarantees
  * that for len characters following the point, text has the correct
  * property.  does not move point.  adjusts text_properties_point and
@@ -3222,6 +4863,7 @@ insert_text_property (GtkText* text, GdkFont* font,
 	  /* Grow the property in front of us. */
 	  
 	  MARK_PROPERTY_LENGTH(mark) += len;
+	  prop_tree_length_changed (forward_prop);
 	}
       else if (backward_prop &&
 	       text_properties_equal(backward_prop, font, fore, back))
@@ -3234,6 +4876,7 @@ insert_text_property (GtkText* text, GdkFont* font,
 			     backward_prop->length);
 	  
 	  backward_prop->length += len;
+	  prop_tree_length_changed (backward_prop);
 	}
       else if ((MARK_NEXT_LIST_PTR(mark) == NULL) &&
 	       (forward_prop->length == 1))
@@ -3263,6 +4906,7 @@ insert_text_property (GtkText* text, GdkFont* font,
 	      forward_prop->back_color = *back;
 	    }
 	  forward_prop->length += len;
+	  prop_tree_length_changed (forward_prop);
 
 	  if (GTK_WIDGET_REALIZED (text))
 	    realize_property (text, forward_prop);
@@ -3281,6 +4925,7 @@ insert_text_property (GtkText* text, GdkFont* font,
 	    new_prop->prev->next = new_prop;
 
 	  new_prop->data = new_text_property (text, font, fore, back, len);
+	  prop_tree_insert (new_prop);
 
 	  SET_PROPERTY_MARK (mark, new_prop, 0);
 	}
@@ -3297,6 +4942,7 @@ insert_text_property (GtkText* text, GdkFont* font,
       if (text_properties_equal (forward_prop, font, fore, back))
 	{
 	  forward_prop->length += len;
+	  prop_tree_length_changed (forward_prop);
 	}
       else if ((MARK_NEXT_LIST_PTR(mark) == NULL) &&
 	       (MARK_OFFSET(mark) + 1 == forward_prop->length))
@@ -3305,12 +4951,14 @@ insert_text_property (GtkText* text, GdkFont* font,
 	  
 	  GList* new_prop;
 	  forward_prop->length -= 1;
+	  prop_tree_length_changed (forward_prop);
 	  
 	  new_prop = g_list_alloc();
 	  new_prop->data = new_text_property (text, font, fore, back, len+1);
 	  new_prop->prev = MARK_LIST_PTR(mark);
 	  new_prop->next = NULL;
 	  MARK_NEXT_LIST_PTR(mark) = new_prop;
+	  prop_tree_insert (new_prop);
 	  
 	  SET_PROPERTY_MARK (mark, new_prop, 0);
 	}
@@ -3324,6 +4972,7 @@ insert_text_property (GtkText* text, GdkFont* font,
 	  /* Set the new lengths according to where they are split.  Construct
 	   * two new properties. */
 	  forward_prop->length = MARK_OFFSET(mark);
+	  prop_tree_length_changed (forward_prop);
 
 	  new_prop_forward->data = 
 	    new_text_property(text,
@@ -3348,6 +4997,9 @@ insert_text_property (GtkText* text, GdkFont* font,
 	  
 	  if (next)
 	    next->prev = new_prop_forward;
+
+	  prop_tree_insert (new_prop);
+	  prop_tree_insert (new_prop_forward);
 	  
 	  SET_PROPERTY_MARK (mark, new_prop, 0);
 	}
@@ -3385,12 +5037,17 @@ delete_text_property (GtkText* text, guint nchars)
   TextProperty *prop;
   GList        *tmp;
   gint          is_first;
+  guint         n;
   
-  for(; nchars; nchars -= 1)
+  /* Take out as much of each property as we can at once, rather
+   * than a character at a time. */
+  while (nchars > 0)
     {
       prop = MARK_CURRENT_PROPERTY(&text->point);
       
-      prop->length -= 1;
+      n = MIN (nchars, prop->length - text->point.offset);
+      prop->length -= n;
+      nchars -= n;
       
       if (prop->length == 0)
 	{
@@ -3401,6 +5058,8 @@ delete_text_property (GtkText* text, guint nchars)
 	  MARK_LIST_PTR (&text->point) = g_list_remove_link (tmp, tmp);
 	  text->point.offset = 0;
 
+	  prop_tree_remove (prop);
+
 	  if (GTK_WIDGET_REALIZED (text))
 	    unrealize_property (text, prop);
 
@@ -3414,10 +5073,15 @@ delete_text_property (GtkText* text, guint nchars)
 	  
 	  g_assert (prop->length != 0);
 	}
-      else if (prop->length == text->point.offset)
+      else
 	{
-	  MARK_LIST_PTR (&text->point) = MARK_NEXT_LIST_PTR (&text->point);
-	  text->point.offset = 0;
+	  prop_tree_length_changed (prop);
+
+	  if (prop->length == text->point.offset)
+	    {
+	      MARK_LIST_PTR (&text->point) = MARK_NEXT_LIST_PTR (&text->point);
+	      text->point.offset = 0;
+	    }
 	}
     }
   
@@ -3431,9 +5095,12 @@ delete_text_property (GtkText* text, guint nchars)
       tmp = MARK_LIST_PTR (&text->point);
       prop = MARK_CURRENT_PROPERTY(&text->point);
       
+      prop_tree_remove (prop);
+
       MARK_LIST_PTR (&text->point) = MARK_PREV_LIST_PTR (&text->point);
       MARK_CURRENT_PROPERTY(&text->point)->length += 1;
       MARK_NEXT_LIST_PTR(&text->point) = NULL;
+      prop_tree_length_changed (MARK_CURRENT_PROPERTY(&text->point));
       
       text->point.offset = MARK_CURRENT_PROPERTY(&text->point)->length - 1;
       
@@ -3455,6 +5122,7 @@ init_properties (GtkText *text)
       text->text_properties->prev = NULL;
       text->text_properties->data = new_text_property (text, NULL, NULL, NULL, 1);
       text->text_properties_end = text->text_properties;
+      prop_tree_insert (text->text_properties);
       
       SET_PROPERTY_MARK (&text->point, text->text_properties, 0);
       
@@ -3562,38 +5230,43 @@ find_mark (GtkText* text, guint mark_position)
 }
 
 /*
- * You can also start from the end, what a drag.
+ * Positions within the property near is in are reached by moving
+ * near; anything further away is looked up in the property tree.
  */
 static GtkPropertyMark
-find_mark_near (GtkText* text, guint mark_position, const GtkPropertyMark* near)
-{
-  gint diffa;
-  gint diffb;
-  
-  GtkPropertyMark mark;
-  
-  if (!near)
-    diffa = mark_position + 1;
-  else
-    diffa = mark_position - near->index;
-  
-  diffb = mark_position;
-  
-  if (diffa < 0)
-    diffa = -diffa;
+find_mark_near (GtkText* text, guint mark_position, const GtkPropertyMark* near)
+{
+  GtkPropertyMark mark;
+  TextProperty *prop;
+  guint start;
   
-  if (diffa <= diffb)
+  if (near &&
+      mark_position >= near->index - near->offset &&
+      mark_position < (near->index - near->offset +
+		       MARK_CURRENT_PROPERTY (near)->length))
     {
       mark = *near;
+      move_mark_n (&mark, mark_position - mark.index);
+      
+      return mark;
+    }
+
+  prop = prop_tree_find (text, mark_position, &start);
+  
+  if (prop)
+    {
+      mark.index = mark_position;
+      mark.property = prop->link;
+      mark.offset = mark_position - start;
     }
   else
     {
       mark.index = 0;
       mark.property = text->text_properties;
       mark.offset = 0;
+      
+      move_mark_n (&mark, mark_position);
     }
-
-  move_mark_n (&mark, mark_position - mark.index);
    
   return mark;
 }
@@ -3606,13 +5279,37 @@ static void
 find_line_containing_point (GtkText* text, guint point,
 			    gboolean scroll)
 {
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextParagraph *paragraph;
   GList* cache;
   gint height;
+  gint top;
+  gint line_height;
+  guint start;
   
   text->current_line = NULL;
 
   TEXT_SHOW (text);
 
+  gdk_window_get_size (text->text_area, NULL, &height);
+
+  /* If the point is more than a screen away, jump there in one go
+   * rather than scrolling through all the lines in between.
+   */
+  text_lines_update (text);
+  paragraph = paragraph_find_index (private, point, &start, &top);
+  
+  if (top + (gint) paragraph->height + height < (gint) text->vadj->value)
+    {
+      find_line_at_index (text, point, &top, &line_height);
+      scroll_int (text, top - (gint) text->vadj->value);
+    }
+  else if (scroll && top > (gint) text->vadj->value + 2 * height)
+    {
+      find_line_at_index (text, point, &top, &line_height);
+      scroll_int (text, top + line_height - height - (gint) text->vadj->value);
+    }
+
   /* Scroll backwards until the point is on screen
    */
   while (CACHE_DATA(text->line_start_cache).start.index > point)
@@ -3628,7 +5325,8 @@ find_line_containing_point (GtkText* text, guint point,
 	scroll_int (text, - LINE_HEIGHT(CACHE_DATA(text->line_start_cache->next)));
     }
 
-  gdk_window_get_size (text->text_area, NULL, &height);
+  /* We hold on to cache across the scrolls below */
+  private->cache_locked += 1;
   
   for (cache = text->line_start_cache; cache; cache = cache->next)
     {
@@ -3639,6 +5337,7 @@ find_line_containing_point (GtkText* text, guint point,
 	{
 	  text->current_line = cache; /* LOOK HERE, this proc has an
 				       * important side effect. */
+	  private->cache_locked -= 1;
 	  return;
 	}
       
@@ -3789,149 +5488,664 @@ find_cursor_at_line (GtkText* text, const LineParams* start_line, gint pixel_hei
       editable->ic_attr->preedit_foreground = *MARK_CURRENT_FORE (text, &mark);
       editable->ic_attr->preedit_background = *MARK_CURRENT_BACK (text, &mark);
 
-      if (MARK_CURRENT_FONT (text, &mark)->type == GDK_FONT_FONTSET)
+      if (MARK_CURRENT_FONT (text, &mark)->type == GDK_FONT_FONTSET)
+	{
+	  mask |= GDK_IC_PREEDIT_FONTSET;
+	  editable->ic_attr->preedit_fontset = MARK_CURRENT_FONT (text, &mark);
+	}
+      
+      gdk_ic_set_attr (editable->ic, editable->ic_attr, mask);
+    }
+#endif 
+}
+
+static void
+find_cursor (GtkText* text, gboolean scroll)
+{
+  if (GTK_WIDGET_REALIZED (text))
+    {
+      find_line_containing_point (text, text->cursor_mark.index, scroll);
+      
+      if (text->current_line)
+	find_cursor_at_line (text,
+			     &CACHE_DATA(text->current_line),
+			     pixel_height_of(text, text->current_line));
+    }
+  
+  GTK_EDITABLE (text)->current_pos = text->cursor_mark.index;
+}
+
+static void
+find_mouse_cursor_at_line (GtkText *text, const LineParams* lp,
+			   guint line_pixel_height,
+			   gint button_x)
+{
+  GtkPropertyMark mark     = lp->start;
+  TabStopMark  tab_mark = lp->tab_cont.tab_start;
+  
+  gint char_width = find_char_width(text, &mark, &tab_mark);
+  gint pixel_width = LINE_START_PIXEL (*lp) + (char_width+1)/2;
+  
+  text->cursor_pos_y = line_pixel_height;
+  
+  for (;;)
+    {
+      GdkWChar ch = LAST_INDEX (text, mark) ? 
+	LINE_DELIM : GTK_TEXT_INDEX (text, mark.index);
+      
+      if (button_x < pixel_width || mark.index == lp->end.index)
+	{
+	  text->cursor_pos_x       = pixel_width - (char_width+1)/2;
+	  text->cursor_mark        = mark;
+	  text->cursor_char_offset = lp->font_descent;
+	  
+	  if ((text->use_wchar) ? gdk_iswspace (ch) : isspace (ch))
+	    text->cursor_char = 0;
+	  else
+	    text->cursor_char = ch;
+	  
+	  break;
+	}
+      
+      advance_tab_mark (text, &tab_mark, ch);
+      advance_mark (&mark);
+      
+      pixel_width += char_width/2;
+      
+      char_width = find_char_width (text, &mark, &tab_mark);
+      
+      pixel_width += (char_width+1)/2;
+    }
+}
+
+static void
+find_mouse_cursor (GtkText* text, gint x, gint y)
+{
+  gint pixel_height;
+  GList* cache = text->line_start_cache;
+  
+  g_assert (cache);
+  
+  pixel_height = - text->first_cut_pixels;
+  
+  for (; cache; cache = cache->next)
+    {
+      pixel_height += LINE_HEIGHT(CACHE_DATA(cache));
+      
+      if (y < pixel_height || !cache->next)
+	{
+	  find_mouse_cursor_at_line (text, &CACHE_DATA(cache), pixel_height, x);
+	  
+	  find_cursor (text, FALSE);
+	  
+	  return;
+	}
+    }
+}
+
+/**********************************************************************/
+/*			    Cache Manager                             */
+/**********************************************************************/
+
+static void
+free_cache (GtkText* text)
+{
+  GList* cache = text->line_start_cache;
+  
+  if (cache)
+    {
+      while (cache->prev)
+	cache = cache->prev;
+      
+      text->line_start_cache = cache;
+    }
+  
+  for (; cache; cache = cache->next)
+    g_mem_chunk_free (params_mem_chunk, cache->data);
+  
+  g_list_free (text->line_start_cache);
+  
+  text->line_start_cache = NULL;
+}
+
+static GList*
+remove_cache_line (GtkText* text, GList* member)
+{
+  GList *list;
+  
+  if (member == NULL)
+    return NULL;
+  
+  if (member == text->line_start_cache)
+    text->line_start_cache = text->line_start_cache->next;
+  
+  if (member->prev)
+    member->prev->next = member->next;
+  
+  if (member->next)
+    member->next->prev = member->prev;
+  
+  list = member->next;
+  
+  g_mem_chunk_free (params_mem_chunk, member->data);
+  g_list_free_1 (member);
+  
+  return list;
+}
+
+/**********************************************************************/
+/*			    Paragraph Index                           */
+/**********************************************************************/
+
+static GtkTextPrivate *
+gtk_text_get_private (GtkText *text)
+{
+  return gtk_object_get_data_by_id (GTK_OBJECT (text), private_key_id);
+}
+
+static void
+paragraph_free_all (TextTreeNode *node)
+{
+  if (node)
+    {
+      paragraph_free_all (node->left);
+      paragraph_free_all (node->right);
+      g_mem_chunk_free (paragraph_chunk, node);
+    }
+}
+
+static void
+gtk_text_private_destroy (GtkTextPrivate *private)
+{
+  chunk_free_all ((TextTreeNode*) private->chunks);
+  paragraph_free_all ((TextTreeNode*) private->paragraphs);
+  g_list_free (private->dirty);
+  g_free (private->pending);
+  g_free (private);
+}
+
+static void
+text_lines_invalidate (GtkText *text)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  
+  paragraph_free_all ((TextTreeNode*) private->paragraphs);
+  private->paragraphs = NULL;
+  
+  g_list_free (private->dirty);
+  private->dirty = NULL;
+}
+
+static TextParagraph *
+paragraph_new (guint chars, guint height)
+{
+  TextParagraph *paragraph;
+  
+  if (paragraph_chunk == NULL)
+    paragraph_chunk = g_mem_chunk_new ("text paragraph mem chunk",
+				       sizeof (TextParagraph),
+				       1024 * sizeof (TextParagraph),
+				       G_ALLOC_AND_FREE);
+  
+  paragraph = g_chunk_new (TextParagraph, paragraph_chunk);
+  paragraph->node.parent = NULL;
+  paragraph->chars = chars;
+  paragraph->height = height;
+  paragraph->dirty_link = NULL;
+  
+  return paragraph;
+}
+
+#define PARAGRAPH_CHARS(n)  ((n) ? ((TextParagraph*) (n))->total_chars : 0)
+#define PARAGRAPH_HEIGHT(n) ((n) ? ((TextParagraph*) (n))->total_height : 0)
+
+static void
+paragraph_update (TextTreeNode *node)
+{
+  TextParagraph *paragraph = (TextParagraph*) node;
+  
+  paragraph->total_chars = (PARAGRAPH_CHARS (node->left) +
+			    paragraph->chars +
+			    PARAGRAPH_CHARS (node->right));
+  paragraph->total_height = (PARAGRAPH_HEIGHT (node->left) +
+			     paragraph->height +
+			     PARAGRAPH_HEIGHT (node->right));
+}
+
+static void
+paragraph_changed (TextParagraph *paragraph)
+{
+  text_tree_changed ((TextTreeNode*) paragraph, paragraph_update);
+}
+
+/* Insert paragraph into the index right after prev, or at the start
+ * if prev is NULL. */
+static void
+paragraph_insert_after (GtkTextPrivate *private,
+			TextParagraph *prev,
+			TextParagraph *paragraph)
+{
+  TextTreeNode *next = NULL;
+  
+  if (!prev)
+    next = text_tree_first ((TextTreeNode*) private->paragraphs);
+  
+  private->paragraphs = (TextParagraph*) text_tree_insert ((TextTreeNode*) prev, next,
+							   (TextTreeNode*) paragraph,
+							   paragraph_update);
+}
+
+static void
+paragraph_remove (GtkTextPrivate *private, TextParagraph *paragraph)
+{
+  private->paragraphs = (TextParagraph*) text_tree_remove ((TextTreeNode*) paragraph,
+							   paragraph_update);
+  
+  if (paragraph->dirty_link)
+    {
+      private->dirty = g_list_remove_link (private->dirty, paragraph->dirty_link);
+      g_list_free_1 (paragraph->dirty_link);
+    }
+  
+  g_mem_chunk_free (paragraph_chunk, paragraph);
+}
+
+static TextParagraph *
+paragraph_next (TextParagraph *paragraph)
+{
+  return (TextParagraph*) text_tree_next ((TextTreeNode*) paragraph);
+}
+
+static void
+paragraph_set_dirty (GtkTextPrivate *private, TextParagraph *paragraph)
+{
+  if (!paragraph->dirty_link)
+    {
+      private->dirty = g_list_prepend (private->dirty, paragraph);
+      paragraph->dirty_link = private->dirty;
+    }
+}
+
+/* Find the first character and the top pixel of paragraph. */
+static void
+paragraph_position (TextParagraph *paragraph, guint *start, gint *top)
+{
+  TextTreeNode *node = (TextTreeNode*) paragraph;
+  guint chars = PARAGRAPH_CHARS (node->left);
+  gint height = PARAGRAPH_HEIGHT (node->left);
+  
+  for (; node->parent; node = node->parent)
+    if (node->parent->right == node)
+      {
+	chars += PARAGRAPH_CHARS (node->parent->left) + ((TextParagraph*) node->parent)->chars;
+	height += PARAGRAPH_HEIGHT (node->parent->left) + ((TextParagraph*) node->parent)->height;
+      }
+  
+  if (start)
+    *start = chars;
+  if (top)
+    *top = height;
+}
+
+static TextParagraph *
+paragraph_last (GtkTextPrivate *private, guint *start, gint *top)
+{
+  TextParagraph *paragraph;
+  
+  paragraph = (TextParagraph*) text_tree_last ((TextTreeNode*) private->paragraphs);
+  paragraph_position (paragraph, start, top);
+  
+  return paragraph;
+}
+
+/* Find the paragraph containing character index, as well as where it
+ * starts.  Indexes past the end give the last paragraph. */
+static TextParagraph *
+paragraph_find_index (GtkTextPrivate *private,
+		      guint index,
+		      guint *start,
+		      gint *top)
+{
+  TextTreeNode *node = (TextTreeNode*) private->paragraphs;
+  guint chars = 0;
+  gint height = 0;
+  
+  while (node)
+    {
+      TextParagraph *paragraph = (TextParagraph*) node;
+      
+      if (index < chars + PARAGRAPH_CHARS (node->left))
+	node = node->left;
+      else
+	{
+	  chars += PARAGRAPH_CHARS (node->left);
+	  height += PARAGRAPH_HEIGHT (node->left);
+	  
+	  if (index < chars + paragraph->chars)
+	    {
+	      if (start)
+		*start = chars;
+	      if (top)
+		*top = height;
+	      
+	      return paragraph;
+	    }
+	  
+	  chars += paragraph->chars;
+	  height += paragraph->height;
+	  node = node->right;
+	}
+    }
+  
+  return paragraph_last (private, start, top);
+}
+
+/* Likewise for the paragraph containing vertical pixel position pixel. */
+static TextParagraph *
+paragraph_find_pixel (GtkTextPrivate *private,
+		      gint pixel,
+		      guint *start,
+		      gint *top)
+{
+  TextTreeNode *node = (TextTreeNode*) private->paragraphs;
+  guint chars = 0;
+  gint height = 0;
+  
+  pixel = MAX (pixel, 0);
+  
+  while (node)
+    {
+      TextParagraph *paragraph = (TextParagraph*) node;
+      
+      if (pixel < height + (gint) PARAGRAPH_HEIGHT (node->left))
+	node = node->left;
+      else
 	{
-	  mask |= GDK_IC_PREEDIT_FONTSET;
-	  editable->ic_attr->preedit_fontset = MARK_CURRENT_FONT (text, &mark);
+	  chars += PARAGRAPH_CHARS (node->left);
+	  height += PARAGRAPH_HEIGHT (node->left);
+	  
+	  if (pixel < height + (gint) paragraph->height)
+	    {
+	      if (start)
+		*start = chars;
+	      if (top)
+		*top = height;
+	      
+	      return paragraph;
+	    }
+	  
+	  chars += paragraph->chars;
+	  height += paragraph->height;
+	  node = node->right;
 	}
+    }
+  
+  return paragraph_last (private, start, top);
+}
+
+static gint
+paragraph_scan_iterator (GtkText* text, LineParams* lp, void* data)
+{
+  ParagraphScanData *sdata = (ParagraphScanData*) data;
+  TextParagraph *paragraph;
+  
+  sdata->height += LINE_HEIGHT (*lp);
+  
+  if (LAST_INDEX (text, lp->end) ||
+      GTK_TEXT_INDEX (text, lp->end.index) == LINE_DELIM)
+    {
+      paragraph = paragraph_new (lp->end.index - sdata->start + 1, sdata->height);
+      paragraph_insert_after (sdata->private, sdata->last, paragraph);
       
-      gdk_ic_set_attr (editable->ic, editable->ic_attr, mask);
+      sdata->last = paragraph;
+      sdata->start = lp->end.index + 1;
+      sdata->height = 0;
     }
-#endif 
+  
+  return FALSE;
 }
 
-static void
-find_cursor (GtkText* text, gboolean scroll)
+/* Walks the lines of one paragraph, stopping at the line holding
+ * target_index or target_pixel, or at the last line. */
+static gint
+line_search_iterator (GtkText* text, LineParams* lp, void* data)
 {
-  if (GTK_WIDGET_REALIZED (text))
+  LineSearchData *sdata = (LineSearchData*) data;
+  gint found;
+  
+  if (sdata->by_pixel)
+    found = sdata->pixel_height + LINE_HEIGHT (*lp) > sdata->target_pixel;
+  else
+    found = lp->end.index >= sdata->target_index;
+  
+  if (found || lp->end.index >= sdata->end_index)
     {
-      find_line_containing_point (text, text->cursor_mark.index, scroll);
+      sdata->mark = lp->start;
+      sdata->line_height = LINE_HEIGHT (*lp);
       
-      if (text->current_line)
-	find_cursor_at_line (text,
-			     &CACHE_DATA(text->current_line),
-			     pixel_height_of(text, text->current_line));
+      return TRUE;
     }
   
-  GTK_EDITABLE (text)->current_pos = text->cursor_mark.index;
+  sdata->pixel_height += LINE_HEIGHT (*lp);
+  
+  return FALSE;
 }
 
 static void
-find_mouse_cursor_at_line (GtkText *text, const LineParams* lp,
-			   guint line_pixel_height,
-			   gint button_x)
+line_search (GtkText *text, guint start, gint top, guint chars,
+	     LineSearchData *sdata)
 {
-  GtkPropertyMark mark     = lp->start;
-  TabStopMark  tab_mark = lp->tab_cont.tab_start;
+  GtkPropertyMark mark = find_mark (text, start);
   
-  gint char_width = find_char_width(text, &mark, &tab_mark);
-  gint pixel_width = LINE_START_PIXEL (*lp) + (char_width+1)/2;
+  sdata->pixel_height = top;
+  sdata->end_index = start + chars - 1;
+  sdata->mark = mark;
+  sdata->line_height = 0;
   
-  text->cursor_pos_y = line_pixel_height;
+  line_params_iterate (text, &mark, NULL, FALSE, sdata, line_search_iterator);
+}
+
+/* Make sure the paragraph index is built and its heights are up to
+ * date.  Only call this while realized.
+ */
+static void
+text_lines_update (GtkText *text)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  LineSearchData sdata;
+  TextParagraph *paragraph;
+  guint flags;
+  guint start;
+  gint width;
   
-  for (;;)
+  gdk_window_get_size (text->text_area, &width, NULL);
+  if (GTK_EDITABLE (text)->editable || !text->word_wrap)
+    width -= LINE_WRAP_ROOM;
+  
+  flags = ((text->line_wrap ? 1 : 0) |
+	   (text->word_wrap ? 2 : 0) |
+	   (GTK_EDITABLE (text)->editable ? 4 : 0));
+  
+  /* Without line wrap, the width doesn't change any heights */
+  if (flags != private->layout_flags ||
+      (text->line_wrap && width != private->layout_width))
+    text_lines_invalidate (text);
+  
+  private->layout_flags = flags;
+  private->layout_width = width;
+  
+  if (!private->paragraphs)
     {
-      GdkWChar ch = LAST_INDEX (text, mark) ? 
-	LINE_DELIM : GTK_TEXT_INDEX (text, mark.index);
+      ParagraphScanData scan_data;
+      GtkPropertyMark mark = find_mark (text, 0);
       
-      if (button_x < pixel_width || mark.index == lp->end.index)
-	{
-	  text->cursor_pos_x       = pixel_width - (char_width+1)/2;
-	  text->cursor_mark        = mark;
-	  text->cursor_char_offset = lp->font_descent;
-	  
-	  if ((text->use_wchar) ? gdk_iswspace (ch) : isspace (ch))
-	    text->cursor_char = 0;
-	  else
-	    text->cursor_char = ch;
-	  
-	  break;
-	}
+      scan_data.private = private;
+      scan_data.last = NULL;
+      scan_data.start = 0;
+      scan_data.height = 0;
       
-      advance_tab_mark (text, &tab_mark, ch);
-      advance_mark (&mark);
+      line_params_iterate (text, &mark, NULL, FALSE, &scan_data,
+			   paragraph_scan_iterator);
       
-      pixel_width += char_width/2;
+      return;
+    }
+  
+  while (private->dirty)
+    {
+      paragraph = private->dirty->data;
       
-      char_width = find_char_width (text, &mark, &tab_mark);
+      private->dirty = g_list_remove_link (private->dirty, paragraph->dirty_link);
+      g_list_free_1 (paragraph->dirty_link);
+      paragraph->dirty_link = NULL;
       
-      pixel_width += (char_width+1)/2;
+      paragraph_position (paragraph, &start, NULL);
+      
+      sdata.by_pixel = FALSE;
+      sdata.target_index = start + paragraph->chars - 1;
+      line_search (text, start, 0, paragraph->chars, &sdata);
+      
+      paragraph->height = sdata.pixel_height + sdata.line_height;
+      paragraph_changed (paragraph);
     }
 }
 
+/* nchars characters have just been inserted at index.  Splits the
+ * paragraph they went into at each new newline; the heights are
+ * measured again the next time the index is needed.  The count of
+ * newlines is kept even while there is no index.
+ */
 static void
-find_mouse_cursor (GtkText* text, gint x, gint y)
+text_lines_insert (GtkText *text, guint index, guint nchars)
 {
-  gint pixel_height;
-  GList* cache = text->line_start_cache;
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextParagraph *paragraph = NULL;
+  TextParagraph *new_paragraph;
+  guint start = 0;
+  guint end = 0;
+  guint i;
   
-  g_assert (cache);
+  if (private->paragraphs)
+    {
+      paragraph = paragraph_find_index (private, index, &start, NULL);
+      end = start + paragraph->chars + nchars;
+      paragraph_set_dirty (private, paragraph);
+    }
   
-  pixel_height = - text->first_cut_pixels;
+  for (i = index; i < index + nchars; i++)
+    if (GTK_TEXT_INDEX (text, i) == LINE_DELIM)
+      {
+	private->newlines += 1;
+	
+	if (!paragraph)
+	  continue;
+	
+	paragraph->chars = i - start + 1;
+	paragraph_changed (paragraph);
+	
+	start = i + 1;
+	
+	new_paragraph = paragraph_new (end - start, 0);
+	paragraph_insert_after (private, paragraph, new_paragraph);
+	paragraph_set_dirty (private, new_paragraph);
+	
+	paragraph = new_paragraph;
+      }
   
-  for (; cache; cache = cache->next)
+  if (paragraph)
     {
-      pixel_height += LINE_HEIGHT(CACHE_DATA(cache));
-      
-      if (y < pixel_height || !cache->next)
-	{
-	  find_mouse_cursor_at_line (text, &CACHE_DATA(cache), pixel_height, x);
-	  
-	  find_cursor (text, FALSE);
-	  
-	  return;
-	}
+      paragraph->chars = end - start;
+      paragraph_changed (paragraph);
     }
 }
 
-/**********************************************************************/
-/*			    Cache Manager                             */
-/**********************************************************************/
-
+/* nchars characters are about to be deleted at index.  Joins the
+ * paragraphs whose newlines go with them.
+ */
 static void
-free_cache (GtkText* text)
-{
-  GList* cache = text->line_start_cache;
+text_lines_delete (GtkText *text, guint index, guint nchars)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextParagraph *paragraph;
+  TextParagraph *last;
+  TextParagraph *next;
+  guint start;
+  guint last_start;
+  guint i;
   
-  if (cache)
+  if (!private->paragraphs)
     {
-      while (cache->prev)
-	cache = cache->prev;
+      for (i = index; i < index + nchars; i++)
+	if (GTK_TEXT_INDEX (text, i) == LINE_DELIM)
+	  private->newlines -= 1;
       
-      text->line_start_cache = cache;
+      return;
     }
   
-  for (; cache; cache = cache->next)
-    g_mem_chunk_free (params_mem_chunk, cache->data);
+  paragraph = paragraph_find_index (private, index, &start, NULL);
+  last = paragraph_find_index (private, index + nchars, &last_start, NULL);
   
-  g_list_free (text->line_start_cache);
+  paragraph->chars = last_start + last->chars - nchars - start;
   
-  text->line_start_cache = NULL;
+  if (last != paragraph)
+    do
+      {
+	next = paragraph_next (paragraph);
+	paragraph_remove (private, next);
+	private->newlines -= 1;
+      }
+    while (next != last);
+  
+  paragraph_changed (paragraph);
+  paragraph_set_dirty (private, paragraph);
 }
 
-static GList*
-remove_cache_line (GtkText* text, GList* member)
+/* Find the start of the display line holding index, its top pixel
+ * and its height. */
+static GtkPropertyMark
+find_line_at_index (GtkText *text, guint index,
+		    gint *top, gint *line_height)
 {
-  GList *list;
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextParagraph *paragraph;
+  LineSearchData sdata;
+  guint start;
+  gint paragraph_top;
   
-  if (member == NULL)
-    return NULL;
+  text_lines_update (text);
+  paragraph = paragraph_find_index (private, index, &start, &paragraph_top);
   
-  if (member == text->line_start_cache)
-    text->line_start_cache = text->line_start_cache->next;
+  sdata.by_pixel = FALSE;
+  sdata.target_index = index;
+  line_search (text, start, paragraph_top, paragraph->chars, &sdata);
   
-  if (member->prev)
-    member->prev->next = member->next;
+  *top = sdata.pixel_height;
+  if (line_height)
+    *line_height = sdata.line_height;
   
-  if (member->next)
-    member->next->prev = member->prev;
+  return sdata.mark;
+}
+
+/* Find the start of the display line at vertical position pixel,
+ * and its top pixel. */
+static GtkPropertyMark
+find_line_at_pixel (GtkText *text, gint pixel, gint *top)
+{
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  TextParagraph *paragraph;
+  LineSearchData sdata;
+  guint start;
+  gint paragraph_top;
   
-  list = member->next;
+  text_lines_update (text);
+  paragraph = paragraph_find_pixel (private, pixel, &start, &paragraph_top);
   
-  g_mem_chunk_free (params_mem_chunk, member->data);
-  g_list_free_1 (member);
+  sdata.by_pixel = TRUE;
+  sdata.target_pixel = pixel;
+  line_search (text, start, paragraph_top, paragraph->chars, &sdata);
   
-  return list;
+  *top = sdata.pixel_height;
+  
+  return sdata.mark;
 }
 
 /**********************************************************************/
@@ -4391,73 +6605,29 @@ adjust_adj (GtkText* text, GtkAdjustment* adj)
   gtk_signal_emit_by_name (GTK_OBJECT (adj), "changed");
 }
 
-static gint
-set_vertical_scroll_iterator (GtkText* text, LineParams* lp, void* data)
+static GtkPropertyMark
+set_vertical_scroll (GtkText* text)
 {
-  SetVerticalScrollData *svdata = (SetVerticalScrollData *) data;
-  
-  if ((text->first_line_start_index >= lp->start.index) &&
-      (text->first_line_start_index <= lp->end.index))
-    {
-      svdata->mark = lp->start;
-  
-      if (text->first_line_start_index == lp->start.index)
-	{
-	  text->first_onscreen_ver_pixel = svdata->pixel_height + text->first_cut_pixels;
-	}
-      else
-	{
-	  text->first_onscreen_ver_pixel = svdata->pixel_height;
-	  text->first_cut_pixels = 0;
-	}
-      
-      text->vadj->value = (float) text->first_onscreen_ver_pixel;
-    }
-  
-  svdata->pixel_height += LINE_HEIGHT (*lp);
+  GtkTextPrivate *private = gtk_text_get_private (text);
+  GtkPropertyMark mark;
+  gint height;
+  gint orig_value;
+  gint top;
   
-  return FALSE;
-}
-
-static gint
-set_vertical_scroll_find_iterator (GtkText* text, LineParams* lp, void* data)
-{
-  SetVerticalScrollData *svdata = (SetVerticalScrollData *) data;
-  gint return_val;
+  mark = find_line_at_index (text, text->first_line_start_index, &top, NULL);
   
-  if (svdata->pixel_height <= (gint) text->vadj->value &&
-      svdata->pixel_height + LINE_HEIGHT(*lp) > (gint) text->vadj->value)
+  if (text->first_line_start_index == mark.index)
     {
-      svdata->mark = lp->start;
-      
-      text->first_cut_pixels = (gint)text->vadj->value - svdata->pixel_height;
-      text->first_onscreen_ver_pixel = svdata->pixel_height;
-      text->first_line_start_index = lp->start.index;
-      
-      return_val = TRUE;
+      text->first_onscreen_ver_pixel = top + text->first_cut_pixels;
     }
   else
     {
-      svdata->pixel_height += LINE_HEIGHT (*lp);
-      
-      return_val = FALSE;
+      text->first_onscreen_ver_pixel = top;
+      text->first_cut_pixels = 0;
     }
   
-  return return_val;
-}
-
-static GtkPropertyMark
-set_vertical_scroll (GtkText* text)
-{
-  GtkPropertyMark mark = find_mark (text, 0);
-  SetVerticalScrollData data;
-  gint height;
-  gint orig_value;
-  
-  data.pixel_height = 0;
-  line_params_iterate (text, &mark, NULL, FALSE, &data, set_vertical_scroll_iterator);
-  
-  text->vadj->upper = (float) data.pixel_height;
+  text->vadj->value = (float) text->first_onscreen_ver_pixel;
+  text->vadj->upper = (float) private->paragraphs->total_height;
   orig_value = (gint) text->vadj->value;
   
   gdk_window_get_size (text->text_area, NULL, &height);
@@ -4475,15 +6645,14 @@ set_vertical_scroll (GtkText* text)
   if (text->vadj->value != orig_value)
     {
       /* We got clipped, and don't really know which line to put first. */
-      data.pixel_height = 0;
-      data.last_didnt_wrap = TRUE;
+      mark = find_line_at_pixel (text, (gint) text->vadj->value, &top);
       
-      line_params_iterate (text, &mark, NULL,
-			   FALSE, &data,
-			   set_vertical_scroll_find_iterator);
+      text->first_cut_pixels = (gint) text->vadj->value - top;
+      text->first_onscreen_ver_pixel = top;
+      text->first_line_start_index = mark.index;
     }
 
-  return data.mark;
+  return mark;
 }
 
 static void
@@ -4684,6 +6853,60 @@ scroll_up (GtkText* text, gint diff0)
     process_exposes (text);
 }
 
+/* Move the view to vadj->value by refilling the line cache there,
+ * rather than stepping through everything in between like
+ * scroll_down() and scroll_up().
+ */
+static void
+scroll_jump (GtkText* text, gint diff)
+{
+  GtkPropertyMark mark;
+  GdkRectangle rect;
+  gint width, height;
+  gint top;
+  
+  mark = find_line_at_pixel (text, (gint) text->vadj->value, &top);
+  
+  text->first_cut_pixels = (gint) text->vadj->value - top;
+  text->first_onscreen_ver_pixel = (gint) text->vadj->value;
+  text->first_line_start_index = mark.index;
+  
+  free_cache (text);
+  text->current_line = NULL;
+  fill_line_cache (text, &mark);
+  
+  gdk_window_get_size (text->text_area, &width, &height);
+  
+  rect.x      = 0;
+  rect.y      = 0;
+  rect.width  = width;
+  rect.height = height;
+  
+  expose_text (text, &rect, FALSE);
+  gtk_text_draw_focus ( (GtkWidget *) text);
+  
+  /* Like scrolling, keep the cursor if it is still on screen, and
+   * otherwise move it to the edge we scrolled away from. */
+  if (text->cursor_mark.index < CACHE_DATA(text->line_start_cache).start.index)
+    find_mouse_cursor (text, text->cursor_pos_x,
+		       first_visible_line_height (text));
+  else if (text->cursor_mark.index >
+	   CACHE_DATA(g_list_last (text->line_start_cache)).end.index)
+    find_mouse_cursor (text, text->cursor_pos_x,
+		       last_visible_line_height (text));
+  else
+    {
+      find_cursor (text, FALSE);
+      
+      if (diff > 0 && drawn_cursor_min (text) < 0)
+	find_mouse_cursor (text, text->cursor_pos_x,
+			   first_visible_line_height (text));
+      else if (diff < 0 && drawn_cursor_max (text) >= height)
+	find_mouse_cursor (text, text->cursor_pos_x,
+			   last_visible_line_height (text));
+    }
+}
+
 /**********************************************************************/
 /*			      Display Code                            */
 /**********************************************************************/
@@ -4855,9 +7078,9 @@ expand_scratch_buffer (GtkText* text, guint len)
 {
   if (len >= text->scratch_buffer_len)
     {
-      guint i = 1;
+      guint i = MIN_GAP_SIZE;
       
-      while (i <= len && i < MIN_GAP_SIZE) i <<= 1;
+      while (i <= len) i <<= 1;
       
       if (text->use_wchar)
         {
@@ -4947,42 +7170,8 @@ draw_line (GtkText* text,
   
   /* First provide a contiguous segment of memory.  This makes reading
    * the code below *much* easier, and only incurs the cost of copying
-   * when the line being displayed spans the gap. */
-  if (mark.index <= text->gap_position &&
-      mark.index + chars > text->gap_position)
-    {
-      expand_scratch_buffer (text, chars);
-      
-      if (text->use_wchar)
-	{
-	  for (i = 0; i < chars; i += 1)
-	    text->scratch_buffer.wc[i] = GTK_TEXT_INDEX(text, mark.index + i);
-          buffer.wc = text->scratch_buffer.wc;
-	}
-      else
-	{
-	  for (i = 0; i < chars; i += 1)
-	    text->scratch_buffer.ch[i] = GTK_TEXT_INDEX(text, mark.index + i);
-	  buffer.ch = text->scratch_buffer.ch;
-	}
-    }
-  else
-    {
-      if (text->use_wchar)
-	{
-	  if (mark.index >= text->gap_position)
-	    buffer.wc = text->text.wc + mark.index + text->gap_size;
-	  else
-	    buffer.wc = text->text.wc + mark.index;
-	}
-      else
-	{
-	  if (mark.index >= text->gap_position)
-	    buffer.ch = text->text.ch + mark.index + text->gap_size;
-	  else
-	    buffer.ch = text->text.ch + mark.index;
-	}
-    }
+   * when the line being displayed spans two chunks. */
+  buffer.ch = text_chunk_fetch (text, mark.index, chars);
   
   
   if (running_offset > 0)
@@ -5428,14 +7617,27 @@ gtk_text_update_text    (GtkEditable       *editable,
 static void
 recompute_geometry (GtkText* text)
 {
-  GtkPropertyMark mark, start_mark;
+  GtkPropertyMark start_mark;
+  
+  free_cache (text);
+  
+  start_mark = set_vertical_scroll (text);
+  fill_line_cache (text, &start_mark);
+  
+  find_cursor (text, TRUE);
+}
+
+/* Fill line_start_cache with the lines on screen, the first of them
+ * starting at start_mark. */
+static void
+fill_line_cache (GtkText* text, const GtkPropertyMark *start_mark)
+{
+  GtkPropertyMark mark;
   GList *new_lines;
   gint height;
   gint width;
   
-  free_cache (text);
-  
-  mark = start_mark = set_vertical_scroll (text);
+  mark = *start_mark;
 
   /* We need a real start of a line when calling fetch_lines().
    * not the start of a wrapped line.
@@ -5472,12 +7674,10 @@ recompute_geometry (GtkText* text)
 
   /* Now work forward to the actual first onscreen line */
 
-  while (CACHE_DATA (new_lines).start.index < start_mark.index)
+  while (CACHE_DATA (new_lines).start.index < start_mark->index)
     new_lines = new_lines->next;
   
   text->line_start_cache = new_lines;
-  
-  find_cursor (text, TRUE);
 }
 
 /**********************************************************************/
@@ -48,6 +48,14 @@ typedef struct _GtkPropertyMark   GtkPropertyMark;
 typedef struct _GtkText           GtkText;
 typedef struct _GtkTextClass      GtkTextClass;
 
+/* Fills buffer with up to length bytes of text to append and returns
+ * how many it wrote, 0 if there is nothing to add right now, or -1
+ * once there will be no more. */
+typedef gint (*GtkTextStreamFunc) (GtkText *text,
+				   gchar   *buffer,
+				   gint     length,
+				   gpointer data);
+
 struct _GtkPropertyMark
 {
   /* Position in list. */
@@ -74,22 +82,18 @@ struct _GtkText
   GdkPixmap* line_wrap_bitmap;
   GdkPixmap* line_arrow_bitmap;
 
-		      /* GAPPED TEXT SEGMENT */
+			  /* TEXT STORAGE */
 
-  /* The text, a single segment of text a'la emacs, with a gap
-   * where insertion occurs. */
+  /* The text is no longer a single segment with a gap, but kept in
+   * chunks of its own; read it with GTK_TEXT_INDEX() or
+   * gtk_editable_get_chars().  text is NULL, and gap_position and
+   * gap_size are 0. */
   union { GdkWChar *wc; guchar  *ch; } text;
-  /* The allocated length of the text segment. */
+  /* The number of bytes allocated for the text. */
   guint text_len;
-  /* The gap position, index into address where a char
-   * should be inserted. */
   guint gap_position;
-  /* The gap size, s.t. *(text + gap_position + gap_size) is
-   * the first valid character following the gap. */
   guint gap_size;
-  /* The last character position, index into address where a
-   * character should be appeneded.  Thus, text_end - gap_size
-   * is the length of the actual data. */
+  /* The length of the text. */
   guint text_end;
 			/* LINE START CACHE */
 
@@ -111,7 +115,8 @@ struct _GtkText
   guint line_wrap : 1;
   guint word_wrap : 1;
  /* If a fontset is supplied for the widget, use_wchar become true,
-   * and we use GdkWchar as the encoding of text. */
+   * and we use GdkWchar as the encoding of text.  In compact storage
+   * that only happens once the text holds a character outside ASCII. */
   guint use_wchar : 1;
 
   /* Frozen, don't do updates. @@@ fixme */
@@ -204,11 +209,51 @@ gint       gtk_text_backward_delete (GtkText       *text,
 gint       gtk_text_forward_delete  (GtkText       *text,
 				     guint          nchars);
 
-#define GTK_TEXT_INDEX(t, index)	(((t)->use_wchar) \
-	? ((index) < (t)->gap_position ? (t)->text.wc[index] : \
-					(t)->text.wc[(index)+(t)->gap_size]) \
-	: ((index) < (t)->gap_position ? (t)->text.ch[index] : \
-					(t)->text.ch[(index)+(t)->gap_size]))
+/* Append text read from fd, or produced by func, to the end of the
+ * text in chunks, redrawing at most once a frame.  destroy is called
+ * with data when the stream ends, on end of file, error,
+ * gtk_text_stream_stop() or destruction of the widget.
+ */
+void       gtk_text_stream_fd       (GtkText          *text,
+				     gint              fd,
+				     gpointer          data,
+				     GtkDestroyNotify  destroy);
+void       gtk_text_stream_func     (GtkText          *text,
+				     GtkTextStreamFunc func,
+				     gpointer          data,
+				     GtkDestroyNotify  destroy);
+void       gtk_text_stream_stop     (GtkText          *text);
+
+/* Keep at most max_lines lines, dropping the oldest ones as text is
+ * streamed in; 0 means no limit. */
+void       gtk_text_set_max_lines   (GtkText       *text,
+				     guint          max_lines);
+guint      gtk_text_get_max_lines   (GtkText       *text);
+
+/* With a fontset, keep the text one byte a character for as long as
+ * it is all ASCII, rather than always as GdkWChar.  On by default. */
+void       gtk_text_set_compact_storage (GtkText  *text,
+					 gboolean  compact);
+gboolean   gtk_text_get_compact_storage (GtkText  *text);
+
+/* Find string in the text without copying it out.  Forward searches
+ * return the first match starting at or after start, backward ones
+ * the last match ending at or before start; both return -1 if there
+ * is none.
+ */
+gint       gtk_text_search_forward  (GtkText       *text,
+				     const gchar   *string,
+				     guint          start);
+gint       gtk_text_search_backward (GtkText       *text,
+				     const gchar   *string,
+				     guint          start);
+
+/* The character at index, which must be less than the length.
+ * Looking at characters in order is cheapest. */
+GdkWChar   gtk_text_get_char        (GtkText       *text,
+				     guint          index);
+
+#define GTK_TEXT_INDEX(t, index)	gtk_text_get_char ((t), (index))
 
 #ifdef __cplusplus
 }
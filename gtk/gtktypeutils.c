@@ -31,6 +31,8 @@
 #define	TYPE_NODES_BLOCK_SIZE	(35)  /* needs to be > GTK_TYPE_FUNDAMENTAL_MAX */
 
 typedef struct _GtkTypeNode GtkTypeNode;
+typedef struct _GtkTypeSlab GtkTypeSlab;
+typedef union  _GtkTypeAtom GtkTypeAtom;
 
 struct _GtkTypeNode
 {
@@ -42,9 +44,44 @@ struct _GtkTypeNode
   GtkType parent_type;
   gpointer klass;
   GList *children_types;
-  GMemChunk *mem_chunk;
+
+  /* instance allocation, slabs are only used if a chunk size
+   * was set through gtk_type_set_chunk_alloc()
+   */
+  guint slab_n_atoms;
+  guint atom_size;
+  GtkTypeSlab *free_slabs;
+  guint n_slabs;
+  guint n_empty_slabs;
+  guint n_live;
+  guint n_peak;
+};
+
+/* every instance allocated from a slab is preceeded by an atom header
+ * that points back to its slab, while the instance is free, the header
+ * links it into the slab's free list.
+ */
+union _GtkTypeAtom
+{
+  GtkTypeSlab *slab;
+  GtkTypeAtom *next;
+  gdouble      alignment;
+};
+
+struct _GtkTypeSlab
+{
+  GtkTypeSlab *next;
+  GtkTypeSlab *prev;
+  GtkTypeAtom *free_atoms;
+  guint n_used;
+  guint n_fresh;	/* untouched atoms at the end of the slab */
 };
 
+#define	SLAB_HEADER_SIZE	((sizeof (GtkTypeSlab) + sizeof (GtkTypeAtom) - 1) & \
+				 ~(sizeof (GtkTypeAtom) - 1))
+#define	SLAB_ATOM(slab, node, n) ((GtkTypeAtom*) (((guint8*) (slab)) + SLAB_HEADER_SIZE + \
+						 (n) * (node)->atom_size))
+
 #define	LOOKUP_TYPE_NODE(node_var, type)	{ \
     GtkTypeNode *__node = NULL; \
     GtkType sqn = GTK_TYPE_SEQNO (type); \
@@ -149,17 +186,115 @@ gtk_type_set_chunk_alloc (GtkType      type,
   g_return_if_fail (node != NULL);
   g_return_if_fail (node->chunk_alloc_locked == FALSE);
   
-  if (node->mem_chunk)
+  /* no instances have been created yet, so there are no slabs to release
+   */
+  node->slab_n_atoms = n_chunks;
+  if (n_chunks)
     {
-      g_mem_chunk_destroy (node->mem_chunk);
-      node->mem_chunk = NULL;
+      guint object_size;
+
+      object_size = node->type_info.object_size + sizeof (GtkTypeAtom) - 1;
+      object_size &= ~(sizeof (GtkTypeAtom) - 1);
+      node->atom_size = sizeof (GtkTypeAtom) + object_size;
+    }
+  else
+    node->atom_size = 0;
+}
+
+static gpointer
+gtk_type_slab_alloc (GtkTypeNode *node)
+{
+  GtkTypeSlab *slab;
+  GtkTypeAtom *atom;
+
+  slab = node->free_slabs;
+  if (!slab)
+    {
+      slab = g_malloc (SLAB_HEADER_SIZE + node->slab_n_atoms * node->atom_size);
+      slab->next = NULL;
+      slab->prev = NULL;
+      slab->free_atoms = NULL;
+      slab->n_used = 0;
+      slab->n_fresh = node->slab_n_atoms;
+      node->free_slabs = slab;
+      node->n_slabs++;
+      node->n_empty_slabs++;
+    }
+
+  if (slab->n_used == 0)
+    node->n_empty_slabs--;
+
+  if (slab->free_atoms)
+    {
+      atom = slab->free_atoms;
+      slab->free_atoms = atom->next;
+    }
+  else
+    {
+      atom = SLAB_ATOM (slab, node, node->slab_n_atoms - slab->n_fresh);
+      slab->n_fresh--;
+    }
+  slab->n_used++;
+
+  /* full slabs are kept off the list, they get relinked once an
+   * instance is released back to them
+   */
+  if (slab->n_used == node->slab_n_atoms)
+    {
+      node->free_slabs = slab->next;
+      if (slab->next)
+	slab->next->prev = NULL;
+      slab->next = NULL;
+    }
+
+  atom->slab = slab;
+  memset (atom + 1, 0, node->type_info.object_size);
+
+  return atom + 1;
+}
+
+static void
+gtk_type_slab_free (GtkTypeNode *node,
+		    gpointer	 mem)
+{
+  GtkTypeSlab *slab;
+  GtkTypeAtom *atom;
+
+  atom = ((GtkTypeAtom*) mem) - 1;
+  slab = atom->slab;
+
+  if (slab->n_used == node->slab_n_atoms)
+    {
+      slab->prev = NULL;
+      slab->next = node->free_slabs;
+      if (slab->next)
+	slab->next->prev = slab;
+      node->free_slabs = slab;
+    }
+
+  atom->next = slab->free_atoms;
+  slab->free_atoms = atom;
+  slab->n_used--;
+
+  if (slab->n_used == 0)
+    {
+      /* keep a single empty slab around to avoid thrashing the system
+       * allocator for types that get created and destroyed in turns
+       */
+      if (node->n_empty_slabs)
+	{
+	  if (slab->prev)
+	    slab->prev->next = slab->next;
+	  else
+	    node->free_slabs = slab->next;
+	  if (slab->next)
+	    slab->next->prev = slab->prev;
+	  node->n_slabs--;
+	  g_free (slab);
+	}
+      else
+	node->n_empty_slabs++;
     }
-  
-  if (n_chunks)
-    node->mem_chunk = g_mem_chunk_new (node->type_info.type_name,
-				       node->type_info.object_size,
-				       node->type_info.object_size * n_chunks,
-				       G_ALLOC_AND_FREE);
 }
 
 static GtkType
@@ -214,7 +349,13 @@ gtk_type_create (GtkType      parent_type,
   new_node->parent_type = parent_type;
   new_node->klass = NULL;
   new_node->children_types = NULL;
-  new_node->mem_chunk = NULL;
+  new_node->slab_n_atoms = 0;
+  new_node->atom_size = 0;
+  new_node->free_slabs = NULL;
+  new_node->n_slabs = 0;
+  new_node->n_empty_slabs = 0;
+  new_node->n_live = 0;
+  new_node->n_peak = 0;
   
   if (parent)
     parent->children_types = g_list_append (parent->children_types, GUINT_TO_POINTER (new_node->type));
@@ -364,10 +505,13 @@ gtk_type_new (GtkType type)
     }
   node->chunk_alloc_locked = TRUE;
 
-  if (node->mem_chunk)
-    tobject = g_mem_chunk_alloc0 (node->mem_chunk);
+  if (node->slab_n_atoms)
+    tobject = gtk_type_slab_alloc (node);
   else
     tobject = g_malloc0 (node->type_info.object_size);
+  node->n_live++;
+  if (node->n_live > node->n_peak)
+    node->n_peak = node->n_live;
   
   /* we need to call the base classes' object_init_func for derived
    * objects with the object's ->klass field still pointing to the
@@ -413,10 +557,11 @@ gtk_type_free (GtkType	    type,
   LOOKUP_TYPE_NODE (node, type);
   g_return_if_fail (node != NULL);
   
-  if (node->mem_chunk)
-    g_mem_chunk_free (node->mem_chunk, mem);
+  if (node->slab_n_atoms)
+    gtk_type_slab_free (node, mem);
   else
     g_free (mem);
+  node->n_live--;
 }
 
 GList*
@@ -904,6 +1049,31 @@ gtk_type_query (GtkType type)
   return NULL;
 }
 
+GtkTypeMemStats*
+gtk_type_mem_stats (GtkType type)
+{
+  GtkTypeNode *node;
+  
+  LOOKUP_TYPE_NODE (node, type);
+  if (node)
+    {
+      GtkTypeMemStats *stats;
+
+      stats = g_new0 (GtkTypeMemStats, 1);
+      stats->type = type;
+      stats->n_live = node->n_live;
+      stats->n_peak = node->n_peak;
+      stats->n_slabs = node->n_slabs;
+      stats->slab_n_instances = node->slab_n_atoms;
+      stats->slab_bytes = node->n_slabs * (SLAB_HEADER_SIZE +
+					    node->slab_n_atoms * node->atom_size);
+
+      return stats;
+    }
+  
+  return NULL;
+}
+
 extern void gtk_object_init_type (void);
 
 #include "makeenums.h"			/* include for various places
@@ -151,6 +151,7 @@ typedef struct _GtkArg	       GtkArg;
 typedef struct _GtkObject      GtkObject;   /* forward declaration of object type */
 typedef struct _GtkTypeInfo    GtkTypeInfo;
 typedef struct _GtkTypeQuery   GtkTypeQuery;
+typedef struct _GtkTypeMemStats GtkTypeMemStats;
 typedef struct _GtkEnumValue   GtkEnumValue;
 typedef struct _GtkEnumValue   GtkFlagValue;
 
@@ -328,6 +329,16 @@ struct _GtkTypeQuery
   guint			 class_size;
 };
 
+struct _GtkTypeMemStats
+{
+  GtkType		 type;
+  guint			 n_live;
+  guint			 n_peak;
+  guint			 n_slabs;
+  guint			 slab_n_instances;
+  gulong		 slab_bytes;
+};
+
 struct _GtkEnumValue
 {
   guint	 value;
@@ -378,6 +389,12 @@ GtkType		gtk_type_get_varargs_type	(GtkType	foreign_type);
  * must not modify data pointed to by the members of GtkTypeQuery
  */
 GtkTypeQuery*	gtk_type_query			(GtkType	type);
+/* Report instance allocation statistics for a type, that is the number
+ * of currently living and the peak number of instances, plus the slabs
+ * in use if gtk_type_set_chunk_alloc() was called. The caller has the
+ * responsibility to invoke a subsequent g_free (returned_data).
+ */
+GtkTypeMemStats* gtk_type_mem_stats		(GtkType	type);
 
 
 
@@ -90,7 +90,8 @@ gtk_vbutton_box_new (void)
 
 
 
-/* set default value for spacing */
+/* set default value for spacing, boxes that are already shown only
+ * pick it up when resized */
 
 void gtk_vbutton_box_set_spacing_default (gint spacing)
 {
@@ -1004,7 +1004,7 @@ gtk_widget_init (GtkWidget *widget)
   GdkColormap *colormap;
   GdkVisual *visual;
   
-  GTK_PRIVATE_FLAGS (widget) = 0;
+  GTK_PRIVATE_FLAGS (widget) = PRIVATE_GTK_REQUEST_NEEDED;
   widget->state = GTK_STATE_NORMAL;
   widget->saved_state = GTK_STATE_NORMAL;
   widget->name = NULL;
@@ -2281,6 +2281,8 @@ gtk_widget_idle_draw (gpointer cb_data)
 void
 gtk_widget_queue_resize (GtkWidget *widget)
 {
+  GtkWidget *parent;
+
   g_return_if_fail (widget != NULL);
   g_return_if_fail (GTK_IS_WIDGET (widget));
 
@@ -2289,6 +2291,16 @@ gtk_widget_queue_resize (GtkWidget *widget)
 
   gtk_widget_queue_clear (widget);
 
+  /* only the widget and its ancestors can have a changed requisition,
+   * everything else will hand out its cached one upon size_request.
+   */
+  parent = widget;
+  while (parent)
+    {
+      GTK_PRIVATE_SET_FLAG (parent, GTK_REQUEST_NEEDED);
+      parent = parent->parent;
+    }
+
   if (widget->parent)
     gtk_container_queue_resize (GTK_CONTAINER (widget->parent));
   else if (GTK_WIDGET_TOPLEVEL (widget))
@@ -2392,8 +2404,19 @@ gtk_widget_size_request (GtkWidget	*widget,
 
   gtk_widget_ref (widget);
   gtk_widget_ensure_style (widget);
-  gtk_signal_emit (GTK_OBJECT (widget), widget_signals[SIZE_REQUEST],
-		   &widget->requisition);
+
+  /* widget->requisition stays valid until gtk_widget_queue_resize()
+   * is invoked on the widget or one of its descendants. hidden widgets
+   * are always re-requested though, since most setters don't bother
+   * to queue a resize for them.
+   */
+  if (GTK_WIDGET_REQUEST_NEEDED (widget))
+    {
+      if (GTK_WIDGET_VISIBLE (widget))
+	GTK_PRIVATE_UNSET_FLAG (widget, GTK_REQUEST_NEEDED);
+      gtk_signal_emit (GTK_OBJECT (widget), widget_signals[SIZE_REQUEST],
+		       &widget->requisition);
+    }
 
   if (requisition)
     gtk_widget_get_child_requisition (widget, requisition);
@@ -3564,6 +3587,7 @@ gtk_widget_set_style_internal (GtkWidget *widget,
 		       initial_emission ? NULL : previous_style);
       gtk_style_unref (previous_style);
 
+      GTK_PRIVATE_SET_FLAG (widget, GTK_REQUEST_NEEDED);
       if (widget->parent && !initial_emission)
 	{
 	  GtkRequisition old_requisition;
@@ -3713,26 +3713,31 @@ add1000_clist (GtkWidget *widget, gpointer data)
 static void
 add10000_clist (GtkWidget *widget, gpointer data)
 {
-  gint i;
+  gint i, j;
   char text[TESTGTK_CLIST_COLUMNS][50];
-  char *texts[TESTGTK_CLIST_COLUMNS];
+  char **rows[10000];
 
   for (i = 0; i < TESTGTK_CLIST_COLUMNS; i++)
-    {
-      texts[i] = text[i];
-      sprintf (text[i], "Column %d", i);
-    }
+    sprintf (text[i], "Column %d", i);
   
   sprintf (text[1], "Right");
   sprintf (text[2], "Center");
   
-  gtk_clist_freeze (GTK_CLIST (data));
   for (i = 0; i < 10000; i++)
     {
-      sprintf (text[0], "CListRow %d", rand() % 10000);
-      gtk_clist_append (GTK_CLIST (data), texts);
+      rows[i] = g_new (char *, TESTGTK_CLIST_COLUMNS);
+      rows[i][0] = g_strdup_printf ("CListRow %d", rand() % 10000);
+      for (j = 1; j < TESTGTK_CLIST_COLUMNS; j++)
+	rows[i][j] = text[j];
+    }
+
+  gtk_clist_append_rows (GTK_CLIST (data), rows, 10000);
+
+  for (i = 0; i < 10000; i++)
+    {
+      g_free (rows[i][0]);
+      g_free (rows[i]);
     }
-  gtk_clist_thaw (GTK_CLIST (data));
 }
 
 void
@@ -4121,6 +4126,83 @@ create_clist (void)
     }
 }
 
+/*
+ * Virtual GtkCList
+ */
+
+#define VIRTUAL_CLIST_ROWS 5000000
+
+static void
+virtual_clist_fill (GtkCList *clist,
+		    gint      row,
+		    gchar   **text,
+		    gpointer  data)
+{
+  static gchar buffer[3][32];
+
+  sprintf (buffer[0], "Row %d", row);
+  sprintf (buffer[1], "0x%08x", row);
+  sprintf (buffer[2], "%u", (guint) row * 2654435761U);
+
+  text[0] = buffer[0];
+  text[1] = buffer[1];
+  text[2] = buffer[2];
+}
+
+static void
+create_virtual_clist (void)
+{
+  static GtkWidget *window = NULL;
+  static char *titles[] = { "Row", "Hex", "Hash" };
+  GtkWidget *scrolled_win;
+  GtkWidget *clist;
+  GtkWidget *button;
+
+  if (!window)
+    {
+      window = gtk_dialog_new ();
+
+      gtk_signal_connect (GTK_OBJECT (window), "destroy",
+			  GTK_SIGNAL_FUNC (gtk_widget_destroyed), &window);
+
+      gtk_window_set_title (GTK_WINDOW (window), "virtual clist");
+      gtk_container_set_border_width (GTK_CONTAINER (window), 0);
+      gtk_window_set_default_size (GTK_WINDOW (window), 400, 400);
+
+      scrolled_win = gtk_scrolled_window_new (NULL, NULL);
+      gtk_container_set_border_width (GTK_CONTAINER (scrolled_win), 5);
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_win),
+				      GTK_POLICY_AUTOMATIC, 
+				      GTK_POLICY_AUTOMATIC);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  scrolled_win, TRUE, TRUE, 0);
+
+      clist = gtk_clist_new_with_titles (3, titles);
+      gtk_clist_set_selection_mode (GTK_CLIST (clist),
+				    GTK_SELECTION_EXTENDED);
+      gtk_clist_set_column_width (GTK_CLIST (clist), 0, 100);
+      gtk_clist_set_column_width (GTK_CLIST (clist), 1, 100);
+      gtk_clist_set_virtual (GTK_CLIST (clist), virtual_clist_fill,
+			     NULL, NULL);
+      gtk_clist_set_virtual_rows (GTK_CLIST (clist), VIRTUAL_CLIST_ROWS);
+      gtk_container_add (GTK_CONTAINER (scrolled_win), clist);
+
+      button = gtk_button_new_with_label ("close");
+      gtk_signal_connect_object (GTK_OBJECT (button), "clicked",
+				 GTK_SIGNAL_FUNC (gtk_widget_destroy),
+				 GTK_OBJECT (window));
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_grab_default (button);
+    }
+
+  if (!GTK_WIDGET_VISIBLE (window))
+    gtk_widget_show_all (window);
+  else
+    gtk_widget_destroy (window);
+}
+
 /*
  * GtkCTree
  */
@@ -8129,6 +8211,762 @@ create_mainloop (void)
     gtk_widget_destroy (window);
 }
 
+/*
+ * Resize Test
+ */
+
+#define RESIZE_TEST_ROWS      100
+#define RESIZE_TEST_COLUMNS   50
+#define RESIZE_TEST_RELABELS  200
+
+void
+resize_test_relabel (GtkWidget *widget,
+		     GtkWidget *result)
+{
+  static gint count = 0;
+  GtkWidget *window;
+  GtkWidget *label;
+  GTimer *timer;
+  gchar buffer[64];
+  gint i;
+
+  window = gtk_widget_get_toplevel (widget);
+  label = gtk_object_get_data (GTK_OBJECT (window), "relabel");
+
+  /* have every relabeling negotiate the new size synchronously */
+  gtk_container_set_resize_mode (GTK_CONTAINER (window), GTK_RESIZE_IMMEDIATE);
+
+  timer = g_timer_new ();
+  for (i = 0; i < RESIZE_TEST_RELABELS; i++)
+    {
+      sprintf (buffer, "%d", ++count % 1000);
+      gtk_label_set_text (GTK_LABEL (label), buffer);
+    }
+  g_timer_stop (timer);
+
+  gtk_container_set_resize_mode (GTK_CONTAINER (window), GTK_RESIZE_QUEUE);
+
+  sprintf (buffer, "%d relabels: %.3f ms each",
+	   RESIZE_TEST_RELABELS,
+	   g_timer_elapsed (timer, NULL) * 1000.0 / RESIZE_TEST_RELABELS);
+  gtk_label_set_text (GTK_LABEL (result), buffer);
+
+  g_timer_destroy (timer);
+}
+
+void
+create_resize_test (void)
+{
+  static GtkWidget *window = NULL;
+  GtkWidget *scrolled_window;
+  GtkWidget *vbox;
+  GtkWidget *hbox;
+  GtkWidget *label;
+  GtkWidget *result;
+  GtkWidget *button;
+  gchar buffer[32];
+  gint i, j;
+
+  if (!window)
+    {
+      window = gtk_dialog_new ();
+
+      gtk_signal_connect (GTK_OBJECT (window), "destroy",
+			  GTK_SIGNAL_FUNC(gtk_widget_destroyed),
+			  &window);
+
+      gtk_window_set_title (GTK_WINDOW (window), "Resize Test");
+      gtk_container_set_border_width (GTK_CONTAINER (window), 0);
+      gtk_window_set_default_size (GTK_WINDOW (window), 400, 300);
+
+      result = gtk_label_new ("");
+      gtk_misc_set_padding (GTK_MISC (result), 10, 10);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  result, FALSE, FALSE, 0);
+      gtk_widget_show (result);
+
+      scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+				      GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  scrolled_window, TRUE, TRUE, 0);
+      gtk_widget_show (scrolled_window);
+
+      vbox = gtk_vbox_new (FALSE, 0);
+      gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW (scrolled_window),
+					     vbox);
+      gtk_widget_show (vbox);
+
+      /* RESIZE_TEST_ROWS * RESIZE_TEST_COLUMNS labels, of which
+       * only the one in the middle gets changed
+       */
+      for (i = 0; i < RESIZE_TEST_ROWS; i++)
+	{
+	  hbox = gtk_hbox_new (TRUE, 4);
+	  gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 0);
+	  gtk_widget_show (hbox);
+
+	  for (j = 0; j < RESIZE_TEST_COLUMNS; j++)
+	    {
+	      sprintf (buffer, "%d", (i * RESIZE_TEST_COLUMNS + j) % 1000);
+	      label = gtk_label_new (buffer);
+	      gtk_box_pack_start (GTK_BOX (hbox), label, TRUE, TRUE, 0);
+	      gtk_widget_show (label);
+
+	      if (i == RESIZE_TEST_ROWS / 2 && j == RESIZE_TEST_COLUMNS / 2)
+		gtk_object_set_data (GTK_OBJECT (window), "relabel", label);
+	    }
+	}
+
+      button = gtk_button_new_with_label ("close");
+      gtk_signal_connect_object (GTK_OBJECT (button), "clicked",
+				 GTK_SIGNAL_FUNC(gtk_widget_destroy),
+				 GTK_OBJECT (window));
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_grab_default (button);
+      gtk_widget_show (button);
+
+      button = gtk_button_new_with_label ("relabel");
+      gtk_signal_connect (GTK_OBJECT (button), "clicked",
+			  GTK_SIGNAL_FUNC(resize_test_relabel),
+			  result);
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_show (button);
+    }
+
+  if (!GTK_WIDGET_VISIBLE (window))
+    gtk_widget_show (window);
+  else
+    gtk_widget_destroy (window);
+}
+
+/*
+ * CList Drawing Test
+ */
+
+#define CLIST_DRAW_TEST_ROWS     5000
+#define CLIST_DRAW_TEST_COLUMNS  20
+#define CLIST_DRAW_TEST_PAGES    50
+
+/* A GtkCList whose draw_row can be swapped for one that just chains
+ * up.  With that in place the list draws row by row, as it did before
+ * rows were drawn in batches, so both ways can be compared. */
+static void (*clist_draw_test_parent_draw_row) (GtkCList     *clist,
+						GdkRectangle *area,
+						gint          row,
+						GtkCListRow  *clist_row);
+
+static void
+clist_draw_test_draw_row (GtkCList     *clist,
+			  GdkRectangle *area,
+			  gint          row,
+			  GtkCListRow  *clist_row)
+{
+  clist_draw_test_parent_draw_row (clist, area, row, clist_row);
+}
+
+static void
+clist_draw_test_class_init (GtkCListClass *klass)
+{
+  clist_draw_test_parent_draw_row = klass->draw_row;
+}
+
+static GtkType
+clist_draw_test_get_type (void)
+{
+  static GtkType type = 0;
+
+  if (!type)
+    {
+      static const GtkTypeInfo info =
+      {
+	"TestCListDraw",
+	sizeof (GtkCList),
+	sizeof (GtkCListClass),
+	(GtkClassInitFunc) clist_draw_test_class_init,
+	(GtkObjectInitFunc) NULL,
+	/* reserved_1 */ NULL,
+	/* reserved_2 */ NULL,
+	(GtkClassInitFunc) NULL,
+      };
+
+      type = gtk_type_unique (GTK_TYPE_CLIST, &info);
+    }
+
+  return type;
+}
+
+/* scrolls the list page by page, returns the number of pages */
+static gint
+clist_draw_test_run (GtkCList *clist,
+		     gulong   *requests,
+		     gdouble  *msecs)
+{
+  GtkAdjustment *adj;
+  GTimer *timer;
+  gfloat value;
+  gint pages;
+
+  adj = gtk_clist_get_vadjustment (clist);
+
+  gtk_adjustment_set_value (adj, adj->lower);
+  gdk_flush ();
+
+  /* every page is redrawn synchronously from value_changed, so the
+   * requests sent in between are the ones drawing the rows */
+  *requests = XNextRequest (GDK_DISPLAY ());
+  timer = g_timer_new ();
+  for (pages = 0; pages < CLIST_DRAW_TEST_PAGES; pages++)
+    {
+      value = MIN (adj->value + adj->page_size, adj->upper - adj->page_size);
+      if (value <= adj->value)
+	break;
+      gtk_adjustment_set_value (adj, value);
+    }
+  gdk_flush ();
+  g_timer_stop (timer);
+  *requests = XNextRequest (GDK_DISPLAY ()) - *requests;
+  *msecs = g_timer_elapsed (timer, NULL) * 1000.0;
+  g_timer_destroy (timer);
+
+  return pages;
+}
+
+void
+clist_draw_test_scroll (GtkWidget *widget,
+			GtkWidget *result)
+{
+  GtkWidget *window;
+  GtkCList *clist;
+  GtkCListClass *klass;
+  gulong row_requests, batch_requests;
+  gdouble row_msecs, batch_msecs;
+  gchar buffer[256];
+  gint pages;
+
+  window = gtk_widget_get_toplevel (widget);
+  clist = GTK_CLIST (gtk_object_get_data (GTK_OBJECT (window), "clist"));
+  klass = GTK_CLIST_CLASS (GTK_OBJECT (clist)->klass);
+
+  klass->draw_row = clist_draw_test_draw_row;
+  clist_draw_test_run (clist, &row_requests, &row_msecs);
+  klass->draw_row = clist_draw_test_parent_draw_row;
+  pages = clist_draw_test_run (clist, &batch_requests, &batch_msecs);
+
+  if (pages)
+    sprintf (buffer,
+	     "%d pages, per page:\n"
+	     "row by row: %lu X requests, %.3f ms\n"
+	     "batched: %lu X requests, %.3f ms",
+	     pages,
+	     row_requests / pages, row_msecs / pages,
+	     batch_requests / pages, batch_msecs / pages);
+  else
+    sprintf (buffer, "nothing to scroll");
+  gtk_label_set_text (GTK_LABEL (result), buffer);
+}
+
+void
+create_clist_draw_test (void)
+{
+  static GtkWidget *window = NULL;
+  GtkWidget *scrolled_window;
+  GtkWidget *clist;
+  GtkWidget *result;
+  GtkWidget *button;
+  gchar **rows[CLIST_DRAW_TEST_ROWS];
+  gint i, j;
+
+  if (!window)
+    {
+      window = gtk_dialog_new ();
+
+      gtk_signal_connect (GTK_OBJECT (window), "destroy",
+			  GTK_SIGNAL_FUNC(gtk_widget_destroyed),
+			  &window);
+
+      gtk_window_set_title (GTK_WINDOW (window), "CList Drawing Test");
+      gtk_container_set_border_width (GTK_CONTAINER (window), 0);
+      gtk_window_set_default_size (GTK_WINDOW (window), 600, 400);
+
+      result = gtk_label_new ("");
+      gtk_misc_set_padding (GTK_MISC (result), 10, 10);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  result, FALSE, FALSE, 0);
+      gtk_widget_show (result);
+
+      scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+				      GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  scrolled_window, TRUE, TRUE, 0);
+      gtk_widget_show (scrolled_window);
+
+      clist = gtk_type_new (clist_draw_test_get_type ());
+      gtk_clist_construct (GTK_CLIST (clist), CLIST_DRAW_TEST_COLUMNS, NULL);
+      gtk_object_set_data (GTK_OBJECT (window), "clist", clist);
+      gtk_container_add (GTK_CONTAINER (scrolled_window), clist);
+      gtk_widget_show (clist);
+
+      for (j = 0; j < CLIST_DRAW_TEST_COLUMNS; j++)
+	gtk_clist_set_column_width (GTK_CLIST (clist), j, 60);
+      gtk_clist_set_column_justification (GTK_CLIST (clist), 1,
+					  GTK_JUSTIFY_RIGHT);
+      gtk_clist_set_column_justification (GTK_CLIST (clist), 2,
+					  GTK_JUSTIFY_CENTER);
+
+      for (i = 0; i < CLIST_DRAW_TEST_ROWS; i++)
+	{
+	  rows[i] = g_new0 (gchar *, CLIST_DRAW_TEST_COLUMNS + 1);
+	  for (j = 0; j < CLIST_DRAW_TEST_COLUMNS; j++)
+	    rows[i][j] = g_strdup_printf ("%d.%d", i, j);
+	}
+      gtk_clist_append_rows (GTK_CLIST (clist), rows, CLIST_DRAW_TEST_ROWS);
+      for (i = 0; i < CLIST_DRAW_TEST_ROWS; i++)
+	g_strfreev (rows[i]);
+
+      /* a few selected rows, so more than one gc is in use */
+      for (i = 0; i < CLIST_DRAW_TEST_ROWS; i += 7)
+	gtk_clist_select_row (GTK_CLIST (clist), i, -1);
+
+      button = gtk_button_new_with_label ("close");
+      gtk_signal_connect_object (GTK_OBJECT (button), "clicked",
+				 GTK_SIGNAL_FUNC(gtk_widget_destroy),
+				 GTK_OBJECT (window));
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_grab_default (button);
+      gtk_widget_show (button);
+
+      button = gtk_button_new_with_label ("scroll");
+      gtk_signal_connect (GTK_OBJECT (button), "clicked",
+			  GTK_SIGNAL_FUNC(clist_draw_test_scroll),
+			  result);
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_show (button);
+    }
+
+  if (!GTK_WIDGET_VISIBLE (window))
+    gtk_widget_show (window);
+  else
+    gtk_widget_destroy (window);
+}
+
+/*
+ * Text Stream Test
+ */
+
+#define TEXT_STREAM_TEST_LINES      200000
+#define TEXT_STREAM_TEST_MAX_LINES  2000
+
+static gint text_stream_test_line = 0;
+
+gint
+text_stream_test_produce (GtkText *text,
+			  gchar   *buffer,
+			  gint     length,
+			  gpointer data)
+{
+  gchar line[80];
+  gint n = 0;
+  gint len;
+
+  if (text_stream_test_line >= TEXT_STREAM_TEST_LINES)
+    return -1;
+
+  while (text_stream_test_line < TEXT_STREAM_TEST_LINES)
+    {
+      len = sprintf (line, "line %d: the quick brown fox jumps over the lazy dog\n",
+		     text_stream_test_line);
+      if (n + len > length)
+	break;
+      memcpy (buffer + n, line, len);
+      n += len;
+      text_stream_test_line++;
+    }
+
+  sprintf (line, "%d lines streamed, last %d kept",
+	   text_stream_test_line, TEXT_STREAM_TEST_MAX_LINES);
+  gtk_label_set_text (GTK_LABEL (data), line);
+
+  return n;
+}
+
+void
+text_stream_test_start (GtkWidget *widget,
+			GtkWidget *text)
+{
+  text_stream_test_line = 0;
+
+  gtk_editable_delete_text (GTK_EDITABLE (text), 0, -1);
+  gtk_text_stream_func (GTK_TEXT (text), text_stream_test_produce,
+			gtk_object_get_data (GTK_OBJECT (text), "result"),
+			NULL);
+}
+
+void
+create_text_stream_test (void)
+{
+  static GtkWidget *window = NULL;
+  GtkWidget *hbox;
+  GtkWidget *text;
+  GtkWidget *vscrollbar;
+  GtkWidget *result;
+  GtkWidget *button;
+
+  if (!window)
+    {
+      window = gtk_dialog_new ();
+
+      gtk_signal_connect (GTK_OBJECT (window), "destroy",
+			  GTK_SIGNAL_FUNC(gtk_widget_destroyed),
+			  &window);
+
+      gtk_window_set_title (GTK_WINDOW (window), "Text Stream Test");
+      gtk_container_set_border_width (GTK_CONTAINER (window), 0);
+      gtk_window_set_default_size (GTK_WINDOW (window), 500, 400);
+
+      result = gtk_label_new ("");
+      gtk_misc_set_padding (GTK_MISC (result), 10, 10);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  result, FALSE, FALSE, 0);
+      gtk_widget_show (result);
+
+      hbox = gtk_hbox_new (FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  hbox, TRUE, TRUE, 0);
+      gtk_widget_show (hbox);
+
+      text = gtk_text_new (NULL, NULL);
+      gtk_object_set_data (GTK_OBJECT (text), "result", result);
+      gtk_text_set_max_lines (GTK_TEXT (text), TEXT_STREAM_TEST_MAX_LINES);
+      gtk_box_pack_start (GTK_BOX (hbox), text, TRUE, TRUE, 0);
+      gtk_widget_show (text);
+
+      vscrollbar = gtk_vscrollbar_new (GTK_TEXT (text)->vadj);
+      gtk_box_pack_start (GTK_BOX (hbox), vscrollbar, FALSE, FALSE, 0);
+      gtk_widget_show (vscrollbar);
+
+      button = gtk_button_new_with_label ("close");
+      gtk_signal_connect_object (GTK_OBJECT (button), "clicked",
+				 GTK_SIGNAL_FUNC(gtk_widget_destroy),
+				 GTK_OBJECT (window));
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_grab_default (button);
+      gtk_widget_show (button);
+
+      button = gtk_button_new_with_label ("start");
+      gtk_signal_connect (GTK_OBJECT (button), "clicked",
+			  GTK_SIGNAL_FUNC(text_stream_test_start),
+			  text);
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_show (button);
+
+      button = gtk_button_new_with_label ("stop");
+      gtk_signal_connect_object (GTK_OBJECT (button), "clicked",
+				 GTK_SIGNAL_FUNC(gtk_text_stream_stop),
+				 GTK_OBJECT (text));
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_show (button);
+    }
+
+  if (!GTK_WIDGET_VISIBLE (window))
+    gtk_widget_show (window);
+  else
+    gtk_widget_destroy (window);
+}
+
+/*
+ * Text Storage Test
+ */
+
+#define TEXT_STORAGE_TEST_LINES  100000
+#define TEXT_STORAGE_TEST_CJK     1000
+/* One line in this many names its user in CJK characters */
+
+static guint
+text_storage_test_fill (GdkFont     *fontset,
+			gboolean     compact,
+			const gchar *cjk,
+			gdouble     *seconds)
+{
+  GtkWidget *text;
+  GtkStyle *style;
+  GTimer *timer;
+  gchar line[80];
+  guint bytes;
+  gint i;
+
+  text = gtk_text_new (NULL, NULL);
+  gtk_object_ref (GTK_OBJECT (text));
+  gtk_object_sink (GTK_OBJECT (text));
+
+  style = gtk_style_new ();
+  gdk_font_unref (style->font);
+  style->font = fontset;
+  gdk_font_ref (fontset);
+  gtk_widget_set_style (text, style);
+  gtk_style_unref (style);
+
+  gtk_text_set_compact_storage (GTK_TEXT (text), compact);
+
+  timer = g_timer_new ();
+  gtk_text_freeze (GTK_TEXT (text));
+  for (i = 0; i < TEXT_STORAGE_TEST_LINES; i++)
+    {
+      if (cjk && i % TEXT_STORAGE_TEST_CJK == 0)
+	sprintf (line, "%06d: user %s logged in\n", i, cjk);
+      else
+	sprintf (line, "%06d: connection from 10.0.0.%d accepted\n", i, i % 256);
+      gtk_text_insert (GTK_TEXT (text), NULL, NULL, NULL, line, -1);
+    }
+  gtk_text_thaw (GTK_TEXT (text));
+  g_timer_stop (timer);
+
+  *seconds = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  bytes = GTK_TEXT (text)->text_len;
+
+  gtk_widget_destroy (text);
+  gtk_object_unref (GTK_OBJECT (text));
+
+  return bytes;
+}
+
+void
+text_storage_test_run (GtkWidget *widget,
+		       GtkWidget *result)
+{
+  static GdkWChar cjk_wc[] = { 0x5c71, 0x7530, 0x592a, 0x90ce, 0 };
+  GdkFont *fontset;
+  gdouble wide_time, compact_time;
+  guint wide_bytes, compact_bytes;
+  gchar *cjk;
+  gchar buffer[256];
+
+  fontset = gdk_fontset_load ("-*-fixed-medium-r-normal--*-120-*-*-*-*-*-*");
+  if (!fontset)
+    {
+      gtk_label_set_text (GTK_LABEL (result), "couldn't load a fontset");
+      return;
+    }
+
+  /* NULL if the locale has no way of writing them */
+  cjk = gdk_wcstombs (cjk_wc);
+
+  wide_bytes = text_storage_test_fill (fontset, FALSE, cjk, &wide_time);
+  compact_bytes = text_storage_test_fill (fontset, TRUE, cjk, &compact_time);
+
+  gdk_font_unref (fontset);
+
+  sprintf (buffer,
+	   "%d lines, %s\n"
+	   "GdkWChar: %u bytes, %.3f s\n"
+	   "compact: %u bytes, %.3f s",
+	   TEXT_STORAGE_TEST_LINES,
+	   cjk ? "some with CJK" : "all ASCII (no CJK in this locale)",
+	   wide_bytes, wide_time,
+	   compact_bytes, compact_time);
+  g_free (cjk);
+  gtk_label_set_text (GTK_LABEL (result), buffer);
+}
+
+void
+create_text_storage_test (void)
+{
+  static GtkWidget *window = NULL;
+  GtkWidget *result;
+  GtkWidget *button;
+
+  if (!window)
+    {
+      window = gtk_dialog_new ();
+
+      gtk_signal_connect (GTK_OBJECT (window), "destroy",
+			  GTK_SIGNAL_FUNC(gtk_widget_destroyed),
+			  &window);
+
+      gtk_window_set_title (GTK_WINDOW (window), "Text Storage Test");
+      gtk_container_set_border_width (GTK_CONTAINER (window), 0);
+
+      result = gtk_label_new ("Fill a GtkText with a fontset, "
+			      "with and without compact storage");
+      gtk_misc_set_padding (GTK_MISC (result), 10, 10);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  result, TRUE, TRUE, 0);
+      gtk_widget_show (result);
+
+      button = gtk_button_new_with_label ("close");
+      gtk_signal_connect_object (GTK_OBJECT (button), "clicked",
+				 GTK_SIGNAL_FUNC(gtk_widget_destroy),
+				 GTK_OBJECT (window));
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_grab_default (button);
+      gtk_widget_show (button);
+
+      button = gtk_button_new_with_label ("run");
+      gtk_signal_connect (GTK_OBJECT (button), "clicked",
+			  GTK_SIGNAL_FUNC(text_storage_test_run),
+			  result);
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_show (button);
+    }
+
+  if (!GTK_WIDGET_VISIBLE (window))
+    gtk_widget_show (window);
+  else
+    gtk_widget_destroy (window);
+}
+
+/*
+ * File Completion Test
+ */
+
+#define FILE_COMPLETION_TEST_ENTRIES      200000
+#define FILE_COMPLETION_TEST_COMPLETIONS  1000
+
+void
+file_completion_test_run (GtkWidget *widget,
+			  GtkWidget *result)
+{
+  GtkWidget *filesel;
+  GTimer *timer;
+  gchar *dir_name;
+  gchar *file_name;
+  gchar pattern[16];
+  gchar buffer[256];
+  gdouble create_time, load_time, complete_time;
+  FILE *file;
+  gint i;
+
+  dir_name = g_strdup_printf ("%s/testgtk-completion-%d",
+			      g_get_tmp_dir (), (int) getpid ());
+  if (mkdir (dir_name, 0700) < 0)
+    {
+      gtk_label_set_text (GTK_LABEL (result), "couldn't create a directory");
+      g_free (dir_name);
+      return;
+    }
+
+  timer = g_timer_new ();
+  for (i = 0; i < FILE_COMPLETION_TEST_ENTRIES; i++)
+    {
+      file_name = g_strdup_printf ("%s/%06d", dir_name, i);
+      file = fopen (file_name, "w");
+      if (file)
+	fclose (file);
+      g_free (file_name);
+    }
+  create_time = g_timer_elapsed (timer, NULL);
+
+  /* The first listing reads the directory */
+  filesel = gtk_file_selection_new ("file completion test");
+  file_name = g_strconcat (dir_name, "/", NULL);
+  g_timer_start (timer);
+  gtk_file_selection_set_filename (GTK_FILE_SELECTION (filesel), file_name);
+  load_time = g_timer_elapsed (timer, NULL);
+  g_free (file_name);
+
+  /* Each of these matches ten entries */
+  g_timer_start (timer);
+  for (i = 0; i < FILE_COMPLETION_TEST_COMPLETIONS; i++)
+    {
+      sprintf (pattern, "%05d", (i * 7919) % (FILE_COMPLETION_TEST_ENTRIES / 10));
+      gtk_file_selection_complete (GTK_FILE_SELECTION (filesel), pattern);
+    }
+  g_timer_stop (timer);
+  complete_time = g_timer_elapsed (timer, NULL);
+
+  gtk_widget_destroy (filesel);
+  g_timer_destroy (timer);
+
+  for (i = 0; i < FILE_COMPLETION_TEST_ENTRIES; i++)
+    {
+      file_name = g_strdup_printf ("%s/%06d", dir_name, i);
+      unlink (file_name);
+      g_free (file_name);
+    }
+  rmdir (dir_name);
+  g_free (dir_name);
+
+  sprintf (buffer,
+	   "%d files created in %.3f s\n"
+	   "listed in %.3f s\n"
+	   "%.3f ms per completion",
+	   FILE_COMPLETION_TEST_ENTRIES, create_time, load_time,
+	   complete_time * 1000.0 / FILE_COMPLETION_TEST_COMPLETIONS);
+  gtk_label_set_text (GTK_LABEL (result), buffer);
+}
+
+void
+create_file_completion_test (void)
+{
+  static GtkWidget *window = NULL;
+  GtkWidget *result;
+  GtkWidget *button;
+
+  if (!window)
+    {
+      window = gtk_dialog_new ();
+
+      gtk_signal_connect (GTK_OBJECT (window), "destroy",
+			  GTK_SIGNAL_FUNC(gtk_widget_destroyed),
+			  &window);
+
+      gtk_window_set_title (GTK_WINDOW (window), "File Completion Test");
+      gtk_container_set_border_width (GTK_CONTAINER (window), 0);
+
+      result = gtk_label_new ("Complete file names in a directory of "
+			      "200000 files");
+      gtk_misc_set_padding (GTK_MISC (result), 10, 10);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->vbox),
+			  result, TRUE, TRUE, 0);
+      gtk_widget_show (result);
+
+      button = gtk_button_new_with_label ("close");
+      gtk_signal_connect_object (GTK_OBJECT (button), "clicked",
+				 GTK_SIGNAL_FUNC(gtk_widget_destroy),
+				 GTK_OBJECT (window));
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_grab_default (button);
+      gtk_widget_show (button);
+
+      button = gtk_button_new_with_label ("run");
+      gtk_signal_connect (GTK_OBJECT (button), "clicked",
+			  GTK_SIGNAL_FUNC(file_completion_test_run),
+			  result);
+      GTK_WIDGET_SET_FLAGS (button, GTK_CAN_DEFAULT);
+      gtk_box_pack_start (GTK_BOX (GTK_DIALOG (window)->action_area), 
+			  button, TRUE, TRUE, 0);
+      gtk_widget_show (button);
+    }
+
+  if (!GTK_WIDGET_VISIBLE (window))
+    gtk_widget_show (window);
+  else
+    gtk_widget_destroy (window);
+}
+
 gint
 layout_expose_handler (GtkWidget *widget, GdkEventExpose *event)
 {
@@ -8289,16 +9127,22 @@ create_main_window (void)
       { "shapes", create_shapes },
       { "spinbutton", create_spins },
       { "statusbar", create_statusbar },
+      { "test clist drawing", create_clist_draw_test },
+      { "test file completion", create_file_completion_test },
       { "test idle", create_idle_test },
       { "test mainloop", create_mainloop },
+      { "test resize", create_resize_test },
       { "test scrolling", create_scroll_test },
       { "test selection", create_selection_test },
+      { "test text stream", create_text_stream_test },
+      { "test text storage", create_text_storage_test },
       { "test timeout", create_timeout_test },
       { "text", create_text },
       { "toggle buttons", create_toggle_buttons },
       { "toolbar", create_toolbar },
       { "tooltips", create_tooltips },
       { "tree", create_tree_mode_window},
+      { "virtual clist", create_virtual_clist },
       { "WM hints", create_wmhints },
     };
   int nbuttons = sizeof (buttons) / sizeof (buttons[0]);